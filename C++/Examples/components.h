@@ -72,10 +72,10 @@ public:
   }
    
   // Get the value of an attribute:  If it's not in the table,
-  // return the default
+  // return the default.  Only reads, so many threads can get at once.
   Val get (const string& attr_name, const Val& defalt=None)
   {
-    TransactionLock tl(attrs);
+    TransactionLock tl(attrs, TransactionLock::READ);
     Tab& t = attrs;
     if (t.contains(attr_name))
       return t(attr_name);
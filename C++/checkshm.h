@@ -172,6 +172,19 @@ inline bool InSHM (const int_un& t, StreamingPool* sp,
 { return TopLevelSHMCheck_(t, sp, throw_on_error, "int_n"); }
 
 
+// Get the container inside a Val (or inside its Proxy) WITHOUT
+// going through the Tab&, Arr&, etc. conversions: we are only
+// looking, so a copy-on-write Proxy shouldn't detach a copy.
+template <class T>
+inline T& SHMBody_ (const Val& v, T*)
+{
+  if (v.isproxy) {
+    Proxy* pp = (Proxy*)&v.u.P;
+    return *(T*)pp->data_();
+  }
+  return *(T*)&v.u.t;
+}
+
 // Check and see if given Val is in shared memory
 inline bool InSHM (const Val& v, StreamingPool* sp, 
 		   bool throw_on_error, const char *error_context)
@@ -204,16 +217,16 @@ inline bool InSHM (const Val& v, StreamingPool* sp,
   // Complex containers
   case 'a': { OCString*p=(OCString*)&v.u.a;return InSHM(*p,sp,throw_on_error); }
 
-    // Use the implict conversion so it'll handle Proxys okay
-  case 't': { Tab&  t=v;  return InSHM(t,sp,throw_on_error);break; }
-  case 'o': { OTab& o=v;  return InSHM(o,sp,throw_on_error);break; }
-  case 'u': { Tup&  u=v;  return InSHM(u,sp,throw_on_error);break; }
+    // Use SHMBody_ so it'll handle Proxys okay
+  case 't': { Tab&  t=SHMBody_(v,(Tab*)0);  return InSHM(t,sp,throw_on_error);break; }
+  case 'o': { OTab& o=SHMBody_(v,(OTab*)0); return InSHM(o,sp,throw_on_error);break; }
+  case 'u': { Tup&  u=SHMBody_(v,(Tup*)0);  return InSHM(u,sp,throw_on_error);break; }
   case 'q': { int_n* ip=(int_n*)&v.u.q;  return InSHM(*ip,sp,throw_on_error);break; }
   case 'Q': { int_un*ip=(int_un*)&v.u.Q; return InSHM(*ip,sp,throw_on_error);break; }
   case 'n': {
     switch(v.subtype) {
     case 'Z': {
-      Arr& a = v; return InSHM(a, sp, throw_on_error); break;
+      Arr& a = SHMBody_(v,(Arr*)0); return InSHM(a, sp, throw_on_error); break;
     } 
     case 's': 
     case 'S': 
@@ -230,9 +243,8 @@ inline bool InSHM (const Val& v, StreamingPool* sp,
     case 'D': // Type doesn't matter, just need the allocator, as that'll
               //  check everything for us
     {
-      if (v.isproxy) { throw runtime_error("not handled yet!"); }
-      Array<int_1> *ap = (Array<int_1>*)&v.u.n;
-      return InSHM(*ap, sp, throw_on_error);
+      Array<int_1>& a = SHMBody_(v, (Array<int_1>*)0);
+      return InSHM(a, sp, throw_on_error);
       break;
     }
     default:
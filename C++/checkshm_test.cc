@@ -122,8 +122,24 @@ int lookup (StreamingPool *sp, size_t bytes, bool how)
       cout  << e.what() << endl;
     }
   }
-  
-  
+
+  {
+    // A copy-on-write table in shared memory: copies share it, and
+    // a write detaches a copy from the same shared memory
+    Tab* tp = (Tab*)sp->allocate(sizeof(Tab));
+    new (tp) Tab(Tab("{'a':1, 'b':[1,2,3]}"), sp);
+    Val v = CopyOnWrite(tp);
+    Val copy = v;
+    try {
+      cout << InSHM(v, sp, how, "top-level") << " : " << v << endl;
+      cout << "still shared:" << is(v, copy) << endl;
+      copy["c"] = "three";
+      cout << InSHM(copy, sp, how, "top-level") << " : " << copy << endl;
+      cout << "still shared:" << is(v, copy) << endl;
+    } catch (exception& e) {
+      cout << e.what() << endl;
+    }
+  }
 
   return 0;
 }
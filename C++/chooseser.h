@@ -42,6 +42,7 @@
 #include "valprotocol2.h"
 #include "m2ser.h"
 #include "ocserialize.h"
+#include "ocvalarena.h"
 #include "pickleloader.h"
 #include "ocvalreader.h"
 #include "xmltools.h"
@@ -62,6 +63,8 @@ enum Serialization_e {
   SERIALIZE_PYTHONPRETTY = 7, // ... alias to indicate printing Python dicts
   SERIALIZE_OPALPRETTY = 8,   // ... print an OpalTable pretty
   SERIALIZE_OPALTEXT = 9,     // ... print as Opal WITHOUT pretty indent
+  SERIALIZE_PYTHON_PICKLING_PROTOCOL_4 = 10, // Python 3.4 and up 
+  SERIALIZE_PYTHON_PICKLING_PROTOCOL_5 = 11, // Python 3.8 and up
 
   SERIALIZE_TEXT = 6,         // Will stringize on DUMP, Eval on LOAD
   SERIALIZE_PRETTY = 7,       // Will prettyPrint on DUMP, Eval on LOAD
@@ -73,6 +76,8 @@ enum Serialization_e {
   SERIALIZE_NONE   = SERIALIZE_SEND_STRINGS_AS_IS_WITHOUT_SERIALIZATION,
   SERIALIZE_P0     = SERIALIZE_PYTHON_PICKLING_PROTOCOL_0, 
   SERIALIZE_P2     = SERIALIZE_PYTHON_PICKLING_PROTOCOL_2, 
+  SERIALIZE_P4     = SERIALIZE_PYTHON_PICKLING_PROTOCOL_4, 
+  SERIALIZE_P5     = SERIALIZE_PYTHON_PICKLING_PROTOCOL_5, 
   SERIALIZE_M2K    = SERIALIZE_MIDAS2K_BINARY,
   SERIALIZE_OC     = SERIALIZE_OPENCONTAINERS, 
 
@@ -189,12 +194,23 @@ inline void DumpValToArray (const Val& given, Array<char>& dump,
       issues = PicklingIssues_e(int(issues)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR));
     }
     
-    int bytes = P2TopLevelBytesToDumpVal(given, arrdisp, issues);
-    dump.expandTo(bytes); // overestimate
-    char* mem = dump.data();
-    char* rest = P2TopLevelDumpVal(given, mem, arrdisp, issues);
-    int len = rest-mem;   // exact
-    dump.expandTo(len);
+    // Single pass: no walk over the Val first to size the buffer
+    dump.expandTo(0);
+    P2TopLevelDumpValToArray(given, dump, arrdisp, issues);
+    break;
+  }
+  case SERIALIZE_P4: case SERIALIZE_P5: {
+    if (arrdisp==AS_PYTHON_ARRAY) {
+      throw runtime_error("SERIALIZE_P4/P5 don't support AS_PYTHON_ARRAY");
+    }
+    PicklingIssues_e issues = ABOVE_PYTHON_2_2;
+    if (conv) {
+      issues = PicklingIssues_e(int(issues)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR));
+    }
+    // Everything in-band: see DumpValToArrayP5 for out-of-band
+    dump.expandTo(0);
+    P4TopLevelDumpValToArray(given, dump, (ser==SERIALIZE_P5) ? 5 : 4, 
+			     arrdisp, issues);
     break;
   }
   case SERIALIZE_M2K: {
@@ -227,13 +243,10 @@ inline void DumpValToArray (const Val& given, Array<char>& dump,
     break;
   }
   case SERIALIZE_OC: {
-    // The OC, if we request conversion, does it in place so its faster
-    int bytes = BytesToSerialize(given, conv);
-    dump.expandTo(bytes); // overestimate
-    char* mem = dump.data();
-    char* rest = Serialize(given, mem, conv);
-    int len = rest-mem;
-    dump.expandTo(len);   // exact
+    // The OC, if we request conversion, does it in place so its faster.
+    // Single pass: no walk over the Val first to size the buffer
+    dump.expandTo(0);
+    SerializeToArray(given, dump, conv);
     break;
   }
     //case SERIALIZE_TEXT: {
@@ -305,7 +318,10 @@ inline void DumpValToArray (const Val& given, Array<char>& dump,
 
 }
 
-// Load a Val from an array containing serialized data. 
+// Load a Val from an array containing serialized data.  If result
+// uses an allocator (for example, it's the root of a ValArena: see
+// ocvalarena.h), the Val is built with that allocator: every loader
+// builds directly into it (under an AllocatorScope).
 inline void LoadValFromArray (const Array<char>& dump, Val& result,
 			      Serialization_e ser=SERIALIZE_P0,
 			      ArrayDisposition_e array_disposition=AS_LIST,
@@ -315,9 +331,19 @@ inline void LoadValFromArray (const Array<char>& dump, Val& result,
   bool conv = perform_conversion_of_OTabTupBigInt_to_TabArrStr;
   char* mem = const_cast<char*>(dump.data());
   int   len = dump.length();
+  Allocator* alloc = result.allocator();
+  if (alloc && ser!=SERIALIZE_OC) {
+    AllocatorScope scope(alloc);
+    Val loaded;
+    LoadValFromArray(dump, loaded, ser, array_disposition, conv, endian);
+    result.swap(loaded);
+    result.a = alloc;  // everything in it came from alloc: keep it
+    return;
+  }
   switch (ser) {
     // The new loader supports both versions: P0, P2 (and P1 to a certain ex).
-  case SERIALIZE_P0: case SERIALIZE_P2: {
+  case SERIALIZE_P0: case SERIALIZE_P2: 
+  case SERIALIZE_P4: case SERIALIZE_P5: {
     PickleLoader pl(mem, len);
     pl.env()["supportsNumeric"] = (array_disposition==AS_NUMERIC);
     //cout << pl.env() << endl;
@@ -390,6 +416,126 @@ inline void LoadValFromArray (const Array<char>& dump, Val& result,
   }
 }
 
+// Like DumpValToArray, but stream the dump to the given sink (a file
+// descriptor, a FILE*, ... see ocdumpsink.h) a chunk at a time as it
+// is encoded, so the whole dump is never in memory at once.  The
+// bytes are exactly what DumpValToArray gives.  SERIALIZE_OC,
+// SERIALIZE_P2 (all flavors) and SERIALIZE_M2K stream; the others are
+// dumped to an Array first, then written.
+inline void DumpValToSink (const Val& given, DumpSink& sink,
+			   Serialization_e ser=SERIALIZE_P0,
+			   ArrayDisposition_e arrdisp=AS_LIST,
+			   bool perform_conversion_of_OTabTupBigInt_to_TabArrStr = false,
+			   MachineRep_e endian=MachineRep_EEEI)
+{
+  bool conv = perform_conversion_of_OTabTupBigInt_to_TabArrStr;
+  switch (ser) {
+  case SERIALIZE_P2: case SERIALIZE_P2_OLDIMPL: case SERIALIZE_P2_OLD: {
+    if (arrdisp==AS_PYTHON_ARRAY) break; // for the deprecation warning
+    PicklingIssues_e issues = 
+      ((ser==SERIALIZE_P2_OLD) ? AS_PYTHON_2_2 : ABOVE_PYTHON_2_2);
+    if (conv) {
+      issues = PicklingIssues_e(int(issues)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR));
+    }
+    P2TopLevelDumpValToSink(given, sink, arrdisp, issues);
+    return;
+  }
+  case SERIALIZE_P4: case SERIALIZE_P5: {
+    if (arrdisp==AS_PYTHON_ARRAY) break; // for the error
+    PicklingIssues_e issues = ABOVE_PYTHON_2_2;
+    if (conv) {
+      issues = PicklingIssues_e(int(issues)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR));
+    }
+    P4TopLevelDumpValToSink(given, sink, (ser==SERIALIZE_P5) ? 5 : 4, 
+			    arrdisp, issues);
+    return;
+  }
+  case SERIALIZE_M2K: {
+    // Same forcing to a table as DumpValToArray
+    if (given.tag=='n' && given.subtype == 'Z') {
+      OpalDumpArr(given, sink, endian); 
+    } else if (given.tag=='t') {
+      OpalDumpTab(given, sink, endian); 
+    } else if (given.tag=='o') {
+      OpalDumpOTab(given, sink, endian); 
+    } else if (given.tag=='u') {
+      OpalDumpTup(given, sink, endian); 
+    } else {
+      Tab special;
+      special["__SPECIAL__"] = given;
+      OpalDumpTab(special, sink, endian);
+    }
+    return;
+  }
+  case SERIALIZE_OC: {
+    SerializeToSink(given, sink, conv);
+    return;
+  }
+  default: break;
+  }
+
+  // Everything else goes through an Array
+  Array<char> buff;
+  DumpValToArray(given, buff, ser, arrdisp, conv, endian);
+  sink.write(buff.data(), buff.length());
+}
+
+// Pickling Protocol 5 with out-of-band buffers: like
+// DumpValToArray(given, dump, SERIALIZE_P5, arrdisp, ...), but the data
+// of every POD Array (dumped AS_NUMPY) stays out of the dump: a
+// PickleBuffer pointing at it is appended to out_of_band instead (see
+// valprotocol2.h), so big arrays are never copied.  Send the buffers
+// along with the dump (in order), and leave given alone until they've
+// gone.  Python loads it with pickle.loads(dump, buffers=...).
+inline void DumpValToArrayP5 (const Val& given, Array<char>& dump,
+			      Array<PickleBuffer>& out_of_band,
+			      ArrayDisposition_e arrdisp=AS_NUMPY,
+			      bool perform_conversion_of_OTabTupBigInt_to_TabArrStr = false)
+{
+  if (arrdisp==AS_PYTHON_ARRAY) {
+    throw runtime_error("SERIALIZE_P5 doesn't support AS_PYTHON_ARRAY");
+  }
+  PicklingIssues_e issues = ABOVE_PYTHON_2_2;
+  if (perform_conversion_of_OTabTupBigInt_to_TabArrStr) {
+    issues = PicklingIssues_e(int(issues)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR));
+  }
+  dump.expandTo(0);
+  P4TopLevelDumpValToArray(given, dump, 5, arrdisp, issues, &out_of_band);
+}
+
+// Load a Pickling Protocol 5 dump that has out-of-band buffers (from
+// DumpValToArrayP5, or Python's pickle.dumps(..., protocol=5,
+// buffer_callback=...)): the buffers are given in order, and each
+// NumPy array takes over the memory of its buffer (which is left
+// empty) rather than copying it.  As with LoadValFromArray, if result
+// uses an allocator, the Val is built with that allocator: then the
+// buffers (from the heap) can't be taken over, so each NumPy array
+// gets a copy in the allocator's memory (see Array::giveMemoryTo).
+inline void LoadValFromArrayP5 (const Array<char>& dump, Val& result,
+				Array< Array<char> >& out_of_band,
+				ArrayDisposition_e array_disposition=AS_NUMPY,
+				bool perform_conversion_of_OTabTupBigInt_to_TabArrStr = false)
+{
+  Allocator* alloc = result.allocator();
+  if (alloc) {
+    AllocatorScope scope(alloc);
+    Val loaded;
+    LoadValFromArrayP5(dump, loaded, out_of_band, array_disposition,
+		       perform_conversion_of_OTabTupBigInt_to_TabArrStr);
+    result.swap(loaded);
+    result.a = alloc;  // everything in it came from alloc: keep it
+    return;
+  }
+  char* mem = const_cast<char*>(dump.data());
+  PickleLoader pl(mem, dump.length());
+  pl.env()["supportsNumeric"] = (array_disposition==AS_NUMERIC);
+  pl.outOfBand(&out_of_band);
+  pl.loads(result);
+  if (perform_conversion_of_OTabTupBigInt_to_TabArrStr) {
+    ConvertAllOTabTupBigIntToTabArrStr(result);
+  }
+}
+
 // A convenience function for dumping a Val to a file: if you want
 // finer control over a dump, use the particular serialization by
 // itself.  Dump a val to a file, using one of the serializations
@@ -402,15 +548,20 @@ inline void DumpValToFile (const Val& v, const string& filename,
 			   bool perform_conversion_of_OTabTupBigInt_to_TabArrStr = false,
 			   MachineRep_e endian=MachineRep_EEEI)
 {
-  Array<char> buff;
-  DumpValToArray(v, buff, ser, arrdisp,
-		 perform_conversion_of_OTabTupBigInt_to_TabArrStr, endian);
-  ofstream ofs(filename.c_str(), ios::out|ios::binary|ios::trunc);
-  if (ofs.good()) {
-    char* mem = buff.data();
-    int len = buff.length();
-    ofs.write(mem, len);
-  } else {
+  // Streams straight into the file (see DumpValToSink)
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (!fp) {
+    throw runtime_error("Trouble writing the file:"+filename);
+  }
+  try {
+    FILEDumpSink sink(fp);
+    DumpValToSink(v, sink, ser, arrdisp,
+		  perform_conversion_of_OTabTupBigInt_to_TabArrStr, endian);
+  } catch (...) {
+    fclose(fp);
+    throw;
+  }
+  if (fclose(fp)!=0) {
     throw runtime_error("Trouble writing the file:"+filename);
   }
 }
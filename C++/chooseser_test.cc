@@ -1,5 +1,6 @@
 
 #include "chooseser.h"
+#include "jsonprint.h"
 
 // Compare two tables based on serialization
 void Compare (const Val& in, const Val& out, Serialization_e ser, 
@@ -97,6 +98,98 @@ void TrialConv (Serialization_e dump_ser, const Val& in, int load_ser_int = -1)
 }
 
 
+// Protocol 5 with the POD arrays out-of-band
+void TrialOutOfBand ()
+{
+  cout << "*** Testing P5 out-of-band" << endl;
+  Val in = Tab("{'a':1, 'b':2.2, 'c':None, 'd': [1,2,'three'] }");
+  Array<real_8> a(5);
+  for (int ii=0; ii<5; ii++) a.append(ii*1.5);
+  in["e"] = a;
+  Array<int_2> b(3);
+  for (int ii=0; ii<3; ii++) b.append(-ii);
+  in["f"] = b;
+
+  Array<char> buff;
+  Array<PickleBuffer> out_of_band;
+  DumpValToArrayP5(in, buff, out_of_band);
+  cout << "buffers:" << out_of_band.length() << endl;
+
+  // What would be received on the other side
+  Array< Array<char> > received;
+  for (size_t ii=0; ii<out_of_band.length(); ii++) {
+    received.append(Array<char>());
+    for (size_t jj=0; jj<out_of_band[ii].bytes; jj++) {
+      received[ii].append(out_of_band[ii].data[jj]);
+    }
+  }
+  Array< Array<char> > received_again(received);
+  Val out;
+  LoadValFromArrayP5(buff, out, received);
+
+  Compare(in, out, SERIALIZE_P5, in);
+
+  // Into a ValArena: the buffers are from the heap, so the arrays get
+  // copies in the arena (a clear would never give the buffers back)
+  cout << "*** Testing P5 out-of-band into a ValArena" << endl;
+  ValArena arena;
+  LoadValFromArrayP5(buff, arena.root(), received_again);
+  Array<real_8>& e = arena.root()["e"];
+  Array<int_2>& f = arena.root()["f"];
+  if (e.allocator()!=arena.allocator() || f.allocator()!=arena.allocator()
+      || received_again[0].length()!=0) {
+    cerr << "Out-of-band arrays are not in the arena" << endl;
+    exit(1);
+  }
+  Compare(in, arena.root(), SERIALIZE_P5, in);
+}
+
+// Dumping only reads, so copy-on-write proxies stay shared
+void TrialCopyOnWrite (Serialization_e ser)
+{
+  cout << "*** Testing copy-on-write:" << int(ser) << endl;
+  Val config = CopyOnWrite(new Tab("{'a':1, 'b':[1,2,3]}"));
+  Val in = Tab();
+  in["one"] = config;
+  in["two"] = config;
+
+  Array<char> buff;
+  DumpValToArray(in, buff, ser);
+  if (!is(in("one"), config) || !is(in("two"), config)) {
+    cerr << "Dump detached a copy-on-write proxy:" << int(ser) << endl;
+    exit(1);
+  }
+  Val out;
+  LoadValFromArray(buff, out, ser);
+
+  Compare(in, out, ser, in);
+}
+
+// ... and so does printing as JSON or XML
+void TrialCopyOnWritePrint ()
+{
+  cout << "*** Testing copy-on-write: JSON and XML" << endl;
+  Val config = CopyOnWrite(new Tab("{'a':1, 'b':[1,2,3], 'c':(1,2)}"));
+  Val list = CopyOnWrite(new Arr("[1, 2]"));
+  Val in = Tab();
+  in["one"] = config;
+  in["two"] = config;
+  in["list"] = list;
+  const Val keep_config = config, keep_list = list;
+
+  ostringstream os;
+  JSONPrint(in, os);
+  XMLDumper xd(os, XML_DUMP_PRETTY);
+  xd.XMLDumpKeyValue("top", in);
+  XMLDumper xl(os, XML_DUMP_PRETTY);
+  xl.XMLDumpKeyValue("top", list);
+  if (!is(in("one"), keep_config) || !is(in("list"), keep_list) ||
+      !is(list, keep_list)) {
+    cerr << "Printing detached a copy-on-write proxy" << endl;
+    exit(1);
+  }
+}
+
 void TrialFile (Serialization_e ser)
 {
   cout << "*** Testing File:" << int(ser) << endl;
@@ -118,12 +211,21 @@ int main ()
   Trial(SERIALIZE_P0_OLDIMPL);
   Trial(SERIALIZE_P2);
   Trial(SERIALIZE_P2_OLDIMPL);
+  Trial(SERIALIZE_P4);
+  Trial(SERIALIZE_P5);
   Trial(SERIALIZE_P2_OLD);
   Trial(SERIALIZE_M2K);
   Trial(SERIALIZE_OC);
   Trial(SERIALIZE_TEXT);
   Trial(SERIALIZE_PRETTY);
   Trial(SERIALIZE_NONE);
+  TrialOutOfBand();
+  TrialCopyOnWrite(SERIALIZE_P2);
+  TrialCopyOnWrite(SERIALIZE_M2K);
+  TrialCopyOnWrite(SERIALIZE_OC);
+  TrialCopyOnWrite(SERIALIZE_TEXT);
+  TrialCopyOnWrite(SERIALIZE_PRETTY);
+  TrialCopyOnWritePrint();
 
   Val in = OTab("o{}");
   Val copy = in;
@@ -133,6 +235,8 @@ int main ()
   TrialConv(SERIALIZE_P0_OLDIMPL, in);
   TrialConv(SERIALIZE_P2, in);
   TrialConv(SERIALIZE_P2_OLDIMPL, in);
+  TrialConv(SERIALIZE_P4, in);
+  TrialConv(SERIALIZE_P5, in);
   TrialConv(SERIALIZE_P2_OLD, in);
   TrialConv(SERIALIZE_M2K, in);
   TrialConv(SERIALIZE_OC, in);
@@ -148,6 +252,8 @@ int main ()
   TrialConv(SERIALIZE_P0_OLDIMPL, in);
   TrialConv(SERIALIZE_P2, in);
   TrialConv(SERIALIZE_P2_OLDIMPL, in);
+  TrialConv(SERIALIZE_P4, in);
+  TrialConv(SERIALIZE_P5, in);
   TrialConv(SERIALIZE_P2_OLD, in);
   TrialConv(SERIALIZE_M2K, in);
   TrialConv(SERIALIZE_OC, in);
@@ -161,6 +267,8 @@ int main ()
   TrialConv(SERIALIZE_P0_OLDIMPL, in, SERIALIZE_P0); // P0_OLD_IMPL can't load Tuples well
   TrialConv(SERIALIZE_P2, in);
   TrialConv(SERIALIZE_P2_OLDIMPL, in, SERIALIZE_P2); // P2_OLD_IMPL can't load Tuples well
+  TrialConv(SERIALIZE_P4, in);
+  TrialConv(SERIALIZE_P5, in);
   //TrialConv(SERIALIZE_P2_OLD, in);  // TODO: do we support anymore?
   TrialConv(SERIALIZE_M2K, in);
   TrialConv(SERIALIZE_OC, in);
@@ -177,6 +285,8 @@ int main ()
   TrialConv(SERIALIZE_P0_OLDIMPL, in, SERIALIZE_P0); // P0_OLD_IMPL can't load it_n well
   TrialConv(SERIALIZE_P2, in);
   TrialConv(SERIALIZE_P2_OLDIMPL, in, SERIALIZE_P2); // P2_OLD_IMPL can't load int_un well
+  TrialConv(SERIALIZE_P4, in);
+  TrialConv(SERIALIZE_P5, in);
   // TrialConv(SERIALIZE_P2_OLD, in); // TODO: do we support anymore?
   TrialConv(SERIALIZE_M2K, in);
   TrialConv(SERIALIZE_OC, in);
@@ -189,6 +299,8 @@ int main ()
   TrialConv(SERIALIZE_P0_OLDIMPL, in, SERIALIZE_P0); // P0_OLD_IMPL can't load it_n well
   TrialConv(SERIALIZE_P2, in);
   TrialConv(SERIALIZE_P2_OLDIMPL, in, SERIALIZE_P2); // P2_OLD_IMPL can't load it_n well
+  TrialConv(SERIALIZE_P4, in);
+  TrialConv(SERIALIZE_P5, in);
   // TrialConv(SERIALIZE_P2_OLD, in); // TODO: Do we support?
   TrialConv(SERIALIZE_M2K, in);
   TrialConv(SERIALIZE_OC, in);
@@ -200,6 +312,8 @@ int main ()
   TrialFile(SERIALIZE_P0_OLDIMPL);
   TrialFile(SERIALIZE_P2);
   TrialFile(SERIALIZE_P2_OLDIMPL);
+  TrialFile(SERIALIZE_P4);
+  TrialFile(SERIALIZE_P5);
   TrialFile(SERIALIZE_P2_OLD);
   TrialFile(SERIALIZE_M2K);
   TrialFile(SERIALIZE_OC);
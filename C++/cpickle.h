@@ -60,6 +60,24 @@
 #define PY_NEWFALSE '\x89' /* push False */
 #define PY_LONG1    '\x8a' /* push long from < 256 bytes */
 #define PY_LONG4    '\x8b' /* push really big long */
+/* Protocol 3 (Python 3.x) */
+#define PY_BINBYTES       'B' /* push bytes; counted binary string argument */
+#define PY_SHORT_BINBYTES 'C' /*  "     "   ;    "      "      "     " < 256 bytes */
+/* Protocol 4 */
+#define PY_SHORT_BINUNICODE '\x8c' /* push short string; UTF-8 length < 256 bytes */
+#define PY_BINUNICODE8      '\x8d' /* push very long string */
+#define PY_BINBYTES8        '\x8e' /* push very long bytes string */
+#define PY_EMPTY_SET        '\x8f' /* push empty set on the stack */
+#define PY_ADDITEMS         '\x90' /* modify set by adding topmost stack items */
+#define PY_FROZENSET        '\x91' /* build frozenset from topmost stack items */
+#define PY_NEWOBJ_EX        '\x92' /* like NEWOBJ but work with keyword only arguments */
+#define PY_STACK_GLOBAL     '\x93' /* same as GLOBAL but using names on the stacks */
+#define PY_MEMOIZE          '\x94' /* store top of the stack in memo */
+#define PY_FRAME            '\x95' /* indicate the beginning of a new frame */
+/* Protocol 5 */
+#define PY_BYTEARRAY8       '\x96' /* push bytearray */
+#define PY_NEXT_BUFFER      '\x97' /* push next out-of-band buffer */
+#define PY_READONLY_BUFFER  '\x98' /* make top of stack readonly */
 
 
 #define CPICKLE_H_
@@ -485,7 +485,7 @@ inline void BuildNumPyArray_ (const Val& type_object,
 
   // Handle raw data
   Val& vdata = tuple(4);
-  OCString* ocp = (OCString*) &vdata.u.s;
+  OCString* ocp = (OCString*) &vdata.u.a;
   const char* raw_data = ocp->data();
   const int raw_data_bytes = ocp->length();
 
@@ -41,16 +41,18 @@ enum OpalValueA_Type_e {
 // array bounds by doing a "reserve" when we know how much space we'll
 // be socking it to.  (We still check the array bounds often, just not
 // every single put).  Essentially this is a dynamically resizing
-// buffer
+// buffer.  If given a sink, it's a fixed-size chunk instead: when
+// it fills, it goes to the sink and starts again.
 #define DEFAULT_OMEM_LEN 1024
 class OMemStream { 
   public:
 
-  OMemStream (int expected, MachineRep_e rep) :
+  OMemStream (int expected, MachineRep_e rep, DumpSink* sink=0) :
     data_(new char[expected]),
     len_(0),
     capac_(expected),
-    rep_(rep)
+    rep_(rep),
+    sink_(sink)
   { }
   ~OMemStream() { delete [] data_; }
   
@@ -58,6 +60,7 @@ class OMemStream {
   // and return a pointer to where the space would start
   char* reserve (int bytes_of_space) 
   {
+    if (bytes_of_space+len_>capac_ && sink_) flush();
     if (bytes_of_space+len_>capac_) {
       // Alocate new space
       int new_capac = max(bytes_of_space+len_, 2*capac_);
@@ -73,6 +76,25 @@ class OMemStream {
     len_ += bytes_of_space;
     return current;
   } 
+
+  // Add a block of string or vector data: when streaming, a block
+  // that doesn't fit goes straight to the sink
+  void write (const char* data, int bytes)
+  {
+    if (bytes+len_>capac_ && sink_) {
+      flush();
+      sink_->write(data, bytes);
+      return;
+    }
+    memcpy(reserve(bytes), data, bytes);
+  }
+
+  // Streaming: send everything so far to the sink
+  void flush ()
+  {
+    sink_->write(data_, len_);
+    len_ = 0;
+  }
   
   // Return where memory starts:  this is for adoption!
   char* start () 
@@ -91,6 +113,7 @@ class OMemStream {
   int len_;     // current length, always <= capac_
   int capac_;   // maximum number of bytes in buffer
   MachineRep_e rep_;  // the rep of the OUTGOING data (this tells the machine to convert the convert internal rep to THIS)
+  DumpSink* sink_; // where full chunks go if streaming, 0 otherwise
 }; // OMemStream 
 
 
@@ -119,7 +142,7 @@ char* EndianDump (char* mem, const T* data_ptr, MachineRep_e outgoing_rep)
 inline void OpalDumpCString (const char* data, int_u4 len, OMemStream& oms,
 			     bool dump_without_opal_prefix=false)
 {
-  char* mem = oms.reserve((dump_without_opal_prefix?0:1)+4+len);
+  char* mem = oms.reserve((dump_without_opal_prefix?0:1)+4);
 
   // The prefix is NOT on tables, but everywhere else
   if (!dump_without_opal_prefix) {
@@ -128,7 +151,7 @@ inline void OpalDumpCString (const char* data, int_u4 len, OMemStream& oms,
   // RTS: memcpy(mem, &len, sizeof(len));
   // RTS: mem+=sizeof(len);
   mem = EndianDump(mem, &len, oms.rep());
-  memcpy(mem, data, len);
+  oms.write(data, len);
 }
 
 inline void OpalDumpString (const string& s, OMemStream& oms,
@@ -153,11 +176,11 @@ inline void OpalDump (const OCString& s, OMemStream& oms)
 // string.  Do we want to make them full proxies or just leave as is?
 // For the moment, when we see a Proxy, we just dump it as is without
 // trying.  TODO:  Have OpalLinks become Proxy???
-#define OPALARRDUMPPROXY(T) { Array<T>& t=p; OpalDump(t,oms); }
+#define OPALARRDUMPPROXY(T) { const Array<T>& t=*(Array<T>*)p.data_(); OpalDump(t,oms); }
 inline void OpalDump (const Proxy& p, OMemStream& oms)
 {
   switch (p.tag) {
-  case 't': { Tab& t=p; OpalDump(t,oms); } break;
+  case 't': { const Tab& t=*(Tab*)p.data_(); OpalDump(t,oms); } break;
   case 'n': {
     switch (p.subtype) {
     case 's': OPALARRDUMPPROXY(int_1);  break;
@@ -295,7 +318,7 @@ inline void OpalVecDump_ (Arr& a, T*, Numeric_e number_tag, OMemStream& oms)
 {
   int_u4 len=a.length(); 
  
-  char* mem = oms.reserve(1+1+sizeof(len)+sizeof(T)*len);
+  char* mem = oms.reserve(1+1+sizeof(len));
 
   // opalvalue tag then numeric tag
   *mem++ = OpalValueA_VECTOR; 
@@ -306,7 +329,7 @@ inline void OpalVecDump_ (Arr& a, T*, Numeric_e number_tag, OMemStream& oms)
   mem = EndianDump(mem, &len, oms.rep());
 
   // .. the actual data itself... TODO: Endian?
-  memcpy(mem, a.data(),sizeof(T)*len); 
+  oms.write((const char*)a.data(), sizeof(T)*len); 
 }
 
 inline void OpalDump (const Val& v, OMemStream& oms)
@@ -331,7 +354,7 @@ inline void OpalDump (const Val& v, OMemStream& oms)
   case 'f': OpalNumDump_(&v.u.f, M2_FLOAT, oms); break;
   case 'd': OpalNumDump_(&v.u.d, M2_DOUBLE, oms); break;
   case 'F': OpalNumDump_(&v.u.F, M2_CX_FLOAT, oms); break;
-  case 'D': OpalNumDump_(&v.u.D, M2_CX_DOUBLE, oms); break;
+  case 'D': OpalNumDump_((cx_union_t<real_8>*)&v.u.D, M2_CX_DOUBLE, oms); break;
 
     // bool
   case 'b': {
@@ -373,7 +396,7 @@ inline void OpalDump (const Val& v, OMemStream& oms)
     case 'f': OpalVecDump_(*ap, &v.u.f, M2_FLOAT, oms); break;
     case 'd': OpalVecDump_(*ap, &v.u.d, M2_DOUBLE, oms); break;
     case 'F': OpalVecDump_(*ap, &v.u.F, M2_CX_FLOAT, oms); break;
-    case 'D': OpalVecDump_(*ap, &v.u.D, M2_CX_DOUBLE, oms); break;
+    case 'D': OpalVecDump_(*ap, (cx_union_t<real_8>*)&v.u.D, M2_CX_DOUBLE, oms); break;
       
     case 'a': { Array<string>*sp=(Array<string>*)&v.u.n; OpalDump(*sp, oms); break; }
     case 't': { Array<Tab>*tp=(Array<Tab>*)&v.u.n; OpalDump(*tp, oms); break; }
@@ -431,6 +454,48 @@ int OpalDumpTup (const Tup& a, char*& mem, MachineRep_e rep)
 }
 
 
+// Streaming: the same dumps, a chunk at a time
+void OpalDumpVal (const Val& v, DumpSink& sink, MachineRep_e rep)
+{
+  OMemStream oms(OC_DUMP_CHUNK, rep, &sink);
+  OpalDump(v, oms);
+  *oms.reserve(1) = '\0';  // just like start()
+  oms.flush();
+}
+
+void OpalDumpTab (const Tab& t, DumpSink& sink, MachineRep_e rep)
+{
+  OMemStream oms(OC_DUMP_CHUNK, rep, &sink);
+  OpalDumpTab(t, oms, true);
+  *oms.reserve(1) = '\0';  // just like start()
+  oms.flush();
+}
+
+void OpalDumpOTab (const OTab& t, DumpSink& sink, MachineRep_e rep)
+{
+  OMemStream oms(OC_DUMP_CHUNK, rep, &sink);
+  OpalDumpOTab(t, oms, true);
+  *oms.reserve(1) = '\0';  // just like start()
+  oms.flush();
+}
+
+void OpalDumpArr (const Arr& a, DumpSink& sink, MachineRep_e rep)
+{
+  OMemStream oms(OC_DUMP_CHUNK, rep, &sink);
+  OpalDumpArr(a, oms, true);
+  *oms.reserve(1) = '\0';  // just like start()
+  oms.flush();
+}
+
+void OpalDumpTup (const Tup& a, DumpSink& sink, MachineRep_e rep)
+{
+  OMemStream oms(OC_DUMP_CHUNK, rep, &sink);
+  OpalDumpArr(a.impl(), oms, true);
+  *oms.reserve(1) = '\0';  // just like start()
+  oms.flush();
+}
+
+
 PTOOLS_END_NAMESPACE
 
 // Loads
@@ -469,7 +534,7 @@ inline char* OpalLoadNumber (Val& v, char* mem, MachineRep_e endian)
   case FLOAT:    OPALLOADNUMB(v.u.f, 'f'); break;
   case DOUBLE:   OPALLOADNUMB(v.u.d, 'd'); break;
   case CX_FLOAT: OPALLOADNUMB(v.u.F, 'F'); break;
-  case CX_DOUBLE:OPALLOADNUMB(v.u.D, 'D'); break;
+  case CX_DOUBLE:OPALLOADNUMB(*(cx_union_t<real_8>*)v.newSpace_(sizeof(complex_16)), 'D'); break;
 
     // Time is an int_u8, Duration a real_8: but they need
     // to be strings to be consistent with how all others
@@ -511,7 +576,7 @@ inline char* OpalLoadString (Val& v, char* mem, MachineRep_e endian)
   mem = EndianLoad(&length, mem, endian);
 
   // Get the string
-  OCString* sp = (OCString*)v.u.a;
+  OCString* sp = (OCString*)v.newSpace_(sizeof(OCString));
   new (sp) OCString(mem, length);
   
   mem+=length;
@@ -550,7 +615,7 @@ inline char* OpalLoadTable (Val& v, char* mem,
 }
 
 
-#define OPALLOADVEC(T, TAG) { v.tag='n'; v.subtype=TAG; Array<T>*ap=(Array<T>*)&v.u.n; new (ap) Array<T>(length); ap->expandTo(length); memcpy(ap->data(), mem, length*sizeof(T)); mem+=length*sizeof(T); }
+#define OPALLOADVEC(T, TAG) { v.tag='n'; v.subtype=TAG; Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>)); new (ap) Array<T>(length); ap->expandTo(length); memcpy(ap->data(), mem, length*sizeof(T)); mem+=length*sizeof(T); }
 
 
 inline char* OpalLoadVector (Val& v, char* mem, MachineRep_e endian)
@@ -8,6 +8,7 @@
 
 #include "ocval.h"
 #include "m2convertrep.h"
+#include "ocdumpsink.h"
 
 PTOOLS_BEGIN_NAMESPACE
 
@@ -30,6 +31,19 @@ int OpalDumpOTab (const OTab& t, char*& mem,
 int OpalDumpTup (const Tup& t, char*& mem,
 		 MachineRep_e endian=MachineRep_EEEI);
 
+// Stream (see ocdumpsink.h) the same dumps a chunk at a time, rather
+// than building them in memory first
+void OpalDumpVal (const Val& v, DumpSink& sink, 
+		  MachineRep_e endian=MachineRep_EEEI);
+void OpalDumpTab (const Tab& t, DumpSink& sink,
+		  MachineRep_e endian=MachineRep_EEEI);
+void OpalDumpArr (const Arr& t, DumpSink& sink,
+		  MachineRep_e endian=MachineRep_EEEI);
+void OpalDumpOTab (const OTab& t, DumpSink& sink,
+		   MachineRep_e endian=MachineRep_EEEI);
+void OpalDumpTup (const Tup& t, DumpSink& sink,
+		  MachineRep_e endian=MachineRep_EEEI);
+
 
 // Load from M2k Binary Serialization
 char* OpalLoadVal (Val& v, char* mem, 
@@ -30,6 +30,48 @@ enum SocketDuplex_e {
 };
 
 
+// A framed message (see MidasSocket_::framedSends) has this where the
+// length would be: then comes the usual header, then the serialized
+// data as frames (an int_u4 length in network order, then that many
+// bytes), ending with an empty frame.
+#define MIDASSOCKET_FRAMED 0xFFFFFFFFU
+
+// A SERIALIZE_P5 message (framed or not) is followed by its
+// out-of-band buffers (see DumpValToArrayP5): an int_u4 count in
+// network order, then for each buffer its length as an int_u8 (two
+// int_u4s in network order, high word first) and that many bytes.
+// The buffers go straight from (and into) the arrays: never copied.
+
+// Implementation Detail: a DumpSink that writes everything it's given
+// to the socket as frames
+class MidasFramedSink_ : public DumpSink {
+ public:
+  MidasFramedSink_ (int fd) : fd_(fd) { }
+
+  virtual void write (const char* data, size_t len)
+  {
+    while (len) {  // an empty frame would end the message
+      const int_u4 frame = (len>(1U<<30)) ? (1U<<30) : int_u4(len);
+      const int_u4 frame_net = htonl(frame);
+      FDTools_::WriteExact(fd_, (const char*)&frame_net, sizeof(frame_net));
+      FDTools_::WriteExact(fd_, data, frame);
+      data += frame;
+      len  -= frame;
+    }
+  }
+
+  // The empty frame that ends the message
+  void finish ()
+  {
+    const int_u4 zero = 0;
+    FDTools_::WriteExact(fd_, (const char*)&zero, sizeof(zero));
+  }
+
+ protected:
+  int fd_;
+}; // MidasFramedSink_
+
+
 // A base class with some primitive I/O facilities for MidasServer and
 // MidasTalker
 class MidasSocket_ : public FDTools_ {
@@ -63,7 +105,8 @@ class MidasSocket_ : public FDTools_ {
     serialization_(serialization),
     arrayDisposition_(disposition),
     compatibilityMode_(false),
-    forceShutdownOnClose_(true)
+    forceShutdownOnClose_(true),
+    framedSends_(false)
   {
     if (ignore_sigpipe) installSIGPIPE_ignore();
   }
@@ -88,6 +131,18 @@ class MidasSocket_ : public FDTools_ {
   bool forceShutdownOnClose () const { return forceShutdownOnClose_; }
   void forceShutdownOnClose (bool v) { forceShutdownOnClose_ = v; }
 
+  // EXPERTS:
+  // A message normally starts with its length, so the whole message
+  // has to be serialized into memory before the first byte goes out.
+  // With framed sends, the message is streamed out a chunk at a time
+  // as it is serialized (see DumpValToSink), each chunk in its own
+  // frame (see MIDASSOCKET_FRAMED above): much less memory for big
+  // messages, and the encoding overlaps the I/O.  Any MidasSocket_
+  // can receive framed messages, but older receivers can't, so this
+  // is false by default.  (SERIALIZE_NONE is never framed).
+  bool framedSends () const { return framedSends_; }
+  void framedSends (bool v) { framedSends_ = v; }
+
 
   virtual ~MidasSocket_ () { }
 
@@ -109,6 +164,8 @@ class MidasSocket_ : public FDTools_ {
   
   bool forceShutdownOnClose_;    // Do we do close only or shutdown/close ?
 
+  bool framedSends_;       // TRUE if sends stream as frames (see above)
+
   string header_;          // Header is PY00 for Non-Numeric, PYN0 for Numeric,
                            //           PYA0 for python Arrays
 
@@ -173,6 +230,8 @@ class MidasSocket_ : public FDTools_ {
     switch (serialization) {
     case SERIALIZE_P0:     header[3] = '0'; break;
     case SERIALIZE_P2:     header[3] = '2'; break;
+    case SERIALIZE_P4:     header[3] = '4'; break;
+    case SERIALIZE_P5:     header[3] = '5'; break;
     case SERIALIZE_P2_OLD: header[3] = '-'; break;
     case SERIALIZE_NONE:   header    = ""; break;
     case SERIALIZE_M2K:    header    = "M2BD"; break; 
@@ -222,6 +281,8 @@ class MidasSocket_ : public FDTools_ {
 	switch (hdr[3]) {
 	case '0': serialization = SERIALIZE_P0;     break;
 	case '2': serialization = SERIALIZE_P2;     break;
+	case '4': serialization = SERIALIZE_P4;     break;
+	case '5': serialization = SERIALIZE_P5;     break;
 	case '-': serialization = SERIALIZE_P2_OLD; break;
 	}
 	// Choose Array Disposition
@@ -299,11 +360,21 @@ class MidasSocket_ : public FDTools_ {
   Val recvBlocking_ (int fd) 
   {
     Val retval;
+    recvBlocking_(fd, retval);
+    return retval;
+  }
 
+  // Blocking call to get next Val off of socket, into retval.  If
+  // retval uses an allocator (say, it's the root of a ValArena), the
+  // Val is built with that allocator.
+  void recvBlocking_ (int fd, Val& retval) 
+  {
     // Preamble: number of bytes to read (doesn't include 4 bytes hdr, next)
     int_u4 bytes_to_read = 0;
     readExact_(fd, (char*)&bytes_to_read, sizeof(bytes_to_read));
     bytes_to_read = ntohl(bytes_to_read);
+    const bool framed = (bytes_to_read==MIDASSOCKET_FRAMED);
+    if (framed) bytes_to_read = sizeof(int_u4); // room for NONE's "header"
 
     // Read the header and decide what kind of serialization we have
     char rep[4] = { 0 };
@@ -326,6 +397,8 @@ class MidasSocket_ : public FDTools_ {
     case SERIALIZE_OC:
     case SERIALIZE_P0:
     case SERIALIZE_P2:
+    case SERIALIZE_P4:
+    case SERIALIZE_P5:
     case SERIALIZE_P2_OLD: correction = 0;  break;
     case SERIALIZE_NONE: // In case we read 4 bytes prematurely
       memcpy(buffer.data(), rep, sizeof(rep)); 
@@ -333,10 +406,94 @@ class MidasSocket_ : public FDTools_ {
       break;
     default: throw runtime_error("unknown serial:"+Stringize(serialization));
     };
-    readExact_(fd, buffer.data()+correction, bytes_to_read-correction);
+    if (framed) {
+      buffer.expandTo(correction);
+      readFrames_(fd, buffer);
+    } else {
+      readExact_(fd, buffer.data()+correction, bytes_to_read-correction);
+    }
+    if (serialization==SERIALIZE_P5) {
+      Array< Array<char> > out_of_band;
+      readBuffers_(fd, out_of_band);
+      LoadValFromArrayP5(buffer, retval, out_of_band, array_disposition,
+			 compatibilityMode_);
+      return;
+    }
     unpackageData_(buffer, serialization, array_disposition,
 		   retval, endian);
-    return retval;
+  }
+
+  // Big reads and writes (the out-of-band buffers) a piece at a time
+  void readBig_ (int fd, char* data, size_t len)
+  {
+    while (len) {
+      const int piece = (len>(1U<<30)) ? (1<<30) : int(len);
+      readExact_(fd, data, piece);
+      data += piece;
+      len  -= piece;
+    }
+  }
+  void writeBig_ (int fd, const char* data, size_t len)
+  {
+    while (len) {
+      const int piece = (len>(1U<<30)) ? (1<<30) : int(len);
+      FDTools_::WriteExact(fd, data, piece);
+      data += piece;
+      len  -= piece;
+    }
+  }
+
+  // Read the out-of-band buffers after a SERIALIZE_P5 message (see
+  // above), each right into its own Array
+  void readBuffers_ (int fd, Array< Array<char> >& out_of_band)
+  {
+    int_u4 count = 0;
+    readExact_(fd, (char*)&count, sizeof(count));
+    count = ntohl(count);
+    out_of_band.resize(count);  // so the Arrays never move
+    for (int_u4 ii=0; ii<count; ii++) {
+      int_u4 len[2] = { 0, 0 };
+      readExact_(fd, (char*)&len[0], sizeof(len));
+      const int_u8 bytes = (int_u8(ntohl(len[0]))<<32) | ntohl(len[1]);
+      out_of_band.append(Array<char>());
+      Array<char>& a = out_of_band[ii];
+      a.expandTo(size_t(bytes));
+      readBig_(fd, a.data(), size_t(bytes));
+    }
+  }
+
+  // Write the out-of-band buffers after a SERIALIZE_P5 message
+  void writeBuffers_ (int fd, const Array<PickleBuffer>& out_of_band)
+  {
+    const int_u4 count = htonl(int_u4(out_of_band.length()));
+    writeExact_(fd, (char*)&count, sizeof(count));
+    for (size_t ii=0; ii<out_of_band.length(); ii++) {
+      const PickleBuffer& pb = out_of_band[ii];
+      const int_u8 bytes = pb.bytes;
+      int_u4 len[2] = { htonl(int_u4(bytes>>32)), htonl(int_u4(bytes)) };
+      writeExact_(fd, (char*)&len[0], sizeof(len));
+      writeBig_(fd, pb.data, pb.bytes);
+    }
+  }
+
+  // Read all the frames of a framed message onto the end of the
+  // buffer, leaving a zero just past the end (for M2k)
+  void readFrames_ (int fd, Array<char>& buffer)
+  {
+    while (1) {
+      int_u4 frame = 0;
+      readExact_(fd, (char*)&frame, sizeof(frame));
+      frame = ntohl(frame);
+      if (frame==0) break;
+      const size_t len = buffer.length();
+      if (len+frame+1 > buffer.capacity()) {
+	size_t cap = 2*buffer.capacity();
+	buffer.resize((cap<len+frame+1) ? len+frame+1 : cap);
+      }
+      buffer.expandTo(len+frame);
+      readExact_(fd, buffer.data()+len, frame);
+    }
+    buffer.data()[buffer.length()] = '\0';
   }
 
 
@@ -377,11 +534,48 @@ class MidasSocket_ : public FDTools_ {
   // Blocking call to send Val over socket.
   void sendBlocking_ (int fd, const Val& val)
   {
-    // Pickle into buffer
-    Array<char> buffer(1024);
     ArrayDisposition_e array_disposition;
     Serialization_e serialization = 
       chooseSendSerialization_(fd, array_disposition);
+
+    // Framed: stream it out as it serializes
+    if (framedSends_ && serialization != SERIALIZE_NONE) {
+      int_u4 framed = htonl(MIDASSOCKET_FRAMED);
+      writeExact_(fd, (char*)&framed, sizeof(framed));
+      writeHeader_(fd, serialization, array_disposition);
+      MidasFramedSink_ sink(fd);
+      if (serialization==SERIALIZE_P5) {
+	Array<PickleBuffer> out_of_band;
+	PicklingIssues_e issues = compatibilityMode_ ?
+	  PicklingIssues_e(int(ABOVE_PYTHON_2_2)|int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR)) : ABOVE_PYTHON_2_2;
+	P4TopLevelDumpValToSink(val, sink, 5, array_disposition, issues,
+				&out_of_band);
+	sink.finish();
+	writeBuffers_(fd, out_of_band);
+	return;
+      }
+      DumpValToSink(val, sink, serialization, array_disposition,
+		    compatibilityMode_, NativeEndian());
+      sink.finish();
+      return;
+    }
+
+    // P5: the big arrays go out-of-band, right from the Val
+    if (serialization==SERIALIZE_P5) {
+      Array<char> buffer(1024);
+      Array<PickleBuffer> out_of_band;
+      DumpValToArrayP5(val, buffer, out_of_band, array_disposition,
+		       compatibilityMode_);
+      int_u4 bytes_to_write = htonl(int_u4(buffer.length()));
+      writeExact_(fd, (char*)&bytes_to_write, sizeof(bytes_to_write));
+      writeHeader_(fd, serialization, array_disposition);
+      writeExact_(fd, buffer.data(), buffer.length());
+      writeBuffers_(fd, out_of_band);
+      return;
+    }
+
+    // Pickle into buffer
+    Array<char> buffer(1024);
     // Package it up
     MachineRep_e endian=NativeEndian();
     packageData_(val, serialization, array_disposition,
@@ -391,8 +585,16 @@ class MidasSocket_ : public FDTools_ {
     int_u4 bytes_to_write = buffer.length();
     bytes_to_write = htonl(bytes_to_write);
     writeExact_(fd, (char*)&bytes_to_write, sizeof(bytes_to_write));
+    writeHeader_(fd, serialization, array_disposition);
+
+    // Write pickled buffer
+    writeExact_(fd, buffer.data(), buffer.length());
+  }
 
-    // Headers support:  M2k is complex mess, Python is just 4 bytes
+  // Headers support:  M2k is complex mess, Python is just 4 bytes
+  void writeHeader_ (int fd, Serialization_e serialization,
+		     ArrayDisposition_e array_disposition)
+  {
     if (serialization == SERIALIZE_M2K) {
       handleWritingM2kHdr_(fd); 
     } else if (serialization != SERIALIZE_NONE) {
@@ -400,9 +602,6 @@ class MidasSocket_ : public FDTools_ {
       string header = createHeader_(serialization, array_disposition); 
       writeExact_(fd, &header[0], 4);
     }
-
-    // Write pickled buffer
-    writeExact_(fd, buffer.data(), buffer.length());
   }
 
 
@@ -289,6 +289,11 @@ class MidasTalker : protected MidasSocket_ {
   // Blocking call to recv
   Val recvBlocking () { return recvBlocking_(s_[0]); }
 
+  // Blocking call to recv, into result: give it the root of a
+  // ValArena, and the whole message is built in the arena (and can
+  // be thrown away in O(1)).  See ocvalarena.h.
+  void recvBlocking (Val& result) { recvBlocking_(s_[0], result); }
+
   // This function returns True immediately if the MidasTalker can
   // read immediately without waiting.  If the socket is NOT
   // available, then the socket is watched for timeout seconds: if
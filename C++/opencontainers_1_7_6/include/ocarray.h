@@ -59,9 +59,11 @@ class Array {
     // value, the vector will be resized autotmatically.  By default,
     // all memory allocation/deallocations will be done with new and
     // delete, but you can specify that the allocations/deallocations
-    // will be done with malloc and free if necessary.
+    // will be done with malloc and free if necessary.  (If there is a
+    // current allocator, see AllocatorScope, new and delete mean the
+    // current allocator.)
     Array (size_t capac = ARRAY_DEFAULT_CAPACITY, int use_new_and_delete = 1) :
-      allocator_(0),
+      allocator_(use_new_and_delete==1 ? CurrentAllocator() : 0),
       length_(0),
       capac_(capac),
       useNewAndDelete_(use_new_and_delete),
@@ -70,9 +72,10 @@ class Array {
     { }
 
 
-    // Array that can use a shared memory allocator
+    // Array that can use a shared memory allocator (0 means the
+    // current allocator: see AllocatorScope)
     Array (size_t capac, Allocator* a) :
-      allocator_(a),
+      allocator_(a ? a : CurrentAllocator()),
       length_(0),
       capac_(capac),
       useNewAndDelete_(1),
@@ -86,10 +89,10 @@ class Array {
     // new array will have the same capacity and number of elements as
     // the old array.
     Array (const Array<T>& c, Allocator*a = 0) : 
-      allocator_(a),
+      allocator_(a ? a : CurrentAllocator()),
       length_(c.length_),
       capac_(c.capac_),
-      useNewAndDelete_(c.useNewAndDelete_),
+      useNewAndDelete_(c.useNewAndDelete_==3 ? 1 : c.useNewAndDelete_),
       reservedSpace_(c.reservedSpace_),
       data_(allocate_(c.capac_))
     {
@@ -122,6 +125,37 @@ class Array {
     }
 
 
+#if defined(OC_MOVE_SEMANTICS)
+    // Move constructor.  Steals the memory of c (and its allocator),
+    // and leaves c empty.  No elements are copied.
+    Array (Array<T>&& c) : 
+      allocator_(c.allocator_),
+      length_(0),
+      capac_(0),
+      useNewAndDelete_(1),
+      reservedSpace_(0),
+      data_(0)
+    {
+      this->swap(c);  // takes care of c using inline memory
+    }
+
+    // Move assignment.  If both arrays use the same allocator, just
+    // steal the memory of rhs, otherwise we have to copy.
+    Array<T>& operator= (Array<T>&& rhs)
+    {
+      if (&rhs!=this) {
+	if (allocator_==rhs.allocator_) {
+	  // rhs may live inside of this, so take it before we release
+	  Array<T> temp(std::move(rhs));
+	  this->swap(temp);
+	} else {
+	  *this = rhs;  // Copy
+	}
+      }
+      return *this;
+    }
+#endif
+
     // Destructor.  Release resources.
     ~Array () { releaseResources_(); }
 
@@ -143,17 +177,51 @@ class Array {
 
     // Adopt memory allocated via new [] T(): This releases the old
     // memory and sets the new memory, and capacity to cap: the length
-    // is set to 0.
+    // is set to 0.  A use_new_and_delete of 3 means the memory is
+    // NOT adopted, just borrowed (see useNewAndDelete_ below): the
+    // allocator is kept, for when the Array grows out of it.
     void adoptMemory (T* adopt_me, int cap, int use_new_and_delete=1)
     {
       releaseResources_();
-      allocator_ = 0;
+      if (use_new_and_delete!=3) allocator_ = 0;
       length_ = 0;
       capac_ = cap;
       useNewAndDelete_ = use_new_and_delete;
       data_ = adopt_me;
     }
     
+    // Give this Array's memory to an Array of another POD type (no
+    // copy: the other Array just takes over the bytes, as many whole
+    // U's as fit), leaving this one empty.  Whatever the other Array
+    // had is released.  Both T and U must be POD.  If the other
+    // Array uses a different allocator (say, it lives in a ValArena
+    // and this memory is from the heap), it can't take the memory
+    // over (it would never be given back): the bytes are copied into
+    // the other Array's own memory instead.
+    template <class U>
+    void giveMemoryTo (Array<U>& other)
+    {
+      if (other.allocator_!=allocator_) {
+	const size_t len = (length_*sizeof(T))/sizeof(U);
+	other.clear();
+	other.expandTo(len);
+	if (len) memcpy((void*)other.data_, (void*)data_, len*sizeof(U));
+	releaseResources_();
+	length_ = capac_ = 0;
+	data_   = 0;
+	return;
+      }
+      ownStorage_();
+      other.releaseResources_();
+      other.allocator_       = allocator_;
+      other.length_          = (length_*sizeof(T))/sizeof(U);
+      other.capac_           = (capac_*sizeof(T))/sizeof(U);
+      other.useNewAndDelete_ = useNewAndDelete_;
+      other.data_            = (U*)data_;
+      length_ = capac_ = 0;
+      data_   = 0;
+    }
+
     // Return the allocator being used, 0 if none
     Allocator* allocator () const { return allocator_; }
 
@@ -169,6 +237,28 @@ class Array {
       length_++;
     }
 
+#if defined(OC_MOVE_SEMANTICS)
+    // Appends the value a to the end of the array by moving it in
+    // (rather than copying it).  Arrays with an allocator have to
+    // copy so the new element uses the allocator.
+    void append (T&& a) 
+    {
+      if (allocator_) { 
+	const T& copy = a;
+	append(copy);
+      } else if (capac_==length_) {
+	// a may be an element of this array: move it out before resize
+	T temp(std::move(a));
+	resize(2*capac_);
+	new (&data_[length_]) T(std::move(temp));
+	length_++;
+      } else {
+	new (&data_[length_]) T(std::move(a));
+	length_++;
+      }
+    }
+#endif
+
 
     // Returns the ith value in the array.  The first variant can be
     // used as an lvalue, the second cannot.  The index i must be
@@ -432,12 +522,16 @@ class Array {
       releaseResources_(run_destructors);
       data_ = new_data;
       capac_ = new_capacity;
+      if (useNewAndDelete_==3) useNewAndDelete_ = 1; // out of inline mem
     }
 
     // Swap with another Array: This is a O(1) operation since we only
     // swap pointers (no copying of full arrays).
     void swap (Array<T>& rhs) 
     {
+      // Borrowed memory stays where it is: only the elements move out
+      ownStorage_();
+      rhs.ownStorage_();
       OC_NAMESPACED::swap(allocator_, rhs.allocator_);
       OC_NAMESPACED::swap(length_, rhs.length_);
       OC_NAMESPACED::swap(capac_,  rhs.capac_);
@@ -478,6 +572,8 @@ class Array {
 
   protected:
 
+    template <class U> friend class Array;  // for giveMemoryTo
+
     // ///// Data Members
 
     // The allocator if we want to allocate things in shared memory
@@ -496,6 +592,11 @@ class Array {
     // 0 means malloc/free
     // 1 means operator new/operator delete
     // 2 means new T[]
+    // 3 means the memory is borrowed from someone else (like the
+    //   inline buffer of a SmallArray): it is never freed, and it
+    //   can't be handed to another Array (see ownStorage_).  When
+    //   the array outgrows it, it moves to operator new memory (or
+    //   its allocator, if it has one).
     int_4 useNewAndDelete_;
 
     // Extra pad most of the time, may be useful to keep class data
@@ -524,7 +625,7 @@ class Array {
       if (allocator_!=0) {
 	return (T*) allocator_->allocate(sizeof(T)*amt);
       }
-      if (useNewAndDelete_==1) 
+      if (useNewAndDelete_==1 || useNewAndDelete_==3) 
 	return (T*) operator new(sizeof(T)*amt);
       else if (useNewAndDelete_==2) 
 	return (T*) operator new[](sizeof(T)*amt);
@@ -546,7 +647,9 @@ class Array {
       }
 
       // Delete the memory
-      if (allocator_) {
+      if (useNewAndDelete_==3) {
+	; // borrowed: not ours to free
+      } else if (allocator_) {
 	allocator_->deallocate((char*)data_);
       } else if (useNewAndDelete_==1) {
 	operator delete(data_);
@@ -557,6 +660,19 @@ class Array {
       }
     }
 
+    // If the memory is borrowed, move the elements out to memory of
+    // our own (so the Array can be swapped and moved like any other).
+    void ownStorage_ ()
+    {
+      if (useNewAndDelete_!=3) return;
+      useNewAndDelete_ = 1;
+      T* new_data = allocate_(capac_);
+      if (MoveArray(data_, new_data, length())) {
+	for (size_t ii=0; ii<length(); ii++) (&data_[ii])->~T();
+      }
+      data_ = new_data;
+    }
+
    
 }; // Array
 
@@ -579,6 +695,60 @@ inline void PlaceCopyCons_ (void* location, const Array<T>& copy, Allocator* a)
   new (location) Array<T>(copy, a); 
 }
 
+// A key just put in a table node, with its hash: keys that can cache
+// their hash (see Val) do it here.  Default: nothing to cache.
+template <class K>
+inline void CacheHash_ (K&, int_u4) { }
+
+
+// ///////////////////////////////////////////// The SmallArray Class
+
+// A SmallArray is an Array with room for its first N elements inline
+// (inside the SmallArray itself), so short arrays never touch the
+// heap: only when it grows past N elements does it move to the heap
+// like a normal Array.  It IS an Array, so it can be passed anywhere
+// an Array<T>& can.  Swapping (or moving) with another Array moves
+// the elements out to the heap first.
+//
+//   SmallArray<real_8, 4> point;  // x, y: no heap allocation
+//   point.append(1.5); point.append(2.5);
+//
+// SmallArrays don't take an allocator: the inline buffer is wherever
+// the SmallArray is.
+template <class T, int N>
+class SmallArray : public Array<T> {
+ public:
+  SmallArray () : Array<T>(0) { useInline_(); }
+  SmallArray (const Array<T>& c) : Array<T>(0) { useInline_(); copy_(c); }
+  SmallArray (const SmallArray<T,N>& c) : Array<T>(0) { useInline_(); copy_(c); }
+  ~SmallArray () { this->clear(); }
+
+  SmallArray<T,N>& operator= (const Array<T>& rhs)
+  { if (&rhs!=this) { this->clear(); copy_(rhs); } return *this; }
+  SmallArray<T,N>& operator= (const SmallArray<T,N>& rhs)
+  { if (&rhs!=this) { this->clear(); copy_(rhs); } return *this; }
+
+  // Is everything still in the inline buffer?
+  bool isInline () const { return this->data_==(const T*)buffer_.bytes_; }
+
+ protected:
+  // Make sure the buffer is aligned for anything we're likely to hold
+  union {
+    char   bytes_[N*sizeof(T)];
+    real_8 alignReal_;
+    int_8  alignInt_;
+    void*  alignPtr_;
+  } buffer_;
+
+  void useInline_ () { this->adoptMemory((T*)buffer_.bytes_, N, 3); }
+  void copy_ (const Array<T>& c)
+  {
+    if (c.length()>this->capacity()) this->resize(c.length());
+    for (size_t ii=0; ii<c.length(); ii++) this->append(c[ii]);
+  }
+
+}; // SmallArray
+
 
 // ///////////////////////////////////////////// The ArrayPtr Class
 
@@ -0,0 +1,552 @@
+#ifndef OC_ARRAYMATH_H_
+
+// Elementwise math on numeric arrays, so DSP-style processing can stay
+// inside Array<T> and Val without pulling out the data and writing
+// the loops by hand.  Everything comes in three layers:
+//
+//   Buffer*: raw pointers and a length, like BufferConvert
+//   Array*:  Array<T> (in-place and out-of-place forms)
+//   Array*:  Vals holding arrays (tag 'n'), dispatched on the subtype
+//
+//   Scale, Offset     a*s, a+s     (s a scalar)
+//   Add, Sub, Mul     a+b, a-b, a*b (elementwise, same lengths)
+//   Abs, Mag2, Mag    |a|, |a|^2, |a|  (complex give real arrays)
+//   Sum, Min, Max     reductions to a single value
+//   Dot               sum of a*b
+//
+// Integer results wrap around in the element type (just like the
+// plain loop would).  For real_4 and real_8, Sum and Dot add in a
+// different order than the plain loop, so the last bit may differ.
+//
+// The kernels are written once with gcc vector extensions, so every
+// integer and real element type gets SSE2 (16 byte) and AVX2 (32
+// byte) versions, chosen at runtime just like the conversions in
+// ocsimd.h.  Complex arrays are arrays of reals for Add, Sub and Scale
+// (by a real); the other complex operations are plain loops.  Without
+// the vector extensions (other compilers, or -DOC_NO_SIMD) it's all
+// the plain loop.
+
+#include "ocval.h"
+#include "ocsimd.h"
+#if defined(OC_NEW_STYLE_INCLUDES)
+# include <cmath>
+#else
+# include <math.h>
+#endif
+
+#if defined(OC_SIMD_SSE2) && !defined(__clang__) && \
+    (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=9))
+# define OC_SIMD_VECTOR
+# define OC_SIMD_INLINE inline __attribute__((always_inline))
+#else
+# define OC_SIMD_INLINE inline
+#endif
+
+OC_BEGIN_NAMESPACE
+
+// The operations: each works on a scalar and on a whole vector,
+// updating a in place
+struct OCAddOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a, const X& b) { a = a+b; } };
+struct OCSubOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a, const X& b) { a = a-b; } };
+struct OCMulOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a, const X& b) { a = a*b; } };
+struct OCMinOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a, const X& b) { a = b<a ? b : a; } };
+struct OCMaxOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a, const X& b) { a = a<b ? b : a; } };
+struct OCAbsOp_ { template <class X> OC_SIMD_INLINE static void apply (X& a) { a = a<0 ? -a : a; } };
+
+
+#if defined(OC_SIMD_VECTOR)
+
+// ///////////////////////////////////////////// Vector kernels
+
+// Each kernel does as many whole vectors of BYTES bytes as it can and
+// returns how many elements it did: the caller finishes the rest.
+
+template <class T, int BYTES, class OP>
+OC_SIMD_INLINE int VecBinary_ (const T* a, const T* b, T* out, int len)
+{
+  typedef T V __attribute__((vector_size(BYTES)));
+  const int lanes = BYTES/sizeof(T);
+  int ii = 0;
+  for (; ii+lanes<=len; ii+=lanes) {
+    V x, y;
+    memcpy(&x, a+ii, BYTES);
+    memcpy(&y, b+ii, BYTES);
+    OP::apply(x, y);
+    memcpy(out+ii, &x, BYTES);
+  }
+  return ii;
+}
+
+template <class T, int BYTES, class OP>
+OC_SIMD_INLINE int VecScalar_ (const T* a, T s, T* out, int len)
+{
+  typedef T V __attribute__((vector_size(BYTES)));
+  const int lanes = BYTES/sizeof(T);
+  V y = V() + s;  // s in every lane
+  int ii = 0;
+  for (; ii+lanes<=len; ii+=lanes) {
+    V x;
+    memcpy(&x, a+ii, BYTES);
+    OP::apply(x, y);
+    memcpy(out+ii, &x, BYTES);
+  }
+  return ii;
+}
+
+template <class T, int BYTES, class OP>
+OC_SIMD_INLINE int VecUnary_ (const T* a, T* out, int len)
+{
+  typedef T V __attribute__((vector_size(BYTES)));
+  const int lanes = BYTES/sizeof(T);
+  int ii = 0;
+  for (; ii+lanes<=len; ii+=lanes) {
+    V x;
+    memcpy(&x, a+ii, BYTES);
+    OP::apply(x);
+    memcpy(out+ii, &x, BYTES);
+  }
+  return ii;
+}
+
+// Reduce with OP into result (which the caller has started off): if
+// b is given, reduce a*b instead of a (for Dot)
+template <class T, int BYTES, class OP>
+OC_SIMD_INLINE int VecReduce_ (const T* a, const T* b, int len, T& result)
+{
+  typedef T V __attribute__((vector_size(BYTES)));
+  const int lanes = BYTES/sizeof(T);
+  if (len<lanes) return 0;
+  V acc = V() + result;
+  int ii = 0;
+  for (; ii+lanes<=len; ii+=lanes) {
+    V x;
+    memcpy(&x, a+ii, BYTES);
+    if (b) {
+      V y;
+      memcpy(&y, b+ii, BYTES);
+      x = x*y;
+    }
+    OP::apply(acc, x);
+  }
+  T r = acc[0];
+  for (int jj=1; jj<lanes; jj++) {
+    T lane = acc[jj];
+    OP::apply(r, lane);
+  }
+  result = r;
+  return ii;
+}
+
+# if defined(OC_SIMD_AVX2)
+// The same kernels compiled for AVX2
+template <class T, class OP> OC_AVX2 int AVX2Binary_ (const T* a, const T* b, T* out, int len)
+{ return VecBinary_<T,32,OP>(a, b, out, len); }
+template <class T, class OP> OC_AVX2 int AVX2Scalar_ (const T* a, T s, T* out, int len)
+{ return VecScalar_<T,32,OP>(a, s, out, len); }
+template <class T, class OP> OC_AVX2 int AVX2Unary_ (const T* a, T* out, int len)
+{ return VecUnary_<T,32,OP>(a, out, len); }
+template <class T, class OP> OC_AVX2 int AVX2Reduce_ (const T* a, const T* b, int len, T& result)
+{ return VecReduce_<T,32,OP>(a, b, len, result); }
+#  define OC_SIMD_DISPATCH(KERNEL, ARGS) \
+  return OCHasAVX2() ? AVX2##KERNEL##_<T,OP> ARGS : Vec##KERNEL##_<T,16,OP> ARGS;
+# else
+#  define OC_SIMD_DISPATCH(KERNEL, ARGS) return Vec##KERNEL##_<T,16,OP> ARGS;
+# endif
+
+#endif // OC_SIMD_VECTOR
+
+
+// ///////////////////////////////////////////// Buffer level
+
+// Which kernels a type gets: only the integer and real types go to
+// the vector kernels, bool and complex (elementwise) get none and
+// always use the plain loop.  Each returns how many elements it did.
+template <class T, int VECTORIZABLE=0>
+struct OCKernels_ {
+  template <class OP> static int binary (const T*, const T*, T*, int) { return 0; }
+  template <class OP> static int scalar (const T*, T, T*, int) { return 0; }
+  template <class OP> static int unary (const T*, T*, int) { return 0; }
+  template <class OP> static int reduce (const T*, const T*, int, T&) { return 0; }
+};
+
+#if defined(OC_SIMD_VECTOR)
+template <class T>
+struct OCKernels_<T, 1> {
+  template <class OP> static int binary (const T* a, const T* b, T* out, int len)
+  { OC_SIMD_DISPATCH(Binary, (a, b, out, len)) }
+  template <class OP> static int scalar (const T* a, T s, T* out, int len)
+  { OC_SIMD_DISPATCH(Scalar, (a, s, out, len)) }
+  template <class OP> static int unary (const T* a, T* out, int len)
+  { OC_SIMD_DISPATCH(Unary, (a, out, len)) }
+  template <class OP> static int reduce (const T* a, const T* b, int len, T& r)
+  { OC_SIMD_DISPATCH(Reduce, (a, b, len, r)) }
+};
+# define OC_VECTORIZABLE(T) \
+  template <> struct OCKernels_<T, 0> : public OCKernels_<T, 1> { };
+OC_VECTORIZABLE(int_1)  OC_VECTORIZABLE(int_u1)
+OC_VECTORIZABLE(int_2)  OC_VECTORIZABLE(int_u2)
+OC_VECTORIZABLE(int_4)  OC_VECTORIZABLE(int_u4)
+OC_VECTORIZABLE(int_8)  OC_VECTORIZABLE(int_u8)
+OC_VECTORIZABLE(real_4) OC_VECTORIZABLE(real_8)
+#endif
+
+// out = a OP b, elementwise: out may be a or b
+template <class T, class OP>
+inline void BufferBinary_ (const T* a, const T* b, T* out, int len)
+{
+  int ii = 0;
+  if (len>=OC_SIMD_MIN_LENGTH) {
+    ii = OCKernels_<T>::template binary<OP>(a, b, out, len);
+  }
+  for (; ii<len; ii++) {
+    T r = a[ii];
+    OP::apply(r, b[ii]);
+    out[ii] = r;
+  }
+}
+
+// out = a OP s: out may be a
+template <class T, class OP>
+inline void BufferScalar_ (const T* a, T s, T* out, int len)
+{
+  int ii = 0;
+  if (len>=OC_SIMD_MIN_LENGTH) {
+    ii = OCKernels_<T>::template scalar<OP>(a, s, out, len);
+  }
+  for (; ii<len; ii++) {
+    T r = a[ii];
+    OP::apply(r, s);
+    out[ii] = r;
+  }
+}
+
+// out = OP a: out may be a
+template <class T, class OP>
+inline void BufferUnary_ (const T* a, T* out, int len)
+{
+  int ii = 0;
+  if (len>=OC_SIMD_MIN_LENGTH) {
+    ii = OCKernels_<T>::template unary<OP>(a, out, len);
+  }
+  for (; ii<len; ii++) {
+    T r = a[ii];
+    OP::apply(r);
+    out[ii] = r;
+  }
+}
+
+// Fold a (or a*b if b is given) into result with OP
+template <class T, class OP>
+inline T BufferReduce_ (const T* a, const T* b, int len, T result)
+{
+  int ii = 0;
+  if (len>=OC_SIMD_MIN_LENGTH) {
+    ii = OCKernels_<T>::template reduce<OP>(a, b, len, result);
+  }
+  if (b) {
+    for (; ii<len; ii++) {
+      T product = a[ii]*b[ii];
+      OP::apply(result, product);
+    }
+  } else {
+    for (; ii<len; ii++) OP::apply(result, a[ii]);
+  }
+  return result;
+}
+
+template <class T>
+inline void BufferAdd (const T* a, const T* b, T* out, int len)
+{ BufferBinary_<T, OCAddOp_>(a, b, out, len); }
+template <class T>
+inline void BufferSub (const T* a, const T* b, T* out, int len)
+{ BufferBinary_<T, OCSubOp_>(a, b, out, len); }
+template <class T>
+inline void BufferMul (const T* a, const T* b, T* out, int len)
+{ BufferBinary_<T, OCMulOp_>(a, b, out, len); }
+template <class T>
+inline void BufferScale (const T* a, T s, T* out, int len)
+{ BufferScalar_<T, OCMulOp_>(a, s, out, len); }
+template <class T>
+inline void BufferOffset (const T* a, T s, T* out, int len)
+{ BufferScalar_<T, OCAddOp_>(a, s, out, len); }
+template <class T>
+inline void BufferAbs (const T* a, T* out, int len)
+{ BufferUnary_<T, OCAbsOp_>(a, out, len); }
+template <class T>
+inline T BufferSum (const T* a, int len)
+{ return BufferReduce_<T, OCAddOp_>(a, 0, len, T(0)); }
+template <class T>
+inline T BufferDot (const T* a, const T* b, int len)
+{ return BufferReduce_<T, OCAddOp_>(a, b, len, T(0)); }
+template <class T>
+inline T BufferMin (const T* a, int len)
+{
+  if (len<=0) throw runtime_error("Min of an empty array");
+  return BufferReduce_<T, OCMinOp_>(a, 0, len, a[0]);
+}
+template <class T>
+inline T BufferMax (const T* a, int len)
+{
+  if (len<=0) throw runtime_error("Max of an empty array");
+  return BufferReduce_<T, OCMaxOp_>(a, 0, len, a[0]);
+}
+
+// Complex: Add, Sub and Scale (by a real) are just on twice as many
+// reals.  The rest are plain loops.
+#define OC_CX_BUFFER(CX, R) \
+inline void BufferAdd (const CX* a, const CX* b, CX* out, int len) \
+{ BufferAdd((const R*)a, (const R*)b, (R*)out, 2*len); } \
+inline void BufferSub (const CX* a, const CX* b, CX* out, int len) \
+{ BufferSub((const R*)a, (const R*)b, (R*)out, 2*len); } \
+inline void BufferScale (const CX* a, R s, CX* out, int len) \
+{ BufferScale((const R*)a, s, (R*)out, 2*len); } \
+inline void BufferScale (const CX* a, CX s, CX* out, int len) \
+{ for (int ii=0; ii<len; ii++) out[ii] = a[ii]*s; } \
+inline void BufferOffset (const CX* a, CX s, CX* out, int len) \
+{ for (int ii=0; ii<len; ii++) out[ii] = a[ii]+s; } \
+inline void BufferOffset (const CX* a, R s, CX* out, int len) \
+{ for (int ii=0; ii<len; ii++) { out[ii] = a[ii]; out[ii].re += s; } } \
+inline void BufferMul (const CX* a, const CX* b, CX* out, int len) \
+{ for (int ii=0; ii<len; ii++) out[ii] = a[ii]*b[ii]; } \
+inline void BufferMag2 (const CX* a, R* out, int len) \
+{ for (int ii=0; ii<len; ii++) out[ii] = a[ii].re*a[ii].re+a[ii].im*a[ii].im; } \
+inline void BufferMag (const CX* a, R* out, int len) \
+{ for (int ii=0; ii<len; ii++) out[ii] = sqrt(a[ii].re*a[ii].re+a[ii].im*a[ii].im); } \
+inline CX BufferSum (const CX* a, int len) \
+{ CX r; for (int ii=0; ii<len; ii++) r += a[ii]; return r; } \
+inline CX BufferDot (const CX* a, const CX* b, int len) \
+{ CX r; for (int ii=0; ii<len; ii++) r += a[ii]*b[ii]; return r; }
+OC_CX_BUFFER(complex_8,  real_4)
+OC_CX_BUFFER(complex_16, real_8)
+
+
+// ///////////////////////////////////////////// Array<T> level
+
+// Make result the same length as a, ready to be written over
+template <class T, class R>
+inline R* ArrayResult_ (const Array<T>& a, Array<R>& result)
+{
+  const int len = a.length();
+  result.clear();
+  result.expandTo(len);
+  return result.data();
+}
+
+template <class T>
+inline void ArrayCheckLengths_ (const Array<T>& a, const Array<T>& b)
+{
+  if (a.length()!=b.length()) {
+    throw runtime_error("Arrays of different lengths: "+
+			Stringize(a.length())+" and "+Stringize(b.length()));
+  }
+}
+
+// Elementwise ops, in-place (a op= b) and out-of-place (result = a op b)
+#define OC_ARRAY_BINARY(NAME) \
+template <class T> inline void Array##NAME (Array<T>& a, const Array<T>& b) \
+{ ArrayCheckLengths_(a, b); Buffer##NAME(a.data(), b.data(), a.data(), a.length()); } \
+template <class T> inline void Array##NAME (const Array<T>& a, const Array<T>& b, Array<T>& result) \
+{ ArrayCheckLengths_(a, b); const T* bd = b.data(); \
+  T* out = ArrayResult_(a, result); Buffer##NAME(a.data(), bd, out, a.length()); }
+OC_ARRAY_BINARY(Add)
+OC_ARRAY_BINARY(Sub)
+OC_ARRAY_BINARY(Mul)
+
+// With a scalar: in-place (a op= s) and out-of-place (result = a op s)
+#define OC_ARRAY_SCALAR(NAME) \
+template <class T, class S> inline void Array##NAME (Array<T>& a, S s) \
+{ Buffer##NAME(a.data(), s, a.data(), a.length()); } \
+template <class T, class S> inline void Array##NAME (const Array<T>& a, S s, Array<T>& result) \
+{ if (&a==&result) { Array##NAME(result, s); return; } \
+  T* out = ArrayResult_(a, result); Buffer##NAME(a.data(), s, out, a.length()); }
+OC_ARRAY_SCALAR(Scale)
+OC_ARRAY_SCALAR(Offset)
+
+template <class T> inline void ArrayAbs (Array<T>& a)
+{ BufferAbs(a.data(), a.data(), a.length()); }
+template <class T> inline void ArrayAbs (const Array<T>& a, Array<T>& result)
+{ if (&a==&result) { ArrayAbs(result); return; }
+  T* out = ArrayResult_(a, result); BufferAbs(a.data(), out, a.length()); }
+
+template <class CX, class R> inline void ArrayMag2 (const Array<CX>& a, Array<R>& result)
+{ R* out = ArrayResult_(a, result); BufferMag2(a.data(), out, a.length()); }
+template <class CX, class R> inline void ArrayMag (const Array<CX>& a, Array<R>& result)
+{ R* out = ArrayResult_(a, result); BufferMag(a.data(), out, a.length()); }
+
+template <class T> inline T ArraySum (const Array<T>& a)
+{ return BufferSum(a.data(), a.length()); }
+template <class T> inline T ArrayMin (const Array<T>& a)
+{ return BufferMin(a.data(), a.length()); }
+template <class T> inline T ArrayMax (const Array<T>& a)
+{ return BufferMax(a.data(), a.length()); }
+template <class T> inline T ArrayDot (const Array<T>& a, const Array<T>& b)
+{ ArrayCheckLengths_(a, b); return BufferDot(a.data(), b.data(), a.length()); }
+
+
+// ///////////////////////////////////////////// Val level
+
+// The Vals must hold POD arrays (tag 'n'): the binary ops need both
+// with the same subtype.  Arrays of bool aren't numbers: they throw.
+// Scalars (Scale, Offset) are converted to the element type, except
+// that a complex array with a real scalar stays on the fast path.
+// Abs and Mag of a complex array (and Mag2) give a real array.
+
+inline void ValArrayCheck_ (const Val& a, const char* routine)
+{
+  if (a.tag!='n') {
+    throw runtime_error(string(routine)+": input not an array");
+  }
+}
+inline void ValArrayCheck_ (const Val& a, const Val& b, const char* routine)
+{
+  ValArrayCheck_(a, routine);
+  ValArrayCheck_(b, routine);
+  if (a.subtype!=b.subtype) {
+    throw runtime_error(string(routine)+": arrays of different types '"+
+			a.subtype+"' and '"+b.subtype+"'");
+  }
+}
+inline void ValArrayBadType_ (const Val& a, const char* routine)
+{
+  throw runtime_error(string(routine)+": cannot work on arrays of type '"+
+		      a.subtype+"'");
+}
+
+// Calls M(T, NAME) for the element type T of the array A, or
+// CX(T, R, NAME) for complex arrays (R is the real type)
+#define OC_VAL_ARRAY_SWITCH(A, M, CX, NAME) \
+  switch (A.subtype) { \
+  case 's': M(int_1,  NAME); break; \
+  case 'S': M(int_u1, NAME); break; \
+  case 'i': M(int_2,  NAME); break; \
+  case 'I': M(int_u2, NAME); break; \
+  case 'l': M(int_4,  NAME); break; \
+  case 'L': M(int_u4, NAME); break; \
+  case 'x': M(int_8,  NAME); break; \
+  case 'X': M(int_u8, NAME); break; \
+  case 'f': M(real_4, NAME); break; \
+  case 'd': M(real_8, NAME); break; \
+  case 'F': CX(complex_8,  real_4, NAME); break; \
+  case 'D': CX(complex_16, real_8, NAME); break; \
+  default: ValArrayBadType_(A, "Array" #NAME); \
+  }
+
+// a op= b, result = a op b
+#define OC_VAL_BINARY_IN(T, NAME) \
+  { Array<T>& aa = a; Array<T>& bb = b; Array##NAME(aa, bb); }
+#define OC_VAL_BINARY_OUT(T, NAME) \
+  { Array<T>& aa = a; Array<T>& bb = b; r = Array<T>(aa.length()); \
+    Array<T>& rr = r; Array##NAME(aa, bb, rr); }
+#define OC_VAL_BINARY_IN_CX(T, R, NAME) OC_VAL_BINARY_IN(T, NAME)
+#define OC_VAL_BINARY_OUT_CX(T, R, NAME) OC_VAL_BINARY_OUT(T, NAME)
+#define OC_VAL_BINARY(NAME) \
+inline void Array##NAME (Val& a, const Val& b) \
+{ \
+  ValArrayCheck_(a, b, "Array" #NAME); \
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_BINARY_IN, OC_VAL_BINARY_IN_CX, NAME) \
+} \
+inline void Array##NAME (const Val& a, const Val& b, Val& result) \
+{ \
+  ValArrayCheck_(a, b, "Array" #NAME); \
+  Val r; \
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_BINARY_OUT, OC_VAL_BINARY_OUT_CX, NAME) \
+  result.swap(r); \
+}
+OC_VAL_BINARY(Add)
+OC_VAL_BINARY(Sub)
+OC_VAL_BINARY(Mul)
+
+// a op= s, result = a op s
+#define OC_VAL_SCALAR_IN(T, NAME) \
+  { Array<T>& aa = a; T ss = s; Array##NAME(aa, ss); }
+#define OC_VAL_SCALAR_OUT(T, NAME) \
+  { Array<T>& aa = a; T ss = s; r = Array<T>(aa.length()); \
+    Array<T>& rr = r; Array##NAME(aa, ss, rr); }
+#define OC_VAL_SCALAR_IN_CX(T, R, NAME) \
+  { Array<T>& aa = a; \
+    if (s.tag=='F' || s.tag=='D') { T ss = s; Array##NAME(aa, ss); } \
+    else { R ss = s; Array##NAME(aa, ss); } }
+#define OC_VAL_SCALAR_OUT_CX(T, R, NAME) \
+  { Array<T>& aa = a; r = Array<T>(aa.length()); Array<T>& rr = r; \
+    if (s.tag=='F' || s.tag=='D') { T ss = s; Array##NAME(aa, ss, rr); } \
+    else { R ss = s; Array##NAME(aa, ss, rr); } }
+#define OC_VAL_SCALAR(NAME) \
+inline void Array##NAME (Val& a, const Val& s) \
+{ \
+  ValArrayCheck_(a, "Array" #NAME); \
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_SCALAR_IN, OC_VAL_SCALAR_IN_CX, NAME) \
+} \
+inline void Array##NAME (const Val& a, const Val& s, Val& result) \
+{ \
+  ValArrayCheck_(a, "Array" #NAME); \
+  Val r; \
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_SCALAR_OUT, OC_VAL_SCALAR_OUT_CX, NAME) \
+  result.swap(r); \
+}
+OC_VAL_SCALAR(Scale)
+OC_VAL_SCALAR(Offset)
+
+// result = |a|, |a|^2: complex arrays give real arrays
+#define OC_VAL_ABS_OUT(T, NAME) \
+  { Array<T>& aa = a; r = Array<T>(aa.length()); Array<T>& rr = r; \
+    ArrayAbs(aa, rr); }
+#define OC_VAL_SQUARE_OUT(T, NAME) \
+  { Array<T>& aa = a; r = Array<T>(aa.length()); Array<T>& rr = r; \
+    ArrayMul(aa, aa, rr); }
+#define OC_VAL_MAG_OUT_CX(T, R, NAME) \
+  { Array<T>& aa = a; r = Array<R>(aa.length()); Array<R>& rr = r; \
+    ArrayMag(aa, rr); }
+#define OC_VAL_MAG2_OUT_CX(T, R, NAME) \
+  { Array<T>& aa = a; r = Array<R>(aa.length()); Array<R>& rr = r; \
+    ArrayMag2(aa, rr); }
+#define OC_VAL_UNARY(NAME, M, CX) \
+inline void Array##NAME (const Val& a, Val& result) \
+{ \
+  ValArrayCheck_(a, "Array" #NAME); \
+  Val r; \
+  OC_VAL_ARRAY_SWITCH(a, M, CX, NAME) \
+  result.swap(r); \
+} \
+inline void Array##NAME (Val& a) { Array##NAME(a, a); }
+OC_VAL_UNARY(Abs,  OC_VAL_ABS_OUT,    OC_VAL_MAG_OUT_CX)
+OC_VAL_UNARY(Mag,  OC_VAL_ABS_OUT,    OC_VAL_MAG_OUT_CX)
+OC_VAL_UNARY(Mag2, OC_VAL_SQUARE_OUT, OC_VAL_MAG2_OUT_CX)
+
+// Reductions to a single value (the same type as the elements)
+#define OC_VAL_REDUCE(T, NAME) \
+  { Array<T>& aa = a; return Array##NAME(aa); }
+#define OC_VAL_REDUCE_CX(T, R, NAME) OC_VAL_REDUCE(T, NAME)
+#define OC_VAL_REDUCE_NO_CX(T, R, NAME) ValArrayBadType_(a, "Array" #NAME);
+#define OC_VAL_DOT(T, NAME) \
+  { Array<T>& aa = a; Array<T>& bb = b; return Array##NAME(aa, bb); }
+#define OC_VAL_DOT_CX(T, R, NAME) OC_VAL_DOT(T, NAME)
+
+inline Val ArraySum (const Val& a)
+{
+  ValArrayCheck_(a, "ArraySum");
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_REDUCE, OC_VAL_REDUCE_CX, Sum)
+  return Val();
+}
+inline Val ArrayMin (const Val& a)
+{
+  ValArrayCheck_(a, "ArrayMin");
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_REDUCE, OC_VAL_REDUCE_NO_CX, Min)
+  return Val();
+}
+inline Val ArrayMax (const Val& a)
+{
+  ValArrayCheck_(a, "ArrayMax");
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_REDUCE, OC_VAL_REDUCE_NO_CX, Max)
+  return Val();
+}
+inline Val ArrayDot (const Val& a, const Val& b)
+{
+  ValArrayCheck_(a, b, "ArrayDot");
+  OC_VAL_ARRAY_SWITCH(a, OC_VAL_DOT, OC_VAL_DOT_CX, Dot)
+  return Val();
+}
+
+OC_END_NAMESPACE
+
+#define OC_ARRAYMATH_H_
+#endif // OC_ARRAYMATH_H_
@@ -250,6 +250,11 @@ class BigInt {
   string stringize (int default_base = 10) const
   { return impl_.stringize(default_base, sign()==0 ? ' ' : '-'); }
 
+  // Set this to the (non-negative) number in the given string of
+  // digits: see BigUInt::assignDigits
+  BigInt& assignDigits (const char* digits, int len, int base=10)
+  { impl_.assignDigits(digits, len, base); sign() = 0; return *this; }
+
   BigInt& singleDigitAdd (I digit) { return digitThing_(digit, 0); }
 
   BigInt& singleDigitSub (I digit) { return digitThing_(digit, 1); }
@@ -436,6 +441,9 @@ BIGINT_SPEC_OP(I,BI,>=);
 BIGINT_SPEC(int_u1, int_u2);
 BIGINT_SPEC(int_u2, int_u4);
 BIGINT_SPEC(int_u4, int_u8);
+#if defined(OC_INT128)
+BIGINT_SPEC(int_u8, int_u16);
+#endif
 
 // Basic ops: +, -, /, *
 /*
@@ -498,6 +506,9 @@ inline BigInt<I,BI> operator OP (const BigInt<I,BI>& lhs,const BigInt<I,BI>& rhs
 BIGINT_MATHOP_DEF(int_u1, int_u2);
 BIGINT_MATHOP_DEF(int_u2, int_u4);
 BIGINT_MATHOP_DEF(int_u4, int_u8);
+#if defined(OC_INT128)
+BIGINT_MATHOP_DEF(int_u8, int_u16);
+#endif
 
 
 // Stream operations
@@ -543,6 +554,7 @@ inline void MakeBigIntFromBinary (const char* in, int len,
   bool is_negative=MakeBigUIntFromBinary(in, len, int_return.impl_, true);
   if (is_negative) {
     int_return = (~int_return.impl_) + 1;
+    int_return.impl_.normalize_();  // top digits may be all sign
     int_return.sign() = 1;
   } else {
     int_return.sign() = 0;
@@ -560,6 +572,13 @@ inline string MakeBinaryFromBigInt (const BigInt<I, BI>& ii)
     BigUInt<I, BI> impl(ii.impl_);
     impl.negate();
     result = MakeBinaryFromBigUInt(impl, false);
+    // Digits bigger than 4 bytes: only keep as many 4-byte words as
+    // int_u4 digits would have had, so the bytes on the wire don't
+    // depend on the digit size
+    if (sizeof(I)>4) {
+      size_t words = (MakeBinaryFromBigUInt(ii.impl_).length()+3)/4;
+      result.resize(words*4);
+    }
     sign_bit = result[result.length()-1]>>7;
     if (sign_bit==0) result.append("\xff",1);
   } else {
@@ -584,6 +603,7 @@ inline BigUInt<I,BI> MakeBigUIntFromBigInt (const BigInt<I,BI>& s,Allocator *a)
 // What's the best way to use BigInts on a machine?  It seems that
 // on 32-bit machines: BigUInt<int_u2, int_u4> is faster
 // on 64-bit machines: BigUInt<int_u4, int_u8> is faster
+// and if there is a 128-bit int: BigUInt<int_u8, int_u16> is fastest
 // Use technique from Modern C++ Design to figure out how big pointers
 // are: this way we can choose the better implementation for int_un
 template <bool flag, typename T, typename U>
@@ -594,8 +614,13 @@ template <typename T, typename U>
 struct SelectBigInt<false, T, U> {
   typedef U Result;
 };
+#if defined(OC_INT128)
+typedef int_u8  Smaller_int;
+typedef int_u16 Bigger_int;
+#else
 typedef SelectBigInt<(sizeof(void*)==4), int_u2, int_u4>::Result Smaller_int;
 typedef SelectBigInt<(sizeof(void*)==4), int_u4, int_u8>::Result Bigger_int;
+#endif
 
 typedef BigInt<Smaller_int, Bigger_int> int_n;
 
@@ -664,12 +689,11 @@ inline BIGINT StringToBigIntHelper (const char* data, int len, Allocator *a)
     ii++;
     sign=c;
   }  
+  int start = ii;
   for (; ii<len; ii++) {
-    c = data[ii];
-    if ( !isdigit(c) ) break; // Only keep going if digit
-    result.singleDigitMultiply(10);
-    result.singleDigitAdd((c-'0'));
+    if ( !isdigit(data[ii]) ) break; // Only keep going if digit
   }
+  result.assignDigits(data+start, ii-start);
   if (sign=='-') {
     result.negate();
   }
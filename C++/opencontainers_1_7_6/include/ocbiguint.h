@@ -33,6 +33,34 @@
 #include <string.h>   // for memcpy
 #include <math.h>       // for modf and fmod
 
+// Multiplies switch from schoolbook to Karatsuba (and then to Toom-3)
+// when both numbers have at least this many "digits" (I).  Squares
+// (x*=x) have their own thresholds, as the schoolbook square is
+// faster than the schoolbook multiply.  See timing/bigint_timing.cc.
+#ifndef OC_KARATSUBA_THRESHOLD
+# define OC_KARATSUBA_THRESHOLD 32
+#endif
+#ifndef OC_KARATSUBA_SQR_THRESHOLD
+# define OC_KARATSUBA_SQR_THRESHOLD 48
+#endif
+#ifndef OC_TOOM3_THRESHOLD
+# define OC_TOOM3_THRESHOLD 400
+#endif
+#ifndef OC_TOOM3_SQR_THRESHOLD
+# define OC_TOOM3_SQR_THRESHOLD 512
+#endif
+
+// Numbers of more than this many "digits" (I) are converted to and
+// from strings by splitting them in half by a power of the base, and
+// the splits of more than OC_NEWTON_DIV_THRESHOLD digits divide with
+// a reciprocal from Newton's iteration rather than DivMod.
+#ifndef OC_RADIX_DC_THRESHOLD
+# define OC_RADIX_DC_THRESHOLD 32
+#endif
+#ifndef OC_NEWTON_DIV_THRESHOLD
+# define OC_NEWTON_DIV_THRESHOLD 2048
+#endif
+
 OC_BEGIN_NAMESPACE
 
 // Forward decl for converting to real values
@@ -50,6 +78,10 @@ template<class I, class BI>
 
 template<class I, class BI>
   string MakeBinaryFromBigUInt (const BigUInt<I, BI>& i, bool truncate=true);
+
+template<class I, class BI>
+  inline void MakeBigIntFromBinary (const char* in, int len, 
+				    BigInt<I,BI>& int_return);
 				
 template<class I, class BI>
   BigUInt<I,BI> MakeBigUIntFromBigInt (const BigInt<I,BI>& s, Allocator *a=0);
@@ -88,6 +120,8 @@ class BigUInt {
   friend bool MakeBigUIntFromBinary<>(const char* in_stream, int len,
 				      BigUInt& int_return, bool sign_extend);
   friend string MakeBinaryFromBigUInt<>(const BigUInt& i, bool truncate);
+  friend void MakeBigIntFromBinary<>(const char* in, int len, 
+				     BigInt<I,BI>& int_return);
 
   public:
 
@@ -302,57 +336,31 @@ class BigUInt {
     // Optimization
     if (other.length()==1) {
       return singleDigitMultiply(other.data_[0]);
+    } else if (length()==1) {
+      BigUInt result(other);
+      result.singleDigitMultiply(data_[0]);
+      this->swap(result);
+      return *this;
     }
 
-    // General convolution
-    static const BI mask = BI(I(~I(0))) << (sizeof(I)<<3);// all 1s top,0s bot
-    static const BI unmask = BI(~mask);                 // 0s top, 1s bottom
-
-    BigUInt result(false, length()+other.length()+ 4); // extra space for all the += , the 4 is just some slop
-    result.data_.append(0);  // still just 0 ...
-
-    // Normalize so lhs is longer one, rhs is shorter.  
-    bool compare = other.length() >= length();
-    const BigUInt& lhs = compare ? other : *this;
-    const BigUInt& rhs = compare ? *this : other;
-    // Assertion, len(lhs) is >= len(rhs)
-
-    // Convolve
-    const I* ldata = lhs.data_.data();
-    const I* rdata = rhs.data_.data();            // 2 for extra space
-    BigUInt intermediate_sum(false, lhs.length()+1+rhs.length()+2); 
-    I* idata = intermediate_sum.data_.data();
-    for (int ii=0; ii<rhs.length(); ii++) {
-      // plop zeros in bottom of intermediate sum and reuse as temp each time
-      for (int kk=0; kk<ii; kk++) {
-	idata[kk] = 0;
-      }
-      // Do a single digit multiply
-      BI carry = 0;
-      int jj = 0;
-      BI single_digit = rdata[ii];
-      for (; jj<lhs.length(); jj++) {
-	BI lhs_piece = ldata[jj];
-	BI rhs_piece = single_digit; // rdata[ii];
-	BI mult = lhs_piece * rhs_piece + carry;
-	carry = (mask & mult)>>(sizeof(I)<<3);
-	BI digit = unmask & mult;
-	idata[jj+ii] = digit;
-      }
-      // Left over carry, make sure we keep it, otherwise we are too long
-      idata[jj+ii] = carry;
-      if (!carry) {
-	intermediate_sum.data_.expandTo(lhs.length()+ii);
-      } else {
-	intermediate_sum.data_.expandTo(lhs.length()+ii+1);
-      }
-      // Assertion: intermediate_sum has the result of a digit multiply
-      result += intermediate_sum;
+    // Schoolbook, Karatsuba or Toom-3 depending on the sizes: x*=x
+    // is a square, which is faster still
+    const int len = length()+other.length();
+    BigUInt result(true, len);
+    if (&other==this) {
+      SqrLimbs_(result.data_.data(), data_.data(), length());
+    } else {
+      MulLimbs_(result.data_.data(), data_.data(), length(),
+		other.data_.data(), other.length());
     }
+    result.normalize_();
     this->swap(result);
     return *this;
   }
 
+  // Square this inplace: same as x*=x
+  BigUInt& square () { return *this *= *this; }
+
   // Inplace multiply this by a single digit: faster than general multiply
   BigUInt& singleDigitMultiply (I digit)
   {
@@ -372,6 +380,7 @@ class BigUInt {
     }
     // Left over carry, make sure we keep it, otherwise we are too long
     if (carry) data_.append(carry);
+    if (rhs_piece==0) normalize_();
     // All done
     return *this;
   }
@@ -454,26 +463,25 @@ class BigUInt {
       return result;
     }
 
-    // Use binary search to find the digit: bounds have to be signed
-    // integer so they don't roll, int_8 is "big enough" for all 3 I
-    // types we expect (int_u1, int_u2, int_u4)
-    int_8 upper_bound = I(~(I(0))); // can't excede this as an upper bound
-    int_8 lower_bound = 0;
-    int_8 mid;
+    // Use binary search to find the biggest digit d with m*d<=n: the
+    // answer is always in [lower_bound, upper_bound], so the (unsigned)
+    // bounds never roll
+    BI upper_bound = I(~(I(0))); // can't excede this as an upper bound
+    BI lower_bound = 0;
+    BI mid;
     int compare = -1;
-    while (upper_bound>=lower_bound) {
-      mid =(upper_bound + lower_bound)>>1; 
+    while (upper_bound>lower_bound) {
+      mid = lower_bound + (upper_bound - lower_bound + 1)/2; 
       trial_mk = m;
-      trial_mk.singleDigitMultiply(mid);  // this avoids extra copies
+      trial_mk.singleDigitMultiply(I(mid));  // this avoids extra copies
       compare = trial_mk.threeWayCompare(n);
       switch (compare) {
-      case -1: lower_bound = mid+1; break;  
-      case  0: closest_mult.swap(trial_mk); return mid; break; // found!
+      case -1: lower_bound = mid; break;  
+      case  0: closest_mult.swap(trial_mk); return I(mid); break; // found!
       case +1: upper_bound = mid-1; break;
       }
     }
-    // Out of bounds: so we "expected" the answer 
-    result=lower_bound-1;
+    result = I(lower_bound);
     trial_mk = m;
     trial_mk.singleDigitMultiply(result);  // this avoids extra copies
     closest_mult.swap(trial_mk);
@@ -484,8 +492,6 @@ class BigUInt {
   static void singleDigitDivide (const BigUInt& u, I v,
 				 BigUInt& q, I& r)
   {
-    static BI baseshift = sizeof(I)<<3; // how many bits to shift to *,/ by base
-
     // Error and simple cases
     if (v==0) 
       throw runtime_error("Division by zero");
@@ -501,11 +507,10 @@ class BigUInt {
     // Constants
     I* q_ = q.data_.data();
     const I* u_ = u.data_.data();
-    int_8 k = 0;
+    I k = 0;   // remainder so far: always < v
  
     for (int j=m-1; j>=0; j--) {
-      q_[j] = (BI(k<<baseshift) + u_[j])/v;
-      k = (BI(k<<baseshift) + u_[j]) - BI(q_[j]*v);
+      q_[j] = DivWide_(k, u_[j], v, k);
     }
     r = k;
     
@@ -529,7 +534,6 @@ class BigUInt {
     // Constants
     static const BI baseshift = sizeof(I)<<3; 
     static const BI b         = BI(1) << baseshift;
-    static const BI basemask  = b - 1;          // all ones for I
     int m = u.length(); const I *u_ = u.data_.data();
     int n = v.length(); const I *v_ = v.data_.data();
 
@@ -550,7 +554,6 @@ class BigUInt {
     BI qhat, rhat;
     BI p;          // product of 2 digits
     int s;
-    int_8 t, k; // TODO: have template choose int_8, int_4, int_2
 
     // Normalize (in the Knuth sense, getting the v above v/2
     // so we can apply the qhat check)
@@ -602,52 +605,56 @@ class BigUInt {
     // D2
     for (int j=m-n; j>=0; j--) { // main loop 
 
-      // D3: Compute estimate qhat of q[j]
-      //if (un[j+n] >= vn[n-1]) {
-      //qhat = b-1;
-      //} else 
-      {
-	qhat = ((BI(un[j+n])<<baseshift) + un[j+n-1])/BI(vn[n-1]);
-	rhat = ((BI(un[j+n])<<baseshift) + un[j+n-1]) - qhat * vn[n-1]; 
-
-    qhatfix:
-	if ((qhat>=b) || 
-	    ( qhat*vn[n-2] > (rhat<<baseshift) + un[j+n-2]) ) {
-	  qhat -= 1;
-	  rhat += vn[n-1];
-	  if (rhat < b) goto qhatfix;
-	}
+      // D3: Compute estimate qhat of q[j] (the top digit of the
+      // remainder is never more than the top digit of the divisor)
+      if (un[j+n] >= vn[n-1]) {
+	qhat = b-1;
+	rhat = BI(un[j+n-1]) + vn[n-1];
+      } else {
+	I r1;
+	qhat = DivWide_(un[j+n], un[j+n-1], vn[n-1], r1);
+	rhat = r1;
+      }
+      while (rhat < b && 
+	     qhat*vn[n-2] > (rhat<<baseshift) + un[j+n-2]) {
+	qhat -= 1;
+	rhat += vn[n-1];
       }
       
-      // D4: Multiply and subtract
-      k = 0;
+      // D4: Multiply and subtract (with unsigned carry and borrow, so
+      // this works for any size of I)
+      BI carry = 0;
+      I borrow = 0;
       for (int i=0; i<n; i++) {
-	p = qhat *vn[i];
-	t = un[i+j] - k - (p & basemask);  // The p keeps in BI range
+	p = qhat*vn[i] + carry;
+	carry = p >> baseshift;
+	const I low = I(p), ui = un[i+j];
+	const I t = ui - low - borrow;
+	borrow = (ui<low || (ui==low && borrow)) ? 1 : 0;
 	un[i+j] = t;
-	k = (p>>baseshift) - (t>>baseshift);
       }
-      t = un[j+n] -k;
-      un[j+n] = t;
+      const BI sub = carry + borrow;
+      const bool negative = BI(un[j+n]) < sub;
+      un[j+n] = I(un[j+n] - sub);
       
       // D5 test remainders
-      q_[j] = qhat;   // store quotient digit
-      if (t<0) {     // D6: If we subtracted too
+      q_[j] = I(qhat);   // store quotient digit
+      if (negative) {     // D6: If we subtracted too
 	q_[j] -= 1;   // much, add back
-	k = 0;
-	for (int i=0; i<n; i++) {
-	  t = BI(un[i+j]) + BI(vn[i]) + k; // Coersions needed to keep in BI
-	  un[i+j] = t;
-	  k = t >> baseshift;
-	}
-	un[j+n] += k;
+	un[j+n] += AddN_(un+j, un+j, vn, n);
       }
 
     } // D7: loop on j
 
-    // D8: Unnormalize remainder
-    for (int i=0; i<n; i++) {
-      r_[i] = (un[i] >> s) | (un[i+1] << (baseshift-s)); 
+    // D8: Unnormalize remainder (shift by number of bits is undefined)
+    if (s==0) {
+      for (int i=0; i<n; i++) {
+	r_[i] = un[i];
+      }
+    } else {
+      for (int i=0; i<n; i++) {
+	r_[i] = (un[i] >> s) | (un[i+1] << (baseshift-s)); 
+      }
     }
 
     // get rid of excess zeros
@@ -687,59 +694,58 @@ class BigUInt {
   
   // Print: this is used by operator<<
   ostream& print (ostream& os, int default_base = 10) const
-  {
-    static char base_lookup[] = "0123456789ABCDEF";
-    if (default_base>16 || default_base<2) {
-      throw runtime_error("Illegal base for print: only base 2-16");
-    }
-    if (zero()) {
-      return os << "0";
-    } 
-    BigUInt res(*this);
-    Array<char> pr(data_.length());
-    BigUInt divver, rem;
-    BigUInt base(default_base);
-    while (!res.zero()) {
-      DivMod(res, base, divver, rem);
-      I lsb = rem.data_[0]; // cout << "lsb = " << lsb << endl;
-      char single_digit = base_lookup[lsb];
-      pr.append(single_digit);
-      res.swap(divver);
-    }
-    // In reverse order:
-    for (int ii=pr.length()-1; ii>=0; ii--) {
-      os << pr[ii];
-    }
-    return os;
-  }
+  { return os << stringize(default_base); }
 
-  // Optimized string output function
+  // Optimized string output function: numbers are converted a chunk
+  // of digits at a time (9 decimal digits per divide for int_u4s), and
+  // big numbers are split in half (recursively) by powers of the base
+  // first, so printing a huge number is not quadratic.
   string stringize (int default_base = 10, char prefix=' ') const
   {
-    static char base_lookup[] = "0123456789ABCDEF";
     if (default_base>16 || default_base<2) {
       throw runtime_error("Illegal base for print: only base 2-16");
     }
-    BigUInt res(*this);
-    const int LEN = length() * 10;
-    char a[LEN]; // Enough space to stringize into based on size of int: don't waste space!
-    int ii=LEN-1;
-    BigUInt divver, rem;
-    BigUInt base(default_base);
-    do {
-      DivMod(res, base, divver, rem);
-      I lsb = rem.data_[0]; // cout << "lsb = " << lsb << endl;
-      char single_digit = base_lookup[lsb];
-      a[ii--] = single_digit;
-      res.swap(divver);
-    } while (!res.zero());
+    // Upper bound on how many digits, plus room for the prefix
+    const int len = int(length()*sizeof(I)*8*(log(2.0)/log(real_8(default_base)))) + 3;
+    Array<char> a(len);
+    a.expandTo(len);
+    char* end = a.data() + len;
+
+    int chunk;
+    const I chunk_power = ChunkPower_(default_base, chunk);
+    Array<BigUInt> pow(32), inv(32);
+    RadixPowers_(default_base, chunk, chunk_power, -1, length(), pow);
+    for (size_t ii=0; ii<pow.length(); ii++) inv.append(BigUInt());
+    ToDigits_(*this, end, len-1, default_base, chunk, chunk_power, pow, inv);
+
+    // Strip the leading zeros (keep one if it's zero)
+    char* start = end-(len-1);
+    while (start<end-1 && *start=='0') start++;
     if (prefix!=' ') {
-      a[ii--] = prefix;
+      *--start = prefix;
     }
-    return string(&a[ii+1], LEN-ii-1);
+    return string(start, end-start);
   }
 
-  
+  // Set this to the number in the given string of digits (most
+  // significant first, no sign or spaces: '0'-'9', then 'A'-'F' or
+  // 'a'-'f' for bases above 10).  Like stringize, big strings are split
+  // in half (recursively), so they are converted with a few big
+  // multiplies.
+  BigUInt& assignDigits (const char* digits, int len, int base=10)
+  {
+    if (base>16 || base<2) {
+      throw runtime_error("Illegal base for parse: only base 2-16");
+    }
+    int chunk;
+    const I chunk_power = ChunkPower_(base, chunk);
+    Array<BigUInt> pow(32);
+    RadixPowers_(base, chunk, chunk_power, len, -1, pow);
+    BigUInt result;
+    FromDigits_(digits, len, base, chunk, chunk_power, pow, result);
+    *this = result;   // keeps our allocator
+    return *this;
+  }
 
   // Helper: returns -1 is this<other 0 if this==other, 1 if this>other
   int threeWayCompare (const BigUInt& other) const
@@ -853,14 +859,595 @@ class BigUInt {
   void assignIt_ (T arg) 
   {
     int_8 plain = static_cast<int_8>(arg);
-    const BI mask = ~I(0) ; // all 1s up top,0s at bottom
-    for (size_t ii=0; ii<sizeof(plain)/sizeof(I); ii++) {
-      data_.append(plain & mask);
-      plain >>= (sizeof(I)<<3);
+    const BI mask = I(~I(0)) ; // all 1s up top,0s at bottom
+    data_.append(I(plain & mask));
+    for (size_t ii=1; ii<sizeof(plain)/sizeof(I); ii++) {
+      plain >>= (sizeof(I)<<2);  // two halves: a shift by the whole
+      plain >>= (sizeof(I)<<2);  // sizeof(plain) is undefined
+      data_.append(I(plain & mask));
     }
     normalize_();
   }
 
+
+  // ///// Multiplication on raw "digits"
+
+  // All of these work on plain arrays of I (least significant first),
+  // so the recursive multiplies don't have to build temporaries.  The
+  // result r never overlaps the inputs.
+
+  // (hi*base + lo) / v, and the remainder: hi<v, so the quotient is
+  // one digit.  (There's a faster version for 64-bit digits below.)
+  static I DivWide_ (I hi, I lo, I v, I& rem)
+  {
+    static const int baseshift = sizeof(I)<<3;
+    const BI num = (BI(hi)<<baseshift) + lo;
+    const BI q = num / v;
+    rem = I(num - q*v);
+    return I(q);
+  }
+
+  // r[0..n) += a[0..n)*digit, returning the carry out
+  static I MulAddDigit_ (I* r, const I* a, int n, I digit)
+  {
+    static const int baseshift = sizeof(I)<<3;
+    const BI d = digit;
+    BI carry = 0;
+    for (int ii=0; ii<n; ii++) {
+      BI t = BI(a[ii])*d + r[ii] + carry;  // can't overflow BI
+      r[ii] = I(t);
+      carry = t >> baseshift;
+    }
+    return I(carry);
+  }
+
+  // r[0..n) = a[0..n) + b[0..n), returning the carry out (r may be a)
+  static I AddN_ (I* r, const I* a, const I* b, int n)
+  {
+    static const int baseshift = sizeof(I)<<3;
+    BI carry = 0;
+    for (int ii=0; ii<n; ii++) {
+      BI t = BI(a[ii]) + b[ii] + carry;
+      r[ii] = I(t);
+      carry = t >> baseshift;
+    }
+    return I(carry);
+  }
+
+  // r[0..n) = a[0..n) - b[0..n), returning the borrow out (r may be a)
+  static I SubN_ (I* r, const I* a, const I* b, int n)
+  {
+    I borrow = 0;
+    for (int ii=0; ii<n; ii++) {
+      I ai = a[ii], bi = b[ii];
+      I t = ai - bi - borrow;
+      borrow = (ai<bi || (ai==bi && borrow)) ? 1 : 0;
+      r[ii] = t;
+    }
+    return borrow;
+  }
+
+  // r[0..rn) += a[0..an), with an<=rn: the carry runs up r, and
+  // is returned if it falls off the end
+  static I AddInto_ (I* r, int rn, const I* a, int an)
+  {
+    I carry = AddN_(r, r, a, an);
+    for (int ii=an; carry && ii<rn; ii++) {
+      carry = (++r[ii]==0);
+    }
+    return carry;
+  }
+
+  // r[0..rn) -= a[0..an), with an<=rn: returns the borrow
+  static I SubFrom_ (I* r, int rn, const I* a, int an)
+  {
+    I borrow = SubN_(r, r, a, an);
+    for (int ii=an; borrow && ii<rn; ii++) {
+      borrow = (r[ii]--==0);
+    }
+    return borrow;
+  }
+
+  // -1, 0, +1 as a[0..n) is <, ==, > b[0..n)
+  static int CompareN_ (const I* a, const I* b, int n)
+  {
+    for (int ii=n-1; ii>=0; ii--) {
+      if (a[ii]!=b[ii]) return a[ii]<b[ii] ? -1 : +1;
+    }
+    return 0;
+  }
+
+  // r = |a[0..an) - b[0..bn)|, with bn<=an, as an digits: returns
+  // true if a<b
+  static bool AbsDiff_ (I* r, const I* a, int an, const I* b, int bn)
+  {
+    bool a_smaller = false;
+    if (bn==an) {
+      a_smaller = CompareN_(a, b, an) < 0;
+    } else {
+      bool top_zero = true;
+      for (int ii=bn; ii<an; ii++) if (a[ii]) { top_zero = false; break; }
+      a_smaller = top_zero && CompareN_(a, b, bn) < 0;
+    }
+    if (a_smaller) {
+      SubN_(r, b, a, bn);         // b is all in bn digits
+      for (int ii=bn; ii<an; ii++) r[ii] = 0;
+    } else {
+      memcpy(r, a, an*sizeof(I));
+      SubFrom_(r, an, b, bn);
+    }
+    return a_smaller;
+  }
+
+  // Schoolbook: r[0..an+bn) = a*b
+  static void BasecaseMul_ (I* r, const I* a, int an, const I* b, int bn)
+  {
+    memset(r, 0, (an+bn)*sizeof(I));
+    for (int jj=0; jj<bn; jj++) {
+      r[jj+an] = MulAddDigit_(r+jj, a, an, b[jj]);
+    }
+  }
+
+  // Schoolbook square: r[0..2n) = a*a.  Each cross product a[i]*a[j]
+  // is only done once (and doubled), so this is about twice as fast
+  // as BasecaseMul_.
+  static void BasecaseSqr_ (I* r, const I* a, int n)
+  {
+    static const int baseshift = sizeof(I)<<3;
+    memset(r, 0, 2*n*sizeof(I));
+    for (int ii=0; ii<n-1; ii++) {
+      r[ii+n] = MulAddDigit_(r+2*ii+1, a+ii+1, n-ii-1, a[ii]);
+    }
+    // Double the cross products ...
+    I top = 0;
+    for (int ii=0; ii<2*n; ii++) {
+      I next = r[ii] >> (baseshift-1);
+      r[ii] = (r[ii]<<1) | top;
+      top = next;
+    }
+    // ... and add in the squares
+    BI carry = 0;
+    for (int ii=0; ii<n; ii++) {
+      BI sq = BI(a[ii])*a[ii];
+      BI t = BI(r[2*ii]) + I(sq) + carry;
+      r[2*ii] = I(t);
+      t = BI(r[2*ii+1]) + (sq>>baseshift) + (t>>baseshift);
+      r[2*ii+1] = I(t);
+      carry = t >> baseshift;
+    }
+  }
+
+  // Scratch space (in digits) Karatsuba needs for n digit inputs
+  static int KaratsubaScratch_ (int n)
+  {
+    if (n<OC_KARATSUBA_THRESHOLD) return 0;
+    const int m = n - n/2;
+    return 4*m+1 + KaratsubaScratch_(m);
+  }
+
+  // Karatsuba: r[0..2n) = a*b (or a*a if b is 0) for n digit inputs.
+  // Split each in two (low half m digits, high half k<=m digits):
+  //   a*b = z2*B^2m + (z0 + z2 + (a0-a1)*(b1-b0))*B^m + z0
+  // where z0=a0*b0, z2=a1*b1, so there are only 3 half size
+  // multiplies.  The scratch space ws is KaratsubaScratch_(n) digits.
+  static void Karatsuba_ (I* r, const I* a, const I* b, int n, I* ws)
+  {
+    const int m = n - n/2, k = n/2;
+    const bool sqr = (b==0);
+    I* z1 = ws;           // 2m digits
+    I* da = ws+2*m;       // m digits
+    I* db = ws+3*m;       // m digits
+    I* tmp = ws+2*m;      // 2m+1 digits: reuses da, db once z1 is done
+    I* rest = ws+4*m+1;   // for the recursive calls
+
+    // z1 = |a0-a1| * |b1-b0|
+    bool negative = AbsDiff_(da, a, m, a+m, k);
+    if (sqr) {
+      KaratsubaSqrN_(z1, da, m, rest);
+      negative = true;                  // -(a0-a1)^2
+    } else {
+      negative ^= !AbsDiff_(db, b, m, b+m, k);  // (b0-b1) = -(b1-b0)
+      KaratsubaMulN_(z1, da, db, m, rest);
+    }
+    // z0 and z2 straight into place
+    if (sqr) {
+      KaratsubaSqrN_(r, a, m, rest);
+      KaratsubaSqrN_(r+2*m, a+m, k, rest);
+    } else {
+      KaratsubaMulN_(r, a, b, m, rest);
+      KaratsubaMulN_(r+2*m, a+m, b+m, k, rest);
+    }
+    // tmp = z0 + z2 +/- z1, then add it in the middle
+    memcpy(tmp, r, 2*m*sizeof(I));
+    tmp[2*m] = AddInto_(tmp, 2*m, r+2*m, 2*k);
+    if (negative) {
+      SubFrom_(tmp, 2*m+1, z1, 2*m);
+    } else {
+      AddInto_(tmp, 2*m+1, z1, 2*m);
+    }
+    AddInto_(r+m, 2*n-m, tmp, 2*m+1 <= 2*n-m ? 2*m+1 : 2*n-m);
+  }
+  static void KaratsubaMulN_ (I* r, const I* a, const I* b, int n, I* ws)
+  {
+    if (n<OC_KARATSUBA_THRESHOLD) BasecaseMul_(r, a, n, b, n);
+    else Karatsuba_(r, a, b, n, ws);
+  }
+  static void KaratsubaSqrN_ (I* r, const I* a, int n, I* ws)
+  {
+    if (n<OC_KARATSUBA_SQR_THRESHOLD) BasecaseSqr_(r, a, n);
+    else if (n<OC_KARATSUBA_THRESHOLD) BasecaseMul_(r, a, n, a, n);
+    else Karatsuba_(r, a, 0, n, ws);
+  }
+
+  // Make a BigUInt from some digits
+  static BigUInt FromLimbs_ (const I* a, int n)
+  {
+    BigUInt result(true, n>0 ? n : 1);
+    if (n>0) memcpy(result.data_.data(), a, n*sizeof(I));
+    else result.data_[0] = 0;
+    result.normalize_();
+    return result;
+  }
+
+  // a += b for sign-magnitude values (Toom-3 needs negatives)
+  static void SignedAdd_ (BigUInt& a, bool& a_neg, 
+			  const BigUInt& b, bool b_neg)
+  {
+    if (a_neg==b_neg) {
+      a += b;
+    } else if (a>=b) {
+      a -= b;
+    } else {
+      BigUInt t(b);
+      t -= a;
+      a.swap(t);
+      a_neg = b_neg;
+    }
+    if (a.zero()) a_neg = false;
+  }
+
+  // Exact division by a small digit (magnitude only)
+  static void DivideExact_ (BigUInt& a, I digit)
+  {
+    BigUInt q; I rem;
+    singleDigitDivide(a, digit, q, rem);
+    a.swap(q);
+  }
+
+  // Toom-3: r[0..2n) = a*b (or a*a if b is 0) for n digit inputs.
+  // Split each in three, so a(x) = a2*x^2 + a1*x + a0 with x=B^k,
+  // evaluate at 0, 1, -1, -2 and infinity, do the 5 multiplies of a
+  // third the size (recursively), then interpolate back (Bodrato's
+  // sequence).  This works on BigUInts: it only kicks in for big
+  // numbers where the temporaries don't matter.
+  static void Toom3_ (I* r, const I* a, const I* b, int n)
+  {
+    const int k = (n+2)/3;
+    const bool sqr = (b==0);
+
+    // Evaluate a (and b) at 0, 1, -1, -2, infinity
+    BigUInt ev[2][5];                   // [a or b][point]
+    bool neg[2][5] = { { false }, { false } };
+    for (int which=0; which<(sqr ? 1 : 2); which++) {
+      const I* x = which==0 ? a : b;
+      BigUInt x0 = FromLimbs_(x, k);
+      BigUInt x1 = FromLimbs_(x+k, k);
+      BigUInt x2 = FromLimbs_(x+2*k, n-2*k);
+      BigUInt* e = ev[which];
+      bool* e_neg = neg[which];
+      BigUInt x02 = x0;  x02 += x2;
+      e[0] = x0;
+      e[1] = x02;  e[1] += x1;
+      e[2] = x02;  SignedAdd_(e[2], e_neg[2], x1, true);
+      e[3] = x2;   e[3] += x2;                     // 2*(2*x2-x1) + x0
+      SignedAdd_(e[3], e_neg[3], x1, true);
+      e[3] += BigUInt(e[3]);
+      SignedAdd_(e[3], e_neg[3], x0, false);
+      e[4] = x2;
+    }
+    if (sqr) {
+      for (int ii=0; ii<5; ii++) {
+	ev[1][ii] = ev[0][ii];
+	neg[1][ii] = neg[0][ii];
+      }
+    }
+
+    // Pointwise multiplies (these recurse back through *=)
+    BigUInt w[5];
+    bool w_neg[5];
+    for (int ii=0; ii<5; ii++) {
+      w[ii] = ev[0][ii];
+      if (sqr) w[ii].square(); else w[ii] *= ev[1][ii];
+      w_neg[ii] = (neg[0][ii]!=neg[1][ii]) && !w[ii].zero();
+    }
+
+    // Interpolate: t1, t2, t3 are the middle coefficients
+    BigUInt t3 = w[3]; bool t3_neg = w_neg[3];
+    SignedAdd_(t3, t3_neg, w[1], true);         // (w(-2) - w(1)) / 3
+    DivideExact_(t3, 3);
+    BigUInt t1 = w[1]; bool t1_neg = false;
+    SignedAdd_(t1, t1_neg, w[2], !w_neg[2]);    // (w(1) - w(-1)) / 2
+    DivideExact_(t1, 2);
+    BigUInt t2 = w[2]; bool t2_neg = w_neg[2];
+    SignedAdd_(t2, t2_neg, w[0], true);         // w(-1) - w(0)
+    {
+      BigUInt t = t2; bool t_neg = t2_neg;      // (t2 - t3)/2 + 2*w(inf)
+      SignedAdd_(t, t_neg, t3, !t3_neg);
+      DivideExact_(t, 2);
+      BigUInt twice = w[4]; twice += w[4];
+      SignedAdd_(t, t_neg, twice, false);
+      t3.swap(t); t3_neg = t_neg;
+    }
+    SignedAdd_(t2, t2_neg, t1, t1_neg);         // t2 + t1 - w(inf)
+    SignedAdd_(t2, t2_neg, w[4], true);
+    SignedAdd_(t1, t1_neg, t3, !t3_neg);        // t1 - t3
+
+    // Recompose: all the coefficients are positive now
+    memset(r, 0, 2*n*sizeof(I));
+    const BigUInt* coeff[5] = { &w[0], &t1, &t2, &t3, &w[4] };
+    for (int ii=0; ii<5; ii++) {
+      const BigUInt& c = *coeff[ii];
+      const int off = ii*k;
+      int len = c.length();
+      if (c.zero() || off>=2*n) continue;
+      if (off+len > 2*n) len = 2*n-off;  // top digits must be zero
+      AddInto_(r+off, 2*n-off, c.data_.data(), len);
+    }
+  }
+
+  // r[0..2n) = a*b for n digit inputs: chooses the algorithm
+  static void MulN_ (I* r, const I* a, const I* b, int n)
+  {
+    if (n<OC_KARATSUBA_THRESHOLD) {
+      BasecaseMul_(r, a, n, b, n);
+    } else if (n<OC_TOOM3_THRESHOLD) {
+      Array<I> ws(KaratsubaScratch_(n));
+      Karatsuba_(r, a, b, n, ws.data());
+    } else {
+      Toom3_(r, a, b, n);
+    }
+  }
+
+  // r[0..an+bn) = a*b for any sizes: a long a is cut into pieces the
+  // size of b, so each piece is a balanced multiply
+  static void MulLimbs_ (I* r, const I* a, int an, const I* b, int bn)
+  {
+    if (an<bn) { 
+      const I* t = a; a = b; b = t; 
+      int tn = an; an = bn; bn = tn;
+    }
+    if (bn<OC_KARATSUBA_THRESHOLD) {
+      BasecaseMul_(r, a, an, b, bn);
+      return;
+    }
+    if (an==bn) {
+      MulN_(r, a, b, an);
+      return;
+    }
+    memset(r, 0, (an+bn)*sizeof(I));
+    Array<I> piece(2*bn);
+    I* p = piece.data();
+    for (int off=0; off<an; off+=bn) {
+      const int len = an-off < bn ? an-off : bn;
+      if (len==bn) {
+	MulN_(p, a+off, b, bn);
+      } else {
+	MulLimbs_(p, b, bn, a+off, len);
+      }
+      AddInto_(r+off, an+bn-off, p, len+bn);
+    }
+  }
+
+  // r[0..2n) = a*a
+  static void SqrLimbs_ (I* r, const I* a, int n)
+  {
+    if (n<OC_KARATSUBA_SQR_THRESHOLD) {
+      BasecaseSqr_(r, a, n);
+    } else if (n<OC_KARATSUBA_THRESHOLD) {
+      BasecaseMul_(r, a, n, a, n);
+    } else if (n<OC_TOOM3_SQR_THRESHOLD) {
+      Array<I> ws(KaratsubaScratch_(n));
+      Karatsuba_(r, a, 0, n, ws.data());
+    } else {
+      Toom3_(r, a, 0, n);
+    }
+  }
+
+
+  // ///// Conversion to and from digits in some base
+
+  // The biggest power of base (base^chunk) that fits in one I: that
+  // many digits at a time can go through a singleDigitDivide or
+  // singleDigitMultiply
+  static I ChunkPower_ (int base, int& chunk)
+  {
+    const BI max_digit = I(~I(0));
+    BI power = base;
+    chunk = 1;
+    while (power*base <= max_digit) {
+      power *= base;
+      chunk++;
+    }
+    return I(power);
+  }
+
+  // pow[k] = base^(chunk*2^k) (each the square of the one before),
+  // as far as needed for a string of digits characters, or for a
+  // number of the given number of I
+  static void RadixPowers_ (int base, int chunk, I chunk_power,
+			    int digits, int len, Array<BigUInt>& pow)
+  {
+    pow.append(BigUInt());
+    pow[0].data_[0] = chunk_power;
+    for (int kk=0; true; kk++) {
+      if (digits>=0 && int_8(chunk)<<(kk+1) >= digits) break;
+      if (len>=0 && 2*pow[kk].length() >= len) break;
+      BigUInt next = pow[kk];
+      next.square();
+      pow.append(next);
+    }
+  }
+
+  static int DigitValue_ (char c)
+  {
+    if (c>='0' && c<='9') return c-'0';
+    if (c>='a' && c<='f') return c-'a'+10;
+    if (c>='A' && c<='F') return c-'A'+10;
+    return 0;
+  }
+
+  // Write x as exactly width digits (with leading zeros) ending just
+  // before end
+  static void ToDigits_ (const BigUInt& x, char* end, int width,
+			 int base, int chunk, I chunk_power,
+			 Array<BigUInt>& pow, Array<BigUInt>& inv)
+  {
+    static char base_lookup[] = "0123456789ABCDEF";
+    char* start = end-width;
+    if (x.length() < OC_RADIX_DC_THRESHOLD) {
+      // A chunk of digits per divide
+      BigUInt res(x), divver;
+      I rem;
+      while (!res.zero() && end>start) {
+	singleDigitDivide(res, chunk_power, divver, rem);
+	for (int ii=0; ii<chunk && end>start; ii++) {
+	  *--end = base_lookup[rem % base];
+	  rem /= base;
+	}
+	res.swap(divver);
+      }
+      while (end>start) *--end = '0';
+      return;
+    }
+
+    // Split by the power that leaves about half the digits on each side
+    int kk = 0;
+    while (2*pow[kk].length() < x.length()) kk++;
+    BigUInt q, r;
+    if (pow[kk].length() >= OC_NEWTON_DIV_THRESHOLD) {
+      if (inv[kk].zero()) Reciprocal_(pow[kk], inv[kk]);
+      ReciprocalDivMod_(x, pow[kk], inv[kk], q, r);
+    } else {
+      DivMod(x, pow[kk], q, r);
+    }
+    const int low = chunk<<kk;
+    ToDigits_(r, end, low, base, chunk, chunk_power, pow, inv);
+    ToDigits_(q, end-low, width-low, base, chunk, chunk_power, pow, inv);
+  }
+
+  // result = the value of digits[0..len)
+  static void FromDigits_ (const char* digits, int len,
+			   int base, int chunk, I chunk_power,
+			   Array<BigUInt>& pow, BigUInt& result)
+  {
+    if (len < chunk*OC_RADIX_DC_THRESHOLD) {
+      // A chunk of digits per multiply: the first chunk is partial
+      result = BigUInt();
+      int ii = 0;
+      int first = len % chunk;
+      if (first==0) first = chunk;
+      while (ii<len) {
+	I value = 0;
+	I scale = 1;
+	for (const int end=ii+first; ii<end; ii++) {
+	  value = value*base + DigitValue_(digits[ii]);
+	  scale *= base;
+	}
+	result.singleDigitMultiply(scale);
+	result.singleDigitAdd(value);
+	first = chunk;
+      }
+      return;
+    }
+
+    // high * base^low + low, where low is the biggest power of two
+    // chunks less than all the digits
+    int kk = 0;
+    while (int_8(chunk)<<(kk+1) < len) kk++;
+    const int low = chunk<<kk;
+    BigUInt high, low_part;
+    FromDigits_(digits, len-low, base, chunk, chunk_power, pow, high);
+    FromDigits_(digits+len-low, low, base, chunk, chunk_power, pow, low_part);
+    high *= pow[kk];
+    high += low_part;
+    high.normalize_();
+    result.swap(high);
+  }
+
+  // x / B^k and x * B^k, where B is the base of I (so these just
+  // move the digits of x)
+  static BigUInt ShiftDown_ (const BigUInt& x, int k)
+  {
+    if (k>=x.length()) return BigUInt();
+    return FromLimbs_(x.data_.data()+k, x.length()-k);
+  }
+  static BigUInt ShiftUp_ (const BigUInt& x, int k)
+  {
+    if (x.zero()) return BigUInt();
+    BigUInt result(true, x.length()+k);
+    I* data = result.data_.data();
+    memset(data, 0, k*sizeof(I));
+    memcpy(data+k, x.data_.data(), x.length()*sizeof(I));
+    return result;
+  }
+
+  // x = floor(B^2m / d), where d has m digits (I).  This is computed
+  // by Newton's iteration from the reciprocal of the top half of d
+  // (recursively), so it costs a few multiplies rather than a divide.
+  static void Reciprocal_ (const BigUInt& d, BigUInt& x)
+  {
+    const int m = d.length();
+    BigUInt b2m = ShiftUp_(BigUInt(1), 2*m);
+    if (m < OC_NEWTON_DIV_THRESHOLD || m < 8) {
+      BigUInt r;
+      DivMod(b2m, d, x, r);
+      return;
+    }
+    // Reciprocal of the top h digits (with 2 digits to spare, so one
+    // Newton step gets almost all the digits right) ...
+    const int h = (m+1)/2 + 2;
+    BigUInt top;
+    Reciprocal_(ShiftDown_(d, m-h), top);
+    x = ShiftUp_(top, m-h);
+
+    // ... one Newton step: x += x*(B^2m - d*x)/B^2m ...
+    BigUInt dx = d*x;
+    if (dx<=b2m) {
+      BigUInt e = b2m;  e -= dx;
+      x += ShiftDown_(x*e, 2*m);
+    } else {
+      BigUInt e = dx;  e -= b2m;
+      x -= ShiftDown_(x*e, 2*m);
+    }
+    x.normalize_();
+
+    // ... and fix up the last few units
+    dx = d*x;
+    while (dx>b2m) {
+      x.singleDigitSub(1);
+      dx -= d;
+    }
+    b2m -= dx;
+    while (b2m>=d) {
+      x.singleDigitAdd(1);
+      b2m -= d;
+    }
+  }
+
+  // q, r = x / d, x % d for x < B^2m, where d has m digits and inv is
+  // Reciprocal_(d): q is off by at most 2
+  static void ReciprocalDivMod_ (const BigUInt& x, const BigUInt& d,
+				 const BigUInt& inv, BigUInt& q, BigUInt& r)
+  {
+    q = ShiftDown_(x*inv, 2*d.length());
+    r = x;
+    r -= q*d;
+    while (r>=d) {
+      r -= d;
+      q.singleDigitAdd(1);
+    }
+  }
+
   // Get rid of excess zeros at the front to keep the impl minimal:
   // zero needs to be length==1 and data_[0]==0
   void normalize_()
@@ -956,6 +1543,9 @@ BIGUINT_SPEC_OP(I,BI,>=);
 BIGUINT_SPEC(int_u1, int_u2);
 BIGUINT_SPEC(int_u2, int_u4);
 BIGUINT_SPEC(int_u4, int_u8);
+#if defined(OC_INT128)
+BIGUINT_SPEC(int_u8, int_u16);
+#endif
 
 
 // Basic ops: +, -, /, *
@@ -1018,6 +1608,24 @@ inline BigUInt<I,BI> operator OP (const BigUInt<I,BI>& lhs,const BigUInt<I,BI>&
 BIGUINT_MATHOP_DEF(int_u1, int_u2);
 BIGUINT_MATHOP_DEF(int_u2, int_u4);
 BIGUINT_MATHOP_DEF(int_u4, int_u8);
+#if defined(OC_INT128)
+BIGUINT_MATHOP_DEF(int_u8, int_u16);
+#endif
+
+#if defined(OC_INT128) && defined(__x86_64__) && defined(__GNUC__)
+// 64-bit digits: the compiler turns an int_u16/int_u8 divide into a
+// call (as the quotient may not fit in 64 bits), but here it always
+// fits, so one divq does it
+template <> 
+inline int_u8 BigUInt<int_u8, int_u16>::DivWide_ (int_u8 hi, int_u8 lo, 
+						int_u8 v, int_u8& rem)
+{
+  int_u8 q, r;
+  __asm__ ("divq %4" : "=a"(q), "=d"(r) : "a"(lo), "d"(hi), "rm"(v));
+  rem = r;
+  return q;
+}
+#endif
 
 // Stream operations
 template <class I, class BI>
@@ -1069,12 +1677,28 @@ template<class I, class BI>
 inline real_8 MakeRealFromBigUInt (const BigUInt<I, BI>& int_thing)
 {
   // We have to divide out the "max I" everytime to convert
-  static BI int_max_divver = I(~I(0)) + 1;
+  static BI int_max_divver = BI(I(~I(0))) + 1;
   real_8 max_divver = int_max_divver; // Note: This can be a problem if the real_8 can't hold without dropping precision, as long as number of bits of precision of real_8 > number of bits of _I_, should be okay.
   
   // Start at lsb to make sure we keep as mch precision as possible:
   // when real_8 gets big, precision will be dropped, so it's better
   // to have the precision in and have it get dropped.
+  if (sizeof(I)>4) {
+    // Digits bigger than 32 bits are added in 32-bit halves, so the
+    // rounding is the same as it was with int_u4 digits
+    const real_8 half_divver = 4294967296.0;
+    real_8 result = real_8(int_u4(int_thing.data_[0]));
+    real_8 scale = half_divver;
+    for (size_t ii=0; ii<int_thing.data_.length(); ii++) {
+      int_u8 digit = int_thing.data_[ii];
+      for (size_t jj=(ii==0); jj<sizeof(I)/4; jj++) {
+	int_u4 half = int_u4(digit >> (32*jj));
+	if (half) result += scale*real_8(half);
+	scale *= half_divver;
+      }
+    }
+    return result;
+  }
   real_8 result = int_thing.data_[0];
   for (size_t ii=1; ii<int_thing.data_.length(); ii++) {
     result += max_divver*real_8(int_thing.data_[ii]);
@@ -1132,6 +1756,7 @@ inline bool MakeBigUIntFromBinary (const char* in, int len,
     int_return.data_.append(temp);
     in += minor;
   }
+  int_return.normalize_();  // (no-op if sign extended)
   return is_negative;
 }
 
@@ -1245,6 +1870,7 @@ inline string DecimalApproximation (const BigUInt<I,BI>& num,
 // What's the best way to use BigUInts on a machine?  It seems that
 // on 32-bit machines: BigUInt<int_u2, int_u4> is faster
 // on 64-bit machines: BigUInt<int_u4, int_u8> is faster
+// and if there is a 128-bit int: BigUInt<int_u8, int_u16> is fastest
 // Use technique from Modern C++ Design to figure out how big pointers
 // are: this way we can choose the better implementation for int_un
 template <bool flag, typename T, typename U>
@@ -1255,8 +1881,13 @@ template <typename T, typename U>
 struct SelectBigUInt<false, T, U> {
   typedef U Result;
 };
+#if defined(OC_INT128)
+typedef int_u8  Smaller_uint;
+typedef int_u16 Bigger_uint;
+#else
 typedef SelectBigUInt<(sizeof(void*)==4), int_u2, int_u4>::Result Smaller_uint;
 typedef SelectBigUInt<(sizeof(void*)==4), int_u4, int_u8>::Result Bigger_uint;
+#endif
 
 typedef BigUInt<Smaller_uint, Bigger_uint> int_un;
 
@@ -1287,12 +1918,11 @@ inline BIGINT StringToBigUIntHelper (const char* data, int len, Allocator* a)
     ii++;
     sign=c;
   }  
+  int start = ii;
   for (; ii<len; ii++) {
-    c = data[ii];
-    if ( !isdigit(c) ) break; // Only keep going if digit
-    result.singleDigitMultiply(10);
-    result.singleDigitAdd((c-'0'));
+    if ( !isdigit(data[ii]) ) break; // Only keep going if digit
   }
+  result.assignDigits(data+start, ii-start);
   if (sign=='-') {
     result.negate();
   }
@@ -1300,7 +1930,7 @@ inline BIGINT StringToBigUIntHelper (const char* data, int len, Allocator* a)
 }
 
 inline int_un StringToBigUInt (const char* data, int len, Allocator* a=0)
-{ return StringToBigUIntHelper<int_un>(data, int(strlen(data)), a); }
+{ return StringToBigUIntHelper<int_un>(data, len, a); }
 
 inline int_un StringToBigUInt (const char* data, Allocator *a=0)
 { return StringToBigUInt(data, int(strlen(data)), a); }
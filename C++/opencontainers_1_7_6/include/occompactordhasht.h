@@ -0,0 +1,871 @@
+#ifndef OC_COMPACTORDHASHT_H_
+
+// The CompactOrdHashT is a class for managing Key/Value pairs that
+// remembers insertion order, just like the OrdAVLHashT (go look
+// there first).  It has exactly the same interface and is a plug-in
+// replacement for it.
+
+// Like OrdAVLHashT, you DO NOT need operator< supported by your keys,
+// but you DO need a HashFunction (const K& key) that returns an int_u4.
+
+// Why another ordered table?  Every entry of an OrdAVLHashT is a tree
+// node with a hash bucket link AND a doubly-linked insertion order
+// list: that's 7 words of overhead for every key/value, and walking
+// the table in order chases a pointer per entry.  The CompactOrdHashT
+// is laid out like the Python 3.6+ dict: the entries themselves sit
+// densely in insertion order (so iteration is a linear scan), and a
+// separate, small open-addressing index of 1, 2 or 4 byte integers
+// (depending on how big the table is) says where each hash goes.
+// Big OrderedDicts (like the ones from XML_LOAD_USE_OTABS) take a
+// lot less memory this way.
+
+// [Implementation: The entries are kept in segments that double in
+// size (CHUNKSIZE entries, then 2*CHUNKSIZE, ...), so the entry for
+// an insertion number is found with a little arithmetic, and entries
+// NEVER move when the table grows: references to keys and values
+// stay valid across inserts, just like the OrdAVLHashT.  This
+// matters for Val, where code like "Val& v = t["a"]; t["b"] = v;" is
+// everywhere.  The index is rebuilt (not the entries) when it gets
+// 2/3 full.]
+
+// [Removal: removing an entry leaves a hole in the entries (and a
+// DUMMY in the index).  When more than half the entries are holes,
+// a remove squeezes them out: so, unlike the OrdAVLHashT, a remove
+// may MOVE the other entries, and references into the table are only
+// good until the next remove.]
+
+// ///////////////////////////////////////////// Includes
+
+#include "ocport.h"
+#include "ocarray.h"         // for the sorted iterator
+
+#include "ocstreamingpool.h" // class Allocator;  // Forward
+#include "ocsort.h"          // for OCQuickSort
+#include "ocflathasht.h"     // for FlatMixHash_
+
+OC_BEGIN_NAMESPACE
+
+// ///////////////////////////////////////////// The CompactOrdNode_ struct
+
+// Implementation Detail: the key-value pair (and its full hash, so we
+// never have to rehash a key when the index grows).  A removed entry
+// has its key and value destructed and is no longer live.
+template <class K, class V>
+struct CompactOrdNode_ {
+    CompactOrdNode_ (const K& k, int_u4 keyhash, const V& v) :
+      hashkey(keyhash), live(true), key(k), value(v)
+    { }
+
+    // The hash key: computed hash value, stored in the entry
+    int_u4 hashkey;
+
+    // False for the holes removes leave behind
+    bool live;
+
+    // The key and value for this entry
+    K key;
+    V value;
+
+};  // CompactOrdNode_
+
+// Most CompactOrdHashT's can get by with this
+template <class K, class V>
+inline CompactOrdNode_<K,V>*
+CompactOrdCreateNode (void* memory_to_construct_into,
+		      const K& k, int_u4 keyhash, const V& v,
+		      Allocator*)
+{
+  return new (memory_to_construct_into) CompactOrdNode_<K,V>(k,keyhash,v);
+}
+
+// Implementation Detail: at the front of the memory for the index
+struct CompactOrdHeader_ {
+  int_u4 used;      // Entries used, in order: live ones AND holes
+  int_u4 filled;    // Index slots that aren't EMPTY (entries + DUMMYs)
+  int_u4 segments;  // Entry segments allocated so far
+  int_u4 pad;
+}; // CompactOrdHeader_
+
+// Index slots hold the entry number, or one of these
+enum { COMPACT_EMPTY = -1, COMPACT_DUMMY = -2 };
+
+
+// ///////////////////////////////////////////// Forwards
+
+template <class K, class V, int_u4 CHUNKSIZE> class CompactOrdHashTIterator;
+template <class K, class V, int_u4 CHUNKSIZE> class CompactOrdHashTSortedIterator;
+
+
+// ///////////////////////////////////////////// The CompactOrdHashT Class
+
+template <class K, class V, int_u4 CHUNKSIZE>
+class CompactOrdHashT {
+
+  protected:
+    friend class CompactOrdHashTIterator<K,V,CHUNKSIZE>;
+    friend class CompactOrdHashTSortedIterator<K,V,CHUNKSIZE>;
+    enum Found_e { FOUND, NOT_FOUND };
+    typedef CompactOrdNode_<K,V> N;
+
+  public:
+
+    // ///// Methods
+
+    // Constructor: an empty table has no memory at all.  With no
+    // allocator, uses the current one (see AllocatorScope).
+    CompactOrdHashT (Allocator* a=0) :
+      allocator_(a ? a : CurrentAllocator()),
+      table_(0),
+      entries_(0),
+      capacity_(0)
+    { }
+
+    // Copy Constructor
+    CompactOrdHashT (const CompactOrdHashT<K,V,CHUNKSIZE>& rhs, Allocator* a=0) :
+      allocator_(a ? a : CurrentAllocator()),
+      table_(0),
+      entries_(0),
+      capacity_(0)
+    {
+      copyTable_(rhs);
+    }
+
+    // Assignment
+    CompactOrdHashT<K,V,CHUNKSIZE>& operator= (const CompactOrdHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      // allocator stays the same!!
+      if (&rhs != this) {
+	clear();
+	copyTable_(rhs);
+      }
+      return *this;
+    }
+
+    // Destructor
+    ~CompactOrdHashT () { clear(); }
+
+    // Clear the table, giving all memory back
+    void clear ()
+    {
+      if (table_==0) return;
+      CompactOrdHeader_* h = header_();
+      for (int_u4 ii=0; ii<h->used; ii++) {
+	N* node = entry_(ii);
+	if (node->live) node->N::~CompactOrdNode_<K,V>();
+      }
+      N** segs = segments_();
+      for (int_u4 ii=0; ii<h->segments; ii++) {
+	deallocate_((char*)segs[ii]);
+      }
+      deallocate_(table_);
+      table_ = 0;
+      entries_ = 0;
+      capacity_ = 0;
+    }
+
+    // Returns true is the table contains a key which is equal to key.
+    // Returns false otherwise.
+    bool contains (const K& key) const
+    { return findSlot_(key, HashFunction(key))>=0; }
+
+    // The current number of key-value pairs in the table
+    int_u4 entries () const { return entries_; }
+
+    // Like the OrdAVLHashT (see the Python PEP-372 discussion there),
+    // two tables are only equal if they have the same keys and values
+    // in the same order.
+    bool operator== (const CompactOrdHashT<K,V,CHUNKSIZE>& rhs) const
+    {
+      if (entries() != rhs.entries()) return false;
+      CompactOrdHashTIterator<K,V,CHUNKSIZE> it1(*this);
+      CompactOrdHashTIterator<K,V,CHUNKSIZE> it2(rhs);
+      while (it1() && it2()) {
+	if (it1.key()!=it2.key()) return false;
+	if (it1.value()!=it2.value()) return false;
+      }
+      return true;
+    }
+    bool operator!= (const CompactOrdHashT<K,V,CHUNKSIZE>&t1) const
+    { return !(*this==t1); }
+
+    // Returns true is the table contains a key which is equal to
+    // "target" and puts the matching key into return_key.  Returns
+    // false otherwise and leaves retKey untouched.
+    bool find (const K& target, K& return_key) const
+    {
+      Found_e found_where; N* node = lookup_(target, found_where);
+      if (found_where==FOUND) {
+	return_key = node->key;
+	return true;
+      }
+      return false;
+    }
+
+    // Returns true if the table contains a key which is equal to
+    // "key" and puts the associated value into return_val.  Returns
+    // false otherwise and leaves return_val untouched.
+    bool findValue (const K& key, V& return_val) const
+    {
+      Found_e found_where; N* node = lookup_(key, found_where);
+      if (found_where==FOUND) {
+	return_val = node->value;
+	return true;
+      }
+      return false;
+    }
+
+    // Returns true if the dictionary contains a key which is equal to
+    // key and puts the matching key into into return_key and the
+    // associated value into return_val.  Returns false otherwise and
+    // leaves return_key and return_val untouched.
+    bool findKeyAndValue (const K& key, K& return_key, V& return_val) const
+    {
+      Found_e found_where; N* node = lookup_(key, found_where);
+      if (found_where==FOUND) {
+	return_val = node->value;
+	return_key = node->key;
+	return true;
+      }
+      return false;
+    }
+
+    // Inserts the key and value into the table.  If the key is
+    // already in there, replace it.  New entries are added to the
+    // end, overwriting a previous value keeps its current position.
+    void insertKeyAndValue (const K& key, const V& value)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	node->value = value; // Assumes the op= for V works
+      } else {
+	(void)notInTableInsert_(node, key, hashkey, value, found_where);
+      }
+    }
+
+#if defined(OC_MOVE_SEMANTICS)
+    // Like insertKeyAndValue, but the key and value are moved into
+    // the table rather than copied (if the key is already there, only
+    // the value is moved).  Returns a reference to the value in the
+    // table.
+    V& emplace (K&& key, V&& value)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where!=FOUND) {
+	node = notInTableInsert_(node, K(), hashkey, V(), found_where);
+	node->key = std::move(key);
+	CacheHash_(node->key, hashkey);
+      }
+      node->value = std::move(value);
+      return node->value;
+    }
+#endif
+
+    // Returns true if the table has no items in it, false otherwise.
+    bool isEmpty () const { return entries_==0; }
+
+    // Returns true and removes the (key/value) pair where the key is
+    // equal to the key.  Returns false if there is no such key.
+    bool remove (const K& key)
+    {
+      int slot = findSlot_(key, HashFunction(key));
+      if (slot<0) return false;
+      deleteSlot_(slot);
+      return true;
+    }
+
+    // Lookup the key "key" and return its associated value as an
+    // l-value reference.  If the key is not in the dictionary, then
+    // it is added to the end of the dictionary, with the value
+    // provided by the default constructor for objects of types V.
+    V& operator[] (const K& key)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	return node->value;
+      } else {
+	return notInTableInsert_(node, key, hashkey, V(), found_where)->value;
+      }
+    }
+
+    // Lookup the key "key" and return its associated value as an
+    // l-value reference.  If the key is not in the dictionary, then
+    // an out_of_range is thrown
+    V& operator() (const K& key) const
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	return node->value;
+      } else {
+	throw out_of_range("Key "+Stringize(key)+" not in table");
+      }
+    }
+
+    // Heterogeneous lookup: find the entry whose key compares equal
+    // (via key==probe) to "probe", which can be any type that is
+    // cheaper to build than a K (like a StrView for a Val key).  The
+    // hashkey given MUST be the HashFunction of the equivalent K.
+    // Returns a pointer to the value, or 0 if the key is not there.
+    template <class PROBE>
+    V* lookup (const PROBE& probe, int_u4 hashkey) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      return (found_where==FOUND) ? &node->value : 0;
+    }
+
+    // Like contains and find above, but with a probe (see lookup)
+    template <class PROBE>
+    bool contains (const PROBE& probe, int_u4 hashkey) const
+    { return lookup(probe, hashkey)!=0; }
+
+    template <class PROBE>
+    bool find (const PROBE& probe, int_u4 hashkey, K& return_key) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      if (found_where==FOUND) {
+	return_key = node->key;
+	return true;
+      } else {
+	return false;
+      }
+    }
+
+    // See if data structure internally consistent.  Very expensive.
+    bool consistent () const
+    {
+      if (table_==0) return entries_==0 && capacity_==0;
+      if (capacity_<8 || (capacity_ & (capacity_-1))!=0) return false;
+      const CompactOrdHeader_* h = header_();
+      if (h->used > maxLoad_(capacity_) || h->filled > maxLoad_(capacity_))
+	return false;
+      int_u4 live = 0, filled = 0;
+      for (int_u4 ii=0; ii<h->used; ii++) {
+	N* node = entry_(ii);
+	if (!node->live) continue;
+	live++;
+	int slot = findSlot_(node->key, node->hashkey);
+	if (slot<0 || indexAt_(slot)!=int_4(ii)) return false;
+      }
+      for (int_u4 ii=0; ii<capacity_; ii++) {
+	const int_4 ix = indexAt_(ii);
+	if (ix==COMPACT_EMPTY) continue;
+	filled++;
+	if (ix!=COMPACT_DUMMY && (ix<0 || int_u4(ix)>=h->used)) return false;
+      }
+      return live==entries_ && filled==h->filled;
+    }
+
+    void swap (CompactOrdHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      OC_NAMESPACED::swap(allocator_, rhs.allocator_);
+      OC_NAMESPACED::swap(table_,     rhs.table_);
+      OC_NAMESPACED::swap(entries_,   rhs.entries_);
+      OC_NAMESPACED::swap(capacity_,  rhs.capacity_);
+    }
+
+    // Avoid an extra copy when inserting into a table by giving key
+    // and value which are "disposable" (see AVLHashT::swapInto).
+    // Returns true if the key was already there (so we just swapped
+    // out the value) false if the key wasn't there already (so both
+    // key and value are swapped)
+    bool swapInto (K& key_to_swap, V& value_to_swap)
+    {
+      int_u4 hashkey = HashFunction(key_to_swap);
+      Found_e found_where; N* node = lookup_(key_to_swap, hashkey, found_where);
+      if (found_where == FOUND) {
+	OC_NAMESPACED::swap(value_to_swap, node->value);
+	return true;
+      } else {
+	N* current = notInTableInsert_(node, K(), hashkey, V(), found_where);
+	OC_NAMESPACED::swap(key_to_swap, current->key);
+	CacheHash_(current->key, hashkey);
+	OC_NAMESPACED::swap(value_to_swap, current->value);
+	return false;
+      }
+    }
+
+    // Make sure there is room for at least "expected" entries without
+    // having to grow the index.
+    void reserve (int_u4 expected)
+    {
+      int_u4 cap = capacityFor_(expected);
+      if (cap > capacity_) rehash_(cap);
+    }
+
+  protected:
+
+    // ///// Data Members
+
+    // The allocator used.  This is not quite like STL allocators:
+    // we need to be able to choose between different allocators at
+    // run-time because some tables may exist in global shared memory,
+    // some use new, etc.
+    Allocator* allocator_;
+
+    // One piece of memory: a CompactOrdHeader_, then the pointers to
+    // the entry segments, then capacity_ index slots (of 1, 2 or 4
+    // bytes each).  0 when the table has never had anything in it.
+    char* table_;
+
+    // The number of actual entries in the table
+    int_u4 entries_;
+
+    // Number of index slots: always 0 or a power of two (at least 8)
+    int_u4 capacity_;
+
+    // ///// Methods
+
+    CompactOrdHeader_* header_ () const { return (CompactOrdHeader_*)table_; }
+    N** segments_ () const { return (N**)(table_+sizeof(CompactOrdHeader_)); }
+    char* index_ () const
+    { return table_+sizeof(CompactOrdHeader_)+maxSegments_(capacity_)*sizeof(N*); }
+
+    // Index never gets more than 2/3 full
+    static int_u4 maxLoad_ (int_u4 cap) { return (cap/3)*2; }
+
+    // Smallest legal capacity that can hold n entries
+    static int_u4 capacityFor_ (int_u4 n)
+    {
+      int_u4 cap = 8;
+      while (maxLoad_(cap) < n) cap <<= 1;
+      return cap;
+    }
+
+    // Bytes per index slot: entry numbers are always < capacity
+    static int width_ (int_u4 cap)
+    { return cap<=128 ? 1 : (cap<=32768 ? 2 : 4); }
+
+    // Segment s holds CHUNKSIZE<<s entries: which segment (and where
+    // in it) is entry ii?
+    static int_u4 segmentOf_ (int_u4 ii, int_u4& offset)
+    {
+      const int_u4 q = ii/CHUNKSIZE + 1;
+      int_u4 s = 0;
+#if defined(__GNUC__)
+      s = 31 - __builtin_clz(q);
+#else
+      for (int_u4 t=q; t>1; t>>=1) s++;
+#endif
+      offset = ii - CHUNKSIZE*((int_u4(1)<<s)-1);
+      return s;
+    }
+
+    // How many segments it takes to hold all the entries this
+    // capacity allows
+    static int_u4 maxSegments_ (int_u4 cap)
+    {
+      if (cap==0) return 0;
+      int_u4 offset;
+      return segmentOf_(maxLoad_(cap)-1, offset) + 1;
+    }
+
+    N* entry_ (int_u4 ii) const
+    {
+      int_u4 offset;
+      const int_u4 s = segmentOf_(ii, offset);
+      return segments_()[s] + offset;
+    }
+
+    int_4 indexAt_ (int_u4 slot) const
+    {
+      const char* ix = index_();
+      switch (width_(capacity_)) {
+      case 1:  return ((const int_1*)ix)[slot];
+      case 2:  return ((const int_2*)ix)[slot];
+      default: return ((const int_4*)ix)[slot];
+      }
+    }
+
+    void setIndex_ (int_u4 slot, int_4 value)
+    {
+      char* ix = index_();
+      switch (width_(capacity_)) {
+      case 1:  ((int_1*)ix)[slot] = int_1(value); break;
+      case 2:  ((int_2*)ix)[slot] = int_2(value); break;
+      default: ((int_4*)ix)[slot] = value; break;
+      }
+    }
+
+    char* allocate_ (size_t bytes) const
+    {
+      if (allocator_) return allocator_->allocate(bytes);
+      return new char[bytes];
+    }
+    void deallocate_ (char* memory) const
+    {
+      if (allocator_) allocator_->deallocate(memory);
+      else delete [] memory;
+    }
+
+    // Find the index slot for the key, or -1 if it's not there
+    template <class PROBE>
+    int findSlot_ (const PROBE& key, int_u4 hashkey) const
+    {
+      if (entries_==0) return -1;
+      const int_u4 mask = capacity_-1;
+      int_u4 slot = FlatMixHash_(hashkey) & mask;
+      for (int_u4 step=1; ; step++) {
+	const int_4 ix = indexAt_(slot);
+	if (ix==COMPACT_EMPTY) return -1;
+	if (ix>=0) {
+	  N* node = entry_(ix);
+	  if (node->hashkey==hashkey && node->key==key) return int(slot);
+	}
+	slot = (slot + step) & mask;
+      }
+    }
+
+    // Find the first EMPTY or DUMMY index slot for the hash: there is
+    // always room in the index.
+    int_u4 findInsertSlot_ (int_u4 hashkey) const
+    {
+      const int_u4 mask = capacity_-1;
+      int_u4 slot = FlatMixHash_(hashkey) & mask;
+      for (int_u4 step=1; indexAt_(slot)>=0; step++) {
+	slot = (slot + step) & mask;
+      }
+      return slot;
+    }
+
+    // Helper function used by a lot of methods above: Do a lookup and
+    // see if the item is already there: if it is, return pointer to
+    // it and indicate FOUND.  If not there, return 0 and indicate
+    // NOT_FOUND (so the signature matches the OrdAVLHashT, where OTab
+    // uses it).
+    N* lookup_ (const K& key, Found_e& found_where) const
+    { return lookup_(key, HashFunction(key), found_where); }
+
+    // The key here can be a K or any probe that compares to a K with
+    // == (see lookup): the hashkey is always the hash of the K.
+    template <class PROBE>
+    N* lookup_ (const PROBE& key, int_u4 hashkey, Found_e& found_where) const
+    {
+      int slot = findSlot_(key, hashkey);
+      if (slot<0) {
+	found_where = NOT_FOUND;
+	return 0;
+      }
+      found_where = FOUND;
+      return entry_(indexAt_(slot));
+    }
+
+    // Insert an item we know is not in the table at the end.  The
+    // first and last arguments are ignored: they are there so this
+    // looks just like the OrdAVLHashT routine.
+    N* notInTableInsert_ (N*, const K& key, int_u4 keyhash,
+			  const V& value, Found_e)
+    {
+      if (table_==0 || header_()->used>=maxLoad_(capacity_) ||
+	  header_()->filled>=maxLoad_(capacity_)) {
+	rehash_(capacityFor_((table_ ? header_()->used : 0) + 1));
+      }
+      CompactOrdHeader_* h = header_();
+      const int_u4 ii = h->used;
+      int_u4 offset;
+      const int_u4 s = segmentOf_(ii, offset);
+      if (s==h->segments) {
+	segments_()[s] = (N*)allocate_((CHUNKSIZE<<s)*sizeof(N));
+	h->segments++;
+      }
+
+      // Construct the entry BEFORE we put it in the index, so if the
+      // key/value copy throws, the table is still consistent
+      N* node = CompactOrdCreateNode(segments_()[s]+offset, key, keyhash,
+				     value, allocator_);
+      CacheHash_(node->key, keyhash);
+      const int_u4 slot = findInsertSlot_(keyhash);
+      if (indexAt_(slot)==COMPACT_EMPTY) h->filled++;
+      setIndex_(slot, int_4(ii));
+      h->used++;
+      entries_++;
+      return node;
+    }
+
+    // Remove the entry in the given index slot from the table
+    void deleteSlot_ (int slot)
+    {
+      N* node = entry_(indexAt_(slot));
+      setIndex_(slot, COMPACT_DUMMY);
+      node->key.~K();
+      node->value.~V();
+      node->live = false;
+      entries_--;
+
+      // Too many holes: squeeze them out
+      const int_u4 used = header_()->used;
+      if (entries_==0 || (used>=2*CHUNKSIZE && entries_<used/2)) {
+	compact_();
+      }
+    }
+
+    // Move all the live entries to the front (in the same order), and
+    // rebuild the index
+    void compact_ ()
+    {
+      CompactOrdHeader_* h = header_();
+      int_u4 to = 0;
+      for (int_u4 from=0; from<h->used; from++) {
+	N* src = entry_(from);
+	if (!src->live) continue;
+	if (from!=to) {
+	  N* dest = CompactOrdCreateNode(entry_(to), K(), src->hashkey, V(),
+					 allocator_);
+	  OC_NAMESPACED::swap(dest->key, src->key);
+	  OC_NAMESPACED::swap(dest->value, src->value);
+	  src->key.~K();
+	  src->value.~V();
+	  src->live = false;
+	}
+	to++;
+      }
+      h->used = to;
+      rehash_(capacity_);
+    }
+
+    // Build a new index with the given capacity (never smaller than
+    // the current one).  The entries stay where they are.
+    void rehash_ (int_u4 new_capacity)
+    {
+      if (new_capacity<capacity_) new_capacity = capacity_;
+      const size_t bytes = sizeof(CompactOrdHeader_) +
+	maxSegments_(new_capacity)*sizeof(N*) +
+	new_capacity*width_(new_capacity);
+      char* old_table = table_;
+      CompactOrdHeader_ old_header = { 0, 0, 0, 0 };
+      if (old_table) old_header = *header_();
+      N** old_segments = old_table ? segments_() : 0;
+
+      char* new_table = allocate_(bytes);
+      CompactOrdHeader_* h = (CompactOrdHeader_*)new_table;
+      *h = old_header;
+      N** segs = (N**)(new_table+sizeof(CompactOrdHeader_));
+      for (int_u4 ii=0; ii<old_header.segments; ii++) {
+	segs[ii] = old_segments[ii];
+      }
+      table_ = new_table;
+      capacity_ = new_capacity;
+      memset(index_(), 0xFF, new_capacity*width_(new_capacity)); // EMPTY
+      h->filled = 0;
+      for (int_u4 ii=0; ii<h->used; ii++) {
+	N* node = entry_(ii);
+	if (node->live) {
+	  setIndex_(findInsertSlot_(node->hashkey), int_4(ii));
+	  h->filled++;
+	}
+      }
+      if (old_table) deallocate_(old_table);
+    }
+
+    // Copy: the keys in rhs are all unique, so no need to look them up
+    void copyTable_ (const CompactOrdHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      if (rhs.entries_==0) return;
+      reserve(rhs.entries_);
+      for (CompactOrdHashTIterator<K,V,CHUNKSIZE> it(rhs); it(); ) {
+	N* node = it.current_;
+	(void)notInTableInsert_(0, node->key, node->hashkey, node->value,
+				NOT_FOUND);
+      }
+    }
+
+}; // CompactOrdHashT
+
+template <class K, class V, int_u4 CHUNKSIZE>
+inline void swap (CompactOrdHashT<K,V,CHUNKSIZE>& lhs,
+		  CompactOrdHashT<K,V,CHUNKSIZE>& rhs)
+{ lhs.swap(rhs); }
+
+
+// ////////////////////////////////////// The CompactOrdHashTIterator Class
+
+// This iterates in insertion order
+template <class K, class V, int_u4 CHUNKSIZE>
+class CompactOrdHashTIterator {
+
+    friend class CompactOrdHashT<K,V,CHUNKSIZE>;
+    friend class CompactOrdHashTSortedIterator<K,V,CHUNKSIZE>;
+
+  public:
+
+    // ///// Methods
+
+    // Constructor
+    CompactOrdHashTIterator (const CompactOrdHashT<K,V,CHUNKSIZE>& tree) :
+      tree_(&tree) { reset(); }
+
+    // Advance the iterator one position.  Returns true if the
+    // new position is valid, false otherwise.
+    bool next ()
+    {
+      const int_u4 used = (tree_ && tree_->table_) ? tree_->header_()->used : 0;
+      while (entry_ < used) {
+	CompactOrdNode_<K,V>* node = tree_->entry_(entry_++);
+	if (node->live) {
+	  current_ = node;
+	  return true;
+	}
+      }
+      current_ = 0;
+      return false;
+    }
+
+    // Syntactic sugar for next
+    bool operator++ () { return next();}
+
+    // Advance the iterator one position.  Returns true if the
+    // new position is valid, false otherwise.
+    bool operator() () { return next(); }
+
+    // Returns the key at the iterator's current position.  The
+    // results are undefined if the iterator is no longer valid.
+    const K& key () const { return current_->key; }
+
+    // Resets the iterator to the state it had immediately after
+    // construction.
+    void reset () { current_ = 0; entry_ = 0; }
+
+    // Resets the iterator to iterate over collection c
+    void reset (const CompactOrdHashT<K,V,CHUNKSIZE>& c) { tree_=&c; reset(); }
+
+    // Returns the value at the iterator's current position.  The
+    // results are undefined if the iterator is no longer valid.
+    V& value () const { return current_->value; }
+
+    // Backpointer to container
+    CompactOrdHashT<K, V, CHUNKSIZE>* container () const
+    { typedef CompactOrdHashT<K, V, CHUNKSIZE> NCHT; return (NCHT*)tree_; }
+
+  protected:
+
+    // ///// Data Members
+
+    // The current entry
+    CompactOrdNode_<K,V>* current_;
+
+    // The next entry to look at
+    int_u4 entry_;
+
+    // The table we are looking at.  Not adopted, just reffed.
+    const CompactOrdHashT<K, V, CHUNKSIZE>* tree_;
+
+    // Protected so only friends can see: just so don't have to
+    // construct everything.
+    CompactOrdHashTIterator () : current_(0), entry_(0), tree_(0) { }
+}; // CompactOrdHashTIterator
+
+
+// Helper class for Sorted Iteration
+template <class K, class V> struct CompactOrdNR {
+  CompactOrdNR (CompactOrdNode_<K, V>* data=0) : node(data) { }
+  void swap (CompactOrdNR<K,V>& rhs) { OC_NAMESPACED::swap(node, rhs.node); }
+  bool operator== (CompactOrdNR<K,V>a2) const { return node->key==a2.node->key; }
+  bool operator> (CompactOrdNR<K,V>a2) const  { return node->key > a2.node->key; }
+  bool operator< (CompactOrdNR<K,V>a2) const  { return node->key < a2.node->key; }
+  CompactOrdNode_<K,V>* node;
+};  // CompactOrdNR<K,V>
+
+template<class K, class V>
+void swap(CompactOrdNR<K,V>& lhs, CompactOrdNR<K,V>& rhs) { lhs.swap(rhs); }
+
+// An iterator, sorted via keys
+template <class K, class V, int_u4 CHUNKSIZE>
+class CompactOrdHashTSortedIterator {
+  public:
+
+    CompactOrdHashTSortedIterator (const CompactOrdHashT<K,V,CHUNKSIZE>& tree) :
+      keys_(tree.entries()),
+      current_(-1),
+      tree_(&tree)
+    { reset(); }
+
+    void reset ()
+    {
+      current_ = -1;
+      keys_.clear();
+      for (CompactOrdHashTIterator<K,V,CHUNKSIZE> it(*tree_); it(); ) {
+	keys_.append(CompactOrdNR<K,V>(it.current_));
+      }
+      CompactOrdNR<K,V>* keys_ptr = keys_.data();
+      OCQuickSort(keys_ptr, 0, keys_.length());
+    }
+    void reset (const CompactOrdHashT<K,V,CHUNKSIZE>& tree)
+    { tree_ = &tree; reset(); }
+
+    bool next () { return ++current_ < int(keys_.length()); }
+    bool operator() () { return next(); }
+
+    const K& key ()   const { return keys_[current_].node->key; }
+          V& value () const { return keys_[current_].node->value; }
+
+    CompactOrdHashT<K,V,CHUNKSIZE>& container () const
+    { typedef CompactOrdHashT<K, V, CHUNKSIZE> NCHT; return *(NCHT*)tree_; }
+
+  protected:
+
+    // Keys kept by pointer in an array ... obviously this is
+    // messed up by inserts or deletes into the table.
+    Array<CompactOrdNR< K, V > > keys_;
+    int current_;
+
+    // The table we are looking at.  Not adopted, just reffed.
+    const CompactOrdHashT<K, V, CHUNKSIZE>* tree_;
+
+    // Protected so only friends can access. Just want to avoid lots
+    // on default construction
+    CompactOrdHashTSortedIterator () : keys_(), current_(0), tree_(0) { }
+
+}; // CompactOrdHashTSortedIterator
+
+
+// /////////////////// Global Functions
+
+// Handle comparison other than equality correctly: just like
+// OrdAVLHashT, in insertion order
+template <class K, class V, int_u4 LEN>
+inline bool operator< (const CompactOrdHashT<K,V,LEN>& o1,
+		       const CompactOrdHashT<K,V,LEN>& o2)
+{
+  if (o1.entries()<o2.entries()) return true;
+  if (o1.entries()>o2.entries()) return false;
+  CompactOrdHashTIterator<K,V,LEN> ii(o1);
+  CompactOrdHashTIterator<K,V,LEN> jj(o2);
+  while (ii() && jj()) {
+    const K& k1 = ii.key(); const V& v1 = ii.value();
+    const K& k2 = jj.key(); const V& v2 = jj.value();
+    if (k1<k2) {
+      return true;
+    } else if (k1==k2) {
+      if (v1<v2) {
+	return true;
+      } else if (v1==v2) {
+	continue;
+      } else {
+	return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return false;
+}
+
+template <class K, class V, int_u4 LEN>
+bool operator<= (const CompactOrdHashT<K,V,LEN>& o1, const CompactOrdHashT<K,V,LEN>&o2)
+{ return o1<o2 || o1==o2; }
+
+template <class K, class V, int_u4 LEN>
+bool operator> (const CompactOrdHashT<K,V,LEN>& o1, const CompactOrdHashT<K,V,LEN>&o2)
+{ return o2<o1; }
+
+template <class K, class V, int_u4 LEN>
+bool operator>= (const CompactOrdHashT<K,V,LEN>& o1, const CompactOrdHashT<K,V,LEN>&o2)
+{ return o1>o2 || o1==o2; }
+
+
+OC_END_NAMESPACE
+
+#define OC_COMPACTORDHASHT_H_
+#endif // OC_COMPACTORDHASHT_H_
@@ -111,10 +111,10 @@ typedef cx_t<real_4> complex_8;
 typedef cx_t<real_8> complex_16;
 
 inline ostream& operator<< (ostream& os, complex_8 a)
-{ os.precision(OC_FLT_DIGITS); return os<<"("<<a.re<<((a.im<0)?"":"+")<<a.im<<"j)"; }
+{ return PrintComplex_(os, a.re, a.im); }
 
 inline ostream& operator<< (ostream& os, complex_16 a)
-{ os.precision(OC_DBL_DIGITS); return os<<"("<<a.re<<((a.im<0)?"":"+")<<a.im<<"j)"; }
+{ return PrintComplex_(os, a.re, a.im); }
 
 // TODO:  Ya, this probably needs to be made more robust
 template <class T>
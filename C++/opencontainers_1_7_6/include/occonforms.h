@@ -505,10 +505,12 @@ inline bool ArrayMatch_ (const Val& v1, const Val& v2,
     // types match
     else {
       if (v1.subtype==v2.subtype) return true;
-      Val special1=complex_16(0);
-      Val special2=complex_16(0);  // Make sure fill in vals with valid 0s
-      special1.tag = v1.subtype;
-      special2.tag = v2.subtype;  // Bad code: I depend on the impl of Val
+      // Make sure fill in vals with valid 0s: complex_16 may live out
+      // of the Val (OC_COMPACT_VAL), but everything else fits in a complex_8
+      Val special1 = (v1.subtype=='D') ? Val(complex_16(0)) : Val(complex_8(0));
+      Val special2 = (v2.subtype=='D') ? Val(complex_16(0)) : Val(complex_8(0));
+      if (v1.subtype!='D') special1.tag = v1.subtype;
+      if (v2.subtype!='D') special2.tag = v2.subtype;  // Bad code: I depend on the impl of Val
       return PrimitiveMatch_(special1, special2, exact_structure, type_match,
 			     throw_exception_with_message);
     }
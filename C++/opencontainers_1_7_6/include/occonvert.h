@@ -180,7 +180,7 @@ inline void ConvertOTabAndTupHelper_ (Val& v,
   void* handle = p.handle_;
 
   if (!cc.already_processed.contains(handle)) { 
-    FROM& o = p;
+    FROM& o = *(FROM*)p.data_();  // only read: no copy-on-write detach
     Proxy new_proxy = ProxyCopy(p, (TO*)0);
     cc.already_processed[handle] = new_proxy;
     TO& t = new_proxy;
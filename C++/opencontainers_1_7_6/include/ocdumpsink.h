@@ -0,0 +1,137 @@
+#ifndef OC_DUMPSINK_H_
+
+// A DumpSink is where a streaming dump goes: rather than building the
+// whole serialization in memory first (and then writing it), the
+// streaming dumps (SerializeToSink for OC, P2TopLevelDumpValToSink for
+// Python Pickling Protocol 2, the DumpSink forms of OpalDumpVal for
+// M2k) fill a fixed-size chunk and hand it to the sink every time it
+// fills up.  Big strings and arrays of POD go straight to the sink
+// without being copied into the chunk at all.  A dump of a 2G Val
+// then only needs one chunk of extra memory, and the writing overlaps
+// the encoding.
+//
+//   FILE* fp = fopen("state.oc", "wb");
+//   FILEDumpSink sink(fp);
+//   SerializeToSink(v, sink);
+//   fclose(fp);
+//
+// To stream somewhere else (a socket with framing, a compressor, ...),
+// inherit from DumpSink and implement write.
+
+// ///////////////////////////////////////////// Include Files
+
+#include "ocarray.h"
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+OC_BEGIN_NAMESPACE
+
+// How big a chunk a streaming dump fills before it goes to the sink
+#ifndef OC_DUMP_CHUNK
+# define OC_DUMP_CHUNK 65536
+#endif
+
+// ///////////////////////////////////////////// The DumpSink Class
+
+class DumpSink {
+ public:
+  virtual ~DumpSink () { }
+
+  // Write all of the given bytes (or throw an exception)
+  virtual void write (const char* data, size_t len) = 0;
+
+}; // DumpSink
+
+
+// Stream straight to a file descriptor (a file, a pipe, a socket):
+// throws a runtime_error if a write fails.  The fd is NOT closed.
+class FDDumpSink : public DumpSink {
+ public:
+  FDDumpSink (int fd) : fd_(fd) { }
+
+  virtual void write (const char* data, size_t len)
+  {
+    while (len) {
+      ssize_t r = ::write(fd_, data, len);
+      if (r<0) {
+	if (errno==EINTR) continue;
+	throw runtime_error("FDDumpSink: write:"+string(strerror(errno)));
+      }
+      data += r;
+      len -= r;
+    }
+  }
+
+ protected:
+  int fd_;
+}; // FDDumpSink
+
+
+// Stream to a FILE*: throws a runtime_error if a write fails.  The
+// FILE* is NOT closed.
+class FILEDumpSink : public DumpSink {
+ public:
+  FILEDumpSink (FILE* fp) : fp_(fp) { }
+
+  virtual void write (const char* data, size_t len)
+  {
+    if (fwrite(data, 1, len, fp_)!=len) {
+      throw runtime_error("FILEDumpSink: fwrite failed");
+    }
+  }
+
+ protected:
+  FILE* fp_;
+}; // FILEDumpSink
+
+
+// Implementation Detail: for single pass dumping.  Make sure there are
+// at least the given bytes between mem and end.  When streaming to a
+// sink, everything dumped so far goes to the sink and mem goes back to
+// the start of the chunk.  If that isn't enough (or there's no sink),
+// the buffer grows, keeping everything before mem.
+inline void OCGrowDumpBuffer_ (Array<char>& buffer, char*& mem, char*& end,
+			       size_t bytes, DumpSink* sink=0)
+{
+  if (sink) {
+    sink->write(buffer.data(), mem-buffer.data());
+    mem = buffer.data();
+    if (size_t(end-mem)>=bytes) return;
+  }
+  const size_t used = mem - buffer.data();
+  size_t cap = 2*buffer.length();
+  if (cap<used+bytes) cap = used+bytes;
+  if (cap<1024) cap = 1024;
+  buffer.expandTo(used);  // so only what's been dumped is copied
+  buffer.resize(cap);
+  buffer.expandTo(cap);
+  mem = buffer.data()+used;
+  end = buffer.data()+cap;
+}
+
+// Implementation Detail: copy a block of data (a string, an array of
+// POD) into a single pass dump.  When streaming, a block that doesn't
+// fit in the rest of the chunk goes straight to the sink (after what's
+// already been dumped).
+inline void OCDumpBlock_ (Array<char>& buffer, char*& mem, char*& end,
+			  const char* data, size_t len, DumpSink* sink=0)
+{
+  if (size_t(end-mem)<len) {
+    if (sink) {
+      sink->write(buffer.data(), mem-buffer.data());
+      mem = buffer.data();
+      sink->write(data, len);
+      return;
+    }
+    OCGrowDumpBuffer_(buffer, mem, end, len);
+  }
+  memcpy(mem, data, len);
+  mem += len;
+}
+
+OC_END_NAMESPACE
+
+#define OC_DUMPSINK_H_
+#endif // OC_DUMPSINK_H_
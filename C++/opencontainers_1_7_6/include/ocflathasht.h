@@ -0,0 +1,1017 @@
+#ifndef OC_FLATHASHT_H_
+
+// The FlatHashT is a class for managing Key/Value pairs, much like
+// the AVLHashT (in fact, you should go look there first).  It has
+// exactly the same interface and is a plug-in replacement for it.
+
+// Like AVLHashT, you DO NOT need operator< supported by your keys,
+// but you DO need a HashFunction (const K& key) that returns an int_u4.
+
+// Why another hash table?  The AVLHashT is a great general purpose
+// table, but every lookup walks a tree of nodes, and every node is a
+// potential cache miss.  For small-to-medium tables that are looked
+// up over and over (think t["field"] on every message), the cache
+// misses dominate.  The FlatHashT is an open-addressing table (in the
+// style of Google's SwissTable): a flat array of one-byte "control"
+// values sits in front of a flat array of slots.  A lookup hashes to
+// a group of 16 control bytes and compares all 16 at once (with SSE2
+// if the platform has it, a simple loop if not), so that the only
+// memory touched is one or two cache lines of control bytes and the
+// one node that matches.  Small tables (one group: up to 14 entries)
+// don't even do that: see below.
+
+// [Implementation: Each control byte is either EMPTY, DELETED or
+// holds the bottom 7 bits of the (mixed) hash of the key in that
+// slot.  The rest of the hash picks the first group to look in, and
+// we probe groups triangularly until we see a group with an EMPTY
+// byte.  The slots hold POINTERS to nodes, and the nodes are
+// allocated in chunks (like the AVLHashT) and never move: so growing
+// the table only moves pointers around and references to keys and
+// values stay valid across inserts, just like the AVLHashT.  This
+// matters for Val, where code like "Val& v = t["a"]; t["b"] = v;" is
+// everywhere.]
+
+// [Small tables: when the whole table is one group, a lookup just
+// walks the full slots and compares the whole hash stored in each
+// node.  Only the compares wait on the hash of the key, so the CPU
+// can load the nodes while it is still hashing (just like it walks
+// down a small AVL tree): a probe by the control bytes can't start
+// until the hash is done.  See timing/containers_timing.results.]
+
+// [Memory: a removed node is destructed right away and goes on the
+// freelist of its chunk, to be reused by a later insert.  When every
+// node in a chunk is free, the chunk goes back to the allocator
+// (like the AVLHashT), unless it is the last chunk the table has.]
+
+// ///////////////////////////////////////////// Includes
+
+#include "ocport.h"
+#include "ocarray.h"         // for the sorted iterator
+
+#include "ocstreamingpool.h" // class Allocator;  // Forward
+#include "ocsort.h"          // for OCQuickSort
+
+#if defined(__SSE2__) && !defined(OC_FLATHASH_NO_SIMD)
+#  include <emmintrin.h>
+#  define OC_FLATHASH_SSE2
+#endif
+
+// The probe of a big table is kept out of line, so the lookup of a
+// small table (which is inlined everywhere) stays small
+#if defined(__GNUC__)
+#  define OC_FLATHASH_NOINLINE __attribute__((noinline))
+#else
+#  define OC_FLATHASH_NOINLINE
+#endif
+
+OC_BEGIN_NAMESPACE
+
+// ///////////////////////////////////////////// The FlatNode_ struct
+
+// Implementation Detail: the key-value pair (and its full hash, so we
+// never have to rehash a key when the table grows)
+template <class K, class V>
+struct FlatNode_ {
+    FlatNode_ (const K& k, int_u4 keyhash, const V& v) :
+      hashkey(keyhash), key(k), value(v)
+    { }
+
+    // The hash key: computed hash value, stored in the node
+    int_u4 hashkey;
+
+    // Where this node is in its chunk, so we can find the chunk when
+    // the node is freed.  Set by the table, not the constructor.
+    int_u4 chunkpos;
+
+    // The key and value for this node
+    K key;
+    V value;
+
+    // When the node is free, the hashkey bytes hold the position of
+    // the next free node in the chunk (the node is destructed, so
+    // this is safe): chunkpos is left alone.
+    int_u4 nextFree () const
+    { int_u4 n; memcpy(&n, (const void*)this, sizeof(n)); return n; }
+    void nextFree (int_u4 n) { memcpy((void*)this, &n, sizeof(n)); }
+
+};  // FlatNode_
+
+// Most FlatHashT's can get by with this
+template <class K, class V>
+inline FlatNode_<K,V>*
+FlatCreateNode (void* memory_to_construct_into,
+		const K& k, int_u4 keyhash, const V& v,
+		Allocator*)
+{
+  return new (memory_to_construct_into) FlatNode_<K,V>(k,keyhash,v);
+}
+
+// Nodes are allocated in chunks: this header sits in front of each
+// chunk so we know which nodes are free and can give the chunk back
+// when none of its nodes are in use.  It's 32 bytes so the nodes
+// after it stay aligned.
+struct FlatChunk_ {
+  FlatChunk_* next;      // All chunks of the table, singly-linked
+  FlatChunk_* next_room; // Chunks with free nodes, singly-linked
+  int_u4      nodes;     // How many nodes the chunk holds
+  int_u4      live;      // How many of them are in use
+  int_u4      freelist;  // First free node (nodes if none)
+  int_u4      fresh;     // Nodes from here on have never been used
+}; // FlatChunk_
+
+// The header in front of the control bytes and slots: these are the
+// parts of the table that only matter once the table has memory.
+struct FlatHeader_ {
+  FlatChunk_* chunks;      // All chunks of nodes, singly-linked
+  FlatChunk_* room;        // Chunks with free nodes (see next_room)
+  int_u4      growth_left; // How many more inserts before we must rehash
+  int_u4      deleted;     // How many DELETED control bytes
+  char        pad[32-2*sizeof(void*)-2*sizeof(int_u4)];
+}; // FlatHeader_
+
+// The hash given to us may be very poor (HashFunction for an int is
+// usually just the int), so mix the bits before we split it into the
+// group number and the 7 bits in the control byte.  One multiply is
+// plenty: the mix is on the critical path of every lookup.
+inline int_u4 FlatMixHash_ (int_u4 h)
+{
+  h *= 0x9e3779b1U;
+  return h ^ (h >> 16);
+}
+
+// Look at a group of 16 control bytes at once: return a bitmask (bit
+// i set means byte i matches).
+enum { FLAT_GROUP = 16 };
+enum { FLAT_EMPTY = -128, FLAT_DELETED = -2 };
+
+#if defined(OC_FLATHASH_SSE2)
+inline int_u4 FlatMatch_ (const int_1* group, int_1 h2)
+{
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+inline int_u4 FlatMatchEmpty_ (const int_1* group)
+{ return FlatMatch_(group, int_1(FLAT_EMPTY)); }
+
+// EMPTY and DELETED are the only control bytes with the top bit set
+inline int_u4 FlatMatchEmptyOrDeleted_ (const int_1* group)
+{
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return _mm_movemask_epi8(ctrl);
+}
+#else
+inline int_u4 FlatMatch_ (const int_1* group, int_1 h2)
+{
+  int_u4 mask = 0;
+  for (int ii=0; ii<FLAT_GROUP; ii++) mask |= int_u4(group[ii]==h2) << ii;
+  return mask;
+}
+inline int_u4 FlatMatchEmpty_ (const int_1* group)
+{ return FlatMatch_(group, int_1(FLAT_EMPTY)); }
+
+inline int_u4 FlatMatchEmptyOrDeleted_ (const int_1* group)
+{
+  int_u4 mask = 0;
+  for (int ii=0; ii<FLAT_GROUP; ii++) mask |= int_u4(group[ii]<0) << ii;
+  return mask;
+}
+#endif
+
+// The slots in use: everything but EMPTY and DELETED
+inline int_u4 FlatMatchFull_ (const int_1* group)
+{ return ~FlatMatchEmptyOrDeleted_(group) & ((1U<<FLAT_GROUP)-1); }
+
+// Index of the lowest bit set in a (non-zero) match mask
+inline int FlatLowestBit_ (int_u4 mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int ii = 0; while (!(mask & 1)) { mask >>= 1; ii++; } return ii;
+#endif
+}
+
+
+// ///////////////////////////////////////////// Forwards
+
+template <class K, class V, int_u4 CHUNKSIZE> class FlatHashTIterator;
+template <class K, class V, int_u4 CHUNKSIZE> class FlatHashTSortedIterator;
+
+
+// ///////////////////////////////////////////// The FlatHashT Class
+
+template <class K, class V, int_u4 CHUNKSIZE>
+class FlatHashT {
+
+  protected:
+    friend class FlatHashTIterator<K,V,CHUNKSIZE>;
+    friend class FlatHashTSortedIterator<K,V,CHUNKSIZE>;
+    enum Found_e { FOUND, NOT_FOUND };
+    typedef FlatNode_<K,V> N;
+
+  public:
+
+    // ///// Methods
+
+    // Constructor: an empty table has no memory at all.  With no
+    // allocator, uses the current one (see AllocatorScope).
+    FlatHashT (Allocator* a=0) :
+      allocator_(a ? a : CurrentAllocator()),
+      table_(0),
+      entries_(0),
+      capacity_(0)
+    { }
+
+    // Copy Constructor
+    FlatHashT (const FlatHashT<K,V,CHUNKSIZE>& rhs, Allocator* a=0) :
+      allocator_(a ? a : CurrentAllocator()),
+      table_(0),
+      entries_(0),
+      capacity_(0)
+    {
+      copyTable_(rhs);
+    }
+
+    // Assignment
+    FlatHashT<K,V,CHUNKSIZE>& operator= (const FlatHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      // allocator stays the same!!
+      if (&rhs != this) {
+	clear();
+	copyTable_(rhs);
+      }
+      return *this;
+    }
+
+    // Destructor
+    ~FlatHashT () { clear(); }
+
+    // Clear the table, giving all memory back
+    void clear ()
+    {
+      if (table_==0) return;
+      const int_1* ctrl = ctrl_();
+      N** slots = slots_();
+      for (int_u4 ii=0; ii<capacity_; ii++) {
+	if (ctrl[ii]>=0) slots[ii]->N::~FlatNode_<K,V>();
+      }
+      for (FlatChunk_* c = header_()->chunks; c; ) {
+	FlatChunk_* next = c->next;
+	deallocate_((char*)c);
+	c = next;
+      }
+      deallocate_(table_);
+      table_ = 0;
+      entries_ = 0;
+      capacity_ = 0;
+    }
+
+    // Returns true is the table contains a key which is equal to key.
+    // Returns false otherwise.
+    bool contains (const K& key) const
+    { return findSlot_(key, HashFunction(key))!=0; }
+
+    // The current number of key-value pairs in the table
+    int_u4 entries () const { return entries_; }
+
+    // See if two tables are equal: Two tables are equal if they have
+    // the same number of keys and values and all keys and values
+    // match.
+    bool operator== (const FlatHashT<K,V,CHUNKSIZE>& t1) const
+    {
+      if (entries() != t1.entries()) return false;
+      for (FlatHashTIterator<K,V,CHUNKSIZE> it(t1); it(); ) {
+	Found_e found_where; N* node = lookup_(it.key(), found_where);
+	if (found_where==FOUND && it.value()==node->value) continue;
+	return false; // single failure, not equal
+      }
+      return true;
+    }
+    bool operator!= (const FlatHashT<K,V,CHUNKSIZE>&t1) const
+    { return !(*this==t1); }
+
+    // Returns true is the table contains a key which is equal to
+    // "target" and puts the matching key into return_key.  Returns
+    // false otherwise and leaves retKey untouched.
+    bool find (const K& target, K& return_key) const
+    {
+      Found_e found_where; N* node = lookup_(target, found_where);
+      if (found_where==FOUND) {
+	return_key = node->key;
+	return true;
+      }
+      return false;
+    }
+
+    // Returns true if the table contains a key which is equal to
+    // "key" and puts the associated value into return_val.  Returns
+    // false otherwise and leaves return_val untouched.
+    bool findValue (const K& key, V& return_val) const
+    {
+      Found_e found_where; N* node = lookup_(key, found_where);
+      if (found_where==FOUND) {
+	return_val = node->value;
+	return true;
+      }
+      return false;
+    }
+
+    // Returns true if the dictionary contains a key which is equal to
+    // key and puts the matching key into into return_key and the
+    // associated value into return_val.  Returns false otherwise and
+    // leaves return_key and return_val untouched.
+    bool findKeyAndValue (const K& key, K& return_key, V& return_val) const
+    {
+      Found_e found_where; N* node = lookup_(key, found_where);
+      if (found_where==FOUND) {
+	return_val = node->value;
+	return_key = node->key;
+	return true;
+      }
+      return false;
+    }
+
+    // Inserts the key and value into the table.  If the key is
+    // already in there, replace it.
+    void insertKeyAndValue (const K& key, const V& value)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	node->value = value; // Assumes the op= for V works
+      } else {
+	(void)notInTableInsert_(node, key, hashkey, value, found_where);
+      }
+    }
+
+#if defined(OC_MOVE_SEMANTICS)
+    // Like insertKeyAndValue, but the key and value are moved into
+    // the table rather than copied (if the key is already there, only
+    // the value is moved).  Returns a reference to the value in the
+    // table.
+    V& emplace (K&& key, V&& value)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where!=FOUND) {
+	node = notInTableInsert_(node, K(), hashkey, V(), found_where);
+	node->key = std::move(key);
+	CacheHash_(node->key, hashkey);
+      }
+      node->value = std::move(value);
+      return node->value;
+    }
+#endif
+
+    // Returns true if the table has no items in it, false otherwise.
+    bool isEmpty () const { return entries_==0; }
+
+    // Returns true and removes the (key/value) pair where the key is
+    // equal to the key.  Returns false if there is no such key.
+    bool remove (const K& key)
+    {
+      N** slot = findSlot_(key, HashFunction(key));
+      if (slot==0) return false;
+      deleteSlot_(int(slot-slots_()));
+      return true;
+    }
+
+    // Lookup the key "key" and return its associated value as an
+    // l-value reference.  If the key is not in the dictionary, then
+    // it is added to the dictionary.  In this case, the value
+    // associated with the key will be provided by the default
+    // constructor ofor objects of types V.
+    V& operator[] (const K& key)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	return node->value;
+      } else {
+	return notInTableInsert_(node, key, hashkey, V(), found_where)->value;
+      }
+    }
+
+    // Lookup the key "key" and return its associated value as an
+    // l-value reference.  If the key is not in the dictionary, then
+    // an out_of_range is thrown
+    V& operator() (const K& key) const
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where==FOUND) {
+	return node->value;
+      } else {
+	throw out_of_range("Key "+Stringize(key)+" not in table");
+      }
+    }
+
+    // Heterogeneous lookup: find the entry whose key compares equal
+    // (via key==probe) to "probe", which can be any type that is
+    // cheaper to build than a K (like a StrView for a Val key).  The
+    // hashkey given MUST be the HashFunction of the equivalent K.
+    // Returns a pointer to the value, or 0 if the key is not there.
+    template <class PROBE>
+    V* lookup (const PROBE& probe, int_u4 hashkey) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      return (found_where==FOUND) ? &node->value : 0;
+    }
+
+    // Like contains and find above, but with a probe (see lookup)
+    template <class PROBE>
+    bool contains (const PROBE& probe, int_u4 hashkey) const
+    { return lookup(probe, hashkey)!=0; }
+
+    template <class PROBE>
+    bool find (const PROBE& probe, int_u4 hashkey, K& return_key) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      if (found_where==FOUND) {
+	return_key = node->key;
+	return true;
+      } else {
+	return false;
+      }
+    }
+
+    // See if data structure internally consistent.  Very expensive.
+    bool consistent () const
+    {
+      if (table_==0) return entries_==0 && capacity_==0;
+      if (capacity_ % FLAT_GROUP != 0 ||
+	  ((capacity_/FLAT_GROUP) & (capacity_/FLAT_GROUP-1)) != 0)
+	return false;
+      const int_1* ctrl = ctrl_();
+      N** slots = slots_();
+      int_u4 full = 0, deleted = 0;
+      for (int_u4 ii=0; ii<capacity_; ii++) {
+	if (ctrl[ii]==FLAT_DELETED) { deleted++; continue; }
+	if (ctrl[ii]==FLAT_EMPTY) continue;
+	if (ctrl[ii]<0) return false;
+	full++;
+	N* node = slots[ii];
+	if (int_1(FlatMixHash_(node->hashkey) & 0x7f) != ctrl[ii]) return false;
+	if (findSlot_(node->key, node->hashkey) != &slots[ii]) return false;
+      }
+      const FlatHeader_* h = header_();
+      if (full!=entries_ || deleted!=h->deleted ||
+	  h->growth_left + entries_ + deleted != maxLoad_(capacity_))
+	return false;
+
+      // Every node in use is in some chunk, and only the last chunk
+      // can be completely free
+      int_u4 live = 0;
+      for (const FlatChunk_* c = h->chunks; c; c = c->next) {
+	if (c->live > c->nodes || c->fresh > c->nodes) return false;
+	if (c->live==0 && !(c==h->chunks && c->next==0)) return false;
+	live += c->live;
+      }
+      return live==entries_;
+    }
+
+    void swap (FlatHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      OC_NAMESPACED::swap(allocator_, rhs.allocator_);
+      OC_NAMESPACED::swap(table_,     rhs.table_);
+      OC_NAMESPACED::swap(entries_,   rhs.entries_);
+      OC_NAMESPACED::swap(capacity_,  rhs.capacity_);
+    }
+
+    // Avoid an extra copy when inserting into a table by giving key
+    // and value which are "disposable" (see AVLHashT::swapInto).
+    // Returns true if the key was already there (so we just swapped
+    // out the value) false if the key wasn't there already (so both
+    // key and value are swapped)
+    bool swapInto (K& key_to_swap, V& value_to_swap)
+    {
+      int_u4 hashkey = HashFunction(key_to_swap);
+      Found_e found_where; N* node = lookup_(key_to_swap, hashkey, found_where);
+      if (found_where == FOUND) {
+	OC_NAMESPACED::swap(value_to_swap, node->value);
+	return true;
+      } else {
+	N* current = notInTableInsert_(node, K(), hashkey, V(), found_where);
+	OC_NAMESPACED::swap(key_to_swap, current->key);
+	CacheHash_(current->key, hashkey);
+	OC_NAMESPACED::swap(value_to_swap, current->value);
+	return false;
+      }
+    }
+
+    // Make sure there is room for at least "expected" entries without
+    // having to grow the table.
+    void reserve (int_u4 expected)
+    {
+      int_u4 cap = capacityFor_(expected);
+      if (cap > capacity_) rehash_(cap);
+    }
+
+  protected:
+
+    // ///// Data Members
+
+    // The allocator used.  This is not quite like STL allocators:
+    // we need to be able to choose between different allocators at
+    // run-time because some tables may exist in global shared memory,
+    // some use new, etc.
+    Allocator* allocator_;
+
+    // One piece of memory: a FlatHeader_, then capacity_ control
+    // bytes, then capacity_ slots (pointers to nodes).  0 when the
+    // table has never had anything in it.
+    char* table_;
+
+    // The number of actual entries in the table
+    int_u4 entries_;
+
+    // Number of slots: always 0 or a power of two times FLAT_GROUP
+    int_u4 capacity_;
+
+    // ///// Methods
+
+    FlatHeader_* header_ () const { return (FlatHeader_*)table_; }
+    int_1* ctrl_ () const { return (int_1*)(table_+sizeof(FlatHeader_)); }
+    N** slots_ () const
+    { return (N**)(table_+sizeof(FlatHeader_)+capacity_); }
+
+    // Tables never get more than 7/8 full
+    static int_u4 maxLoad_ (int_u4 cap) { return cap - cap/8; }
+
+    // Smallest legal capacity that can hold n entries
+    static int_u4 capacityFor_ (int_u4 n)
+    {
+      int_u4 cap = FLAT_GROUP;
+      while (maxLoad_(cap) < n) cap <<= 1;
+      return cap;
+    }
+
+    char* allocate_ (size_t bytes) const
+    {
+      if (allocator_) return allocator_->allocate(bytes);
+      return new char[bytes];
+    }
+    void deallocate_ (char* memory) const
+    {
+      if (allocator_) allocator_->deallocate(memory);
+      else delete [] memory;
+    }
+
+    // Find the slot holding the key, or 0 if it's not there
+    template <class PROBE>
+    N** findSlot_ (const PROBE& key, int_u4 hashkey) const
+    {
+      if (capacity_!=FLAT_GROUP) return probeSlot_(key, hashkey);
+
+      // Small table: just walk the full slots (see top of file)
+      N** slots = slots_();
+      for (int_u4 m = FlatMatchFull_(ctrl_()); m; m &= m-1) {
+	N** slot = slots + FlatLowestBit_(m);
+	if ((*slot)->hashkey==hashkey && (*slot)->key==key) return slot;
+      }
+      return 0;
+    }
+
+    // Same as findSlot_, for tables of more than one group: probe
+    // the groups by the control bytes
+    template <class PROBE> OC_FLATHASH_NOINLINE
+    N** probeSlot_ (const PROBE& key, int_u4 hashkey) const
+    {
+      if (entries_==0) return 0;
+      N** slots = slots_();
+      const int_u4 mixed = FlatMixHash_(hashkey);
+      const int_1 h2 = int_1(mixed & 0x7f);
+      const int_u4 group_mask = capacity_/FLAT_GROUP - 1;
+      const int_1* ctrl = ctrl_();
+      int_u4 g = (mixed >> 7) & group_mask;
+      for (int_u4 step=1; ; step++) {
+	const int_1* group = ctrl + g*FLAT_GROUP;
+	for (int_u4 m = FlatMatch_(group, h2); m; m &= m-1) {
+	  N** slot = slots + g*FLAT_GROUP + FlatLowestBit_(m);
+	  if ((*slot)->hashkey==hashkey && (*slot)->key==key) return slot;
+	}
+	if (FlatMatchEmpty_(group)) return 0;
+	g = (g + step) & group_mask;
+      }
+    }
+
+    // Find the first slot (EMPTY or DELETED) where this hash can go.
+    // Assumes there is room in the table.
+    int findInsertSlot_ (int_u4 mixed) const
+    {
+      const int_u4 group_mask = capacity_/FLAT_GROUP - 1;
+      const int_1* ctrl = ctrl_();
+      int_u4 g = (mixed >> 7) & group_mask;
+      for (int_u4 step=1; ; step++) {
+	int_u4 m = FlatMatchEmptyOrDeleted_(ctrl + g*FLAT_GROUP);
+	if (m) return g*FLAT_GROUP + FlatLowestBit_(m);
+	g = (g + step) & group_mask;
+      }
+    }
+
+    // Helper function used by a lot of methods above: Do a lookup and
+    // see if the item is already there: if it is, return pointer to
+    // it and indicate FOUND.  If not there, return 0 and indicate
+    // NOT_FOUND (so the signature matches the AVLHashT, where Tab
+    // uses it).
+    N* lookup_ (const K& key, Found_e& found_where) const
+    { return lookup_(key, HashFunction(key), found_where); }
+
+    // The key here can be a K or any probe that compares to a K with
+    // == (see lookup): the hashkey is always the hash of the K.
+    template <class PROBE>
+    N* lookup_ (const PROBE& key, int_u4 hashkey, Found_e& found_where) const
+    {
+      N** slot = findSlot_(key, hashkey);
+      if (slot==0) {
+	found_where = NOT_FOUND;
+	return 0;
+      }
+      found_where = FOUND;
+      return *slot;
+    }
+
+    // Insert an item we know is not in the table.  The first and last
+    // arguments are ignored: they are there so this looks just like
+    // the AVLHashT routine.
+    N* notInTableInsert_ (N*, const K& key, int_u4 keyhash,
+			  const V& value, Found_e)
+    {
+      if (table_==0 || header_()->growth_left==0) {
+	growForInsert_();
+      }
+      // Construct the node BEFORE we put it in the table, so if the
+      // key/value copy throws, the table is still consistent
+      N* node = newNode_(key, keyhash, value);
+      placeNode_(node, FlatMixHash_(keyhash));
+      entries_++;
+      return node;
+    }
+
+    // Put a node into the first available slot for its hash
+    void placeNode_ (N* node, int_u4 mixed)
+    {
+      int slot = findInsertSlot_(mixed);
+      int_1* ctrl = ctrl_();
+      FlatHeader_* h = header_();
+      if (ctrl[slot]==FLAT_DELETED) {
+	h->deleted--;
+      } else {
+	h->growth_left--;
+      }
+      ctrl[slot] = int_1(mixed & 0x7f);
+      slots_()[slot] = node;
+    }
+
+    // Remove the node in the given slot from the table
+    void deleteSlot_ (int slot)
+    {
+      int_1* ctrl = ctrl_();
+      FlatHeader_* h = header_();
+      N* node = slots_()[slot];
+
+      // If this group has an EMPTY, no probe sequence ever went past
+      // it, so this slot can go back to EMPTY.  Otherwise, it has to
+      // be a tombstone so later probes keep looking.
+      const int_1* group = ctrl + (slot/FLAT_GROUP)*FLAT_GROUP;
+      if (FlatMatchEmpty_(group)) {
+	ctrl[slot] = int_1(FLAT_EMPTY);
+	h->growth_left++;
+      } else {
+	ctrl[slot] = int_1(FLAT_DELETED);
+	h->deleted++;
+      }
+      entries_--;
+      deleteNode_(node);
+    }
+
+    // The table is out of room: either grow it, or (if it's mostly
+    // tombstones) rehash it in place to get rid of the tombstones.
+    void growForInsert_ ()
+    {
+      if (table_==0) {
+	rehash_(FLAT_GROUP);
+      } else if (entries_+1 <= maxLoad_(capacity_)/2) {
+	rehash_(capacity_);
+      } else {
+	rehash_(capacity_*2);
+      }
+    }
+
+    // Build a new set of control bytes and slots with the given
+    // capacity.  Only pointers move: the nodes stay where they are.
+    void rehash_ (int_u4 new_capacity)
+    {
+      const size_t bytes = sizeof(FlatHeader_) +
+	new_capacity*(sizeof(int_1)+sizeof(N*));
+      char* old_table = table_;
+      const int_u4 old_capacity = capacity_;
+      FlatHeader_ old_header = { 0, 0, 0, 0, { 0 } };
+      if (old_table) old_header = *header_();
+
+      table_ = allocate_(bytes);
+      capacity_ = new_capacity;
+      FlatHeader_* h = header_();
+      h->chunks = old_header.chunks;
+      h->room = old_header.room;
+      h->growth_left = maxLoad_(new_capacity);
+      h->deleted = 0;
+      memset(ctrl_(), FLAT_EMPTY, new_capacity);
+
+      if (old_table) {
+	const int_1* old_ctrl = (const int_1*)(old_table+sizeof(FlatHeader_));
+	N** old_slots = (N**)(old_table+sizeof(FlatHeader_)+old_capacity);
+	for (int_u4 ii=0; ii<old_capacity; ii++) {
+	  if (old_ctrl[ii]>=0) {
+	    N* node = old_slots[ii];
+	    placeNode_(node, FlatMixHash_(node->hashkey));
+	  }
+	}
+	deallocate_(old_table);
+      }
+    }
+
+    // Give me a new node: from the first chunk with room, or a new
+    // chunk if none have any.
+    N* newNode_ (const K& key, int_u4 keyhash, const V& value)
+    {
+      FlatHeader_* h = header_();
+      FlatChunk_* c = h->room;
+      if (c==0) {
+	// Chunks get bigger as the table does, so big tables
+	// don't go to the heap every CHUNKSIZE inserts
+	int_u4 nodes = entries_ < CHUNKSIZE ? CHUNKSIZE : entries_;
+	if (nodes > 4096) nodes = 4096;
+	c = (FlatChunk_*)allocate_(sizeof(FlatChunk_) + nodes*sizeof(N));
+	c->next = h->chunks;
+	c->next_room = 0;
+	c->nodes = nodes;
+	c->live = 0;
+	c->freelist = nodes;
+	c->fresh = 0;
+	h->chunks = h->room = c;
+      }
+      // Take off freelist (or the never-used nodes) only AFTER the
+      // node is constructed, in case the key/value copy throws
+      N* first = chunkNodes_(c);
+      const bool recycled = c->freelist != c->nodes;
+      const int_u4 pos = recycled ? c->freelist : c->fresh;
+      const int_u4 next = recycled ? first[pos].nextFree() : 0;
+      N* result = FlatCreateNode(&first[pos], key, keyhash, value, allocator_);
+      if (recycled) c->freelist = next; else c->fresh++;
+      result->chunkpos = pos;
+      CacheHash_(result->key, keyhash);
+      if (++c->live==c->nodes) h->room = c->next_room; // full: no room
+      return result;
+    }
+
+    // The nodes of a chunk start right after its header
+    static N* chunkNodes_ (FlatChunk_* c) { return (N*)(c+1); }
+
+    // Return node: it goes on the freelist of its chunk, and the chunk
+    // goes back to the allocator if nothing in it is in use (unless
+    // it's the only chunk left: an insert/remove of one key over and
+    // over shouldn't go to the allocator every time).
+    void deleteNode_ (N* node)
+    {
+      const int_u4 pos = node->chunkpos;
+      FlatChunk_* c = (FlatChunk_*)((char*)(node-pos) - sizeof(FlatChunk_));
+      node->N::~FlatNode_<K,V>();
+      FlatHeader_* h = header_();
+      if (c->live==c->nodes) {  // was full, so has room again
+	c->next_room = h->room;
+	h->room = c;
+      }
+      node->nextFree(c->freelist);
+      c->freelist = pos;
+      if (--c->live==0 && !(h->chunks==c && c->next==0)) {
+	unlinkChunk_(&h->chunks, c, &FlatChunk_::next);
+	unlinkChunk_(&h->room, c, &FlatChunk_::next_room);
+	deallocate_((char*)c);
+      }
+    }
+
+    // Take a chunk out of one of the singly-linked lists of chunks.
+    // Lists are short (chunks get big), and this only happens when a
+    // whole chunk frees up.
+    static void unlinkChunk_ (FlatChunk_** list, FlatChunk_* c,
+			      FlatChunk_* FlatChunk_::*link)
+    {
+      for (FlatChunk_** lp = list; *lp; lp = &((*lp)->*link)) {
+	if (*lp==c) { *lp = c->*link; return; }
+      }
+    }
+
+    // Copy: the keys in rhs are all unique, so no need to look them up
+    void copyTable_ (const FlatHashT<K,V,CHUNKSIZE>& rhs)
+    {
+      if (rhs.entries_==0) return;
+      reserve(rhs.entries_);
+      const int_1* ctrl = rhs.ctrl_();
+      N** slots = rhs.slots_();
+      for (int_u4 ii=0; ii<rhs.capacity_; ii++) {
+	if (ctrl[ii]>=0) {
+	  N* node = slots[ii];
+	  N* copy = newNode_(node->key, node->hashkey, node->value);
+	  placeNode_(copy, FlatMixHash_(node->hashkey));
+	  entries_++;
+	}
+      }
+    }
+
+}; // FlatHashT
+
+template <class K, class V, int_u4 CHUNKSIZE>
+inline void swap (FlatHashT<K,V,CHUNKSIZE>& lhs,
+		  FlatHashT<K,V,CHUNKSIZE>& rhs)
+{ lhs.swap(rhs); }
+
+
+// ////////////////////////////////////// The FlatHashTIterator Class
+
+template <class K, class V, int_u4 CHUNKSIZE>
+class FlatHashTIterator {
+
+    friend class FlatHashTSortedIterator<K,V,CHUNKSIZE>;
+
+  public:
+
+    // ///// Methods
+
+    // Constructor
+    FlatHashTIterator (const FlatHashT<K,V,CHUNKSIZE>& tree) :
+      tree_(&tree) { reset(); }
+
+    // Advance the iterator one position.  Returns true if the
+    // new position is valid, false otherwise.
+    bool next ()
+    {
+      const int_u4 cap = tree_ ? tree_->capacity_ : 0;
+      const int_1* ctrl = cap ? tree_->ctrl_() : 0;
+      while (slot_ < cap) {
+	const int_u4 ii = slot_++;
+	if (ctrl[ii]>=0) {
+	  current_ = tree_->slots_()[ii];
+	  return true;
+	}
+      }
+      current_ = 0;
+      return false;
+    }
+
+    // Syntactic sugar for next
+    bool operator++ () { return next();}
+
+    // Advance the iterator one position.  Returns true if the
+    // new position is valid, false otherwise.
+    bool operator() () { return next(); }
+
+    // Returns the key at the iterator's current position.  The
+    // results are undefined if the iterator is no longer valid.
+    const K& key () const { return current_->key; }
+
+    // Resets the iterator to the state it had immediately after
+    // construction.
+    void reset () { current_ = 0; slot_ = 0; }
+
+    // Resets the iterator to iterate over collection c
+    void reset (const FlatHashT<K,V,CHUNKSIZE>& c) { tree_=&c; reset(); }
+
+    // Returns the value at the iterator's current position.  The
+    // results are undefined if the iterator is no longer valid.
+    V& value () const { return current_->value; }
+
+    // Backpointer to container
+    FlatHashT<K, V, CHUNKSIZE>* container () const
+    { typedef FlatHashT<K, V, CHUNKSIZE> NCHT; return (NCHT*)tree_; }
+
+  protected:
+
+    // ///// Data Members
+
+    // The current node
+    FlatNode_<K,V>* current_;
+
+    // The next slot to look at
+    int_u4 slot_;
+
+    // The table we are looking at.  Not adopted, just reffed.
+    const FlatHashT<K, V, CHUNKSIZE>* tree_;
+
+    // Protected so only friends can see: just so don't have to
+    // construct everything.
+    FlatHashTIterator () : current_(0), slot_(0), tree_(0) { }
+}; // FlatHashTIterator
+
+
+// Helper class for Sorted Iteration
+template <class K, class V> struct FlatNR {
+  FlatNR (FlatNode_<K, V>* data=0) : node(data) { }
+  void swap (FlatNR<K,V>& rhs) { OC_NAMESPACED::swap(node, rhs.node); }
+  bool operator== (FlatNR<K,V>a2) const { return node->key==a2.node->key; }
+  bool operator> (FlatNR<K,V>a2) const  { return node->key > a2.node->key; }
+  bool operator< (FlatNR<K,V>a2) const  { return node->key < a2.node->key; }
+  FlatNode_<K,V>* node;
+};  // FlatNR<K,V>
+
+template<class K, class V>
+void swap(FlatNR<K,V>& lhs, FlatNR<K,V>& rhs) { lhs.swap(rhs); }
+
+// An iterator, sorted via keys
+template <class K, class V, int_u4 CHUNKSIZE>
+class FlatHashTSortedIterator {
+  public:
+
+    FlatHashTSortedIterator (const FlatHashT<K,V,CHUNKSIZE>& tree) :
+      keys_(tree.entries()),
+      current_(-1),
+      tree_(&tree)
+    { reset(); }
+
+    void reset ()
+    {
+      current_ = -1;
+      keys_.clear();
+      for (FlatHashTIterator<K,V,CHUNKSIZE> it(*tree_); it(); ) {
+	keys_.append(FlatNR<K,V>(it.current_));
+      }
+      FlatNR<K,V>* keys_ptr = keys_.data();
+      OCQuickSort(keys_ptr, 0, keys_.length());
+    }
+    void reset (const FlatHashT<K,V,CHUNKSIZE>& tree)
+    { tree_ = &tree; reset(); }
+
+    bool next () { return ++current_ < int(keys_.length()); }
+    bool operator() () { return next(); }
+
+    const K& key ()   const { return keys_[current_].node->key; }
+          V& value () const { return keys_[current_].node->value; }
+
+    FlatHashT<K,V,CHUNKSIZE>& container () const
+    { typedef FlatHashT<K, V, CHUNKSIZE> NCHT; return *(NCHT*)tree_; }
+
+  protected:
+
+    // Keys kept by pointer in an array ... obviously this is
+    // messed up by inserts or deletes into the table.
+    Array<FlatNR< K, V > > keys_;
+    int current_;
+
+    // The table we are looking at.  Not adopted, just reffed.
+    const FlatHashT<K, V, CHUNKSIZE>* tree_;
+
+    // Protected so only friends can access. Just want to avoid lots
+    // on default construction
+    FlatHashTSortedIterator () : keys_(), current_(0), tree_(0) { }
+
+}; // FlatHashTSortedIterator
+
+
+// /////////////////// Global Functions
+
+// Handle comparison other than equality correctly: same as AVLHashT,
+// compare in sorted key order so insertion order doesn't matter
+template <class K, class V, int_u4 LEN>
+inline bool operator< (const FlatHashT<K,V,LEN>& o1, const FlatHashT<K,V,LEN>& o2)
+{
+  if (o1.entries()<o2.entries()) return true;
+  if (o1.entries()>o2.entries()) return false;
+  FlatHashTSortedIterator<K,V,LEN> ii(o1);
+  FlatHashTSortedIterator<K,V,LEN> jj(o2);
+  while (ii() && jj()) {
+    const K& k1 = ii.key(); const V& v1 = ii.value();
+    const K& k2 = jj.key(); const V& v2 = jj.value();
+    if (k1<k2) {
+      return true;
+    } else if (k1==k2) {
+      if (v1<v2) {
+	return true;
+      } else if (v1==v2) {
+	continue;
+      } else {
+	return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return false;
+}
+
+template <class K, class V, int_u4 LEN>
+bool operator<= (const FlatHashT<K,V,LEN>& o1, const FlatHashT<K,V,LEN>&o2)
+{ return o1<o2 || o1==o2; }
+
+template <class K, class V, int_u4 LEN>
+bool operator> (const FlatHashT<K,V,LEN>& o1, const FlatHashT<K,V,LEN>&o2)
+{ return o2<o1; }
+
+template <class K, class V, int_u4 LEN>
+bool operator>= (const FlatHashT<K,V,LEN>& o1, const FlatHashT<K,V,LEN>&o2)
+{ return o1>o2 || o1==o2; }
+
+
+OC_END_NAMESPACE
+
+#define OC_FLATHASHT_H_
+#endif
@@ -0,0 +1,308 @@
+#ifndef OC_FROZENTAB_H_
+
+// A FrozenTab is a read-only copy of a Tab, built once, for the big
+// tables that never change but get looked up in over and over
+// (routing tables, unit conversions, ...).  A Tab (AVLHashT or
+// FlatHashT) pays for being able to insert and remove: a FrozenTab
+// doesn't have to, so it keeps all the keys and values in one
+// contiguous array, placed with a minimal perfect hash.  A lookup
+// touches one small word of the displacement table and then the one
+// key/value that can possibly match: usually just two cache lines.
+//
+//   Tab routes = ...;             // built once
+//   FrozenTab frozen(routes);     // ... and frozen
+//   const Val* where = frozen.lookup("station7", 8);
+//   if (where) ...
+//
+// A FrozenTab can't be changed: thaw() gives back a (normal) Tab to
+// change.  When it becomes a Val (to be printed, serialized, put in
+// another table, ...) it becomes a normal Tab again, so it goes out
+// (and comes back) as a plain dict.
+
+// [Implementation: This is "hash, displace and compress" (CHD).  The
+// (mixed) hash of each key puts it in one of the buckets (about 4
+// keys per bucket), then the buckets are placed biggest first: for
+// each, we search for a displacement d so that every key in the
+// bucket lands in a different free slot, and remember the d for the
+// bucket.  A lookup needs no probing: mix the hash, find the
+// bucket's d, and the slot is a function of the two.  There are
+// exactly as many slots as keys.  Keys with exactly the same hash
+// can't be separated by any d, so if that happens (or the search
+// takes too long), the FrozenTab falls back to keeping the entries
+// sorted by hash and binary searching.]
+
+// ///////////////////////////////////////////// Include Files
+
+#include "ocval.h"
+
+OC_BEGIN_NAMESPACE
+
+// How many displacements to try for one bucket before giving up
+// (and trying again with more buckets)
+#ifndef OC_FROZENTAB_MAXTRIES
+# define OC_FROZENTAB_MAXTRIES (1<<20)
+#endif
+
+// Implementation Detail: a key/value pair in a FrozenTab, with the
+// (unmixed) hash of the key so most misses never compare keys.
+struct FrozenItem_ {
+  FrozenItem_ () : hash(0) { }
+  int_u4 hash;
+  Val    key;
+  Val    value;
+}; // FrozenItem_
+
+
+// ///////////////////////////////////////////// The FrozenTab Class
+
+class FrozenTab {
+
+ public:
+
+  // An empty table
+  FrozenTab () : items_(1), disp_(1), mask_(0), perfect_(true) { }
+
+  // Freeze a copy of the given table
+  explicit FrozenTab (const Tab& t) :
+    items_(t.entries()),
+    disp_(1),
+    mask_(0),
+    perfect_(true)
+  { build_(t); }
+
+  // Number of key/value pairs
+  int entries () const { return int(items_.length()); }
+  bool empty () const { return entries()==0; }
+
+  // Find the value for the key: returns 0 if it isn't there.  As with
+  // Tab, a string key can be given as a (pointer, length) so no
+  // temporary Val is built, and the hash can be given if it's known
+  // (it must be what HashFunction gives for the key).
+  const Val* lookup (const Val& key) const
+  { return lookup_(key, HashFunction(key)); }
+  const Val* lookup (const char* key, size_t len) const
+  { StrView s(key, len); return lookup_(s, s.hash()); }
+  const Val* lookup (const char* key, size_t len, int_u4 hashkey) const
+  { return lookup_(StrView(key, len), hashkey); }
+
+  bool contains (const Val& key) const { return lookup(key)!=0; }
+  bool contains (const char* key, size_t len) const
+  { return lookup(key, len)!=0; }
+
+  // The value for the key: throws an out_of_range (just like Tab) if
+  // the key isn't there
+  const Val& operator() (const Val& key) const
+  {
+    const Val* vp = lookup(key);
+    if (!vp) throw out_of_range("Key "+Stringize(key)+" not in table");
+    return *vp;
+  }
+
+  // The value for the key, or the default if the key isn't there
+  Val get (const Val& key, const Val& def=None) const
+  {
+    const Val* vp = lookup(key);
+    return vp ? *vp : def;
+  }
+
+  // The ith key and value, for iterating over all of them (in no
+  // particular order):  for (int ii=0; ii<f.entries(); ii++) f.key(ii) ...
+  const Val& key (int ii) const { return items_[ii].key; }
+  const Val& value (int ii) const { return items_[ii].value; }
+
+  // A normal (changeable) Tab with all the same keys and values
+  Tab thaw () const
+  {
+    Tab t;
+    for (int ii=0; ii<entries(); ii++) {
+      t[items_[ii].key] = items_[ii].value;
+    }
+    return t;
+  }
+
+  // As a Val, a FrozenTab is just a Tab
+  operator Val () const { return Val(thaw()); }
+
+  // Did the perfect hash work?  (false means it fell back to binary
+  // search: see above)
+  bool perfect () const { return perfect_; }
+
+  void swap (FrozenTab& rhs)
+  {
+    items_.swap(rhs.items_);
+    disp_.swap(rhs.disp_);
+    OC_NAMESPACED::swap(mask_, rhs.mask_);
+    OC_NAMESPACED::swap(perfect_, rhs.perfect_);
+  }
+
+ protected:
+
+  // All entries, each in the slot the perfect hash puts it in (or
+  // sorted by hash if there is no perfect hash)
+  Array<FrozenItem_> items_;
+
+  // The displacement for each bucket: there are mask_+1 buckets
+  Array<int_u4> disp_;
+  int_u4 mask_;
+
+  bool perfect_;
+
+  // Where a key with this (mixed) hash goes with displacement d
+  int_u4 slot_ (int_u4 mixed, int_u4 d) const
+  {
+    const int_u4 h = FlatMixHash_(mixed ^ (d*0x9E3779B9U));
+    return int_u4((int_u8(h) * int_u8(items_.length())) >> 32);
+  }
+
+  template <class K>
+  const Val* lookup_ (const K& key, int_u4 hashkey) const
+  {
+    const size_t n = items_.length();
+    if (n==0) return 0;
+    const FrozenItem_* items = items_.data();
+    if (perfect_) {
+      const int_u4 mixed = FlatMixHash_(hashkey);
+      const FrozenItem_& item = items[slot_(mixed, disp_[mixed & mask_])];
+      return (item.hash==hashkey && item.key==key) ? &item.value : 0;
+    }
+
+    // Fallback: binary search for the first with this hash
+    size_t lo = 0, hi = n;
+    while (lo<hi) {
+      const size_t mid = (lo+hi)/2;
+      if (items[mid].hash<hashkey) lo = mid+1; else hi = mid;
+    }
+    for (; lo<n && items[lo].hash==hashkey; lo++) {
+      if (items[lo].key==key) return &items[lo].value;
+    }
+    return 0;
+  }
+
+  void build_ (const Tab& t)
+  {
+    const int n = int(t.entries());
+    Array<int_u4> hashes(n);
+    Array<const Val*> keys(n), values(n);
+    for (It ii(t); ii(); ) {
+      hashes.append(HashFunction(ii.key()));
+      keys.append(&ii.key());
+      values.append(&ii.value());
+    }
+    items_.fill(FrozenItem_(), n);
+
+    // Sorted by hash: for the fallback, and to see if any keys have
+    // exactly the same hash (then there is no perfect hash)
+    Array<int_u8> order(n);
+    for (int ii=0; ii<n; ii++) order.append((int_u8(hashes[ii])<<32) | ii);
+    OCQuickSort(order, 0, n);
+    bool same_hash = false;
+    for (int ii=1; ii<n && !same_hash; ii++) {
+      same_hash = (order[ii]>>32)==(order[ii-1]>>32);
+    }
+
+    // About 4 keys per bucket, then more buckets if it takes too long
+    int_u4 buckets = 1;
+    while (buckets*4<int_u4(n)) buckets <<= 1;
+    for (int attempt=0; attempt<4 && !same_hash; attempt++, buckets<<=1) {
+      Array<int_u4> slots(n);
+      if (place_(hashes, buckets, slots)) {
+	for (int ii=0; ii<n; ii++) {
+	  FrozenItem_& item = items_[slots[ii]];
+	  item.hash = hashes[ii];
+	  item.key = *keys[ii];
+	  item.value = *values[ii];
+	}
+	return;
+      }
+    }
+
+    // No perfect hash: sorted by hash
+    perfect_ = false;
+    disp_.clear();
+    mask_ = 0;
+    for (int ii=0; ii<n; ii++) {
+      const int from = int(order[ii] & 0xFFFFFFFFU);
+      FrozenItem_& item = items_[ii];
+      item.hash = hashes[from];
+      item.key = *keys[from];
+      item.value = *values[from];
+    }
+  }
+
+  // Try to find a displacement for every bucket: on success, the
+  // displacements are in disp_ and the slot for each key in slots
+  bool place_ (const Array<int_u4>& hashes, int_u4 buckets,
+	       Array<int_u4>& slots)
+  {
+    const int n = int(hashes.length());
+    mask_ = buckets-1;
+    disp_.clear();
+    disp_.fill(0, buckets);
+    slots.clear();
+    slots.fill(0, n);
+
+    // Which keys are in each bucket: keys sorted by bucket
+    Array<int_u8> by_bucket(n);
+    for (int ii=0; ii<n; ii++) {
+      by_bucket.append((int_u8(FlatMixHash_(hashes[ii]) & mask_)<<32) | ii);
+    }
+    OCQuickSort(by_bucket, 0, n);
+
+    // ... and the buckets, biggest first: (n-size, start) so the
+    // sort puts them in order
+    Array<int_u8> order(buckets);
+    for (int start=0; start<n; ) {
+      int end = start+1;
+      while (end<n && (by_bucket[end]>>32)==(by_bucket[start]>>32)) end++;
+      order.append((int_u8(n-(end-start))<<32) | start);
+      start = end;
+    }
+    OCQuickSort(order, 0, int(order.length()));
+
+    Array<char> taken(n);
+    taken.fill(0, n);
+    Array<int_u4> tried(32);
+    for (size_t bb=0; bb<order.length(); bb++) {
+      const int start = int(order[bb] & 0xFFFFFFFFU);
+      const int size = n - int(order[bb]>>32);
+      const int_u4 bucket = int_u4(by_bucket[start]>>32);
+
+      int_u4 d = 0;
+      for (; d<int_u4(OC_FROZENTAB_MAXTRIES); d++) {
+	tried.clear();
+	bool fits = true;
+	for (int kk=0; kk<size && fits; kk++) {
+	  const int key = int(by_bucket[start+kk] & 0xFFFFFFFFU);
+	  const int_u4 s = slot_(FlatMixHash_(hashes[key]), d);
+	  if (taken[s]) { fits = false; break; }
+	  for (size_t jj=0; jj<tried.length(); jj++) {
+	    if (tried[jj]==s) { fits = false; break; }
+	  }
+	  tried.append(s);
+	}
+	if (fits) break;
+      }
+      if (d==int_u4(OC_FROZENTAB_MAXTRIES)) return false;
+
+      disp_[bucket] = d;
+      for (int kk=0; kk<size; kk++) {
+	const int key = int(by_bucket[start+kk] & 0xFFFFFFFFU);
+	slots[key] = tried[kk];
+	taken[tried[kk]] = 1;
+      }
+    }
+    return true;
+  }
+
+}; // FrozenTab
+
+inline void swap (FrozenTab& lhs, FrozenTab& rhs) { lhs.swap(rhs); }
+
+// Prints just like the Tab it came from
+inline ostream& operator<< (ostream& os, const FrozenTab& f)
+{ return os << f.thaw(); }
+
+OC_END_NAMESPACE
+
+#define OC_FROZENTAB_H_
+#endif // OC_FROZENTAB_H_
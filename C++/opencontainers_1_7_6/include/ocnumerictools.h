@@ -3,6 +3,8 @@
 // A few helper functions/defines for help for dealing with Numeric
 // (Python Numeric)
 #include "ocport.h"
+#include "occomplex.h"
+#include "ocsimd.h"
 
 OC_BEGIN_NAMESPACE
 
@@ -63,6 +65,31 @@ inline void BufferConvert (const IT* in, OT* out, int len)
   }
 } 
 
+// The common conversions (small ints to reals, reals to reals,
+// complex to complex) have vectorized versions: see ocsimd.h
+#define OC_SIMD_INT_TO_REAL(IT, OT) \
+inline void BufferConvert (const IT* in, OT* out, int len) \
+{ SIMDIntToReal(in, out, len); }
+OC_SIMD_INT_TO_REAL(int_1,  real_4)
+OC_SIMD_INT_TO_REAL(int_u1, real_4)
+OC_SIMD_INT_TO_REAL(int_2,  real_4)
+OC_SIMD_INT_TO_REAL(int_u2, real_4)
+OC_SIMD_INT_TO_REAL(int_4,  real_4)
+OC_SIMD_INT_TO_REAL(int_1,  real_8)
+OC_SIMD_INT_TO_REAL(int_u1, real_8)
+OC_SIMD_INT_TO_REAL(int_2,  real_8)
+OC_SIMD_INT_TO_REAL(int_u2, real_8)
+OC_SIMD_INT_TO_REAL(int_4,  real_8)
+
+inline void BufferConvert (const real_4* in, real_8* out, int len)
+{ SIMDRealToReal(in, out, len); }
+inline void BufferConvert (const real_8* in, real_4* out, int len)
+{ SIMDRealToReal(in, out, len); }
+inline void BufferConvert (const complex_8* in, complex_16* out, int len)
+{ SIMDRealToReal((const real_4*)in, (real_8*)out, 2*len); }
+inline void BufferConvert (const complex_16* in, complex_8* out, int len)
+{ SIMDRealToReal((const real_8*)in, (real_4*)out, 2*len); }
+
 // helper function to convert from POD array to a different type of POD array
 #define OCCVTARRT(T) { result=Array<T>(len); Array<T>& c=result; c.expandTo(len); T* cdata=c.data(); BufferConvert(a,cdata,len); }
 template <class T>
@@ -93,7 +120,7 @@ inline void ConvertCXArrayT_ (const T* a, const int len, char to_type,
 {
   switch (to_type) {
   case 'F': OCCVTARRT(complex_8); break;
-  case 'D': OCCVTARRT(complex_8); break;
+  case 'D': OCCVTARRT(complex_16); break;
   default: throw runtime_error("Cannot convert array of complex to anything but another complex: Use mag2? mag? re? im?"); break;
   }
 }
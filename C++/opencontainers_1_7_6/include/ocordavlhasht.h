@@ -232,10 +232,11 @@ class OrdAVLHashT {
 
     // ///// Methods
   
-    // Constructor 
+    // Constructor: with no allocator, uses the current allocator
+    // (see AllocatorScope in ocstreamingpool.h)
     OrdAVLHashT (Allocator* a=0) :
       entries_(0),
-      allocator_(a)
+      allocator_(a ? a : CurrentAllocator())
     {
       helpConstruct_();
       if (sizeof(root_->right_) != sizeof(AVLP))
@@ -245,7 +246,7 @@ class OrdAVLHashT {
     // Copy Constructor
     OrdAVLHashT (const OrdAVLHashT<K,V,CHUNKSIZE>& rhs, Allocator* a=0) :
       entries_(0),
-      allocator_(a)
+      allocator_(a ? a : CurrentAllocator())
     { 
       helpConstruct_();
       copyTable_(rhs);
@@ -394,6 +395,25 @@ class OrdAVLHashT {
 	(void)notInTableInsert_(node, key, hashkey, value, found_where);
       }
     }
+
+#if defined(OC_MOVE_SEMANTICS)
+    // Like insertKeyAndValue, but the key and value are moved into
+    // the table rather than copied (if the key is already there, only
+    // the value is moved).  Returns a reference to the value in the
+    // table.
+    V& emplace (K&& key, V&& value)
+    {
+      int_u4 hashkey = HashFunction(key);
+      Found_e found_where; N* node = lookup_(key, hashkey, found_where);
+      if (found_where!=FOUND) {
+	node = notInTableInsert_(node, K(), hashkey, V(), found_where);
+	node->key = std::move(key);
+	CacheHash_(node->key, hashkey);
+      }
+      node->value = std::move(value);
+      return node->value;
+    }
+#endif
     
     // Returns true if the table has no items in it, false otherwise.
     bool isEmpty () const { return entries_==0; }
@@ -443,6 +463,35 @@ class OrdAVLHashT {
       }
     }
 
+    // Heterogeneous lookup: find the entry whose key compares equal
+    // (via key==probe) to "probe", which can be any type that is
+    // cheaper to build than a K (like a StrView for a Val key).  The
+    // hashkey given MUST be the HashFunction of the equivalent K.
+    // Returns a pointer to the value, or 0 if the key is not there.
+    template <class PROBE>
+    V* lookup (const PROBE& probe, int_u4 hashkey) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      return (found_where==FOUND) ? &node->value : 0;
+    }
+
+    // Like contains and find above, but with a probe (see lookup)
+    template <class PROBE>
+    bool contains (const PROBE& probe, int_u4 hashkey) const
+    { return lookup(probe, hashkey)!=0; }
+
+    template <class PROBE>
+    bool find (const PROBE& probe, int_u4 hashkey, K& return_key) const
+    {
+      Found_e found_where; N* node = lookup_(probe, hashkey, found_where);
+      if (found_where==FOUND) {
+	return_key = node->key;
+	return true;
+      } else {
+	return false;
+      }
+    }
+
 
     // See if data structure internally consistent.  Very expensive.
     bool consistent ()
@@ -508,6 +557,7 @@ class OrdAVLHashT {
 	// inserting is done.
 	N* current = notInTableInsert_(node, K(), hashkey, V(), found_where);
 	OC_NAMESPACED::swap(key_to_swap, current->key);
+	CacheHash_(current->key, hashkey);
         OC_NAMESPACED::swap(value_to_swap, current->value);
 	return false;
       }
@@ -546,8 +596,11 @@ class OrdAVLHashT {
     // would be on the left or the right, or in a bucket list.
     N* lookup_ (const K& key, Found_e& found_where) const
     { return lookup_(key, HashFunction(key), found_where); }
-    
-    N* lookup_ (const K& key, int_u4 hashkey, Found_e& found_where) const
+
+    // The key here can be a K or any probe that compares to a K with
+    // == (see lookup): the hashkey is always the hash of the K.
+    template <class PROBE>
+    N* lookup_ (const PROBE& key, int_u4 hashkey, Found_e& found_where) const
     {
       // It's just a binary search tree: look left is less than, right
       // otherwise.  IF WE DON'T FIND it, then we return the parent
@@ -948,8 +1001,10 @@ class OrdAVLHashT {
       // specializations for constructing a node in shared memory, we
       // encapsulate this in a function which will be specialized for
       // those things that need allocators.
-      return AVLCreateNode(node,left,right,parent,key,keyhash,value,allocator_);
+      N* result = AVLCreateNode(node,left,right,parent,key,keyhash,value,allocator_);
       // return new (node) N(left,right,parent,key,keyhash,value,allocator_); 
+      CacheHash_(result->key, keyhash);
+      return result;
     }    
     
     // Return node
@@ -0,0 +1,279 @@
+#ifndef OCPARALLELSORT_H_
+
+// Sorting big arrays with multiple threads: the array is cut into one
+// piece per thread, each thread sorts its piece (with OCQuickSort or
+// OCRadixSort from ocsort.h), then the sorted pieces are merged
+// together, pairwise, until there is only one.  Every merge is split
+// across all the threads too (each thread does an equal share of the
+// output), so even the last merge is done in parallel.
+//
+// The threads are managed by a WorkerCoordinatorT, so they are
+// created once and reused: if you sort a lot of arrays, keep a
+// ParallelSortT around.
+//
+//   ParallelSortT<real_8> sorter(4);  // 4 threads
+//   sorter.sort(a);                   // a is an Array<real_8>
+//   sorter.radixSort(a);              // integers or reals only
+//
+//   OCParallelSort(a, 4);             // create threads, sort, done
+//
+// Like OCQuickSort, the sort is not stable.  It uses an extra n
+// elements of scratch space for the merges.
+
+// ///////////////////////////////////////////// Include Files
+
+#include "ocsort.h"
+#include "ocworkercoordinatort.h"
+
+OC_BEGIN_NAMESPACE
+
+// ///////////////////////////////////////////// Helpers
+
+// Merge a[0..m) and b[0..n) into out: on ties, the element from a
+// goes first.
+template <class T>
+inline void OCMerge_ (const T* a, int m, const T* b, int n, T* out)
+{
+  int ii=0, jj=0, kk=0;
+  while (ii<m && jj<n) {
+    if (b[jj] < a[ii]) {
+      out[kk++] = b[jj++];
+    } else {
+      out[kk++] = a[ii++];
+    }
+  }
+  while (ii<m) out[kk++] = a[ii++];
+  while (jj<n) out[kk++] = b[jj++];
+}
+
+// For merging a[0..m) and b[0..n): how many of the first d elements
+// of the output come from a.  This lets us start a merge in the
+// middle of the output (so threads can each do one piece).
+template <class T>
+inline int OCMergeSplit_ (const T* a, int m, const T* b, int n, int d)
+{
+  int lo = d-n<0 ? 0 : d-n;
+  int hi = d<m ? d : m;
+  while (lo<hi) {
+    int ii = (lo+hi)/2;
+    if (b[d-ii-1] < a[ii]) {
+      hi = ii;
+    } else {
+      lo = ii+1;
+    }
+  }
+  return lo;
+}
+
+// Only instantiate OCRadixSort for the types it works on
+template <class T, int RADIXABLE=OCRadixKey_<T>::radixable>
+struct OCRadixSortIfPossible_ {
+  static void sort (T*, int, int)
+  { throw logic_error("OCRadixSort only works on integers and reals"); }
+};
+template <class T>
+struct OCRadixSortIfPossible_<T, 1> {
+  static void sort (T* c, int start, int length)
+  { OCRadixSort(c, start, length); }
+};
+
+// One piece of work: either sort [start, start+length) of from (in
+// place), or merge the two sorted runs of from starting at start
+// (lengths length and length2) into to, but only output elements
+// [first, last) of the merge.
+template <class T>
+struct OCSortTask_ {
+  T*  from;
+  T*  to;
+  int start, length, length2;
+  int first, last;
+  bool merge;
+};
+
+
+// ///////////////////////////////////////////// ParallelSortWorker_
+
+// One of the sorting threads: it does whatever tasks it is given.
+template <class T>
+class ParallelSortWorker_ : public SynchronizedWorker {
+  public:
+
+    ParallelSortWorker_ (int worker_number) :
+      SynchronizedWorker("ParallelSortWorker"+Stringize(worker_number)),
+      radix_(false)
+    { }
+
+    // Manager calls directly to set up worker before each round
+    void clearWork () { tasks_.clear(); }
+    void assignWork (const OCSortTask_<T>& task, bool radix)
+    {
+      tasks_.append(task);
+      radix_ = radix;
+    }
+
+  protected:
+
+    // Called for you by framework when work is ready
+    virtual void dispatchWork_ ()
+    {
+      for (size_t ii=0; ii<tasks_.length(); ii++) {
+	const OCSortTask_<T>& t = tasks_[ii];
+	if (t.merge) {
+	  mergePiece_(t);
+	} else if (radix_) {
+	  OCRadixSortIfPossible_<T>::sort(t.from, t.start, t.length);
+	} else {
+	  OCQuickSort(t.from, t.start, t.length);
+	}
+      }
+    }
+
+    // Output elements [first, last) of the merge of two runs
+    void mergePiece_ (const OCSortTask_<T>& t)
+    {
+      const T* a = t.from + t.start;
+      const T* b = a + t.length;
+      const int m = t.length, n = t.length2;
+      const int a_first = OCMergeSplit_(a, m, b, n, t.first);
+      const int a_last  = OCMergeSplit_(a, m, b, n, t.last);
+      OCMerge_(a+a_first, a_last-a_first,
+	       b+(t.first-a_first), (t.last-a_last)-(t.first-a_first),
+	       t.to + t.start + t.first);
+    }
+
+    Array<OCSortTask_<T> > tasks_;  // What to do this round
+    bool radix_;                    // Sort pieces with OCRadixSort?
+
+}; // ParallelSortWorker_
+
+
+// ///////////////////////////////////////////// The ParallelSortT Class
+
+template <class T>
+class ParallelSortT : public WorkerCoordinatorT<ParallelSortWorker_<T> > {
+
+  public:
+
+    // Create the given number of sorting threads: they wait around
+    // until there is something to sort.
+    ParallelSortT (int threads)
+    {
+      if (threads<1) throw logic_error("Have to have at least one thread");
+      for (int ii=0; ii<threads; ii++) {
+	this->addNewWorker(new ParallelSortWorker_<T>(ii));
+      }
+    }
+
+    // Sort a portion of an array inplace: If you want to sort the
+    // entire array, start=0, len=length_of_array. The pieces are
+    // sorted with OCQuickSort, so T just needs <, >, == and copying.
+    void sort (T* c, int start, int length) { sort_(c, start, length, false); }
+    void sort (Array<T>& a) { sort_(a.data(), 0, a.length(), false); }
+
+    // Same, but the pieces are sorted with OCRadixSort, so T has to
+    // be one of the integer or real types.
+    void radixSort (T* c, int start, int length) { sort_(c, start, length, true); }
+    void radixSort (Array<T>& a) { sort_(a.data(), 0, a.length(), true); }
+
+  protected:
+
+    OC_INLINE void sort_ (T* c, int start, int length, bool radix);
+
+}; // ParallelSortT
+
+
+template <class T>
+OC_INLINE void ParallelSortT<T>::sort_ (T* c, int start, int length,
+					bool radix)
+{
+  const int threads = this->workers();
+  c += start;
+  if (radix && !OCRadixKey_<T>::radixable) {
+    OCRadixSortIfPossible_<T>::sort(c, 0, length);  // throws
+  }
+
+  // Not worth the threads: just sort it
+  if (threads==1 || length < threads*OC_QSTUNE) {
+    if (radix) {
+      OCRadixSortIfPossible_<T>::sort(c, 0, length);
+    } else {
+      OCQuickSort(c, 0, length);
+    }
+    return;
+  }
+
+  // Each thread sorts its own piece
+  Array<int> runs(threads+1);  // where each sorted run starts
+  for (int ii=0; ii<=threads; ii++) {
+    runs.append(int(int_8(length)*ii/threads));
+  }
+  OCSortTask_<T> task = { c, c, 0, 0, 0, 0, 0, false };
+  for (int ii=0; ii<threads; ii++) {
+    this->worker(ii).clearWork();
+    task.start = runs[ii];
+    task.length = runs[ii+1]-runs[ii];
+    this->worker(ii).assignWork(task, radix);
+  }
+  this->startAndSynchronizeAllWorkers();
+
+  // Merge pairs of runs back and forth between c and the scratch
+  // until there is one run: each merge is split into enough pieces
+  // to keep all the threads busy.
+  Array<T> scratch(length);
+  scratch.fill(T(), length);  // constructed, so it can be assigned into
+  T* from = c;
+  T* to = scratch.data();
+  while (runs.length()>2) {
+    const int run_count = runs.length()-1;
+    const int pairs = run_count/2;
+    const int pieces = threads/pairs<1 ? 1 : threads/pairs;
+    for (int ii=0; ii<threads; ii++) this->worker(ii).clearWork();
+
+    Array<int> merged(pairs+2);
+    int w = 0;
+    task.from = from; task.to = to; task.merge = true;
+    for (int pp=0; pp<run_count; pp+=2) {
+      merged.append(runs[pp]);
+      task.start = runs[pp];
+      task.length = runs[pp+1]-runs[pp];
+      task.length2 = pp+1<run_count ? runs[pp+2]-runs[pp+1] : 0;
+      const int total = task.length + task.length2;
+      for (int kk=0; kk<pieces; kk++) {
+	task.first = int(int_8(total)*kk/pieces);
+	task.last  = int(int_8(total)*(kk+1)/pieces);
+	this->worker(w).assignWork(task, radix);
+	w = (w+1) % threads;
+      }
+    }
+    merged.append(length);
+    this->startAndSynchronizeAllWorkers();
+
+    runs.swap(merged);
+    T* temp = from; from = to; to = temp;
+  }
+  if (from!=c) {
+    for (int ii=0; ii<length; ii++) c[ii] = from[ii];
+  }
+}
+
+
+// Sort a whole Array with the given number of threads (which are
+// created and destroyed just for this sort).
+template <class T>
+inline void OCParallelSort (Array<T>& a, int threads)
+{
+  ParallelSortT<T> sorter(threads);
+  sorter.sort(a);
+}
+
+template <class T>
+inline void OCParallelRadixSort (Array<T>& a, int threads)
+{
+  ParallelSortT<T> sorter(threads);
+  sorter.radixSort(a);
+}
+
+OC_END_NAMESPACE
+
+#define OCPARALLELSORT_H_
+#endif // OCPARALLELSORT_H_
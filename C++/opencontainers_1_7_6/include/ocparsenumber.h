@@ -0,0 +1,181 @@
+#ifndef OCPARSENUMBER_H_
+
+// NOTE: Like ocvalreader.h, this needs ocval.h included first.
+
+// Turn a number literal (as the ValReader sees it: 123, -17, 1.5,
+// .25, 6.02e23, ...) straight from a buffer of chars into a Val,
+// without building any temporary strings or streams.  Like
+// from_chars, it works on [start, end) and returns where the number
+// stopped:
+//
+//   Val v;
+//   const char* s = "  3.25, 17";
+//   const char* after = ParseNumber(s+2, s+10, v);  // v is 3.25
+//
+// Integers become int_4, int_8 or int_u8 (the smallest that holds
+// them, chosen just like the ValReader always has), anything with a
+// . or exponent becomes a real_8, correctly rounded.  Anything more
+// unusual (nan, inf, long ints with an L, ints too big for an int_u8,
+// syntax errors) returns 0 and leaves the Val alone, so the caller
+// can fall back to the slower, more thorough parse.
+
+#include <stdlib.h>   // strtod
+
+OC_BEGIN_NAMESPACE
+
+// Above this many characters, don't bother copying for strtod
+#ifndef OC_PARSENUMBER_MAXCHARS
+# define OC_PARSENUMBER_MAXCHARS 64
+#endif
+
+inline bool OCIsDigit_ (char c) { return c>='0' && c<='9'; }
+
+// mantissa * 10^exp10, correctly rounded: the common cases are exact
+// in doubles (Clinger's fast path), everything else goes through
+// strtod on a copy of the (unsigned) literal [start, end).  Returns
+// false if the result over or underflowed.
+inline bool OCDecimalToReal_ (int_u8 mantissa, bool truncated, int exp10,
+			      const char* start, const char* end, real_8& r)
+{
+  static const real_8 powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const int_u8 exact = int_u8(1)<<53;  // every int up to here is a real_8
+  if (!truncated && mantissa<=exact) {
+    if (exp10>=0 && exp10<=22) {
+      r = real_8(mantissa) * powers[exp10];
+      return true;
+    } else if (exp10<0 && exp10>=-22) {
+      r = real_8(mantissa) / powers[-exp10];
+      return true;
+    } else if (exp10>22 && exp10<=22+15) {
+      // Move some of the power into the mantissa, if it stays exact
+      for (; exp10>22 && mantissa<=exact/10; exp10--) mantissa *= 10;
+      if (exp10==22) {
+	r = real_8(mantissa) * powers[22];
+	return true;
+      }
+    }
+  }
+
+  const int len = int(end-start);
+  if (len>=OC_PARSENUMBER_MAXCHARS) return false;
+  char buff[OC_PARSENUMBER_MAXCHARS];
+  memcpy(buff, start, len);
+  buff[len] = '\0';
+  char* stop = 0;
+  r = strtod(buff, &stop);
+  if (stop!=buff+len) return false;  // locale with a different . ?
+  if (r-r!=0) return false;          // inf
+  if (r==0 && mantissa!=0) return false;
+  return true;
+}
+
+// Parse the number literal starting at start (no leading white space)
+// into v: returns the end of the number, or 0 if this is not a number
+// ParseNumber handles (see above).
+inline const char* ParseNumber (const char* start, const char* end, Val& v)
+{
+  const char* p = start;
+  bool negative = false;
+  if (p<end && (*p=='-' || *p=='+')) {
+    negative = (*p=='-');
+    p++;
+  }
+
+  // Only the first 19 significant digits fit in an int_u8: the rest
+  // just move the exponent
+  int_u8 mantissa = 0;
+  int digits = 0;
+  bool truncated = false;
+  int exp10 = 0;
+
+  const char* int_start = p;
+  for (; p<end && OCIsDigit_(*p); p++) {
+    if (digits<19) {
+      mantissa = mantissa*10 + (*p-'0');
+      if (mantissa) digits++;
+    } else {
+      if (*p!='0') truncated = true;
+      exp10++;
+    }
+  }
+  const int int_digits = int(p-int_start);
+
+  bool is_real = false;
+  int frac_digits = 0;
+  if (p<end && *p=='.') {
+    is_real = true;
+    const char* frac_start = ++p;
+    for (; p<end && OCIsDigit_(*p); p++) {
+      if (digits<19) {
+	mantissa = mantissa*10 + (*p-'0');
+	if (mantissa) digits++;
+	exp10--;
+      } else if (*p!='0') {
+	truncated = true;
+      }
+    }
+    frac_digits = int(p-frac_start);
+  }
+  if (int_digits+frac_digits==0) return 0;
+
+  if (p<end && (*p=='e' || *p=='E')) {
+    is_real = true;
+    p++;
+    bool negative_exp = false;
+    if (p<end && (*p=='-' || *p=='+')) {
+      negative_exp = (*p=='-');
+      p++;
+    }
+    const char* exp_start = p;
+    int e = 0;
+    for (; p<end && OCIsDigit_(*p); p++) {
+      if (e<100000) e = e*10 + (*p-'0');
+    }
+    if (p==exp_start) return 0;
+    exp10 += negative_exp ? -e : e;
+  }
+
+  if (is_real) {
+    real_8 r;
+    if (!OCDecimalToReal_(mantissa, truncated, exp10, int_start, p, r)) return 0;
+    v = negative ? -r : r;
+    return p;
+  }
+
+  // Integers: leading zeros and L suffixes are left to the ValReader
+  if (int_digits>1 && *int_start=='0') return 0;
+  if (p<end && (*p=='l' || *p=='L')) return 0;
+  if (int_digits>20) return 0;
+  if (int_digits==20) {
+    const int last = p[-1]-'0';
+    if (mantissa > (~int_u8(0)-last)/10) return 0;
+    mantissa = mantissa*10 + last;
+  }
+
+  if (negative) {
+    if (mantissa<=int_u8(2147483648ULL)) {
+      v = int_4(-int_8(mantissa));
+    } else if (mantissa<=int_u8(9223372036854775808ULL)) {
+      v = int_8(0-mantissa);
+    } else {
+      return 0;
+    }
+  } else {
+    if (mantissa<=int_u8(2147483647)) {
+      v = int_4(mantissa);
+    } else if (mantissa<=int_u8(9223372036854775807ULL)) {
+      v = int_8(mantissa);
+    } else {
+      v = mantissa;
+    }
+  }
+  return p;
+}
+
+OC_END_NAMESPACE
+
+#define OCPARSENUMBER_H_
+#endif // OCPARSENUMBER_H_
@@ -17,6 +17,8 @@
 // #define OC_NAMESPACE_FORCE_NAMESPACE
 // #define OC_SERIALIZE_COMPAT true
 // #define OC_BIGINT_OUTCONVERT_AS true
+// #define OC_NO_MOVE_SEMANTICS
+// #define OC_THREAD_LOCAL
 
 // They are all turned off by default, and your code can include it
 // directly and turn on the portability features you need with
@@ -291,6 +293,15 @@ OC_END_NAMESPACE
 
 OC_BEGIN_NAMESPACE
 
+// DECISION: Does the compiler have a 128-bit unsigned int?  (Most
+// 64-bit gccs and clangs do.)  If so, the BigUInt/BigInt (int_un and
+// int_n) use 64-bit digits, doing their math in int_u16.  Define
+// OC_NO_INT128 to go back to 32-bit digits.
+#if defined(__SIZEOF_INT128__) && !defined(OC_NO_INT128)
+#  define OC_INT128
+  __extension__ typedef unsigned __int128 int_u16;
+#endif
+
 // DECISION: Are size_t distinct from both int_u4 and int_u8?  On
 // X-Midas 64-bit platforms, size_t and int_u8 are NOT typedefed the
 // same, so code like 'size_t a = 1; Val v = a;' would cause compiler
@@ -541,6 +552,33 @@ OC_END_NAMESPACE
 // DECISION: Do we support BigUInt.operator int_u8()? or AS
 #define OC_BIGINT_OUTCONVERT_AS true
 
+// DECISION: Do we use C++11 move semantics?  If the compiler has
+// rvalue references, then Val, Tab, OTab, Tup, Arr, Array and
+// OCString get move constructors and move assignments (so returning
+// or assigning a temporary container doesn't copy it), and Tab, OTab
+// and Arr get emplace-style insertion.  Older compilers (or anyone
+// who wants the old behavior) can -D OC_NO_MOVE_SEMANTICS.
+#if !defined(OC_NO_MOVE_SEMANTICS) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600))
+# define OC_MOVE_SEMANTICS
+# include <utility>  // for std::move, std::forward
+#endif
+
+// DECISION: How do we declare thread-local variables?  (The current
+// allocator, see AllocatorScope in ocstreamingpool.h, is one per
+// thread.)  C++11 has thread_local, older g++ has __thread, older
+// Microsoft compilers have __declspec(thread).  A compiler with none
+// of these can -D OC_THREAD_LOCAL= (and then only use AllocatorScopes
+// from one thread).
+#if !defined(OC_THREAD_LOCAL)
+# if __cplusplus >= 201103L
+#  define OC_THREAD_LOCAL thread_local
+# elif defined(_MSC_VER)
+#  define OC_THREAD_LOCAL __declspec(thread)
+# else
+#  define OC_THREAD_LOCAL __thread
+# endif
+#endif
+
 
 
 // DECISION: Do we use STL or OC strings? Note we have to do this
@@ -607,6 +645,12 @@ OC_BEGIN_NAMESPACE
 # define OC_FLT_DIGITS 7
 #endif
 
+OC_END_NAMESPACE
+
+#include "ocstringizereal.h"   // StringizeReal: the fast way to print reals
+
+OC_BEGIN_NAMESPACE
+
 // A very standard way to Stringize items
 template <class T>
 inline string GenericStringize (const T& v) 
@@ -640,128 +684,22 @@ inline string Stringize<string> (const string& s)
 { return s; }
 
 // Stringize of floats and doubles should look like Python more, with
-// .0 added to distinguish it from an int.  This isn't super fast
-// right now: it needs to be cleaned up a little.
+// .0 added to distinguish it from an int.  These are just wrappers
+// for StringizeReal (ocstringizereal.h), which prints the shortest
+// digits that read back as the same number: use it directly if you
+// don't need a string.
 template <>
 inline string Stringize<real_4> (const real_4& orig)
 {
-#if defined(OC_NEW_STYLE_INCLUDES)
-  ostringstream os;
-
-  os.precision(OC_FLT_DIGITS);
-  if (orig<0) {
-    int_8 con=int_8(orig);
-    real_4 convert_back = con;
-    if (convert_back==orig) {
-      os << con << +".0";
-    } else {
-      os << orig;
-    }
-  } else {
-    int_u8 con=int_u8(orig);
-    real_4 convert_back = con;
-    if (convert_back==orig) {
-      os << con << ".0";
-    } else {
-      os << orig;
-    }
-  }
-
-#if defined(OC_USE_OC_STRING)
-  std::string s = os.str();
-  string ret_val(s.data(), s.length());
-#else
-  string ret_val = os.str();
-#endif
-  return ret_val;
-#else
-  ostrstream os;
-
-  os.precision(OC_FLT_DIGITS);
-  if (orig<0) {
-    int_8 con=int_8(orig);
-    real_4 convert_back = con;
-    if (convert_back==orig) {
-      os << con << +".0";
-    } else {
-      os << orig;
-    }
-  } else {
-    int_u8 con=int_u8(orig);
-    real_4 convert_back = con;
-    if (convert_back==orig) {
-      os << con << ".0";
-    } else {
-      os << orig;
-    }
-  }
-  // os << v << ends; // operator<< will do precision correctly
-  os << ends;
-  string ret_val = string(os.str());
-  delete [] os.str(); // Clean up ostrstream's mess
-  return ret_val;
-#endif
+  char buf[OC_REAL_CHARS];
+  return string(buf, StringizeReal(orig, buf));
 }
 
 template <>
 inline string Stringize<real_8> (const real_8& orig)
 {
-#if defined(OC_NEW_STYLE_INCLUDES)
-  ostringstream os;
-
-  os.precision(OC_DBL_DIGITS);
-  if (orig<0) {
-    int_8 con=int_8(orig);
-    real_8 convert_back = con;
-    if (convert_back==orig) {
-      os << con << +".0";
-    } else {
-      os << orig;
-    }
-  } else {
-    int_u8 con=int_u8(orig);
-    real_8 convert_back = con;
-    if (convert_back==orig) {
-      os << con << ".0";
-    } else {
-      os << orig;
-    }
-  }
-#if defined(OC_USE_OC_STRING)
-  std::string s = os.str();
-  string ret_val(s.data(), s.length());
-#else
-  string ret_val = os.str();
-#endif
-
-  return ret_val;
-#else
-  ostrstream os;
-
-  os.precision(OC_DBL_DIGITS);
-  if (orig<0) {
-    int_8 con=int_8(orig);
-    real_8 convert_back = con;
-    if (convert_back==orig) {
-      os << con << +".0";
-    } else {
-      return os << orig;
-    }
-  } else {
-    int_u8 con=int_u8(orig);
-    real_8 convert_back = con;
-    if (convert_back==orig) {
-      os << con << ".0";
-    } else {
-      os << orig;
-    }
-  }
-  // os << v << ends; // operator<< will do precision correctly
-  os << ends;
-  string ret_val = string(os.str());
-  delete [] os.str(); // Clean up ostrstream's mess
-  return ret_val;
-#endif
+  char buf[OC_REAL_CHARS];
+  return string(buf, StringizeReal(orig, buf));
 }
 
 // Very optimized way to stringize an integer.  Note that this will
@@ -35,6 +35,7 @@ OC_INST_PROXYCONSARR(Str)
 
 #if defined(TEMPLATE_OUTCONVERSION_SUPPORTED)
 #define OC_INST_ARRAYOUTCONV(T) \
+ template Proxy::operator Array<T>& (); \
  template Proxy::operator Array<T>& () const; 
 OC_INST_ARRAYOUTCONV(int_1)
 OC_INST_ARRAYOUTCONV(int_u1)
@@ -113,6 +114,28 @@ OC_INST_SHARED(OTab)
 OC_INST_SHARED(Tup)
 OC_INST_SHARED(Str)
 
+#define OC_INST_COPYONWRITE(T) \
+ template Proxy CopyOnWrite (Array<T>*);
+OC_INST_COPYONWRITE(int_1)
+OC_INST_COPYONWRITE(int_u1)
+OC_INST_COPYONWRITE(int_2)
+OC_INST_COPYONWRITE(int_u2)
+OC_INST_COPYONWRITE(int_4)
+OC_INST_COPYONWRITE(int_u4)
+OC_INST_COPYONWRITE(int_8)
+OC_INST_COPYONWRITE(int_u8)
+OC_INST_COPYONWRITE(ALLOW_SIZE_T)
+OC_INST_COPYONWRITE(ALLOW_LONG)
+OC_INST_COPYONWRITE(ALLOW_UNSIGNED_LONG)
+OC_INST_COPYONWRITE(ALLOW_LONG_LONG)
+OC_INST_COPYONWRITE(ALLOW_UNSIGNED_LONG_LONG)
+OC_INST_COPYONWRITE(real_4)
+OC_INST_COPYONWRITE(real_8)
+OC_INST_COPYONWRITE(complex_8)
+OC_INST_COPYONWRITE(complex_16)
+OC_INST_COPYONWRITE(bool)
+OC_INST_COPYONWRITE(Val)
+
 OC_END_NAMESPACE
 
 #endif
@@ -126,11 +149,13 @@ OC_INLINE RefCount_<T>::~RefCount_<T> ()
   if (adopted_) {
     T* data = this->data_;
     Allocator* a=allocator_;
-    if (a) {
+    if (inPlace_) {
+      data->~T();  // memory goes away with this
+    } else if (a && a->owns((char*)data)) {
       data->~T();
       a->deallocate((char*)data); // can't depend on allocator being that after destruction, so had to copy into local var
     } else {
-      delete data;
+      delete data;  // from new, even if its insides use an allocator
     }
   }
 }
@@ -398,22 +423,85 @@ OC_INLINE void* Proxy::increment_ () const
   }
 }
 
+// Helper function for Proxy: give a copy-on-write proxy its own
+// (full) copy of the body, from the same allocator, and let go of the
+// shared one.  Copy-on-write proxies are never locked.
+template <class T>
+OC_INLINE void* Detach (T*, void* handle)
+{
+  RefCount_<T>* h = (RefCount_<T>*)handle;
+  Allocator* a = h->allocator_;
+  void* mem;
+  if (a) {
+    mem = a->allocate(sizeof(T));
+  } else {
+    mem = ::operator new(sizeof(T));
+  }
+  T* copy = new (mem) T(*h->data(), a);
+  RefCount_<T>* new_h = (RefCount_<T>*)helpConstruct_(copy,true,false,false,a);
+  new_h->copyOnWrite_ = true;
+  h->dec();
+  return new_h;
+}
+#define DETACH(T) { T* i=0; new_handle = Detach(i, handle_); } break;
+#define DETACHARR(T) { Array<T>* i=0; new_handle = Detach(i, handle_); } break;
+
+OC_INLINE void* Proxy::detach_ () const
+{
+  if (lock) throw logic_error("Copy-on-write proxies can't be locked");
+  void* new_handle = 0;
+  switch (tag) {
+  case 't':  DETACH(Tab); 
+  case 'o':  DETACH(OTab);
+  case 'u':  DETACH(Tup); 
+  case 'n':  
+    switch(subtype) {
+    case 's': DETACHARR(int_1);  
+    case 'S': DETACHARR(int_u1); 
+    case 'i': DETACHARR(int_2);  
+    case 'I': DETACHARR(int_u2); 
+    case 'l': DETACHARR(int_4);  
+    case 'L': DETACHARR(int_u4); 
+    case 'x': DETACHARR(int_8);  
+    case 'X': DETACHARR(int_u8); 
+    case 'b': DETACHARR(bool);   
+    case 'f': DETACHARR(real_4); 
+    case 'd': DETACHARR(real_8); 
+    case 'F': DETACHARR(complex_8); 
+    case 'D': DETACHARR(complex_16); 
+    case 'n': throw logic_error("Arrays of Arrays not currently supported");
+    case 'Z': DETACH(Arr);    
+    default: throw logic_error("detach");   
+    }
+    break;
+  default: throw logic_error("detach");
+  }
+  // The "logical" value of this proxy hasn't changed, only which body
+  // it holds: so this is allowed on a const Proxy
+  Proxy* self = const_cast<Proxy*>(this);
+  self->adopt   = true;
+  self->handle_ = new_handle;
+  return new_handle;
+}
+
 #if defined(TEMPLATE_OUTCONVERSION_SUPPORTED)
 template <class T> 
-OC_INLINE Proxy::operator Array<T>& () const 
+OC_INLINE Proxy::operator Array<T>& () 
 {
-  if (tag != 'n' || subtype != TagFor((T*)0)) {
-    NoConversion_(tag, "Proxy", "Array<>");
-  }
-  RefCount_<Array<T> >* pp = (RefCount_<Array<T> >*)handle_;
-  return *pp->data();
+  return *(Array<T>*)body_(tag=='n' && subtype==TagFor((T*)0), "Array<>", true);
+}
+template <class T> 
+OC_INLINE Proxy::operator Array<T>& () const
+{
+  return *(Array<T>*)body_(tag=='n' && subtype==TagFor((T*)0), "Array<>", false);
 }
 #else 
   // Same code as above, but squished to fit in a Macro
-#define OC_PROXY2ARR_CODE(T) OC_INLINE Proxy::operator Array<T>& () const {\
-if (tag!='n' || subtype != TagFor((T*)0)) { \
-  NoConversion_(tag, "Proxy", "Array<>"); } \
- RefCount_<Array<T> >*pp=(RefCount_<Array<T> >*)handle_;return *pp->data(); }
+#define OC_PROXY2ARR_CODE(T) \
+OC_INLINE Proxy::operator Array<T>& () { \
+ return *(Array<T>*)body_(tag=='n' && subtype==TagFor((T*)0), "Array<>", true); } \
+OC_INLINE Proxy::operator Array<T>& () const { \
+ return *(Array<T>*)body_(tag=='n' && subtype==TagFor((T*)0), "Array<>", false); }
 
 
     OC_PROXY2ARR_CODE(int_1)
@@ -441,8 +529,10 @@ if (tag!='n' || subtype != TagFor((T*)0)) { \
     OC_PROXY2ARR_CODE(Val)
 #endif
 
-#define PROXYOS(T) { T& t = p; os << t; }
-#define PROXYOSARR(T) { Array<T>& a = p; PrintArray(os, a); }
+// These only read, so they go straight to the data (a copy-on-write
+// Proxy shouldn't detach just to be printed or compared)
+#define PROXYOS(T) { T& t = *(T*)p.data_(); os << t; }
+#define PROXYOSARR(T) { Array<T>& a = *(Array<T>*)p.data_(); PrintArray(os, a); }
 OC_INLINE ostream& operator<< (ostream& os, const Proxy& p)
 {
   // TODO:  A Proxy will either print as a string or special
@@ -483,8 +573,8 @@ OC_INLINE ostream& operator<< (ostream& os, const Proxy& p)
   return os;
 }
 
-#define PROXYEQ(T) { T& t1 = p1; T& t2 = p2; return t1==t2; }
-#define PROXYAREQ(T) { Array<T>&a1 = p1; Array<T>& a2 = p2; return a1==a2; }
+#define PROXYEQ(T) { T& t1 = *(T*)p1.data_(); T& t2 = *(T*)p2.data_(); return t1==t2; }
+#define PROXYAREQ(T) { Array<T>&a1 = *(Array<T>*)p1.data_(); Array<T>& a2 = *(Array<T>*)p2.data_(); return a1==a2; }
 OC_INLINE bool operator== (const Proxy& p1, const Proxy& p2) 
 {
   if (is(p1, p2)) return true;
@@ -531,8 +621,8 @@ OC_INLINE bool operator== (const Proxy& p1, const Proxy& p2)
 }
 
 
-#define PROXYLT(T) { T& t1=p1; T& t2=p2; return t1<t2; } 
-#define PROXYARLT(T) { Array<T>& t1=p1; Array<T>& t2=p2; return t1<t2; } 
+#define PROXYLT(T) { T& t1=*(T*)p1.data_(); T& t2=*(T*)p2.data_(); return t1<t2; } 
+#define PROXYARLT(T) { Array<T>& t1=*(Array<T>*)p1.data_(); Array<T>& t2=*(Array<T>*)p2.data_(); return t1<t2; } 
 OC_INLINE bool operator< (const Proxy& p1, const Proxy& p2) 
 {
   if (is(p1, p2)) return false;   // Same handle: me<me is false!
@@ -758,6 +848,104 @@ OC_INLINE Proxy Locked (Array<T>* adopted_array)
   return Proxy(adopted_array, adopting, requires_lock,shared_across_processes);
 }
 
+OC_INLINE Proxy CopyOnWrite (Tab* adopted_table)
+{
+  Proxy p(adopted_table, true, false, false);
+  p.copyOnWrite(true);
+  return p;
+}
+
+OC_INLINE Proxy CopyOnWrite (OTab* adopted_table)
+{
+  Proxy p(adopted_table, true, false, false);
+  p.copyOnWrite(true);
+  return p;
+}
+
+OC_INLINE Proxy CopyOnWrite (Tup* adopted_table)
+{
+  Proxy p(adopted_table, true, false, false);
+  p.copyOnWrite(true);
+  return p;
+}
+
+OC_INLINE Proxy CopyOnWrite (Arr* adopted_arr)
+{
+  Proxy p(adopted_arr, true, false, false);
+  p.copyOnWrite(true);
+  return p;
+}
+
+template <class T>
+OC_INLINE Proxy CopyOnWrite (Array<T>* adopted_array)
+{
+  Proxy p(adopted_array, true, false, false);
+  p.copyOnWrite(true);
+  return p;
+}
+
+
+// Round so everything in an inline block is aligned
+inline size_t InlineOffset_ (size_t bytes) { return (bytes+15) & ~size_t(15); }
+
+// Helper for InlineArr and InlineTup: one block (from the current
+// allocator, if there is one), laid out as the RefCount_, then the
+// T, then room for n elements.  The caller constructs the T (without
+// any memory of its own) in place.
+template <class T>
+inline char* InlineBlock_ (int_u4 n, Allocator* a)
+{
+  const size_t block = InlineOffset_(sizeof(RefCount_<T>)) + 
+                       InlineOffset_(sizeof(T)) + n*sizeof(Val);
+  return a ? a->allocate(int(block)) : (char*)::operator new(block);
+}
+
+template <class T>
+inline Val* InlineElements_ (T* thing, char* mem, Allocator* a)
+{
+  RefCount_<T>* rc = new (mem) RefCount_<T>(thing, true, a);
+  rc->inPlace_ = true;
+  return (Val*)(mem + InlineOffset_(sizeof(RefCount_<T>)) + 
+		InlineOffset_(sizeof(T)));
+}
+
+OC_INLINE Proxy InlineArr (int_u4 inline_elements)
+{
+  Allocator* alloc = CurrentAllocator();
+  char* mem = InlineBlock_<Arr>(inline_elements, alloc);
+  Arr* a = new (mem+InlineOffset_(sizeof(RefCount_<Arr>))) Arr(0); // 0: no memory
+  Val* elements = InlineElements_(a, mem, alloc);
+  a->adoptMemory(elements, inline_elements, 3);
+  return Proxy('n', 'Z', mem);
+}
+
+OC_INLINE Proxy InlineTup (int_u4 inline_elements)
+{
+  Allocator* alloc = CurrentAllocator();
+  char* mem = InlineBlock_<Tup>(inline_elements, alloc);
+  Tup* u = new (mem+InlineOffset_(sizeof(RefCount_<Tup>))) Tup(); // no memory
+  Val* elements = InlineElements_(u, mem, alloc);
+  u->impl().adoptMemory(elements, inline_elements, 3);
+  return Proxy('u', 'Z', mem);
+}
+
+template <class T>
+OC_INLINE Proxy NewProxy ()
+{
+  Allocator* a = CurrentAllocator();
+  if (a==0) return Proxy(new T());
+  char* mem = a->allocate(sizeof(T));
+  T* thing = 0;
+  try {
+    thing = new (mem) T();  // uses the current allocator too
+  } catch (...) {
+    a->deallocate(mem);
+    throw;
+  }
+  return Proxy(thing, true, false, false);
+}
+
+
 // TODO: A lot of replicated code ... these should probably be templates
 
 OC_INLINE Proxy Shared (StreamingPool* shm, const Tab& table_to_copy)
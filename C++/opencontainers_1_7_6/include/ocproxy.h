@@ -93,6 +93,34 @@
 //       // ... someone else deallocates at the proper time ...
 //       // t.~Tab(); // call destructor when you want to clean up
 //       // ... dellocate(memory); ...
+//
+// (5) Some (probably large) table gets copied all over the place, but
+//     hardly ever changes: for example, a configuration table that
+//     goes into every outgoing message.  A copy-on-write proxy makes
+//     copies O(1) (the copies all share the same body), but the
+//     first time someone asks for a reference they could change
+//     (a Tab&, an Arr&, etc.) while the body is still shared, that
+//     proxy "detaches" a private (full) copy of the body first.  To
+//     everyone else, it looks like each Val has its own copy.
+//
+//       // CREATION
+//       Val config = CopyOnWrite(new Tab("{'a':1}"));
+//                or
+//       Val config = Tab("{'a':1}");
+//       config.Proxyize(true, false, true); // adopt, no lock, cow
+//
+//       // USE
+//       Val message = Tab();
+//       message["config"] = config;  // O(1): shares the body
+//       message["config"]["b"] = 2;  // message gets its own copy first
+//
+//     Printing, comparing, serializing, and checking InSHM all look
+//     at the body without detaching.  Nested tables inside the body
+//     are just Vals: if they are copy-on-write too, a detach only
+//     copies one level of the tree.  Copy-on-write proxies are like
+//     (1): they are NOT threadsafe, and a borrowed reference (a Tab&)
+//     that you hold across a copy of the Val may still point to the
+//     (now shared) body, so get the reference after the copy.
 
 
 #include "ocsynchronizer.h"
@@ -141,6 +169,8 @@ class RefCount_  {
     refCount_(1), 
     adopted_(adopt), 
     sharedAcrossProcesses_(false),
+    copyOnWrite_(false),
+    inPlace_(false),
     allocator_(a), 
     data_(data) { }
   
@@ -165,11 +195,23 @@ class RefCount_  {
   volatile int        refCount_;
   bool       adopted_;
   bool       sharedAcrossProcesses_; // also means a ProtectedRefCount!
+  bool       copyOnWrite_; // detach a private copy before any change
+  bool       inPlace_;     // data_ lives in the same block as this
   Allocator* allocator_; // allocator_ is just referenced, not adopted
   T*         data_;      // data_ only adopted if the adopted_ flag is set
 }; // RefCount_
 
 
+// The ref count of a ProtectedRefCount_ is changed with atomic
+// instructions (no lock), so copying a Locked or Shared Proxy between
+// threads (or processes: the atomics work on shared memory too) is
+// cheap.  Define OC_LOCKED_REFCOUNT to go back to taking the lock for
+// every increment and decrement (compilers without the GNU atomic
+// builtins always do).
+#if defined(__GNUC__) && !defined(OC_LOCKED_REFCOUNT)
+# define OC_ATOMIC_REFCOUNT
+#endif
+
 // Adds protection for copying the class from threads
 template <class T>
 class ProtectedRefCount_ : public RefCount_<T> {
@@ -179,33 +221,43 @@ class ProtectedRefCount_ : public RefCount_<T> {
   ProtectedRefCount_ (T* data, bool adopted=true, Allocator* a=0,
 		      bool shared_across_processes=false) : 
     RefCount_<T>(data, adopted, a),
-    cv_(shared_across_processes)
+    cv_(shared_across_processes),
+    readers_(0),
+    writersWaiting_(0)
   {
     this->sharedAcrossProcesses_ = true;
   }
 
   void* inc ()   // NOT virtual on purpose!
   {
+#if defined(OC_ATOMIC_REFCOUNT)
+    __sync_fetch_and_add(&this->refCount_, 1);
+#else
     {
       this->cv_.lock();
       this->refCount_ += 1;
-      //this->cv_.signal();
       this->cv_.unlock();
     }
+#endif
     return this;
   }
 
   void dec ()  // NOT virtual on purpose!
   {
     bool done = false;
+#if defined(OC_ATOMIC_REFCOUNT)
+    // Only the one that takes it to 0 sees 0: the full barrier makes
+    // sure all the other threads' changes are seen before the delete
+    done = (__sync_sub_and_fetch(&this->refCount_, 1)==0);
+#else
     {
       this->cv_.lock();
       if (--(this->refCount_)==0) {
 	done = true;
       }
-      // this->cv_.signal();
       this->cv_.unlock();
     }
+#endif
     // Normally a bad idea to delete this, but this is a standard way
     // to handle resource deallocation and make sure this resource 
     // is cleaned up when there are no further references to it
@@ -228,9 +280,16 @@ class ProtectedRefCount_ : public RefCount_<T> {
   // its pieces: call destructor then delete memory)
   OC_INLINE void PRCdeleteThis_ ();
 
-  // Lock:  We only need mutual exclusion for ++ and -- on ref count, 
-  // no signalling, but the TransactionLock needs the full condvar.
+  // Lock: the ref count doesn't need it (unless OC_LOCKED_REFCOUNT),
+  // but the TransactionLock needs the full condvar.  cv_() is true
+  // while a writer has the transaction.
   CondVar cv_;
+
+  // For READ transactions (see TransactionLock): how many readers are
+  // in, and how many writers are waiting to get in.  Only looked at
+  // with the cv_ lock held.
+  int_u4 readers_;
+  int_u4 writersWaiting_;
 }; // ProtectedRefCount_
 
 
@@ -305,40 +364,27 @@ class Proxy  {
   // table that is valid as long as the Proxy is still valid.
   // Proxy p = new Tab();
   // Tab& borrow_ref = p;
-  operator Tab& () const 
-  {
-    if (tag!='t') {
-      NoConversion_(tag, "Proxy", "Tab&");
-    }
-    RefCount_<Tab>* pp = (RefCount_<Tab>*)handle_;
-    return *pp->data();
-  }
+  // From a non-const Proxy, the reference is for changing things, so
+  // a shared copy-on-write body is detached first.  From a const
+  // Proxy (or a const Val), the reference is only for looking: it
+  // never detaches (or writes to the Proxy), so many readers can use
+  // a shared body at once, but nothing should be changed through it.
+  operator Tab& () { return *(Tab*)body_(tag=='t', "Tab&", true); }
+  operator Tab& () const { return *(Tab*)body_(tag=='t', "Tab&", false); }
 
   // Allows someone to get a borrowed reference:  a reference to the
   // table that is valid as long as the Proxy is still valid.
   // Proxy p = new OTab();
   // OTab& borrow_ref = p;
-  operator OTab& () const 
-  {
-    if (tag!='o') {
-      NoConversion_(tag, "Proxy", "OTab&");
-    }
-    RefCount_<OTab>* pp = (RefCount_<OTab>*)handle_;
-    return *pp->data();
-  }
+  operator OTab& () { return *(OTab*)body_(tag=='o', "OTab&", true); }
+  operator OTab& () const { return *(OTab*)body_(tag=='o', "OTab&", false); }
 
   // Allows someone to get a borrowed reference:  a reference to the
   // table that is valid as long as the Proxy is still valid.
   // Proxy p = new Tup();
   // Tab& borrow_ref = p;
-  operator Tup& () const 
-  {
-    if (tag!='u') {
-      NoConversion_(tag, "Proxy", "Tup&");
-    }
-    RefCount_<Tup>* pp = (RefCount_<Tup>*)handle_;
-    return *pp->data();
-  }
+  operator Tup& () { return *(Tup*)body_(tag=='u', "Tup&", true); }
+  operator Tup& () const { return *(Tup*)body_(tag=='u', "Tup&", false); }
   
   // Allows someone to get a borrowed reference to an Array: a reference
   // to the Array is still valid as long as the Proxy is still Valid.
@@ -350,9 +396,11 @@ class Proxy  {
   // Some compilers don't support outconverters with templates well,
   // so we have to do it manually
   template <class T> 
+  OC_INLINE operator Array<T>& ();
+  template <class T> 
   OC_INLINE operator Array<T>& () const;
 #else
-#define OC_PROXY2ARR_OUTCONV(T) OC_INLINE operator Array<T>& () const;
+#define OC_PROXY2ARR_OUTCONV(T) OC_INLINE operator Array<T>& (); OC_INLINE operator Array<T>& () const;
     OC_PROXY2ARR_OUTCONV(int_1)
     OC_PROXY2ARR_OUTCONV(int_u1)
     OC_PROXY2ARR_OUTCONV(int_2)
@@ -383,18 +431,22 @@ class Proxy  {
   // Usage:  Proxy p = new Array<real_8>(100);
   //         Array<real_8>& a = p;    // borrowed ref
   //         Array<real_8> copy = p;  // FULL COPY
-  operator Arr& () const
-  {
-    if (tag!='n' || subtype!='Z') {
-      NoConversion_(tag, "Proxy", "Arr&");
-    }
-    RefCount_<Arr>* pp = (RefCount_<Arr>*)handle_;
-    return *pp->data();
-  }
+  operator Arr& () { return *(Arr*)body_(tag=='n' && subtype=='Z', "Arr&", true); }
+  operator Arr& () const { return *(Arr*)body_(tag=='n' && subtype=='Z', "Arr&", false); }
 
   // One less proxy
   ~Proxy () { decrement_(); }
 
+  // Wrap a handle that has already been built (with its ref count
+  // already counting this proxy).  Adopted and not locked.
+  Proxy (char t, char st, void* handle) :
+    tag(t),
+    subtype(st),
+    adopt(true),
+    lock(false),
+    handle_(handle)
+  { }
+
   // Copy constructor
   Proxy (const Proxy& p) :
     tag(p.tag),
@@ -436,6 +488,19 @@ class Proxy  {
     return prc->sharedAcrossProcesses_; 
   }
 
+  // Copy-on-write?  Turning it on only makes sense right after the
+  // proxy is created, before anyone else shares the body.
+  bool copyOnWrite () const
+  {
+    RefCount_<void>* prc=(RefCount_<void>*)handle_; 
+    return prc->copyOnWrite_; 
+  }
+  void copyOnWrite (bool cow)
+  {
+    RefCount_<void>* prc=(RefCount_<void>*)handle_; 
+    prc->copyOnWrite_ = cow;
+  }
+
 
   // protected:
 
@@ -447,6 +512,25 @@ class Proxy  {
   OC_INLINE void* increment_ () const;  // Increment ref count 
   OC_INLINE void  decrement_ () const;  // Decrement ref count
 
+  // Give this proxy a private (full) copy of a shared copy-on-write
+  // body, and return the new handle.  Only the conversions of a
+  // non-const Proxy call this.
+  OC_INLINE void* detach_ () const;
+
+  // The body for the conversions above: throws if ok is false, and
+  // detaches a shared copy-on-write body first if asked to.
+  void* body_ (bool ok, const char* to_thing, bool detach) const
+  {
+    if (!ok) {
+      NoConversion_(tag, "Proxy", to_thing);
+    }
+    RefCount_<void>* prc = (RefCount_<void>*)handle_;
+    if (detach && prc->copyOnWrite_ && prc->refCount_>1) {
+      prc = (RefCount_<void>*)detach_();
+    }
+    return prc->data_;
+  }
+
   // Gives a pointer to the void* data in the RefCount
   inline void* data_ () const 
   { 
@@ -504,6 +588,39 @@ OC_INLINE Proxy Locked (Arr* adopted_arr);
 template <class T>
 OC_INLINE Proxy Locked (Array<T>* adopted_array);
 
+// Give me a copy-on-write proxy for the table: copies of the proxy
+// share the table until someone asks for a reference to change it,
+// then they get their own copy.  The proxy adopts the table (which
+// should come from the standard free store, or its own allocator).
+// Usage:   Val config = CopyOnWrite(new Tab("{'a':1}"));
+OC_INLINE Proxy CopyOnWrite (Tab* adopted_table);
+OC_INLINE Proxy CopyOnWrite (OTab* adopted_table);
+OC_INLINE Proxy CopyOnWrite (Tup* adopted_table);
+OC_INLINE Proxy CopyOnWrite (Arr* adopted_arr);
+template <class T>
+OC_INLINE Proxy CopyOnWrite (Array<T>* adopted_array);
+
+// Give me a proxy for a new, empty Arr (or Tup) with room for
+// inline_elements elements, where the reference count, the Arr and
+// the elements all come from ONE allocation (instead of three).  If
+// the Arr grows past inline_elements, the elements move out to the
+// heap like any other Arr.  This is for the loaders: most of the
+// lists and tuples in a typical message only have a few elements.
+// Under an AllocatorScope, the block comes from the current allocator.
+// Usage:   Val v = InlineArr(2); v.append(x); v.append(y);
+OC_INLINE Proxy InlineArr (int_u4 inline_elements);
+OC_INLINE Proxy InlineTup (int_u4 inline_elements);
+
+// Give me a proxy for a new, empty T (Tab, OTab, Tup, Arr or some
+// Array<T>).  Usually, this is just Proxy(new T()), but if there is a
+// current allocator (see AllocatorScope), the T and its reference
+// count come from that allocator too (a plain new T() would be on
+// the heap), so a tree of proxies can be built completely in shared
+// memory or an arena.
+// Usage:   Val v = NewProxy<Tab>();
+template <class T>
+OC_INLINE Proxy NewProxy ();
+
 // Give me a Proxy for the table.  The given table is immediately copied 
 // to an adopted piece of SharedMemory.  We then add a lock so we can do 
 // protected transactions on it.  
@@ -528,20 +645,47 @@ OC_INLINE Proxy Shared (StreamingPool* shm, const Array<T>& array_to_copy);
 //    t[1] = 2; /// etc
 //  }                        // Lock released
 //
-// TODO: Reader-Writer Transactions so can have multiple readers, 1 writer
+// A transaction that only reads can be a READ transaction: any number
+// of readers can be in at once (but no writer):
+//
+//  {
+//    TransactionLock tl(p, TransactionLock::READ);
+//    Tab& t = p;
+//    cout << t("a") << t("b");  // ... no changes!
+//  }
+//
+// Writers get preference: once a writer is waiting, new readers wait
+// behind it (so a steady stream of readers can't starve the writers).
+// This means a thread must NOT take a second READ transaction on a
+// proxy it already has one on: if a writer came in between, they
+// would wait on each other forever.  This works the same for proxies
+// shared across processes (the counts live with the lock).
 class TransactionLock {
  public:
-  TransactionLock (const Proxy& p) : p_(p)
+  enum Transaction_e { WRITE, READ };
+
+  TransactionLock (const Proxy& p, Transaction_e mode=WRITE) : 
+    p_(p), 
+    mode_(mode)
   {
     if (p_.lock) {
       ProtectedRefCount_<void>* prc=(ProtectedRefCount_<void>*)p_.handle_;
       CondVar& cv = prc->cv_;
       {
 	cv.lock();
-	while (cv()) {
-	  cv.wait();
+	if (mode_==READ) {
+	  while (cv() || prc->writersWaiting_) {
+	    cv.wait();
+	  }
+	  prc->readers_ += 1;
+	} else {
+	  prc->writersWaiting_ += 1;
+	  while (cv() || prc->readers_) {
+	    cv.wait();
+	  }
+	  prc->writersWaiting_ -= 1;
+	  cv() = true; // we got it!
 	}
-	cv() = true; // we got it!
 	cv.unlock();
       }
     }
@@ -554,8 +698,13 @@ class TransactionLock {
       CondVar& cv = prc->cv_;
       {
 	cv.lock();
-	cv() = false;  // no one there anymore!
-	cv.broadcast();  // indicate we are leaving
+	if (mode_==READ) {
+	  // Only the last reader out can let anyone new in
+	  if (--(prc->readers_)==0) cv.broadcast(); 
+	} else {
+	  cv() = false;  // no one there anymore!
+	  cv.broadcast();  // indicate we are leaving
+	}
 	cv.unlock();
       }
     }
@@ -563,6 +712,7 @@ class TransactionLock {
   
  protected:
   Proxy p_; 
+  Transaction_e mode_;
 
 }; // TransactionLock
 
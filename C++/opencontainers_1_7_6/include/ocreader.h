@@ -185,6 +185,12 @@ class ReaderA {
   virtual int peekChar_ ()    = 0;
   virtual int consumeWS_ ()   = 0;
   virtual void pushback_ (int pushback_char) = 0;
+
+  // Readers holding all their input in memory can give out the unread
+  // part of it, so numbers (say) can be parsed right out of the buffer
+  // and then skipped: the default is no buffer at all.
+  virtual const char* unread_ (int& len) { len = 0; return 0; }
+  virtual void skip_ (int n) { for (int ii=0; ii<n; ii++) getChar_(); }
 }; // ReaderA
 
 
@@ -370,6 +376,19 @@ class StringReader : public ReaderA {
     return;
   }
 
+  // Everything not read yet is right there
+  virtual const char* unread_ (int& len) 
+  { 
+    len = length_-current_;
+    return data_+current_;
+  }
+
+  virtual void skip_ (int n) 
+  {
+    if (context_) context_->addData(data_+current_, n);
+    current_ += n;
+  }
+
 }; // StringReader
 
 
@@ -109,12 +109,13 @@ OC_INLINE void OCSerializer::put (const Proxy& p)
   INT4OCCOPY(mem, marker);
   *mem++ = p.adopt;
   *mem++ = p.lock;
-  *mem++ = ' ';  // TODO: Allocator indicator
+  *mem++ = p.copyOnWrite() ? 'C' : ' ';  // TODO: Allocator indicator
 
-  // Copy in as normal
+  // Copy in as normal (straight from the data, so copy-on-write
+  // proxies don't detach)
   if (p.tag=='t') {
-    Tab& t = p;
-    put(t);
+    Tab* t = (Tab*)(handle->data_);
+    put(*t);
   } else if (p.tag=='n') {
     switch (p.subtype) {
     case 's': VALPRARRPUT(int_1);  break;
@@ -288,7 +289,7 @@ OC_INLINE void OCDeserializer::load (Array<T>* ap)
 
 
 
-#define VALARRDEOCCOPY(T) { Array<T>*ap=(Array<T>*)&v.u.n; load(ap); break; }
+#define VALARRDEOCCOPY(T) { Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>)); load(ap); break; }
 OC_INLINE void OCDeserializer::load (Val& v)
 {
   char*& mem = mem_;
@@ -307,17 +308,17 @@ OC_INLINE void OCDeserializer::load (Val& v)
   case 'f': VAL4DEOCCOPY(real_4, v.u.f); break;
   case 'd': VAL8DEOCCOPY(real_8, v.u.d); break;
   case 'F': VAL8DEOCCOPY(complex_8, v.u.F); break;
-  case 'D': VAL16DEOCCOPY(complex_16, v.u.D); break;
-  case 'a': { OCString* sp = (OCString*)&v.u.a; load(sp); break; }
+  case 'D': VAL16DEOCCOPY(complex_16, *(complex_16*)v.newSpace_(sizeof(complex_16))); break;
+  case 'a': { OCString* sp = (OCString*)v.newSpace_(sizeof(OCString)); load(sp); break; }
   case 'P': { 
-    Proxy*pp = (Proxy*)&v.u.P; 
+    Proxy*pp = (Proxy*)v.newSpace_(sizeof(Proxy)); 
     load(pp); 
     v.isproxy=true; 
     v.tag=pp->tag;
     v.subtype=pp->subtype; 
     break; 
   }
-  case 't': { Tab* tp = (Tab*)&v.u.t; load(tp); break; }
+  case 't': { Tab* tp = (Tab*)v.newSpace_(sizeof(Tab)); load(tp); break; }
   case 'n': { 
     v.subtype = *mem++;
     switch (v.subtype) {
@@ -338,7 +339,7 @@ OC_INLINE void OCDeserializer::load (Val& v)
     case 'P': 
     case 't': throw logic_error("Can't have arrays of tables or strings");
     case 'n': throw logic_error("Can't have arrays of arrays");
-    case 'Z': {Arr*ap = (Arr*)&v.u.n; load(ap); break;}
+    case 'Z': {Arr*ap = (Arr*)v.newSpace_(sizeof(Arr)); load(ap); break;}
     }
     break;
   }
@@ -367,10 +368,10 @@ OC_INLINE void OCDeserializer::load (Proxy* pp)
   }
 
   // Not there, completely deserialize
-  bool adopt, lock, shm;
+  bool adopt, lock; char shm;
   VAL1DEOCCOPY(bool, adopt);
   VAL1DEOCCOPY(bool, lock);
-  VAL1DEOCCOPY(bool, shm);
+  VAL1DEOCCOPY(char, shm);  // 'C' means copy-on-write
   
   char tag = *mem++;
   if (tag=='t') {
@@ -400,6 +401,8 @@ OC_INLINE void OCDeserializer::load (Proxy* pp)
   } else {
     throw logic_error("Can't have Proxy for other than Tab, Arr, Array<T>");
   }
+  if (shm=='C') pp->copyOnWrite(true);
+
   // Add marker back in
   lookup_[marker] = *pp;      
 }
@@ -48,10 +48,22 @@ OC_BEGIN_NAMESPACE
 // we don't serialize them twice.
 struct OCDumpContext_ {
   OCDumpContext_ (char* start_mem, bool compat) : 
-    mem(start_mem), compat_(compat) { }
+    mem(start_mem), compat_(compat), buffer_(0), end_(0), sink_(0) { }
 
   char* mem;  // Where we currently are in the buffer we are dumping into
 
+  // Make sure there is room for the next bytes: only growable buffers
+  // have to check (a plain char* was sized with BytesToSerialize)
+  void room (size_t bytes) 
+  { if (buffer_ && size_t(end_-mem)<bytes) OCGrowDumpBuffer_(*buffer_, mem, end_, bytes, sink_); }
+
+  // Copy a block of string or array data
+  void block (const void* data, size_t len)
+  { 
+    if (buffer_) OCDumpBlock_(*buffer_, mem, end_, (const char*)data, len, sink_);
+    else { memcpy(mem, data, len); mem += len; }
+  }
+
   // Lookup table for looking up the markers:  When a proxy comes
   // in, we need to know if we have seen it before, and if so,
   // what proxy it refers to.  Note that we hold each proxy by
@@ -64,6 +76,12 @@ struct OCDumpContext_ {
   // be able to turn OTabs->Tab and Tup->Arr.
   bool compat_;  // true means convert OTab->Tab, Tup->Arr
 
+  // The growable buffer (and the end of its memory), if there is one,
+  // and where it goes when full if streaming
+  Array<char>* buffer_;
+  char* end_;
+  DumpSink* sink_;
+
 }; // OCDumpContext_
 
 
@@ -315,8 +333,33 @@ OC_INLINE size_t BytesToSerialize (const Array<T>& a)
 
 // Macro for copying into buffer with right types/fields
 #define VALCOPY(T,N) { memcpy(mem,&N,sizeof(T));mem+=sizeof(T); }
-#define VVVCOPY(T,N) { *mem++=v.tag; memcpy(mem,&N,sizeof(T));mem+=sizeof(T); }
-#define VALARRCOPY(T) { Array<T>*ap=(Array<T>*)&v.u.n;mem=Serialize(*ap, mem);}
+#define VVVCOPY(T,N) { dc.room(1+sizeof(T)); *mem++=v.tag; memcpy(mem,&N,sizeof(T));mem+=sizeof(T); }
+#define VALARRCOPY(T) { Array<T>*ap=(Array<T>*)&v.u.n;SerializeArray_(*ap, dc);}
+
+// Strings and arrays of POD: the header, then the data as a block
+OC_INLINE void SerializeString_ (const char* data, int_u4 len, 
+				 OCDumpContext_& dc)
+{
+  char*& mem = dc.mem;
+  dc.room(1+sizeof(int_u4));
+  *mem++ = 'a'; 
+  VALCOPY(int_u4, len);
+  dc.block(data, len);
+}
+
+template <class T>
+OC_INLINE void SerializeArray_ (const Array<T>& a, OCDumpContext_& dc)
+{
+  char*& mem = dc.mem;
+  dc.room(1+1+sizeof(int_u4));
+  *mem++ = 'n';
+  Val sub_type = T();
+  *mem++ = sub_type.tag;
+  const int_u4 len = a.length();
+  VALCOPY(int_u4, len);
+  dc.block(a.data(), sizeof(T)*len);
+}
+
 OC_INLINE void Serialize (const Val& v, OCDumpContext_& dc)
 {
   char*& mem = dc.mem; // Important that this is a RERERENCE!
@@ -337,7 +380,7 @@ OC_INLINE void Serialize (const Val& v, OCDumpContext_& dc)
   case 'd': VVVCOPY(real_8, v.u.d); break;
   case 'F': VVVCOPY(complex_8, v.u.F); break;
   case 'D': VVVCOPY(complex_16, v.u.D); break;
-  case 'a': { OCString*sp=(OCString*)&v.u.a; mem=Serialize(*sp,mem);break;}
+  case 'a': { OCString*sp=(OCString*)&v.u.a; SerializeString_(sp->data(),sp->length(),dc);break;}
   case 't': { Tab*tp=(Tab*)&v.u.t; Serialize(*tp,dc);break; }
   case 'o': { OTab*tp=(OTab*)&v.u.o; Serialize(*tp,dc);break; }
   case 'u': { Tup*tp=(Tup*)&v.u.u; Serialize(*tp,dc);break; }
@@ -367,13 +410,13 @@ OC_INLINE void Serialize (const Val& v, OCDumpContext_& dc)
     }
     break;
   }
-  case 'Z': *mem++ = v.tag; break;
+  case 'Z': dc.room(1); *mem++ = v.tag; break;
   default: unknownType_("Serialize into circular buffer", v.tag);
   }
 }
 
 
-#define OCSERPROXY(T) { Array<T>*t=(Array<T>*)p.data_(); dc.mem=Serialize(*t, dc.mem);}
+#define OCSERPROXY(T) { Array<T>*t=(Array<T>*)p.data_(); SerializeArray_(*t, dc);}
 OC_INLINE void SerializeProxy (const Proxy& p, OCDumpContext_& dc)
 {
   char*& mem = dc.mem;
@@ -385,15 +428,17 @@ OC_INLINE void SerializeProxy (const Proxy& p, OCDumpContext_& dc)
   int_4 marker = (already_serialized)?dc.lookup_(handle):dc.lookup_.entries();
 
   // Always do at least this
+  dc.room(1+sizeof(int_u4)+3);
   *mem++ = 'P';
   VALCOPY(int_u4, marker);
   if (already_serialized) return;  // All done is proxy already in table
 
   // Preamble for proxy
   // copy in the Proxy marker, and proxy flags:adopt flag, lock flag, alloc ind
+  // (the alloc ind is a 'C' for copy-on-write proxies)
   *mem++ = p.adopt;
   *mem++ = p.lock;
-  *mem++ = ' ';  // TODO: Allocator indicator
+  *mem++ = p.copyOnWrite() ? 'C' : ' ';  // TODO: Allocator indicator
 
   // Now plop in main proxy
   dc.lookup_[handle] = marker;     // Put marker in table
@@ -460,6 +505,7 @@ OC_INLINE void Serialize (const Tab& t, OCDumpContext_& dc)
 {
   char*& mem = dc.mem;
 
+  dc.room(1+sizeof(int_u4));
   *mem++ = 't'; // Always need tag
   // Tables: 't', int_u4 length, (length) Key/Value pairs
   const int_u4 len = t.entries();
@@ -478,6 +524,7 @@ OC_INLINE void Serialize (const OTab& t, OCDumpContext_& dc)
   char*& mem = dc.mem;
 
   // Always need tag .. serializes same way except for tag
+  dc.room(1+sizeof(int_u4));
   *mem++ = dc.compat_ ? 't' : 'o'; 
   //*mem++ = 'o'; // Always need tag
   // Tables: 't' or 'o', int_u4 length, (length) Key/Value pairs
@@ -502,6 +549,7 @@ OC_INLINE void Serialize (const Tup& t, OCDumpContext_& dc)
   char*& mem = dc.mem;
 
   // Tup: 'u', 'Z' subtype, int_u4 length, (length) vals
+  dc.room(1+1+sizeof(int_u4));
   *mem++ = 'u'; // Always need tag
   *mem++ = 'Z'; // Strictly no necessary, but makes deserialize code a little easier
   const int_u4 len = t.length();
@@ -517,16 +565,17 @@ OC_INLINE void Serialize (const int_n& t, OCDumpContext_& dc)
 {
   if (dc.compat_) { 
     const Str s = t.stringize();
-    dc.mem = Serialize(s, dc.mem);
+    SerializeString_(s.data(), s.length(), dc);
     return;
   }
 
   char*& mem = dc.mem;
 
   // int_n: 'q', int_u4 length, (length) chars
-  *mem++ = 'q'; // Always need tag
   string repr = MakeBinaryFromBigInt(t);
   const int_u4 len = repr.length();
+  dc.room(1+sizeof(int_u4)+len);
+  *mem++ = 'q'; // Always need tag
   VALCOPY(int_u4, len);
 
   memcpy(mem, repr.data(), len);
@@ -537,16 +586,17 @@ OC_INLINE void Serialize (const int_un& t, OCDumpContext_& dc)
 {
   if (dc.compat_) { 
     const Str s = t.stringize();
-    dc.mem = Serialize(s, dc.mem);
+    SerializeString_(s.data(), s.length(), dc);
     return;
   }
 
   char*& mem = dc.mem;
 
   // int_n: 'q', int_u4 length, (length) chars
-  *mem++ = 'q'; // Always need tag
   string repr = MakeBinaryFromBigUInt(t);
   const int_u4 len = repr.length();
+  dc.room(1+sizeof(int_u4)+len);
+  *mem++ = 'q'; // Always need tag
   VALCOPY(int_u4, len);
 
   memcpy(mem, repr.data(), len);
@@ -560,6 +610,7 @@ OC_INLINE void Serialize (const Arr& a, OCDumpContext_& dc)
   char*& mem = dc.mem;
 
   // Arrays: 'n', subtype, int_u4 length, (length) vals
+  dc.room(1+1+sizeof(int_u4));
   *mem++ = 'n'; // Always need tag
   *mem++ = 'Z'; // subtype
   const int_u4 len = a.length();
@@ -615,6 +666,32 @@ OC_INLINE size_t BytesToSerialize (const Arr& a, bool compat)
 
 OC_INLINE char* Serialize (const Val& v, char* mem, bool compat)
 { OCDumpContext_ dc(mem,compat); Serialize(v, dc); return dc.mem; }
+OC_INLINE size_t SerializeToArray (const Val& v, Array<char>& buffer,
+				   bool compat)
+{
+  const size_t start = buffer.length();
+  buffer.expandTo(buffer.capacity());
+  OCDumpContext_ dc(buffer.data()+start, compat);
+  dc.buffer_ = &buffer;
+  dc.end_ = buffer.data()+buffer.length();
+  Serialize(v, dc);
+  buffer.expandTo(dc.mem-buffer.data());
+  return buffer.length()-start;
+}
+
+OC_INLINE void SerializeToSink (const Val& v, DumpSink& sink, bool compat,
+				size_t chunk_bytes)
+{
+  Array<char> chunk(chunk_bytes);
+  chunk.expandTo(chunk_bytes);
+  OCDumpContext_ dc(chunk.data(), compat);
+  dc.buffer_ = &chunk;
+  dc.end_ = chunk.data()+chunk.length();
+  dc.sink_ = &sink;
+  Serialize(v, dc);
+  sink.write(chunk.data(), dc.mem-chunk.data());
+}
+
 OC_INLINE char* Serialize (const Tab& t, char* mem, bool compat)
 { OCDumpContext_ dc(mem,compat); Serialize(t, dc); return dc.mem; }
 OC_INLINE char* Serialize (const OTab& t, char* mem, bool compat)
@@ -652,12 +729,13 @@ OC_INLINE void DeserializeProxy (Val& v, OCLoadContext_& lc);
 
 
 #define VALDECOPY(T,N) { memcpy(&N,mem,sizeof(T)); mem+=sizeof(T); }
-#define VALDECOPY2(T) { Array<T>*ap = (Array<T>*)&v.u.n; new (ap) Array<T>(len); ap->expandTo(len); memcpy(ap->data(),mem,sizeof(T)*len); mem+=sizeof(T)*len; }
-#define VALDECOPY3(T) {Array<T>*ap=(Array<T>*)&v.u.n;new(ap)Array<T>(len); for(int ii=0;ii<len;ii++){ap->append(T());Deserialize((*ap)[ii], lc);}}
-#define VALDECOPY4(T) {Array<T>*ap=(Array<T>*)&v.u.n;new(ap)Array<T>(len); for(int ii=0;ii<len;ii++){ap->append(T());Val temp;Deserialize(temp, lc); (*ap)[ii]=temp;}}
+#define VALDECOPY2(T) { Array<T>*ap = (Array<T>*)v.newSpace_(sizeof(Array<T>)); new (ap) Array<T>(len, alloc); ap->expandTo(len); memcpy(ap->data(),mem,sizeof(T)*len); mem+=sizeof(T)*len; }
+#define VALDECOPY3(T) {Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>));new(ap)Array<T>(len,alloc); for(int ii=0;ii<len;ii++){ap->append(T());Deserialize((*ap)[ii], lc);}}
+#define VALDECOPY4(T) {Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>));new(ap)Array<T>(len,alloc); for(int ii=0;ii<len;ii++){ap->append(T());Val temp;Deserialize(temp, lc); (*ap)[ii]=temp;}}
 OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
 {
   char*& mem = lc.mem;
+  Allocator* alloc = v.allocator(); // everything is built with v's allocator
 
   if (v.tag!='Z') { // Don't let anything be serialized EXCEPT empty Val
     throw logic_error("You can only deserialize into an empty Val.");
@@ -682,12 +760,12 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
   case 'f': VALDECOPY(real_4, v.u.f); break;
   case 'd': VALDECOPY(real_8, v.u.d); break;
   case 'F': VALDECOPY(complex_8, v.u.F); break;
-  case 'D': VALDECOPY(complex_16, v.u.D); break;
+  case 'D': VALDECOPY(complex_16, *(complex_16*)v.newSpace_(sizeof(complex_16))); break;
 
   case 'q': { 
     int_u4 len; VALDECOPY(int_u4, len);
-    int_n* ip=(int_n*)&v.u.q; 
-    new (ip) int_n;
+    int_n* ip=(int_n*)v.newSpace_(sizeof(int_n)); 
+    new (ip) int_n(0, alloc);
     MakeBigIntFromBinary(mem, len, *ip);
     mem += len;
     if (lc.compat_) {
@@ -698,8 +776,8 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
   }
   case 'Q': { 
     int_u4 len; VALDECOPY(int_u4, len);
-    int_un* ip=(int_un*)&v.u.Q; 
-    new (ip) int_n;
+    int_un* ip=(int_un*)v.newSpace_(sizeof(int_un)); 
+    new (ip) int_un(0, alloc);
     MakeBigUIntFromBinary(mem, len, *ip);
     mem += len;
     if (lc.compat_) {
@@ -714,7 +792,7 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
   case 'a':
     { // Strs: 'a' then int_u4 len, then len bytes
       int_u4 len; VALDECOPY(int_u4, len);
-      OCString* sp = (OCString*)&v.u.a; new (sp) OCString(mem, len);
+      OCString* sp = (OCString*)v.newSpace_(sizeof(OCString)); new (sp) OCString(mem, len, alloc);
       mem += len;
       break;
     } 
@@ -724,7 +802,7 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
       { // Tables: 't', then int_u4 length, then length ley/value pairs
 	v.tag = 't';
 	int_u4 len; VALDECOPY(int_u4, len);
-	Tab* tp = (Tab*)&v.u.t; new (tp) Tab(); 
+	Tab* tp = (Tab*)v.newSpace_(sizeof(Tab)); new (tp) Tab(alloc); 
 	int ilen = len;
 	for (int ii=0; ii<ilen; ii++) {
 	  Val key;
@@ -737,7 +815,7 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
     } else { 
       { // Tables: 'o', then int_u4 length, then length ley/value pairs
 	int_u4 len; VALDECOPY(int_u4, len);
-	OTab* tp = (OTab*)&v.u.o; new (tp) OTab(); 
+	OTab* tp = (OTab*)v.newSpace_(sizeof(OTab)); new (tp) OTab(alloc); 
 	int ilen = len;
 	for (int ii=0; ii<ilen; ii++) {
 	  Val key;
@@ -770,13 +848,12 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
       case 'F': VALDECOPY2(complex_8); break;
       case 'D': VALDECOPY2(complex_16); break;
       case 'a': {
-	Array<Str>*ap=(Array<Str>*)&v.u.n;
-	new (ap) Array<Str>(len); 
+	Array<Str>*ap=(Array<Str>*)v.newSpace_(sizeof(Array<Str>));
+	new (ap) Array<Str>(len, alloc); 
 	for(int ii=0;ii<ilen;ii++) {
-	  ap->append("");
 	  // Strs: 'a' then int_u4 len, then len bytes
 	  int_u4 len; VALDECOPY(int_u4, len);
-	  (*ap)[ii] = Str(mem, len);
+	  ap->append(Str(mem, len));
 	  mem += sizeof(Str);
 	}
 	break;
@@ -785,8 +862,8 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
       case 'o': if (lc.compat_ || v.subtype=='t') 
 	{
 	  //v.subtype = 't';
-	  Array<Tab>*ap=(Array<Tab>*)&v.u.n;
-	  new (ap) Array<Tab>(len); 
+	  Array<Tab>*ap=(Array<Tab>*)v.newSpace_(sizeof(Array<Tab>));
+	  new (ap) Array<Tab>(len, alloc); 
 	  for(int ii=0;ii<ilen;ii++) {
 	    ap->append(Tab());
 	    // Tables: 't', then int_u4 length, then length ley/value pairs
@@ -801,8 +878,8 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
 	    }
 	  }
 	} else {
-	  Array<OTab>*ap=(Array<OTab>*)&v.u.n;
-	  new (ap) Array<OTab>(len); 
+	  Array<OTab>*ap=(Array<OTab>*)v.newSpace_(sizeof(Array<OTab>));
+	  new (ap) Array<OTab>(len, alloc); 
 	  for(int ii=0;ii<ilen;ii++) {
 	    ap->append(OTab());
 	    // Tables: 'o', then int_u4 length, then length ley/value pairs
@@ -823,15 +900,17 @@ OC_INLINE void Deserialize (Val& v, OCLoadContext_& lc)
       case 'Z': 
 	if (lc.compat_ || v.tag=='n') {
 	  v.tag = 'n'; v.subtype = 'Z';
-	  Arr*ap=(Arr*)&v.u.n;
-	  new (ap) Arr(len); 
+	  Arr*ap=(Arr*)v.newSpace_(sizeof(Arr));
+	  new (ap) Arr(len, alloc); 
 	  for(int ii=0; ii<ilen; ii++) {
 	    ap->append(Val());
 	    Deserialize((*ap)[ii], lc);
 	  }
 	} else {
-	  Tup*tp=(Tup*)&v.u.u;
+	  Tup*tp=(Tup*)v.newSpace_(sizeof(Tup));
 	  new (tp) Tup();
+	  Array<Val> exact(len, alloc); // exactly, so no regrowing as we append
+	  tp->impl().swap(exact);
 	  Arr& impl = (Arr&)tp->impl();
 	  for(int ii=0; ii<ilen; ii++) {
 	    impl.append(Val());
@@ -867,15 +946,15 @@ OC_INLINE void DeserializeProxy (Val& v, OCLoadContext_& lc)
   // Assertion: NOT AVAILABLE! The first time we have deserialized
   // this proxy, so we have to completely pull it out.  First,
   // Deserialize the rest of the preamble
-  bool adopt, lock, shm;
+  bool adopt, lock; char shm;
   VALDECOPY(bool, adopt);
   VALDECOPY(bool, lock);
-  VALDECOPY(bool, shm);  // TODO; do something with this?
+  VALDECOPY(char, shm);  // TODO; do something with this?
 
   // Now, Deserialize the full body as normal, then turn into proxy in
   // O(1) time
   Deserialize(v, lc);   
-  v.Proxyize(adopt, lock);
+  v.Proxyize(adopt, lock, shm=='C');
 
   // Add marker back in
   lc.lookup_[marker] = v;
@@ -892,4 +971,322 @@ char* Deserialize (Val& v, char* mem, bool compatibility)
 }
 
 
+/////////////////////////// OCPushDeserializer
+
+// One container an OCPushDeserializer is in the middle of filling in
+struct OCLoadFrame_ {
+  char kind;        // 't' Tab, 'o' OTab, 'n' Arr or Tup (the Array<Val>),
+                    // 'N' the data of an Array of POD, 'P' a proxy's body
+  size_t remaining; // items left (keys and values both count), bytes for 'N'
+  void* container;  // Tab*, OTab*, Array<Val>*, or where the data goes ('N')
+  Val* val;         // the Val being built
+  Val key;          // tables: the key just deserialized
+  int_4 marker;     // proxies: the marker and flags
+  bool adopt, lock;
+  char shm;
+}; // OCLoadFrame_
+
+OCPushDeserializer::~OCPushDeserializer ()
+{
+  for (size_t ii=0; ii<frames_.length(); ii++) {
+    delete frames_[ii];
+  }
+}
+
+void OCPushDeserializer::reset ()
+{
+  depth_ = 0;
+  lookup_.clear();
+  pending_.clear();
+  into_ = slot_ = 0;
+}
+
+void OCPushDeserializer::holdBack_ (const char* data, size_t len)
+{
+  if (len==0) return;
+  const size_t had = pending_.length();
+  if (had+len > pending_.capacity()) {
+    pending_.resize(had+len < 2*had ? 2*had : had+len);
+  }
+  pending_.expandTo(had+len);
+  memcpy(pending_.data()+had, data, len);
+}
+
+OCLoadFrame_& OCPushDeserializer::push_ (char kind, Val* v, void* container,
+				     size_t remaining)
+{
+  if (depth_==frames_.length()) {
+    frames_.append(new OCLoadFrame_);
+  }
+  OCLoadFrame_& f = *frames_[depth_++];
+  f.kind = kind;
+  f.val = v;
+  f.container = container;
+  f.remaining = remaining;
+  return f;
+}
+
+// How many bytes the next item (a whole number or string, or just
+// the header of a table, array or proxy) takes, or 0 if there isn't
+// enough there to tell yet
+size_t OCPushDeserializer::itemBytes_ (const char* mem, size_t len)
+{
+  if (len==0) return 0;
+  switch (mem[0]) {
+  case 's': case 'S': return 1+sizeof(int_1);
+  case 'i': case 'I': return 1+sizeof(int_2);
+  case 'l': case 'L': return 1+sizeof(int_4);
+  case 'x': case 'X': return 1+sizeof(int_8);
+  case 'b': return 1+sizeof(bool);
+  case 'f': return 1+sizeof(real_4);
+  case 'd': return 1+sizeof(real_8);
+  case 'F': return 1+sizeof(complex_8);
+  case 'D': return 1+sizeof(complex_16);
+  case 'Z': return 1;
+  case 'q': case 'Q': case 'a': { // tag, int_u4 len, then len bytes
+    if (len<1+sizeof(int_u4)) return 0;
+    int_u4 bytes; memcpy(&bytes, mem+1, sizeof(int_u4));
+    return 1+sizeof(int_u4)+size_t(bytes);
+  }
+  case 't': case 'o': return 1+sizeof(int_u4);
+  case 'u': case 'n': return 1+1+sizeof(int_u4);
+  case 'P': { // 'P', marker, then adopt, lock, shm (if not seen already)
+    if (len<1+sizeof(int_4)) return 0;
+    int_4 marker; memcpy(&marker, mem+1, sizeof(int_4));
+    if (lookup_.contains(marker)) return 1+sizeof(int_4);
+    return 1+sizeof(int_4)+sizeof(bool)+sizeof(bool)+sizeof(char);
+  }
+  default: unknownType_("Deserialize", mem[0]);
+  }
+  return 0;
+}
+
+// Deserialize the next item into v, just like Deserialize does: but
+// tables, arrays and proxies only get started (their contents come
+// later, see nextSlot_).
+#define OCLOADPOD(T) { Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>)); new (ap) Array<T>(len, alloc); ap->expandTo(len); if (len) push_('N', &v, ap->data(), sizeof(T)*size_t(len)); }
+void OCPushDeserializer::loadItem_ (const char* start, Val& v)
+{
+  char* mem = const_cast<char*>(start);
+  Allocator* alloc = v.allocator(); // everything is built with v's allocator
+
+  if (v.tag!='Z') { // Don't let anything be serialized EXCEPT empty Val
+    throw logic_error("You can only deserialize into an empty Val.");
+  }
+
+  if (*mem=='P') {
+    mem++;
+    int_4 marker;
+    VALDECOPY(int_4, marker);
+    if (lookup_.contains(marker)) {
+      v = lookup_(marker);     // There, just attach to new Proxy
+      return;
+    }
+    OCLoadFrame_& f = push_('P', &v, 0, 1);
+    f.marker = marker;
+    VALDECOPY(bool, f.adopt);
+    VALDECOPY(bool, f.lock);
+    VALDECOPY(char, f.shm);
+    return;
+  }
+
+  v.tag = *mem++; // Grab tag 
+  switch(v.tag) {
+  case 's': VALDECOPY(int_1,  v.u.s); break;
+  case 'S': VALDECOPY(int_u1, v.u.S); break;
+  case 'i': VALDECOPY(int_2,  v.u.i); break;
+  case 'I': VALDECOPY(int_u2, v.u.I); break;
+  case 'l': VALDECOPY(int_4,  v.u.l); break;
+  case 'L': VALDECOPY(int_u4, v.u.L); break;
+  case 'x': VALDECOPY(int_8,  v.u.x); break;
+  case 'X': VALDECOPY(int_u8, v.u.X); break;
+  case 'b': VALDECOPY(bool,   v.u.b); break;
+  case 'f': VALDECOPY(real_4, v.u.f); break;
+  case 'd': VALDECOPY(real_8, v.u.d); break;
+  case 'F': VALDECOPY(complex_8, v.u.F); break;
+  case 'D': VALDECOPY(complex_16, *(complex_16*)v.newSpace_(sizeof(complex_16))); break;
+
+  case 'q': { 
+    int_u4 len; VALDECOPY(int_u4, len);
+    int_n* ip=(int_n*)v.newSpace_(sizeof(int_n)); 
+    new (ip) int_n(0, alloc);
+    MakeBigIntFromBinary(mem, len, *ip);
+    if (compat_) {
+      string s = ip->stringize();
+      v = s;
+    }
+    break;
+  }
+  case 'Q': { 
+    int_u4 len; VALDECOPY(int_u4, len);
+    int_un* ip=(int_un*)v.newSpace_(sizeof(int_un)); 
+    new (ip) int_un(0, alloc);
+    MakeBigUIntFromBinary(mem, len, *ip);
+    if (compat_) {
+      string s = ip->stringize();
+      v = s;
+    }
+    break;
+  }
+
+  case 'a': {
+    int_u4 len; VALDECOPY(int_u4, len);
+    OCString* sp = (OCString*)v.newSpace_(sizeof(OCString)); new (sp) OCString(mem, len, alloc);
+    break;
+  }
+
+  case 't':
+  case 'o': {
+    int_u4 len; VALDECOPY(int_u4, len);
+    if (compat_ || v.tag=='t') {
+      v.tag = 't';
+      Tab* tp = (Tab*)v.newSpace_(sizeof(Tab)); new (tp) Tab(alloc); 
+      push_('t', &v, tp, 2*size_t(len));
+    } else {
+      OTab* tp = (OTab*)v.newSpace_(sizeof(OTab)); new (tp) OTab(alloc); 
+      push_('o', &v, tp, 2*size_t(len));
+    }
+    break;
+  }
+
+  case 'u':
+  case 'n': {
+    v.subtype = *mem++;
+    int_u4 len; VALDECOPY(int_u4, len);
+    switch(v.subtype) {
+    case 's': OCLOADPOD(int_1);  break;
+    case 'S': OCLOADPOD(int_u1); break;
+    case 'i': OCLOADPOD(int_2);  break;
+    case 'I': OCLOADPOD(int_u2); break;
+    case 'l': OCLOADPOD(int_4);  break;
+    case 'L': OCLOADPOD(int_u4); break;
+    case 'x': OCLOADPOD(int_8);  break;
+    case 'X': OCLOADPOD(int_u8); break;
+    case 'b': OCLOADPOD(bool); break;
+    case 'f': OCLOADPOD(real_4); break;
+    case 'd': OCLOADPOD(real_8); break;
+    case 'F': OCLOADPOD(complex_8); break;
+    case 'D': OCLOADPOD(complex_16); break;
+    case 'a': 
+    case 't':   // Serialize never makes these
+    case 'o': throw logic_error("Can't have arrays of non POD data");
+    case 'u': throw logic_error("Can't have POD arrays of tuples");
+    case 'n': throw logic_error("Can't have POD arrays of POD arrays");
+    case 'Z': 
+      if (compat_ || v.tag=='n') {
+	v.tag = 'n'; v.subtype = 'Z';
+	Arr*ap=(Arr*)v.newSpace_(sizeof(Arr));
+	new (ap) Arr(len, alloc); 
+	push_('n', &v, ap, len);
+      } else {
+	Tup*tp=(Tup*)v.newSpace_(sizeof(Tup));
+	new (tp) Tup();
+	Array<Val> exact(len, alloc); // exactly, so no regrowing as we append
+	tp->impl().swap(exact);
+	push_('n', &v, &tp->impl(), len);
+      }
+      break;
+    default: unknownType_("Deserialize Array", v.subtype);
+    }
+    break;
+  }
+  case 'Z': break; // Already copied the tag out, nothing else
+  default: unknownType_("Deserialize", v.tag);
+  }
+}
+
+// The Val the next item goes into: finishes off any containers that
+// are full.  Returns 0 when the into Val is complete.
+Val* OCPushDeserializer::nextSlot_ ()
+{
+  while (depth_) {
+    OCLoadFrame_& f = *frames_[depth_-1];
+    if (f.remaining) {
+      switch (f.kind) {
+      case 'N': return f.val;                   // still waiting for data
+      case 'P': f.remaining = 0; return f.val;  // the body, in place
+      case 'n': {
+	Array<Val>& a = *(Array<Val>*)f.container;
+	f.remaining--;
+	a.append(Val());
+	return &a(a.length()-1);
+      }
+      default: // Tables: a key, then its value
+	if (f.remaining-- % 2 == 0) {
+	  f.key = Val();
+	  return &f.key;
+	}
+	if (f.kind=='t') return &(*(Tab*)f.container)[f.key];
+	return &(*(OTab*)f.container)[f.key];
+      }
+    }
+
+    // This container is complete: proxies are turned into proxies
+    // (in O(1) time) only once their body is all there
+    if (f.kind=='P') {
+      f.val->Proxyize(f.adopt, f.lock, f.shm=='C');
+      lookup_[f.marker] = *f.val;
+    } else if (f.kind=='t' || f.kind=='o') {
+      f.key = Val();
+    }
+    depth_--;
+  }
+  return 0;
+}
+
+bool OCPushDeserializer::feed (const char* data, size_t len, Val& into)
+{
+  if (!into_) {
+    if (into.tag!='Z') {
+      throw logic_error("You can only deserialize into an empty Val.");
+    }
+    into_ = slot_ = &into;
+  } else if (into_!=&into) {
+    throw logic_error("OCPushDeserializer: feed the same Val until done");
+  }
+
+  // Deserialize straight out of the given data, unless part of an
+  // item was held back last time
+  const bool held = pending_.length()!=0;
+  if (held) holdBack_(data, len);
+  const char* mem = held ? pending_.data() : data;
+  size_t left = held ? pending_.length() : len;
+
+  bool done = false;
+  while (!done) {
+    if (depth_ && frames_[depth_-1]->kind=='N') {
+      // The data of an Array of POD goes right into the Array
+      OCLoadFrame_& f = *frames_[depth_-1];
+      const size_t bytes = (f.remaining<left) ? f.remaining : left;
+      memcpy(f.container, mem, bytes);
+      f.container = (char*)f.container + bytes;
+      f.remaining -= bytes;
+      mem += bytes;
+      left -= bytes;
+      if (f.remaining) break;
+    } else {
+      const size_t need = itemBytes_(mem, left);
+      if (need==0 || need>left) break;
+      loadItem_(mem, *slot_);
+      mem += need;
+      left -= need;
+    }
+    slot_ = nextSlot_();
+    done = (slot_==0);
+  }
+
+  // Whatever hasn't been deserialized waits for the next feed
+  if (held) {
+    memmove(pending_.data(), mem, left);
+    pending_.expandTo(left);
+  } else {
+    holdBack_(mem, left);
+  }
+  if (!done) return false;
+  lookup_.clear();
+  into_ = 0;
+  return true;
+}
+
+
 OC_END_NAMESPACE
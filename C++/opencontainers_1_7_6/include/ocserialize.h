@@ -1,6 +1,7 @@
 #ifndef OCSERIALIZE_H_
 
 #include "ocval.h"
+#include "ocdumpsink.h"
 
 OC_BEGIN_NAMESPACE
 
@@ -72,15 +73,91 @@ OC_INLINE char* Serialize (const Arr& s, char* mem,
 template <class T>
 OC_INLINE char* Serialize (const Array<T>& s, char* mem);
 
+// Serialize onto the end of the given buffer in a single pass (no
+// BytesToSerialize first): the buffer grows as needed, and its length
+// is set to include the new serialization.  This returns how many
+// bytes were serialized.
+OC_INLINE size_t SerializeToArray (const Val& v, Array<char>& buffer,
+				   bool compatibility=OC_SERIALIZE_COMPAT);
+
+// Serialize to the given sink (see ocdumpsink.h) in a single pass,
+// a chunk of (at most about) chunk_bytes at a time, so the whole
+// serialization is never in memory.  The output is exactly what
+// Serialize gives.
+OC_INLINE void SerializeToSink (const Val& v, DumpSink& sink,
+				bool compatibility=OC_SERIALIZE_COMPAT,
+				size_t chunk_bytes=OC_DUMP_CHUNK);
+
 // Deserialize into the given memory.  It assumes there is enough
 // memory (computed with BytesToSerialize) to deserialize from. This
 // returns one byte beyond where it serialized (so mem-return value is
 // how many bytes it serialized).  The into val has to be an "empty"
-// Val or it throws a logic_error exception.
+// Val or it throws a logic_error exception.  If the into Val uses an
+// allocator (see ocvalarena.h), everything is built with that
+// allocator.
 OC_INLINE char* Deserialize (Val& into, char* mem, 
 			     bool compatibility=OC_SERIALIZE_COMPAT);
 
 
+// Deserialize in push mode: rather than needing the whole
+// serialization in memory first, give it to an OCPushDeserializer a
+// piece at a time as it comes in (from a non-blocking socket, say).
+// Everything complete is built right away (the arrays of POD are
+// copied straight into the final Array as their data shows up), and
+// only an item split across pieces (a string, a number, a header) is
+// held back until the rest of it comes in.  feed returns true once
+// the into Val is complete (and exactly what Deserialize would have
+// given), false if it needs more.  The into Val is built in place, so
+// give the same (empty) Val to every feed until it's complete.
+// Anything past the end of the serialization is kept for the next
+// one: feed(0,0,next) to deserialize it.
+//
+//   OCPushDeserializer ocd;
+//   Val v;
+//   while ((n=read(fd, buff, sizeof(buff)))>0) {
+//     if (ocd.feed(buff, n, v)) break;
+//   }
+//
+// If feed throws, reset before using it again.
+struct OCLoadFrame_;
+class OCPushDeserializer {
+ public:
+  OCPushDeserializer (bool compatibility=OC_SERIALIZE_COMPAT) :
+    compat_(compatibility), depth_(0), into_(0), slot_(0) { }
+  OC_INLINE ~OCPushDeserializer ();
+
+  // Give the next piece of the serialization: true when into is done
+  OC_INLINE bool feed (const char* data, size_t len, Val& into);
+
+  // Forget everything (including whatever was held back)
+  OC_INLINE void reset ();
+
+ protected:
+  bool compat_;             // See Deserialize
+  Array<char> pending_;     // Given but not deserialized yet
+
+  // The containers being filled in, innermost last: only the first
+  // depth_ are in use, the rest are kept around to be reused
+  Array<OCLoadFrame_*> frames_;
+  size_t depth_;
+
+  // Proxies we've seen already, by marker
+  AVLHashT<int_4, Proxy, 8> lookup_;
+
+  Val* into_;               // What's being built, 0 if nothing yet
+  Val* slot_;               // The next Val to fill in
+
+  // Helpers
+  OC_INLINE size_t itemBytes_ (const char* mem, size_t len);
+  OC_INLINE void loadItem_ (const char* mem, Val& v);
+  OC_INLINE Val* nextSlot_ ();
+  OC_INLINE OCLoadFrame_& push_ (char kind, Val* v, void* container,
+				 size_t remaining);
+  OC_INLINE void holdBack_ (const char* data, size_t len);
+
+}; // OCPushDeserializer
+
+
 //#if defined(OC_USE_OC_STRING)
 // Still have to be able handle OCStrings even if not using...
 OC_INLINE char* Serialize (const OCString&, char *mem);
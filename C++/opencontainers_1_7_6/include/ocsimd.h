@@ -0,0 +1,252 @@
+#ifndef OC_SIMD_H_
+
+// Vectorized (SSE2 and AVX2) kernels for the low-level numeric loops
+// that show up on every packet: converting whole buffers from one POD
+// type to another (see BufferConvert in ocnumerictools.h).  Every
+// kernel has a plain scalar loop to fall back on, and they all give
+// exactly the same answers as the scalar loop (int to real and real_8
+// to real_4 round the same way, with the same MXCSR).
+//
+// On x86 (with g++ or clang), the SSE2 kernels are always there (SSE2
+// is part of x86_64), and the AVX2 kernels are compiled in (with the
+// target attribute, so no special compiler options are needed) and
+// used when the CPU we're running on has AVX2: that is checked once,
+// at runtime.  On other machines (or with -D OC_NO_SIMD), everything
+// is just the scalar loop.  -D OC_NO_AVX2 leaves out just the AVX2.
+
+#include "ocport.h"
+
+#if !defined(OC_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+# define OC_SIMD_SSE2
+extern "C" {
+# include <string.h>  // memcpy
+}
+# include <emmintrin.h>
+# if !defined(OC_NO_AVX2) && \
+     (defined(__clang__) || __GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=9))
+#  define OC_SIMD_AVX2
+#  include <immintrin.h>
+# endif
+#endif
+
+OC_BEGIN_NAMESPACE
+
+// Does the CPU we are running on have AVX2 (and is it compiled in)?
+inline bool OCHasAVX2 ()
+{
+#if defined(OC_SIMD_AVX2)
+  static int has_avx2 = -1;  // benign race: all threads get the same answer
+  if (has_avx2<0) {
+    __builtin_cpu_init();
+    has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return has_avx2==1;
+#else
+  return false;
+#endif
+}
+
+// Converting less than this many elements isn't worth the setup
+#define OC_SIMD_MIN_LENGTH 16
+
+// The plain loop: also finishes up what the kernels leave over
+template <class IT, class OT>
+inline void ScalarConvert_ (const IT* in, OT* out, int len)
+{
+  for (int ii=0; ii<len; ii++) {
+    out[ii] = OT(in[ii]);
+  }
+}
+
+
+#if defined(OC_SIMD_SSE2)
+
+// ///////////////////////////////////////////// SSE2
+
+// Load 4 integers of type IT and widen them to 4 int_4s
+inline __m128i SSE2Widen4_ (const int_4* in)
+{ return _mm_loadu_si128((const __m128i*)in); }
+
+inline __m128i SSE2Widen4_ (const int_2* in)
+{
+  __m128i x = _mm_loadl_epi64((const __m128i*)in);
+  return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16); // sign extend
+}
+
+inline __m128i SSE2Widen4_ (const int_u2* in)
+{
+  __m128i x = _mm_loadl_epi64((const __m128i*)in);
+  return _mm_unpacklo_epi16(x, _mm_setzero_si128());
+}
+
+inline __m128i SSE2Widen4_ (const int_1* in)
+{
+  int_4 bytes; memcpy(&bytes, in, sizeof(bytes));
+  __m128i x = _mm_cvtsi32_si128(bytes);
+  x = _mm_unpacklo_epi8(x, x);
+  return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24); // sign extend
+}
+
+inline __m128i SSE2Widen4_ (const int_u1* in)
+{
+  int_4 bytes; memcpy(&bytes, in, sizeof(bytes));
+  __m128i zero = _mm_setzero_si128();
+  __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+  return _mm_unpacklo_epi16(x, zero);
+}
+
+// Store 4 int_4s as reals
+inline void SSE2Store4_ (__m128i v, real_4* out)
+{ _mm_storeu_ps(out, _mm_cvtepi32_ps(v)); }
+
+inline void SSE2Store4_ (__m128i v, real_8* out)
+{
+  _mm_storeu_pd(out,   _mm_cvtepi32_pd(v));
+  _mm_storeu_pd(out+2, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, 0xEE)));
+}
+
+template <class IT, class OT>
+inline int SSE2IntToReal_ (const IT* in, OT* out, int len)
+{
+  int ii = 0;
+  for (; ii+4<=len; ii+=4) {
+    SSE2Store4_(SSE2Widen4_(in+ii), out+ii);
+  }
+  return ii;
+}
+
+inline int SSE2RealToReal_ (const real_4* in, real_8* out, int len)
+{
+  int ii = 0;
+  for (; ii+4<=len; ii+=4) {
+    __m128 x = _mm_loadu_ps(in+ii);
+    _mm_storeu_pd(out+ii,   _mm_cvtps_pd(x));
+    _mm_storeu_pd(out+ii+2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+  }
+  return ii;
+}
+
+inline int SSE2RealToReal_ (const real_8* in, real_4* out, int len)
+{
+  int ii = 0;
+  for (; ii+4<=len; ii+=4) {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in+ii));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in+ii+2));
+    _mm_storeu_ps(out+ii, _mm_movelh_ps(lo, hi));
+  }
+  return ii;
+}
+
+#endif // OC_SIMD_SSE2
+
+
+#if defined(OC_SIMD_AVX2)
+
+// ///////////////////////////////////////////// AVX2
+
+#define OC_AVX2 __attribute__((target("avx2")))
+
+// Load 8 integers of type IT and widen them to 8 int_4s
+OC_AVX2 inline __m256i AVX2Widen8_ (const int_4* in)
+{ return _mm256_loadu_si256((const __m256i*)in); }
+
+OC_AVX2 inline __m256i AVX2Widen8_ (const int_2* in)
+{ return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)in)); }
+
+OC_AVX2 inline __m256i AVX2Widen8_ (const int_u2* in)
+{ return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)in)); }
+
+OC_AVX2 inline __m256i AVX2Widen8_ (const int_1* in)
+{ return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)in)); }
+
+OC_AVX2 inline __m256i AVX2Widen8_ (const int_u1* in)
+{ return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)in)); }
+
+// Store 8 int_4s as reals
+OC_AVX2 inline void AVX2Store8_ (__m256i v, real_4* out)
+{ _mm256_storeu_ps(out, _mm256_cvtepi32_ps(v)); }
+
+OC_AVX2 inline void AVX2Store8_ (__m256i v, real_8* out)
+{
+  _mm256_storeu_pd(out,   _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+  _mm256_storeu_pd(out+4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v,1)));
+}
+
+template <class IT, class OT>
+OC_AVX2 inline int AVX2IntToReal_ (const IT* in, OT* out, int len)
+{
+  int ii = 0;
+  for (; ii+8<=len; ii+=8) {
+    AVX2Store8_(AVX2Widen8_(in+ii), out+ii);
+  }
+  return ii;
+}
+
+OC_AVX2 inline int AVX2RealToReal_ (const real_4* in, real_8* out, int len)
+{
+  int ii = 0;
+  for (; ii+8<=len; ii+=8) {
+    _mm256_storeu_pd(out+ii,   _mm256_cvtps_pd(_mm_loadu_ps(in+ii)));
+    _mm256_storeu_pd(out+ii+4, _mm256_cvtps_pd(_mm_loadu_ps(in+ii+4)));
+  }
+  return ii;
+}
+
+OC_AVX2 inline int AVX2RealToReal_ (const real_8* in, real_4* out, int len)
+{
+  int ii = 0;
+  for (; ii+8<=len; ii+=8) {
+    _mm_storeu_ps(out+ii,   _mm256_cvtpd_ps(_mm256_loadu_pd(in+ii)));
+    _mm_storeu_ps(out+ii+4, _mm256_cvtpd_ps(_mm256_loadu_pd(in+ii+4)));
+  }
+  return ii;
+}
+
+#endif // OC_SIMD_AVX2
+
+
+// ///////////////////////////////////////////// Dispatch
+
+// Convert an integer buffer (int_1, int_u1, int_2, int_u2, int_4) to
+// a real buffer (real_4, real_8)
+template <class IT, class OT>
+inline void SIMDIntToReal (const IT* in, OT* out, int len)
+{
+  int done = 0;
+#if defined(OC_SIMD_SSE2)
+  if (len>=OC_SIMD_MIN_LENGTH) {
+# if defined(OC_SIMD_AVX2)
+    if (OCHasAVX2()) {
+      done = AVX2IntToReal_(in, out, len);
+    } else
+# endif
+    done = SSE2IntToReal_(in, out, len);
+  }
+#endif
+  ScalarConvert_(in+done, out+done, len-done);
+}
+
+// Convert real_4 to real_8, or real_8 to real_4 (complex buffers
+// too: they are just twice as many reals)
+template <class IT, class OT>
+inline void SIMDRealToReal (const IT* in, OT* out, int len)
+{
+  int done = 0;
+#if defined(OC_SIMD_SSE2)
+  if (len>=OC_SIMD_MIN_LENGTH) {
+# if defined(OC_SIMD_AVX2)
+    if (OCHasAVX2()) {
+      done = AVX2RealToReal_(in, out, len);
+    } else
+# endif
+    done = SSE2RealToReal_(in, out, len);
+  }
+#endif
+  ScalarConvert_(in+done, out+done, len-done);
+}
+
+OC_END_NAMESPACE
+
+#define OC_SIMD_H_
+#endif // OC_SIMD_H_
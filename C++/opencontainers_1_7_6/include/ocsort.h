@@ -6,6 +6,10 @@
 // Quick sort is best case O(n*log(n)), average case O(n*log(n), 
 //  worst case O(n^2).  It frequently does better than most sorts
 //  (and in fact uses insertion sort as a backup for small containers).
+// Radix sort is O(n) (one pass per byte of the key), but only works
+//  on plain arrays of integers and reals.  It uses an extra n elements
+//  of scratch space.
+// (For sorting with multiple threads, see ocparallelsort.h)
 
 // TODO: In a world that supports proper templates, CONTAINER would be
 // CONTAINER<CONTAINED_TYPE> so we wouldn't have to pass both types
@@ -348,6 +352,124 @@ void OCMedian (CONTAINER& c, int start, int length,
   return_value = c[start+length/2];
 }
 
+
+// ///////////////////////////////////////////// Radix Sort
+
+// Radix sort never compares elements: it looks at the bits of each
+// element, one byte at a time (least significant byte first), so it
+// only works for the integer and real types.  Each type is viewed as
+// an unsigned integer of the same size which sorts the same way:
+// signed integers flip the sign bit, reals flip the sign bit if
+// positive and all the bits if negative.  (So -0.0 sorts before 0.0,
+// and NaNs sort to the front or back depending on their sign).
+template <class T> struct OCRadixKey_ { enum { radixable = 0 }; };
+
+#define OCRADIXKEY_UNSIGNED(T) \
+template <> struct OCRadixKey_<T> { \
+  enum { radixable = 1 }; \
+  typedef T key_type; \
+  static key_type key (key_type u) { return u; } \
+};
+#define OCRADIXKEY_SIGNED(T, U) \
+template <> struct OCRadixKey_<T> { \
+  enum { radixable = 1 }; \
+  typedef U key_type; \
+  static key_type key (key_type u) \
+  { return u ^ (key_type(1)<<(sizeof(U)*8-1)); } \
+};
+#define OCRADIXKEY_REAL(T, U) \
+template <> struct OCRadixKey_<T> { \
+  enum { radixable = 1 }; \
+  typedef U key_type; \
+  static key_type key (key_type u) \
+  { const key_type sign = key_type(1)<<(sizeof(U)*8-1); \
+    return (u & sign) ? ~u : (u ^ sign); } \
+};
+OCRADIXKEY_UNSIGNED(int_u1)
+OCRADIXKEY_UNSIGNED(int_u2)
+OCRADIXKEY_UNSIGNED(int_u4)
+OCRADIXKEY_UNSIGNED(int_u8)
+OCRADIXKEY_SIGNED(int_1, int_u1)
+OCRADIXKEY_SIGNED(int_2, int_u2)
+OCRADIXKEY_SIGNED(int_4, int_u4)
+OCRADIXKEY_SIGNED(int_8, int_u8)
+OCRADIXKEY_REAL(real_4, int_u4)
+OCRADIXKEY_REAL(real_8, int_u8)
+
+// The sortable key for an element
+template <class T>
+inline typename OCRadixKey_<T>::key_type OCRadixKeyOf_ (const T& t)
+{
+  typename OCRadixKey_<T>::key_type k;
+  memcpy(&k, &t, sizeof(k));  // memcpy so reals aren't type-punned
+  return OCRadixKey_<T>::key(k);
+}
+
+// Allows you to tune when you use QuickSort (instead of radix sort)
+// for small arrays inside of OCRadixSort.
+#ifndef OC_RADIXTUNE
+# define OC_RADIXTUNE 256
+#endif
+
+// Sort a portion of a plain array of integers or reals inplace using
+// an LSD radix sort: If you want to sort the entire array, start=0,
+// len=length_of_array.  A pass is skipped if every element has the
+// same value in that byte (so small values in int_8s are cheap).
+template <class T>
+void OCRadixSort (T* c, int start, int length)
+{
+  if (length < OC_RADIXTUNE) {
+    OCQuickSort(c, start, length);
+    return;
+  }
+
+  // One pass over the data to get the counts for every byte
+  const int bytes = sizeof(T);
+  Array<int> counts(bytes*256);
+  counts.fill(0, bytes*256);
+  int* count = counts.data();
+  T* data = c+start;
+  for (int ii=0; ii<length; ii++) {
+    typename OCRadixKey_<T>::key_type k = OCRadixKeyOf_(data[ii]);
+    for (int b=0; b<bytes; b++) {
+      count[b*256 + int((k>>(b*8)) & 0xFF)]++;
+    }
+  }
+
+  // Scatter back and forth between the data and the scratch, a byte
+  // at a time
+  Array<T> scratch(length);
+  scratch.expandTo(length);
+  T* from = data;
+  T* to = scratch.data();
+  for (int b=0; b<bytes; b++) {
+    int* bucket = count + b*256;
+    const int shift = b*8;
+    if (bucket[int((OCRadixKeyOf_(data[0])>>shift) & 0xFF)]==length) {
+      continue;  // all the same in this byte: nothing moves
+    }
+    int offset = 0;
+    for (int d=0; d<256; d++) {
+      int n = bucket[d];
+      bucket[d] = offset;
+      offset += n;
+    }
+    for (int ii=0; ii<length; ii++) {
+      int d = int((OCRadixKeyOf_(from[ii])>>shift) & 0xFF);
+      to[bucket[d]++] = from[ii];
+    }
+    T* temp = from; from = to; to = temp;
+  }
+  if (from!=data) {
+    memcpy(data, from, length*sizeof(T));
+  }
+}
+
+// Radix sort a portion of an Array
+template <class T>
+inline void OCRadixSort (Array<T>& a, int start, int length)
+{ OCRadixSort(a.data(), start, length); }
+
 OC_END_NAMESPACE
 
 #define OCSORT_H_
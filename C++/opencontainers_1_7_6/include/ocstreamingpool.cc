@@ -18,6 +18,7 @@ OC_INLINE static bool isPowerOfTwo (int n)
 
 OC_INLINE bool StreamingPool::isPristine () const
 {
+  if (arena_) return arenaAllocated_==0;
   SPInfo_* pool = pool_();
   return (freelist_.next_ == pool && freelist_.prev_ == pool &&
 	  pool->isFree());
@@ -52,6 +53,13 @@ OC_INLINE StreamingPool::StreamingPool (char* /*memory*/, int bytes,
   poolOffset_(0),
   scheduledForDeletion_(false),
   bytes_(bytes),
+  arena_(false),
+  arenaNext_(0),
+  arenaEnd_(0),
+  arenaChunks_(0),
+  arenaSpare_(0),
+  arenaChunkBytes_(0),
+  arenaAllocated_(0),
   lock_(true), // use across processes???????
   freelist_(0,0,0) // freelist node, not part of managed memory
 {
@@ -104,8 +112,127 @@ OC_INLINE StreamingPool::StreamingPool (char* /*memory*/, int bytes,
 }
 
 
+// Round up to the alignment (a power of 2)
+inline char* ArenaAlign_ (char* mem, int alignment)
+{
+  AVLP m = (AVLP)mem;
+  return (char*)((m + alignment - 1) & ~AVLP(alignment - 1));
+}
+
+OC_INLINE StreamingPool::StreamingPool (char* memory, int bytes, 
+				       int alignment_restrictions,
+				       int overflow_bytes) :
+  alignment_(alignment_restrictions),
+  poolOffset_(0),
+  scheduledForDeletion_(false),
+  bytes_(bytes),
+  arena_(true),
+  arenaNext_(0),
+  arenaEnd_(memory+bytes),
+  arenaChunks_(0),
+  arenaSpare_(0),
+  arenaChunkBytes_(overflow_bytes<1024 ? 1024 : overflow_bytes),
+  arenaAllocated_(0),
+  lock_(false),
+  freelist_(0,0,0) // unused by arenas
+{
+  if (alignment_<4 || !isPowerOfTwo(alignment_) || alignment_>ALIGN_MAX) {
+    throw logic_error("You can only create StreamingPools with alignment "
+		      " restrictions of powers of 2 (or >=4 or <ALIGN_MAX)");
+  }
+  // The arena starts right after the bookkeeping
+  arenaNext_ = ArenaAlign_(&poolData_[0], alignment_);
+}
+
+// Every chunk the arena gets from the heap starts with a pointer to
+// the previous chunk, then its size
+struct ArenaChunk_ {
+  char* previous;
+  int_8 bytes;
+};
+
+OC_INLINE char* StreamingPool::arenaOverflow_ (int bytes_requested)
+{
+  // Leave enough room for the header, and to align the user memory
+  int_8 header = sizeof(ArenaChunk_) + alignment_;
+  char* chunk = 0;
+  ArenaChunk_* spare = (ArenaChunk_*)arenaSpare_;
+  if (spare && bytes_requested+header <= spare->bytes) {
+    chunk = arenaSpare_;  // Kept from the last reset
+    arenaSpare_ = 0;
+  } else {
+    int_8 chunk_bytes = arenaChunkBytes_;
+    if (bytes_requested+header > chunk_bytes) {
+      chunk_bytes = bytes_requested + header;
+    } else if (arenaChunkBytes_ < (1<<30)) {
+      arenaChunkBytes_ *= 2;  // Fewer, bigger chunks as the arena grows
+    }
+    chunk = (char*)::operator new(size_t(chunk_bytes));
+    ((ArenaChunk_*)chunk)->bytes = chunk_bytes;
+  }
+  ArenaChunk_* c = (ArenaChunk_*)chunk;
+  c->previous = arenaChunks_;
+  arenaChunks_ = chunk;
+
+  char* memory = ArenaAlign_(chunk+sizeof(ArenaChunk_), alignment_);
+  arenaNext_ = memory + bytes_requested;
+  arenaEnd_  = chunk + c->bytes;
+  arenaAllocated_ += bytes_requested;
+  return memory;
+}
+
+OC_INLINE bool StreamingPool::owns (const char* memory) const
+{
+  const char* start = (const char*)this;
+  if (memory>=start && memory<start+bytes_) return true;
+  for (char* chunk=arenaChunks_; chunk; 
+       chunk=((ArenaChunk_*)chunk)->previous) {
+    if (memory>=chunk && memory<chunk+((ArenaChunk_*)chunk)->bytes) {
+      return true;
+    }
+  }
+  return false;
+}
+
+OC_INLINE void StreamingPool::resetArena (bool keep_biggest_chunk)
+{
+  // All chunks go back to the heap, except (maybe) the biggest
+  char* chunk = arenaChunks_;
+  while (chunk) {
+    char* previous = ((ArenaChunk_*)chunk)->previous;
+    if (keep_biggest_chunk && (arenaSpare_==0 || 
+	((ArenaChunk_*)chunk)->bytes > ((ArenaChunk_*)arenaSpare_)->bytes)) {
+      char* old_spare = arenaSpare_;
+      arenaSpare_ = chunk;
+      chunk = old_spare;
+    }
+    if (chunk) ::operator delete(chunk);
+    chunk = previous;
+  }
+  if (!keep_biggest_chunk && arenaSpare_) {
+    ::operator delete(arenaSpare_);
+    arenaSpare_ = 0;
+  }
+  arenaChunks_ = 0;
+  arenaNext_ = ArenaAlign_(&poolData_[0], alignment_);
+  arenaEnd_  = (char*)this + bytes_;
+  arenaAllocated_ = 0;
+}
+
+
 OC_INLINE char* StreamingPool::allocate (int bytes_requested)
 {
+  // Arena: just bump through the current chunk
+  if (arena_) {
+    char* memory = ArenaAlign_(arenaNext_, alignment_);
+    if (memory+bytes_requested > arenaEnd_) {
+      return arenaOverflow_(bytes_requested);
+    }
+    arenaNext_ = memory + bytes_requested;
+    arenaAllocated_ += bytes_requested;
+    return memory;
+  }
+
   // An allocation request has to be at least as big as the
   // difference between an inuse node and a free node (there has
   // to be enough space to hold the next and prev pointer when
@@ -149,6 +276,9 @@ OC_INLINE char* StreamingPool::allocate (int bytes_requested)
 
 OC_INLINE void StreamingPool::deallocate (char* start_of_user_data)
 {
+  // Arena: everything goes away at once (see resetArena)
+  if (arena_) return;
+
   // Get the front of this struct that contains the user data
   SPInfo_* current = SPInfo_::GetSPInfo(start_of_user_data);
 
@@ -196,12 +326,14 @@ OC_INLINE void StreamingPool::deallocate (char* start_of_user_data)
 
 OC_INLINE bool StreamingPool::isFull () const
 {
+  if (arena_) return false;  // can always get more
   return (freelist_.next_ == &freelist_ && freelist_.prev_ == &freelist_);
 }
 
 
 OC_INLINE int StreamingPool::biggestFree () 
 {
+  if (arena_) return arenaEnd_ - arenaNext_;
   int big_size = 0;
   
   // Lock the transaction as we search memory
@@ -224,6 +356,7 @@ OC_INLINE int StreamingPool::biggestFree ()
 
 OC_INLINE void StreamingPool::scheduleForDeletion () 
 {
+  if (arena_) return;  // arenas are cleaned explicitly
   bool ready_to_detach = false; 
   {
     ProtectScope ps(lock_);
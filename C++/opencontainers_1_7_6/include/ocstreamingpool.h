@@ -18,6 +18,16 @@
 // words, no external bookkeeping: all bookkeeping has to be in the
 // memory region itself.
 
+// A StreamingPool can also be created as an ARENA (see CreateArena):
+// allocations just bump a pointer through the memory, deallocations
+// do nothing, and everything allocated goes away at once (with
+// resetArena or Clean).  This is for building a whole Val tree (say,
+// a message you just received) that all goes away at the same time:
+// throwing away a 50000 node tree is just throwing away the memory.
+// When the arena's memory runs out, it gets more chunks from the
+// heap, so arenas (unlike pools) are NOT for shared memory.  An arena
+// doesn't lock: only build into it from one thread at a time.
+
 #include "ocport.h"
 #include "ocspinfo.h"
 #include "ocsynchronizer.h"
@@ -49,6 +59,20 @@ class StreamingPool {
     return  new (memory) StreamingPool(memory, bytes, alignment_restrictions); 
   }
 
+  // Create an arena OVER the given memory (see top of file).  When
+  // the memory runs out, the arena gets more from the heap, starting
+  // with chunks of overflow_bytes (and doubling as it goes).
+  static StreamingPool* CreateArena (char* memory, int bytes,
+				     int overflow_bytes=64*1024,
+				     int alignment_restrictions=8)
+  { 
+    if (bytes<=int(sizeof(StreamingPool))) {
+      throw logic_error("Not really enough memory to manage");
+    }
+    return new (memory) StreamingPool(memory, bytes, alignment_restrictions,
+				      overflow_bytes);
+  }
+
   // When the pool is pristine and you want to "clean up".  This
   // doesn't actually return the memory (we don't know it if was
   // allocated in process shared memory, from the free store, etc.)
@@ -57,13 +81,23 @@ class StreamingPool {
   // (1) "Anybody in the pool?"  (isPristine)
   // (2) "Clean all the crap out of the pool"  (CleanStreamingPool)
   // (3) "Drain Pool"  (somehow return memory to system:  delete mem?)
+  // An arena is always clean-able: everything in it just goes away.
   static void Clean (StreamingPool* sp)
   { 
-    if (!sp->isPristine()) {
+    if (sp->isArena()) {
+      sp->resetArena(false);
+    } else if (!sp->isPristine()) {
       throw logic_error("The pool still has things in it, can't clean");
     }
+    if (CleanHook()) CleanHook()(sp);
     sp->~StreamingPool();
   }
+
+  // Anything that remembers pools by address (like the table of
+  // allocators an OC_COMPACT_VAL Val indexes) can set this to hear
+  // when a pool is cleaned, so it can forget it.
+  typedef void (*CleanHook_t) (StreamingPool*);
+  static CleanHook_t& CleanHook () { static CleanHook_t hook = 0; return hook; }
   
   // Ask for a piece of memory of the given size from the pool.
   OC_INLINE char* allocate (int bytes_requested);
@@ -122,9 +156,27 @@ class StreamingPool {
   // thing in pool
   OC_INLINE SPInfo_* firstAllocated (); 
 
+  // Did this memory come from this pool (or arena)?  Memory from the
+  // heap, or from some other pool, didn't.
+  OC_INLINE bool owns (const char* memory) const;
+
   // Number of TOTAL bytes allocated when pool was created
   int_4 bytes () const { return bytes_; }
 
+  // Is this an arena (see CreateArena)?
+  bool isArena () const { return arena_; }
+
+  // Forget everything ever allocated from the arena, and give back
+  // the extra chunks it got from the heap: No destructors are run.
+  // By default, the biggest chunk is kept for next time (so an arena
+  // that is filled and reset over and over stops going to the heap).
+  // Only makes sense for arenas.
+  OC_INLINE void resetArena (bool keep_biggest_chunk=true);
+
+  // How many bytes (of user memory) have been given out by the arena
+  // since it was created (or reset)?
+  int_8 arenaBytesAllocated () const { return arenaAllocated_; }
+
  protected :
     
    OC_INLINE friend SPInfo_* GetFreeList (StreamingPool*);
@@ -132,6 +184,8 @@ class StreamingPool {
    // Constructor and destructor protected so that they only way it can
    // be constructed is over a piece of unitialized memory
    StreamingPool (char* memory, int bytes, int alignment_restrict);
+   OC_INLINE StreamingPool (char* memory, int bytes, int alignment_restrict,
+			    int overflow_bytes);  // arena
    ~StreamingPool () { }
 
    // Don't allow copies.
@@ -148,6 +202,9 @@ class StreamingPool {
    // amount of memory
    OC_INLINE size_t maximumBlockSize_ ();
 
+   // Arena allocation when the current chunk runs out
+   OC_INLINE char* arenaOverflow_ (int bytes_requested);
+
    // ****** The order of these data members is pretty important: The
    // first few bytes are overlaid onto the memory as the data members
    // for the StreamingPool, and the rest of memory is managed as the
@@ -173,6 +230,19 @@ class StreamingPool {
    // actually use, compute that below
    int_4 bytes_;
 
+   // Arena bookkeeping (see CreateArena): the next free byte and the
+   // end of the current chunk, the list of chunks from the heap
+   // (each starts with a pointer to the previous, and its size), the
+   // chunk kept from the last reset, how big the next chunk from the
+   // heap will be, and how much we have given out.
+   bool  arena_;
+   char* arenaNext_;
+   char* arenaEnd_;
+   char* arenaChunks_;
+   char* arenaSpare_;
+   int_4 arenaChunkBytes_;
+   int_8 arenaAllocated_;
+
    // All allocates and deallocates must use this lock so we keep 
    // our data structures consistent
    Mutex lock_;
@@ -202,6 +272,48 @@ OC_END_NAMESPACE
 OC_BEGIN_NAMESPACE
 inline char* Allocate (Allocator* a, int len) { return a->allocate(len); }
 inline void DeAllocate (Allocator* a, char* m) { a->deallocate(m); }
+
+// The current allocator for this thread (0 means the heap): anything
+// that is created without an explicit allocator (Val, Tab, OTab, Tup,
+// Arr, Array, OCString, int_n, ...) gets its memory from here.  See
+// AllocatorScope.
+inline Allocator*& CurrentAllocator_ ()
+{
+  static OC_THREAD_LOCAL Allocator* current = 0;
+  return current;
+}
+inline Allocator* CurrentAllocator () { return CurrentAllocator_(); }
+
+// While an AllocatorScope is around, everything created on this
+// thread without an explicit allocator comes from the given allocator
+// (a pool in shared memory, or an arena), so code that knows nothing
+// about allocators (the pickle loaders, the XML reader, ...) builds
+// right into it:
+//
+//   {
+//     AllocatorScope scope(pool);
+//     Val v;
+//     LoadValFromArray(buffer, v, SERIALIZE_P2);  // all in the pool
+//   }  // back to the heap
+//
+// Scopes nest (the old allocator comes back when a scope goes away),
+// and AllocatorScope(0) goes back to the heap for a while.  Only
+// allocation is affected: a container created in a scope keeps
+// using the allocator after the scope is gone (as if it was given
+// the allocator explicitly), and everything goes back to wherever it
+// came from.  Careful: EVERYTHING created in the scope comes from the
+// allocator, temporaries (and statics initialized) in the scope too.
+class AllocatorScope {
+ public:
+  AllocatorScope (Allocator* a) : previous_(CurrentAllocator_())
+  { CurrentAllocator_() = a; }
+  ~AllocatorScope () { CurrentAllocator_() = previous_; }
+ protected:
+  Allocator* previous_;
+  AllocatorScope (const AllocatorScope&); // NO IMPL
+  AllocatorScope& operator= (const AllocatorScope&); // NO IMPL
+}; // AllocatorScope
+
 OC_END_NAMESPACE
 
 // The implementation: can be put into a .o if you don't want
@@ -35,6 +35,7 @@ class StreamingPool;
 typedef StreamingPool Allocator;
 extern char* Allocate (Allocator*, int len);
 extern void DeAllocate (Allocator*, char*);
+extern Allocator* CurrentAllocator ();
 OC_END_NAMESPACE
 
 #define OC_ALLOCATE(A,LEN) Allocate(A,LEN)
@@ -136,6 +137,31 @@ class OCString {
       }
       return *this;
     }
+
+#if defined(OC_MOVE_SEMANTICS)
+    // Move constructor.  Steal the string: str is left empty.
+    OCString (OCString&& str)
+    {
+      build_(0, 0);
+      swap(str);
+    }
+
+    // Move assignment.  Like operator=, the result never uses an
+    // allocator: so only strings that don't use one can be stolen.
+    OCString& operator= (OCString&& rhs)
+    {
+      if (this!=&rhs) {
+	if (rhs.allocator()==0) {
+	  release_();
+	  build_(0, 0);
+	  swap(rhs);
+	} else {
+	  *this = rhs;  // Copy
+	}
+      }
+      return *this;
+    }
+#endif
     
     
     // Operator+=.  Concatenate rhs to this string.
@@ -321,6 +347,7 @@ class OCString {
 
     void build_ (const char *str, size_type len, Allocator* a=0) {
       if (len > OC_MAX_INTERNAL_LENGTH - 2) {
+	if (!a) a = CurrentAllocator();  // see AllocatorScope
 	u_.s_.a_ = a;
 	u_.s_.ptr_= (a) ? OC_ALLOCATE(a, len+1) : new char[len + 1];
 	memcpy(u_.s_.ptr_, str, len);
@@ -0,0 +1,448 @@
+#ifndef OCSTRINGIZEREAL_H_
+
+// Fast printing of real_4 and real_8: StringizeReal writes the
+// shortest string that reads back as exactly the same number into a
+// buffer you give it (it never allocates), so it's the way to print
+// lots of reals.  This is what Stringize<real_4>/Stringize<real_8>,
+// Val printing, and all the text serializations (pretty printing,
+// JSON, XML, Python pickling protocol 0) use.
+//
+//   char buf[OC_REAL_CHARS];
+//   int len = StringizeReal(3.25, buf);   // buf has "3.25", len is 4
+//   os.write(buf, len);
+//
+// The output follows the same (Python-like) rules Stringize always
+// has:
+//   - reals that are integers (and fit in an int_8/int_u8) print as
+//     that integer with a ".0", so they don't look like ints: "100.0"
+//   - otherwise, like printf %g: fixed notation, unless the exponent
+//     is less than -4 or at least OC_DBL_DIGITS (OC_FLT_DIGITS for
+//     real_4), then exponential notation: "0.001", "1e-05", "1.5e+300"
+//   - "nan", "-nan", "inf", "-inf"
+// The only difference from the old ostream-based version is that
+// the digits are now the shortest that round-trip: 0.1+0.2 prints as
+// 0.30000000000000004 (like Python's repr), where 16 digits gave 0.3
+// (which doesn't read back as the same number).
+//
+// The digits come from the Grisu2 algorithm (Florian Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", PLDI 2010): the result always round-trips, and is
+// almost always the shortest possible.
+
+// This is included by ocport.h, which it depends on for the int types
+
+#if defined(OC_NEW_STYLE_INCLUDES)
+#  include <cstring>
+#else
+#  include <string.h>
+#endif
+
+OC_BEGIN_NAMESPACE
+
+// How big a buffer StringizeReal needs
+#define OC_REAL_CHARS 32
+
+
+// ///////////////////////////////////////////// Grisu2 Helpers
+
+// A "do it yourself" floating point number: f * 2^e
+struct OCDiyFp_ {
+  int_u8 f;
+  int    e;
+  OCDiyFp_ (int_u8 ff=0, int ee=0) : f(ff), e(ee) { }
+};
+
+// x-y, where x>=y and both have the same exponent
+inline OCDiyFp_ OCDiyFpSub_ (const OCDiyFp_& x, const OCDiyFp_& y)
+{ return OCDiyFp_(x.f - y.f, x.e); }
+
+// x*y, rounded to the top 64 bits of the product
+inline OCDiyFp_ OCDiyFpMul_ (const OCDiyFp_& x, const OCDiyFp_& y)
+{
+  const int_u8 u_lo = x.f & 0xFFFFFFFFu, u_hi = x.f >> 32;
+  const int_u8 v_lo = y.f & 0xFFFFFFFFu, v_hi = y.f >> 32;
+  const int_u8 p0 = u_lo*v_lo, p1 = u_lo*v_hi, p2 = u_hi*v_lo, p3 = u_hi*v_hi;
+  int_u8 mid = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+  mid += int_u8(1) << 31;  // round
+  return OCDiyFp_(p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+// Shift up so the top bit is set
+inline OCDiyFp_ OCDiyFpNormalize_ (OCDiyFp_ x)
+{
+  while ((x.f >> 63)==0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+// The neighbors of a real halfway to the next real up (plus) and
+// down (minus): anything strictly between reads back as v.  The
+// boundaries share the exponent of the normalized plus.
+struct OCRealBoundaries_ {
+  OCDiyFp_ w, minus, plus;
+};
+
+// bits is the IEEE representation, with mantissa_bits (not counting
+// the hidden bit) and the given exponent bias
+inline OCRealBoundaries_ OCRealBoundaries_From_ (int_u8 bits,
+						 int mantissa_bits, int bias)
+{
+  const int_u8 hidden = int_u8(1) << mantissa_bits;
+  const int_u8 F = bits & (hidden-1);
+  const int    E = int(bits >> mantissa_bits);
+  const int    min_exp = 1 - bias - mantissa_bits;
+
+  OCDiyFp_ v = (E==0) ? OCDiyFp_(F, min_exp) :
+                        OCDiyFp_(F + hidden, E - bias - mantissa_bits);
+
+  // The boundary below is closer when v is a power of 2 (and not the
+  // smallest normal)
+  const bool lower_is_closer = (F==0 && E>1);
+  OCDiyFp_ plus(2*v.f + 1, v.e - 1);
+  OCDiyFp_ minus = lower_is_closer ? OCDiyFp_(4*v.f - 1, v.e - 2) :
+                                     OCDiyFp_(2*v.f - 1, v.e - 1);
+  OCRealBoundaries_ b;
+  b.plus = OCDiyFpNormalize_(plus);
+  b.minus = OCDiyFp_(minus.f << (minus.e - b.plus.e), b.plus.e);
+  b.w = OCDiyFpNormalize_(v);
+  return b;
+}
+
+// Normalized 10^k, for k=-300, -292, ... 340: f * 2^e
+struct OCCachedPower_ {
+  int_u8 f;
+  int    e;
+  int    k;
+};
+
+// The cached power c = 10^-k so that w*c has a binary exponent in
+// [-60, -32]: then the integer part of w*c fits in 32 bits, and the
+// digit generation can work in 64-bit ints
+inline OCCachedPower_ OCCachedPowerFor_ (int e)
+{
+  static const OCCachedPower_ powers[] = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+    { 0xEB96BF6EBADF77D9ULL,  1039,  332 },
+    { 0xAF87023B9BF0EE6BULL,  1066,  340 },
+  };
+  // k = ceil((-60-e-1) * log10(2)), then round up to a cached one
+  const int f = -60 - e - 1;
+  const int k = (f * 78913) / (1 << 18) + (f > 0);
+  const int index = (300 + k + 7) / 8;
+  return powers[index];
+}
+
+// Largest power of 10 <= n (n>0), and how many digits n has
+inline int OCLargestPow10_ (int_u4 n, int_u4& pow10)
+{
+  static const int_u4 p[] = { 1, 10, 100, 1000, 10000, 100000, 1000000,
+			      10000000, 100000000, 1000000000 };
+  int digits = 10;
+  while (digits>1 && n<p[digits-1]) digits--;
+  pow10 = p[digits-1];
+  return digits;
+}
+
+// Move the last digit down (toward w) as long as that stays inside
+// the boundaries and gets closer to w
+inline void OCGrisuRound_ (char* buf, int len, int_u8 dist, int_u8 delta,
+			   int_u8 rest, int_u8 ten_k)
+{
+  while (rest < dist && delta - rest >= ten_k &&
+	 (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    buf[len-1]--;
+    rest += ten_k;
+  }
+}
+
+// Generate the digits of M+ (as few as possible, stopping as soon
+// as they're inside [M-, M+]): buf*10^exp10 is the result
+inline void OCGrisuDigits_ (char* buf, int& len, int& exp10,
+			    OCDiyFp_ M_minus, OCDiyFp_ w, OCDiyFp_ M_plus)
+{
+  int_u8 delta = OCDiyFpSub_(M_plus, M_minus).f;
+  int_u8 dist  = OCDiyFpSub_(M_plus, w).f;
+  const int    shift = -M_plus.e;
+  const int_u8 one = int_u8(1) << shift;
+  int_u4 p1 = int_u4(M_plus.f >> shift);   // integer part
+  int_u8 p2 = M_plus.f & (one - 1);        // fractional part
+
+  // Integer part
+  int_u4 pow10;
+  int n = OCLargestPow10_(p1, pow10);
+  while (n > 0) {
+    const int_u4 d = p1 / pow10;
+    p1 %= pow10;
+    buf[len++] = char('0' + d);
+    n--;
+    const int_u8 rest = (int_u8(p1) << shift) + p2;
+    if (rest <= delta) {
+      exp10 += n;
+      OCGrisuRound_(buf, len, dist, delta, rest, int_u8(pow10) << shift);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  // Fractional part
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    buf[len++] = char('0' + (p2 >> shift));
+    p2 &= one - 1;
+    m++;
+    delta *= 10;
+    dist  *= 10;
+    if (p2 <= delta) break;
+  }
+  exp10 -= m;
+  OCGrisuRound_(buf, len, dist, delta, p2, one);
+}
+
+// The digits (in buf, len of them) and exponent so that
+// buf*10^exp10 is the shortest(ish) decimal that reads back as the
+// real with the given boundaries
+inline void OCGrisu2_ (char* buf, int& len, int& exp10,
+		       const OCRealBoundaries_& b)
+{
+  const OCCachedPower_ cached = OCCachedPowerFor_(b.plus.e);
+  const OCDiyFp_ c(cached.f, cached.e);
+  const OCDiyFp_ w       = OCDiyFpMul_(b.w, c);
+  const OCDiyFp_ w_minus = OCDiyFpMul_(b.minus, c);
+  const OCDiyFp_ w_plus  = OCDiyFpMul_(b.plus, c);
+
+  // The products can be off by one ulp: stay safely inside
+  const OCDiyFp_ M_minus(w_minus.f + 1, w_minus.e);
+  const OCDiyFp_ M_plus (w_plus.f - 1,  w_plus.e);
+  len = 0;
+  exp10 = -cached.k;
+  OCGrisuDigits_(buf, len, exp10, M_minus, w, M_plus);
+}
+
+
+// ///////////////////////////////////////////// Formatting
+
+// Write the digits of an unsigned integer, return how many
+inline int OCUIntChars_ (int_u8 n, char* out)
+{
+  char temp[24];
+  int ii = 0;
+  do {
+    temp[ii++] = char('0' + n%10);
+    n /= 10;
+  } while (n);
+  for (int jj=0; jj<ii; jj++) out[jj] = temp[ii-1-jj];
+  return ii;
+}
+
+// Lay out the digits (and decimal exponent) like printf %.<precision>g
+// would (except with all the digits): returns number of chars
+inline int OCRealLayout_ (const char* digits, int len, int exp10,
+			  int precision, char* out)
+{
+  const int point = len + exp10;   // where the decimal point goes
+  const int x = point - 1;         // the exponent in d.ddde+x
+  char* o = out;
+  if (x < -4 || x >= precision) {
+    *o++ = digits[0];
+    if (len>1) {
+      *o++ = '.';
+      memcpy(o, digits+1, len-1);
+      o += len-1;
+    }
+    *o++ = 'e';
+    *o++ = (x<0) ? '-' : '+';
+    const int ax = (x<0) ? -x : x;
+    if (ax<10) *o++ = '0';  // always at least 2 digits
+    o += OCUIntChars_(ax, o);
+  } else if (point <= 0) {
+    *o++ = '0';
+    *o++ = '.';
+    for (int ii=point; ii<0; ii++) *o++ = '0';
+    memcpy(o, digits, len);
+    o += len;
+  } else if (point < len) {
+    memcpy(o, digits, point);
+    o += point;
+    *o++ = '.';
+    memcpy(o, digits+point, len-point);
+    o += len-point;
+  } else {
+    memcpy(o, digits, len);
+    o += len;
+    for (int ii=len; ii<point; ii++) *o++ = '0';
+  }
+  return int(o-out);
+}
+
+// Everything but the digits is the same for real_4 and real_8:
+// mark_integers is whether integers get the ".0".
+template <class REAL>
+inline int OCStringizeReal_ (REAL r, int_u8 bits, int mantissa_bits,
+			     int bias, int precision, bool mark_integers,
+			     char* out)
+{
+  char* o = out;
+  const int_u8 sign = bits >> (mantissa_bits + (sizeof(REAL)==4 ? 8 : 11));
+  const int_u8 magnitude = bits & ~(sign << (sizeof(REAL)*8-1));
+
+  if (r!=r) {  // nan
+    if (sign) *o++ = '-';
+    memcpy(o, "nan", 3);
+    return int(o-out) + 3;
+  }
+  if (magnitude == (int_u8(sizeof(REAL)==4 ? 0xFF : 0x7FF) << mantissa_bits)) {
+    if (sign) *o++ = '-';
+    memcpy(o, "inf", 3);
+    return int(o-out) + 3;
+  }
+
+  // Integers (that fit in an int_8 or int_u8) are printed exactly,
+  // with a .0 (-0.0 also goes here, and prints as 0.0)
+  if (mark_integers) {
+    const real_8 d = r;
+    if (d<0 && d >= -9223372036854775808.0 && real_8(int_8(d))==d) {
+      *o++ = '-';
+      o += OCUIntChars_(int_u8(0) - int_u8(int_8(d)), o);
+      *o++ = '.'; *o++ = '0';
+      return int(o-out);
+    } else if (d>=0 && d < 18446744073709551616.0 && real_8(int_u8(d))==d) {
+      o += OCUIntChars_(int_u8(d), o);
+      *o++ = '.'; *o++ = '0';
+      return int(o-out);
+    }
+  }
+
+  if (sign) *o++ = '-';
+  if (magnitude==0) {
+    *o++ = '0';
+    return int(o-out);
+  }
+  char digits[20];
+  int len, exp10;
+  OCGrisu2_(digits, len, exp10,
+	    OCRealBoundaries_From_(magnitude, mantissa_bits, bias));
+  o += OCRealLayout_(digits, len, exp10, precision, o);
+  return int(o-out);
+}
+
+// Write r into out (which must have room for OC_REAL_CHARS chars):
+// returns the number of chars written (there is no '\0' added).  If
+// mark_integers is false, integers don't get a ".0" (like the parts
+// of a complex: (1+2j)).
+inline int StringizeReal (real_8 r, char* out, bool mark_integers=true)
+{
+  int_u8 bits;
+  memcpy(&bits, &r, sizeof(bits));
+  return OCStringizeReal_(r, bits, 52, 1023, OC_DBL_DIGITS, mark_integers,
+			  out);
+}
+
+inline int StringizeReal (real_4 r, char* out, bool mark_integers=true)
+{
+  int_u4 bits;
+  memcpy(&bits, &r, sizeof(bits));
+  return OCStringizeReal_(r, int_u8(bits), 23, 127, OC_FLT_DIGITS,
+			  mark_integers, out);
+}
+
+// Print a complex like Python does: (1+2j), (0.5-1e-05j).  The
+// parts don't get a ".0" (Python doesn't do that for complexes)
+template <class REAL>
+inline ostream& PrintComplex_ (ostream& os, REAL re, REAL im)
+{
+  char buf[2*OC_REAL_CHARS+4];
+  char* o = buf;
+  *o++ = '(';
+  o += StringizeReal(re, o, false);
+  if (!(im<0)) *o++ = '+';
+  o += StringizeReal(im, o, false);
+  *o++ = 'j'; 
+  *o++ = ')';
+  return os.write(buf, o-buf);
+}
+
+OC_END_NAMESPACE
+
+#define OCSTRINGIZEREAL_H_
+#endif // OCSTRINGIZEREAL_H_
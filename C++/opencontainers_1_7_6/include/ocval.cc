@@ -92,8 +92,9 @@ OC_INLINE int_u4 HashFunction (const Val& v)
 {
   int_u4 retval;
   if (v.tag=='a') {
-    OCString* sp = (OCString*)v.u.a;
-    retval = HashFunction(*sp);
+    if (v.hashed) return v.hashcode;
+    OCString* sp = (OCString*)&v.u.a;
+    retval = HashFunction(*sp);  // v may be shared: don't cache here
   } else {
     retval = v;
   }
@@ -158,7 +159,7 @@ OC_INLINE Val Tab::get (const Val& key, const Val& def) const
   // Use the implementation where you only have to lookup the value
   // once.
   Found_e found_where; 
-  AVLNode_<Val,Val>* node = this->lookup_(key, found_where);
+  N* node = this->lookup_(key, found_where);
   if (found_where==FOUND) {
     return node->value; // no need for two lookups
   } else {
@@ -191,7 +192,7 @@ OC_INLINE Val OTab::get (const Val& key, const Val& def) const
   // Use the implementation where you only have to lookup the value
   // once.
   Found_e found_where; 
-  AVLOrdNode_<Val,Val>* node = this->lookup_(key, found_where);
+  N* node = this->lookup_(key, found_where);
   if (found_where==FOUND) {
     return node->value; // no need for two lookups
   } else {
@@ -266,61 +267,110 @@ OC_INLINE void unknownType_ (const char* routine, char tag)
   throw logic_error(mesg.c_str());
 }
 
-      
+
+// The complex_16 in a Val (which may be out of line)
+#define OC_VALCX16(V) (*(cx_union_t<real_8>*)&(V).u.D)
+
+#if defined(OC_COMPACT_VAL)
+// Out of line space starts with the allocator it came from (so it
+// goes back to the right place, even if it came from an
+// AllocatorScope), padded so the space after it is aligned.
+union OCValSpaceHeader_ { Allocator* from; real_8 align; };
+
+OC_INLINE void* Val::newSpace_ (size_t bytes)
+{
+  Allocator* from = allocator();
+  if (!from) from = CurrentAllocator();
+  const size_t header = sizeof(OCValSpaceHeader_);
+  char* mem = from ? from->allocate(int(header+bytes)) : 
+                     (char*)::operator new(header+bytes);
+  ((OCValSpaceHeader_*)mem)->from = from;
+  u.t.where = mem + header;
+  return u.t.where;
+}
+
+OC_INLINE void Val::deleteSpace_ ()
+{
+  char* mem = (char*)u.t.where - sizeof(OCValSpaceHeader_);
+  Allocator* from = ((OCValSpaceHeader_*)mem)->from;
+  if (from) {
+    from->deallocate(mem);
+  } else {
+    ::operator delete(mem);
+  }
+}
+#endif
+
 OC_INLINE Val::Val (const Tab& t, Allocator* alloc) : 
   tag('t'), 
   isproxy(false),
-  a(alloc)  
-{ new (&u.t) Tab(t, alloc); }
+  OC_VAL_UNHASHED_(alloc)  
+{ new (newSpace_(sizeof(Tab))) Tab(t, alloc); }
 
 OC_INLINE Val::Val (const OTab& t, Allocator* alloc) : 
   tag('o'), 
   isproxy(false),
-  a(alloc)  
-{ new (&u.o) OTab(t, alloc); }
+  OC_VAL_UNHASHED_(alloc)  
+{ new (newSpace_(sizeof(OTab))) OTab(t, alloc); }
 
 OC_INLINE Val::Val (const Tup& t, Allocator* alloc) : 
   tag('u'), 
   isproxy(false),
-  a(alloc)  
-{ new (&u.u) Tup(t, alloc); }
+  OC_VAL_UNHASHED_(alloc)  
+{ new (newSpace_(sizeof(Tup))) Tup(t, alloc); }
 
 OC_INLINE Val::Val (const int_n& t, Allocator* alloc) : 
   tag('q'), 
   isproxy(false),
-  a(alloc)  
-{ new (&u.q) int_n(t, alloc); }
+  OC_VAL_UNHASHED_(alloc)  
+{ new (newSpace_(sizeof(int_n))) int_n(t, alloc); }
 
 OC_INLINE Val::Val (const int_un& t, Allocator* alloc) : 
   tag('Q'), 
   isproxy(false),
-  a(alloc)  
-{ new (&u.Q) int_un(t, alloc); }
+  OC_VAL_UNHASHED_(alloc)  
+{ new (newSpace_(sizeof(int_un))) int_un(t, alloc); }
 
 template <class T> 
 OC_INLINE Val::Val (const Array<T>& a, Allocator* alloc) : 
   tag('n'),
   isproxy(false),
-  a(alloc)
+  OC_VAL_UNHASHED_(alloc)
 {
   subtype = TagFor((T*)0);
   if (subtype=='n') {
     throw logic_error("Arrays of Arrays not currently supported");
   } 
-  new (&u.n) Array<T>(a,alloc);
+  new (newSpace_(sizeof(Array<T>))) Array<T>(a,alloc);
 }
 
+#if defined(OC_MOVE_SEMANTICS)
+template <class T> 
+OC_INLINE Val::Val (Array<T>&& arr) : 
+  tag('n'),
+  isproxy(false),
+  OC_VAL_UNHASHED_(arr.allocator())
+{
+  subtype = TagFor((T*)0);
+  if (subtype=='n') {
+    throw logic_error("Arrays of Arrays not currently supported");
+  } 
+  new (newSpace_(sizeof(Array<T>))) Array<T>(std::move(arr));
+}
+#endif
+
 #define VALDESTR(T) { Array<T>*ap=(Array<T>*)&u.n;ap->~Array<T>(); }
 OC_INLINE Val::~Val ()
 {
-  if (isproxy) { Proxy* pp = (Proxy*)&u.P; pp->~Proxy(); return; }
+  if (isproxy) { Proxy* pp = (Proxy*)&u.P; pp->~Proxy(); deleteSpace_(); return; }
   switch(tag) { 
-  case 'a': { OCString* sp = (OCString*)&u.a; sp->~OCString(); break; }
-  case 't': { Tab* tp = (Tab*)&u.t; tp->~Tab(); break; }
-  case 'o': { OTab* tp = (OTab*)&u.o; tp->~OTab(); break; }
-  case 'u': { Tup* tp = (Tup*)&u.o; tp->~Tup(); break; }
-  case 'q': { int_n* tp = (int_n*)&u.q; tp->~int_n(); break; }
-  case 'Q': { int_un* tp = (int_un*)&u.Q; tp->~int_un(); break; }
+  case 'D': deleteSpace_(); break;
+  case 'a': { OCString* sp = (OCString*)&u.a; sp->~OCString(); deleteSpace_(); break; }
+  case 't': { Tab* tp = (Tab*)&u.t; tp->~Tab(); deleteSpace_(); break; }
+  case 'o': { OTab* tp = (OTab*)&u.o; tp->~OTab(); deleteSpace_(); break; }
+  case 'u': { Tup* tp = (Tup*)&u.o; tp->~Tup(); deleteSpace_(); break; }
+  case 'q': { int_n* tp = (int_n*)&u.q; tp->~int_n(); deleteSpace_(); break; }
+  case 'Q': { int_un* tp = (int_un*)&u.Q; tp->~int_un(); deleteSpace_(); break; }
   case 'n': { 
     switch(subtype) { 
     case 's': VALDESTR(int_1);  break;
@@ -342,19 +392,20 @@ OC_INLINE Val::~Val ()
     case 'Z': VALDESTR(Val);    break;
     default: unknownType_("destructor", subtype);
     }
+    deleteSpace_();
   }
   }
 }
 
 
-#define VALCOPYCONS(T) {Array<T>*ap=(Array<T>*)&r.u.n;new(&u.n)Array<T>(*ap,alloc);}
+#define VALCOPYCONS(T) {Array<T>*ap=(Array<T>*)&r.u.n;new(newSpace_(sizeof(Array<T>)))Array<T>(*ap,alloc);}
 OC_INLINE Val::Val (const Val& r, Allocator* alloc) : 
   tag(r.tag),
   subtype(r.subtype),
   isproxy(r.isproxy),
-  a(alloc)
+  OC_VAL_HASH_ALLOC_(r.hashed, r.hashcode, alloc)
 { 
-  if (isproxy) { Proxy* pp=(Proxy*)&r.u.P; new (&u.P) Proxy(*pp); return; }
+  if (isproxy) { Proxy* pp=(Proxy*)&r.u.P; new (newSpace_(sizeof(Proxy))) Proxy(*pp); return; }
   // Copy constructor: Have to write because of Str and table cases.
   // Although we could copy in less code, we want to be purify clean
   // (for now).
@@ -371,13 +422,13 @@ OC_INLINE Val::Val (const Val& r, Allocator* alloc) :
   case 'f': u.f = r.u.f; break;
   case 'd': u.d = r.u.d; break;
   case 'F': u.F = r.u.F; break;
-  case 'D': u.D = r.u.D; break;
-  case 'a': { OCString* sp=(OCString*)&r.u.a; new (&u.a) OCString(*sp,alloc); break; }
-  case 't': { Tab* tp=(Tab*)&r.u.t; new (&u.t) Tab(*tp,alloc); break; }
-  case 'o': { OTab*tp=(OTab*)&r.u.o;new (&u.o)OTab(*tp,alloc); break; }
-  case 'u': { Tup* tp=(Tup*)&r.u.u; new (&u.u) Tup(*tp,alloc); break; }
-  case 'q': { int_n* tp=(int_n*)&r.u.q; new (&u.q) int_n(*tp,alloc); break; }
-  case 'Q': { int_un* tp=(int_un*)&r.u.Q;new (&u.Q) int_un(*tp,alloc); break; }
+  case 'D': new (newSpace_(sizeof(complex_16))) complex_16(OC_VALCX16(r).re, OC_VALCX16(r).im); break;
+  case 'a': { OCString* sp=(OCString*)&r.u.a; new (newSpace_(sizeof(OCString))) OCString(*sp,alloc); break; }
+  case 't': { Tab* tp=(Tab*)&r.u.t; new (newSpace_(sizeof(Tab))) Tab(*tp,alloc); break; }
+  case 'o': { OTab*tp=(OTab*)&r.u.o;new (newSpace_(sizeof(OTab)))OTab(*tp,alloc); break; }
+  case 'u': { Tup* tp=(Tup*)&r.u.u; new (newSpace_(sizeof(Tup))) Tup(*tp,alloc); break; }
+  case 'q': { int_n* tp=(int_n*)&r.u.q; new (newSpace_(sizeof(int_n))) int_n(*tp,alloc); break; }
+  case 'Q': { int_un* tp=(int_un*)&r.u.Q;new (newSpace_(sizeof(int_un))) int_un(*tp,alloc); break; }
   case 'n': {
     switch(r.subtype) { 
     case 's': VALCOPYCONS(int_1);  break;
@@ -425,17 +476,65 @@ OC_INLINE Val& Val::operator= (const Val& rhs)
   return *this; 
 }
 
+#if defined(OC_MOVE_SEMANTICS)
+OC_INLINE Val::Val (Val&& r) :
+  tag(r.tag),
+  subtype(r.subtype),
+  isproxy(r.isproxy),
+  OC_VAL_HASH_ALLOC_(r.hashed, r.hashcode, r.a)
+{ 
+  // Everything (even proxies) just moves over: r is left as None
+  u = r.u;
+  r.tag = 'Z';
+  r.isproxy = false;
+  r.hashed = false;
+}
+
+OC_INLINE Val& Val::operator= (Val&& rhs)
+{
+  if (&rhs!=this) {
+    if (a==rhs.a) {
+      // rhs may be nested inside of this: take it out before the
+      // old value of this goes away (when temp does)
+      Val temp(std::move(rhs));
+      this->swap(temp);
+    } else {
+      // Different allocators: have to copy into our allocator
+      const Val& copy = rhs;
+      *this = copy;
+    }
+  }
+  return *this;
+}
+
+OC_INLINE Val::Val (OCString&& s) : 
+  tag('a'), isproxy(false), OC_VAL_UNHASHED_(s.allocator()) 
+{ new (newSpace_(sizeof(OCString))) OCString(std::move(s)); }
+
+OC_INLINE Val::Val (Tab&& t) : 
+  tag('t'), isproxy(false), OC_VAL_UNHASHED_(t.allocator()) 
+{ new (newSpace_(sizeof(Tab))) Tab(std::move(t)); }
+
+OC_INLINE Val::Val (OTab&& t) : 
+  tag('o'), isproxy(false), OC_VAL_UNHASHED_(t.allocator()) 
+{ new (newSpace_(sizeof(OTab))) OTab(std::move(t)); }
+
+OC_INLINE Val::Val (Tup&& t) : 
+  tag('u'), isproxy(false), OC_VAL_UNHASHED_(t.allocator()) 
+{ new (newSpace_(sizeof(Tup))) Tup(std::move(t)); }
+#endif
+
 // For all the "convert out" operations: Since they are so similar,
 // use macros to generate the code to avoid multiple maintenance.
 
 // Code block to get the proper union member and cast it out correctly
 #define VALSWITCHME(T,M) switch(tag) { case's':return T(u.s);case'S':return T(u.S);case'i':return T(u.i);case'I':return T(u.I);\
 case'l':return T(u.l);case'L':return T(u.L);case'x':return T(u.x);case'X':return T(u.X);case 'b':return T(u.b); case'f':return T(u.f);case'd':return T(u.d); \
-case'F':return T(M(u.F)); case'D':return T(M(u.D)); case'q':{int_n*qp=(int_n*)&u.q; return T(qp->as());} case'Q':{int_un*qp=(int_un*)&u.Q;return T(qp->as());}}
+case'F':return T(M(u.F)); case'D':return T(M(OC_VALCX16(*this))); case'q':{int_n*qp=(int_n*)&u.q; return T(qp->as());} case'Q':{int_un*qp=(int_un*)&u.Q;return T(qp->as());}}
 
 #define VALSWITCHME2(T) switch(tag) { case's':return T(u.s);case'S':return T(u.S);case'i':return T(u.i);case'I':return T(u.I);\
 case'l':return T(u.l);case'L':return T(u.L);case'x':return T(u.x);case'X':return T(u.X);case 'b':return T(u.b); case'f':return T(u.f);case'd':return T(u.d); \
-case'F':return T(u.F.re, u.F.im); case'D':return T(u.D.re, u.D.im); case'q':{int_n*qp=(int_n*)&u.q;return T(real_8(int_8(qp->as())));} case'Q':{int_un*qp=(int_un*)&u.Q;return T(real_8(int_u8(qp->as())));} }
+case'F':return T(u.F.re, u.F.im); case'D':return T(OC_VALCX16(*this).re, OC_VALCX16(*this).im); case'q':{int_n*qp=(int_n*)&u.q;return T(real_8(int_8(qp->as())));} case'Q':{int_un*qp=(int_un*)&u.Q;return T(real_8(int_u8(qp->as())));} }
 
 
 // Function tempplate for convert outs for the numeric types
@@ -491,11 +590,29 @@ OC_INLINE Val::operator Str () const
 #else
     return Str(sp->data(), sp->length());
 #endif
+  } else if (tag=='d') {
+    char b[OC_REAL_CHARS];
+    return Str(b, StringizeReal(u.d, b));
+  } else if (tag=='f') {
+    char b[OC_REAL_CHARS];
+    return Str(b, StringizeReal(u.f, b));
   } else {
     return Stringize(*this);
   }
 }
 
+OC_INLINE Val::operator Tab& ()
+{
+  if (isproxy && tag=='t') {
+    Proxy* pp = (Proxy*)&u.P;
+    Tab& t = *pp; // detaches a shared copy-on-write body
+    return t;
+  }
+  const Val& look = *this;
+  Tab& t = look;
+  return t;
+}
+
 OC_INLINE Val::operator Tab& () const
 {
   Tab *tp = (Tab*)&u.t;
@@ -503,13 +620,25 @@ OC_INLINE Val::operator Tab& () const
     NoConversion_(tag, *this, "table");
   }
   if (isproxy) {
-    Proxy* pp = (Proxy*)&u.P;
+    const Proxy* pp = (const Proxy*)&u.P; // no detach
     Tab& t = *pp;
     tp = &t;
   }
   return *tp;
 }
 
+OC_INLINE Val::operator OTab& ()
+{
+  if (isproxy && tag=='o') {
+    Proxy* pp = (Proxy*)&u.P;
+    OTab& t = *pp; // detaches a shared copy-on-write body
+    return t;
+  }
+  const Val& look = *this;
+  OTab& t = look;
+  return t;
+}
+
 OC_INLINE Val::operator OTab& () const
 {
   OTab *tp = (OTab*)&u.t;
@@ -517,7 +646,7 @@ OC_INLINE Val::operator OTab& () const
     NoConversion_(tag, *this, "ordered table");
   }
   if (isproxy) {
-    Proxy* pp = (Proxy*)&u.P;
+    const Proxy* pp = (const Proxy*)&u.P; // no detach
     OTab& t = *pp;
     tp = &t;
   }
@@ -532,13 +661,25 @@ OC_INLINE Val::operator Tup& () const
   }
   // Does it make sense to have proxies for Tuples???
   if (isproxy) {
-    Proxy* pp = (Proxy*)&u.P;
+    const Proxy* pp = (const Proxy*)&u.P; // no detach
     Tup& t = *pp;
     tp = &t;
   }
   return *tp;
 }
 
+OC_INLINE Val::operator Arr& ()
+{
+  if (isproxy && tag=='n' && subtype=='Z') {
+    Proxy* pp = (Proxy*)&u.P;
+    Arr& a = *pp; // detaches a shared copy-on-write body
+    return a;
+  }
+  const Val& look = *this;
+  Arr& a = look;
+  return a;
+}
+
 OC_INLINE Val::operator Arr& () const
 {
   Arr* ap = (Arr*)&u.n;
@@ -546,7 +687,7 @@ OC_INLINE Val::operator Arr& () const
     NoConversion_(tag, *this, "Arr");
   }
   if (isproxy) {
-    Proxy* pp = (Proxy*)&u.P;
+    const Proxy* pp = (const Proxy*)&u.P; // no detach
     Arr& a = *pp;
     ap = &a;
   }
@@ -658,7 +799,7 @@ OC_INLINE Val::operator int_un () const
 // and slow us down a little more (not much, but every little bit
 // helps).
 
-template <class LOOKUP> Val& ValLookUpBody_ (const Val& v, LOOKUP ii)
+template <class LOOKUP> Val& ValLookUpBody_ (Val& v, LOOKUP ii)
 { 
   // If there are proxies, the outcast will do the proper thing
   if (v.tag=='n') {
@@ -673,7 +814,7 @@ template <class LOOKUP> Val& ValLookUpBody_ (const Val& v, LOOKUP ii)
     OTab& ot=v;
     return ot[ii];
   } else if (v.tag=='u') {
-    Tup& t=v;
+    Tup& t=TupOf_(v);
     return t[ii];
   } else { // Note that this will throw an exception if v is NOT a Tab
     Tab& t = v;
@@ -683,7 +824,7 @@ template <class LOOKUP> Val& ValLookUpBody_ (const Val& v, LOOKUP ii)
 
 #if defined(OC_FACTOR_INTO_H_AND_CC)
 // Explicit instantiation
-#define OC_INST_VALLOOKUP(T) template Val& ValLookUpBody_<T>(const Val&, T);
+#define OC_INST_VALLOOKUP(T) template Val& ValLookUpBody_<T>(Val&, T);
 OC_INST_VALLOOKUP(int_1) 
 OC_INST_VALLOOKUP(int_u1) 
 OC_INST_VALLOOKUP(int_2) 
@@ -732,24 +873,42 @@ OC_INLINE Val& Val::operator[] (const Str& v)  { OC_TABOTABLOOK(); }
 OC_INLINE Val& Val::operator[] (const Val& v)  { OC_TABOTABLOOK(); }
 
 
+// The Tab/OTab/Tup/Array body of a Val, even through a Proxy.  Only
+// for looking: a copy-on-write proxy is NOT detached (the outcasts to
+// Tab& and friends are for changing things, and they detach).  Goes
+// through the union member for the tag, which (with OC_COMPACT_VAL)
+// is where the body was put out of line.
+inline void* ValReadBody_ (const Val& v)
+{
+  if (v.isproxy) return ((Proxy*)&v.u.P)->data_();
+  switch (v.tag) {
+  case 't': return (void*)&v.u.t;
+  case 'o': return (void*)&v.u.o;
+  case 'u': return (void*)&v.u.u;
+  default:  return (void*)&v.u.n;
+  }
+}
+
 template <class LOOKUP> Val& ValLookUpBodyThrow_ (const Val& v, LOOKUP ii)
 {
-  // Proxyies handled via outcast
   if (v.tag=='n') {
     if (v.subtype=='Z') { // For Array<Val>, we can return a reference
-      Array<Val>& a = v;
+      Array<Val>& a = *(Array<Val>*)ValReadBody_(v);
       return a[ii];  // Possibly should use (), but makes more sense to use the version that throws an exception if there's a problem
     }
     // ... but for Arrays of other types, can't return a reference:
     // Force someone to get a contig array, thus force an exception  
     throw logic_error("Only Array<Val> can subscript, Array<T> cannot");
   } else if (v.tag=='o') {
-    OTab& ot=v;
+    OTab& ot = *(OTab*)ValReadBody_(v);
     return ot(ii);
   } else if (v.tag=='u') {
-    Tup& t=v;
+    Tup& t = *(Tup*)ValReadBody_(v);
     return t[ii]; // Possibly should use (), but makes more sense to use the version that throws an exception if there's a problem
-  } else { // Note that this will throw an exception if v is NOT a Tab
+  } else if (v.tag=='t') {
+    Tab& t = *(Tab*)ValReadBody_(v);
+    return t(ii);
+  } else { // Outcast throws the exception: v is NOT a Tab
     Tab& t = v;
     return t(ii);
   }
@@ -796,12 +955,22 @@ OC_INLINE Val& Val::operator() (ALLOW_UNSIGNED_LONG_LONG ii) const { return ValL
 OC_INLINE Val& Val::operator() (bool ii)   const { return ValLookUpBodyThrow_(*this,ii);}
 
 // Tab and OTab only lookups
-#define OC_OTABLOOKER() if (tag=='o'){OTab&t=*this; return t(v);}Tab&t=*this;return t(v);
+#define OC_OTABLOOKER() if (tag=='o'){OTab&t=*(OTab*)ValReadBody_(*this); return t(v);} if (tag=='t'){Tab&t=*(Tab*)ValReadBody_(*this); return t(v);} Tab&t=*this;return t(v);
 OC_INLINE Val& Val::operator() (real_4 v) const { OC_OTABLOOKER(); }
 OC_INLINE Val& Val::operator() (real_8 v) const { OC_OTABLOOKER(); }
 //OC_INLINE Val& Val::operator() (complex_8 v)  { OC_OTABLOOKER(); }
 //OC_INLINE Val& Val::operator() (complex_16 v) { OTABLOOKER(); }
-OC_INLINE Val& Val::operator() (const char* v) const { OC_OTABLOOKER(); }
+OC_INLINE Val& Val::operator() (const char* v) const 
+{
+  // Most common lookup: avoid building a temporary Val for the key
+  const size_t len = strlen(v);
+  Val* vp;
+  if      (tag=='o') { OTab& t=*(OTab*)ValReadBody_(*this); vp=t.lookup(v, len); }
+  else if (tag=='t') { Tab& t=*(Tab*)ValReadBody_(*this);   vp=t.lookup(v, len); }
+  else               { Tab& t=*this;  vp = t.lookup(v, len); } // throws
+  if (vp) return *vp;
+  OC_OTABLOOKER(); // Not there: let the table report the error
+}
 OC_INLINE Val& Val::operator() (const Str& v)   const { OC_OTABLOOKER(); }
 OC_INLINE Val& Val::operator() (const Val& v)   const { OC_OTABLOOKER(); }
 
@@ -835,8 +1004,9 @@ OC_INLINE bool same_type_equal (const Val& v1, const Val& v2)
   case 'f': return v1.u.f==v2.u.f;
   case 'd': return v1.u.d==v2.u.d;
   case 'F': return v1.u.F==v2.u.F;
-  case 'D': return v1.u.D==v2.u.D;
-  case 'a': { OCString* s1=(OCString*)&v1.u.a; OCString* s2=(OCString*)&v2.u.a; return *s1==*s2; }
+  case 'D': return OC_VALCX16(v1)==OC_VALCX16(v2);
+  case 'a': { if (v1.hashed && v2.hashed && v1.hashcode!=v2.hashcode) return false; 
+              OCString* s1=(OCString*)&v1.u.a; OCString* s2=(OCString*)&v2.u.a; return *s1==*s2; }
   case 't': { Tab* t1=(Tab*)&v1.u.t; Tab* t2=(Tab*)&v2.u.t; return *t1==*t2; }
   case 'o': {OTab*t1=(OTab*)&v1.u.o;OTab*t2=(OTab*)&v2.u.o; return *t1==*t2; }
   case 'u': { Tup* t1=(Tup*)&v1.u.u; Tup* t2=(Tup*)&v2.u.t; return *t1==*t2; }
@@ -876,8 +1046,9 @@ OC_INLINE bool same_type_equal (const Val& v1, const Val& v2)
   return false;
 }
 
-#define PROXYCOMPEQ(T) { T& t1=p; T& t2=v; return t1==t2; }
-#define PROXYCOMPARREQ(T) { Array<T>& a1=p; Array<T>& a2=v; return a1==a2; }
+// Only reading the proxy, so go straight to its data (no copy-on-write)
+#define PROXYCOMPEQ(T) { T& t1=*(T*)p.data_(); T& t2=*(T*)ValReadBody_(v); return t1==t2; }
+#define PROXYCOMPARREQ(T) { Array<T>& a1=*(Array<T>*)p.data_(); Array<T>& a2=*(Array<T>*)ValReadBody_(v); return a1==a2; }
 inline bool ProxyEq (const Proxy& p, const Val& v)
 {
   // Not equal if not the same type!
@@ -919,8 +1090,8 @@ inline bool ProxyEq (const Proxy& p, const Val& v)
   return false;
 }
 
-#define PROXYCOMPLT(T) { T& t1=p; T& t2=v; return invert ? t2<t1 : t1<t2; }
-#define PROXYCOMPARRLT(T) { Array<T>& a1=p; Array<T>& a2=v; return invert ? a2<a1 : a1<a2; }
+#define PROXYCOMPLT(T) { T& t1=*(T*)p.data_(); T& t2=*(T*)ValReadBody_(v); return invert ? t2<t1 : t1<t2; }
+#define PROXYCOMPARRLT(T) { Array<T>& a1=*(Array<T>*)p.data_(); Array<T>& a2=*(Array<T>*)ValReadBody_(v); return invert ? a2<a1 : a1<a2; }
 inline bool ProxyLT (const Proxy& p, const Val& v, bool invert)
 {
   // Default kind of compare (like Val compares for total order)
@@ -966,12 +1137,12 @@ OC_INLINE bool operator== (const Val& v1, const Val& v2)
 
   // So that dicts can compare like in Python
   if (v1.tag=='o' && v2.tag=='t') {
-    OTab& o = v1; 
-    Tab&  t = v2;
+    OTab& o = *(OTab*)ValReadBody_(v1); 
+    Tab&  t = *(Tab*)ValReadBody_(v2);
     return bool(o==t);
   } else if (v1.tag=='t' && v2.tag=='o') {
-    Tab& t = v1; 
-    OTab& o = v2;
+    Tab& t = *(Tab*)ValReadBody_(v1); 
+    OTab& o = *(OTab*)ValReadBody_(v2);
     return bool(t==o);
   }
 
@@ -1261,14 +1432,14 @@ OC_INLINE ostream& operator<< (ostream& os, const Val& v)
   case 'q': { int_n* temp = (int_n*)&v.u.q; os << (*temp) << "L"; break; }
   case 'Q': { int_un* temp = (int_un*)&v.u.Q; os << (*temp) << "L"; break; }
   case 'b': { Str res = "False"; if (v.u.b) res="True"; os << res; break; }
-  case 'f': os << Stringize(v.u.f); break; 
-  case 'd': os << Stringize(v.u.d); break; 
+  case 'f': { char b[OC_REAL_CHARS]; os.write(b, StringizeReal(v.u.f, b)); break; }
+  case 'd': { char b[OC_REAL_CHARS]; os.write(b, StringizeReal(v.u.d, b)); break; }
 #if defined(OC_SUPPORT_XM)
-  case 'F': os.precision(OC_FLT_DIGITS);  os<<"("<<v.u.F.re<<((v.u.F.im<0)?"":"+")<<v.u.F.im<<"j)"; break;
-  case 'D': os.precision(OC_DBL_DIGITS); os<<"("<<v.u.D.re<<((v.u.D.im<0)?"":"+")<<v.u.D.im<<"j)"; break;
+  case 'F': PrintComplex_(os, v.u.F.re, v.u.F.im); break;
+  case 'D': PrintComplex_(os, OC_VALCX16(v).re, OC_VALCX16(v).im); break;
 #else
   case 'F': os << complex_8(v.u.F.re, v.u.F.im); break;
-  case 'D': os << complex_16(v.u.D.re, v.u.D.im); break;
+  case 'D': os << complex_16(OC_VALCX16(v).re, OC_VALCX16(v).im); break;
 #endif
   case 'a': { OCString *s = (OCString*)&v.u.a; os << PyImage(*s);  break; }
   case 't': { Tab *t = (Tab*)&v.u.t; os << *t; break; }
@@ -1373,12 +1544,31 @@ OC_INLINE Tab::Tab (const Str& s, Allocator*)
   r.expectTab(*this);
 }
 
-OC_INLINE Tab::Tab (Allocator* alloc) : AVLHashT<Val, Val, 8>(alloc) { }
+OC_INLINE Tab::Tab (Allocator* alloc) : TabImpl_(alloc) { }
 
 OC_INLINE Tab::Tab (const Tab& t, Allocator* a) : 
-  AVLHashT<Val, Val, 8>(t, a) 
+  TabImpl_(t, a) 
 { }
 
+#if defined(OC_MOVE_SEMANTICS)
+OC_INLINE Tab::Tab (Tab&& t) : TabImpl_(t.allocator()) { this->swap(t); }
+
+OC_INLINE Tab& Tab::operator= (Tab&& rhs)
+{
+  if (&rhs!=this) {
+    if (allocator()==rhs.allocator()) {
+      // rhs may be nested inside of this: take it out first
+      Tab temp(std::move(rhs));
+      this->swap(temp);
+    } else {
+      const Tab& copy = rhs;
+      *this = copy;
+    }
+  }
+  return *this;
+}
+#endif
+
 
 OC_INLINE void Tab::appendHelper_ (const Val& key, const Val& value)
 {
@@ -1516,12 +1706,33 @@ OC_INLINE OTab::OTab (const Str& s, Allocator*)
   r.expectOTab(*this);
 }
 
-OC_INLINE OTab::OTab (Allocator* alloc) : OrdAVLHashT<Val, Val, 8>(alloc) { }
+OC_INLINE OTab::OTab (Allocator* alloc) : OTabImpl_(alloc) { }
 
 OC_INLINE OTab::OTab (const OTab& t, Allocator* a) : 
-  OrdAVLHashT<Val, Val, 8>(t, a) 
+  OTabImpl_(t, a) 
 { }
 
+#if defined(OC_MOVE_SEMANTICS)
+OC_INLINE OTab::OTab (OTab&& t) : 
+  OTabImpl_(t.allocator()) 
+{ this->swap(t); }
+
+OC_INLINE OTab& OTab::operator= (OTab&& rhs)
+{
+  if (&rhs!=this) {
+    if (allocator()==rhs.allocator()) {
+      // rhs may be nested inside of this: take it out first
+      OTab temp(std::move(rhs));
+      this->swap(temp);
+    } else {
+      const OTab& copy = rhs;
+      *this = copy;
+    }
+  }
+  return *this;
+}
+#endif
+
 
 OC_INLINE void OTab::appendHelper_ (const Val& key, const Val& value)
 {
@@ -1868,7 +2079,14 @@ OC_INLINE void Val::swap (Val& rhs)
 { 
   OC_NAMESPACED::swap(this->tag,     rhs.tag);
   OC_NAMESPACED::swap(this->subtype, rhs.subtype);
+#if defined(OC_COMPACT_VAL)
+  const bool p = isproxy; isproxy = rhs.isproxy; rhs.isproxy = p; // bitfields
+  const bool h = hashed;  hashed = rhs.hashed;   rhs.hashed = h;
+#else
   OC_NAMESPACED::swap(this->isproxy, rhs.isproxy);
+  OC_NAMESPACED::swap(this->hashed,  rhs.hashed);
+#endif
+  OC_NAMESPACED::swap(this->hashcode,rhs.hashcode);
   OC_NAMESPACED::swap(this->a,       rhs.a);
   OC_NAMESPACED::swap(this->u,       rhs.u); 
 }
@@ -1879,8 +2097,11 @@ OC_INLINE int Val::entries () const
   if (isproxy) {
     Proxy* pp=(Proxy*)&(u.P);
     if (pp->tag=='t') {
-      Tab& t = *pp;
-      ent = t.entries();
+      Tab* tp = (Tab*)pp->data_();
+      ent = tp->entries();
+    } else if (pp->tag=='o') {
+      OTab* tp = (OTab*)pp->data_();
+      ent = tp->entries();
     } else {
       Arr* ap = (Arr*)pp->data_(); // May be different type, layout the same
       ent = ap->length();
@@ -1912,18 +2133,21 @@ OC_INLINE int Val::entries () const
 }
 
 
-#define OC_CONTAINS(T) { Array<T>&arr=*this; con=arr.contains(key); break; }
+#define OC_CONTAINS(T) { Array<T>&arr=*(Array<T>*)body; con=arr.contains(key); break; }
 OC_INLINE bool Val::contains (const Val& key) const
 {
   int con = -17;
+  // Only looking, so go straight to the data (even through a Proxy):
+  // a copy-on-write proxy shouldn't detach here
+  void* body = isproxy ? ((Proxy*)&u.P)->data_() : (void*)&u.t;
   if (tag=='t') {
-    Tab& t = *this;
+    Tab& t = *(Tab*)body;
     con = t.contains(key);
   } else if (tag=='o') {
-    OTab& t = *this;
+    OTab& t = *(OTab*)body;
     con = t.contains(key);
   } else if (tag=='u') {
-    Tup& t = *this;
+    Tup& t = *(Tup*)body;
     con = t.contains(key);
   } else if (tag=='n') {
     switch (subtype) {
@@ -1968,7 +2192,7 @@ OC_INLINE bool Val::remove (const Val& key)
     OTab& t = *this;
     con = t.remove(key);
   } else if (tag=='u') {
-    Tup& t = *this;
+    Tup& t = TupOf_(*this);
     con = t.remove(key);
   } else if (tag=='n') {
     switch (subtype) {
@@ -2034,7 +2258,7 @@ OC_INLINE void Val::append (const Val& v)
     OTab& t = *this;
     t.append(v);
   } else if (tag=='u') {
-    Tup& t = *this;
+    Tup& t = TupOf_(*this);
     t.append(v);
   } else if (tag=='n') {
     switch (subtype) {
@@ -2054,7 +2278,7 @@ OC_INLINE void Val::append (const Val& v)
     case 'a': {Array<Str>*ap=(Array<Str>*)&v.u.a;ap->append(v); break;}
     case 't': {Array<Tab>*ap=(Array<Tab>*)&v.u.a;ap->append(v); break;}
     case 'o': {Array<OTab>*ap=(Array<OTab>*)&v.u.o;ap->append(v); break;}
-    case 'u': {Array<Tup>*ap=(Array<Tup>*)&v.u.u;ap->append(v); break;}
+    case 'u': {Array<Tup>*ap=(Array<Tup>*)&v.u.u;Tup&tu=v;ap->append(tu); break;}
     case 'n': throw logic_error("Arrays of Arrays not currently supported");
     case 'Z': OC_APPEND(Val);    
     default:  unknownType_("append", subtype);
@@ -2078,27 +2302,42 @@ OC_INLINE void Val::appendStr (const Val& v)
 }
 
 
+// Helpers for OCHelpProxize_: an empty T in the given allocator
+template <class T>
+inline T* OCNewEmpty_ (T*, Allocator* a)
+{ return new (a->allocate(sizeof(T))) T(a); }
+template <class T>
+inline Array<T>* OCNewEmpty_ (Array<T>*, Allocator* a)
+{ return new (a->allocate(sizeof(Array<T>))) Array<T>(0, a); }
+
 template <class T>
 inline void OCHelpProxize_ (Val& v, T* impl, 
-			    bool adopt, bool locked)
+			    bool adopt, bool locked, bool copy_on_write)
 {
-  // Turn into a Proxy by swapping the implementations! 
-  T* new_thing = new T();  // TODO: Allocator?
+  // Turn into a Proxy by swapping the implementations!  The new body
+  // (and so the proxy's ref count) comes from the same allocator.
+  Allocator* a = v.allocator();
+  T* new_thing = a ? OCNewEmpty_(impl, a) : new T();
   impl->swap(*new_thing);
-  v = Proxy(new_thing, adopt, locked);  // creates proxy for us
+  Proxy p(new_thing, adopt, locked);
+  p.copyOnWrite(copy_on_write);
+  v = p;  // creates proxy for us
 }
 
 
-#define OC_HELPPROX(T) {Array<T>*ap=(Array<T>*)&u.n;OCHelpProxize_(*this,ap,adopt, locked); break; }
-OC_INLINE void Val::Proxyize (bool adopt, bool locked)
+#define OC_HELPPROX(T) {Array<T>*ap=(Array<T>*)&u.n;OCHelpProxize_(*this,ap,adopt, locked, copy_on_write); break; }
+OC_INLINE void Val::Proxyize (bool adopt, bool locked, bool copy_on_write)
 {
   if (isproxy) return; 
+  if (locked && copy_on_write) {
+    throw logic_error("Copy-on-write proxies can't be locked");
+  }
   if (tag=='t') {
-    OCHelpProxize_(*this,(Tab*)&u.t, adopt, locked);
+    OCHelpProxize_(*this,(Tab*)&u.t, adopt, locked, copy_on_write);
   } else if (tag=='o') {
-    OCHelpProxize_(*this,(OTab*)&u.o, adopt, locked);
+    OCHelpProxize_(*this,(OTab*)&u.o, adopt, locked, copy_on_write);
   } else if (tag=='u') {
-    OCHelpProxize_(*this,(Tup*)&u.u, adopt, locked);
+    OCHelpProxize_(*this,(Tup*)&u.u, adopt, locked, copy_on_write);
   } else if (tag=='n') {
     switch (subtype) {
     case 's': OC_HELPPROX(int_1);  
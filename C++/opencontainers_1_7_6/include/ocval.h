@@ -36,7 +36,9 @@ OC_END_NAMESPACE
 
 #include "ochashtable.h" 
 #include "ocavlhasht.h"
+#include "ocflathasht.h"
 #include "ocordavlhasht.h"
+#include "occompactordhasht.h"
 #include "ocbigint.h" // both int_un and int_n
 #include "ocproxy.h"  // Weird depends ...
 
@@ -159,41 +161,152 @@ inline bool oc_is_numeric (char t) { switch (t) { case 'a': case 't': case 'o':
 #define OC_IS_NUMERIC(v) (oc_is_numeric(v.tag))
 
 
+#if defined(OC_COMPACT_VAL)
+
+// Compiled with OC_COMPACT_VAL, a Val is only 16 bytes (instead of
+// 48): the union only has room for 8 bytes, so anything bigger (Str,
+// Tab, OTab, Tup, Array<T>, int_n, int_un, complex_16 and Proxy) is
+// allocated out of line and the union just holds where it is.
+// Taking the address of one of those union members (&v.u.t) gives
+// the out of line memory, so code like (Tab*)&v.u.t works in both
+// layouts.  Only code that constructs right into a Val has to ask
+// for the memory first, with newSpace_.
+struct OCValBox_ {
+  void* where;
+  void* operator& () const { return where; }
+};
+
+// ... and the allocator is kept as a one byte index into a table of
+// every allocator Vals have been given (0 is the default, the heap),
+// so up to 255 different allocators can be in use at once.  When a
+// pool is cleaned (StreamingPool::Clean, which is what a ValArena
+// does when it goes away), its slot goes on a free-list to be used
+// again, so a process can go through any number of arenas.
+class OCValAllocator_ {
+ public:
+  OCValAllocator_ () : index_(0) { }
+  OCValAllocator_ (Allocator* a) : index_(a ? IndexOf_(a) : 0) { }
+  operator Allocator* () const { return index_ ? Table_()[index_] : 0; }
+  bool operator== (const OCValAllocator_& rhs) const 
+  { return index_==rhs.index_; }
+
+  // Give back the slot for this allocator (if it has one)
+  static void Forget (Allocator* a)
+  {
+    FreeSlots_& f = FreeSlots_::Get();
+    ProtectScope ps(f.lock);
+    Allocator** table = Table_();
+    for (int ii=1; ii<f.used; ii++) {
+      if (table[ii]==a) {
+	table[ii] = 0;
+	f.slots[f.free++] = int_u1(ii);
+	return;
+      }
+    }
+  }
+
+ protected:
+  int_u1 index_;
+  static Allocator** Table_ () { static Allocator* table[256]; return table; }
+
+  // How much of the table has ever been used, and the slots given
+  // back by Forget (all under the lock)
+  struct FreeSlots_ {
+    Mutex lock;
+    int used;
+    int free;
+    int_u1 slots[256];
+    FreeSlots_ () : used(1), free(0) { }
+    static FreeSlots_& Get () { static FreeSlots_ f; return f; }
+  };
+  static int_u1 IndexOf_ (Allocator* a)
+  {
+    FreeSlots_& f = FreeSlots_::Get();
+    ProtectScope ps(f.lock);
+    Allocator** table = Table_();
+    for (int ii=1; ii<f.used; ii++) {
+      if (table[ii]==a) return int_u1(ii);
+    }
+    StreamingPool::CleanHook() = Forget;
+    int_u1 slot;
+    if (f.free) {
+      slot = f.slots[--f.free];
+    } else if (f.used==256) {
+      throw runtime_error("Too many allocators for OC_COMPACT_VAL");
+    } else {
+      slot = int_u1(f.used++);
+    }
+    table[slot] = a;
+    return slot;
+  }
+}; // OCValAllocator_
+
+#endif // OC_COMPACT_VAL
+
+
+// The init list for the hash cache and the allocator of a Val: they
+// are in a different order in the two layouts, and the init lists
+// have to follow the declarations.  Most constructors start with no
+// cached hash.
+#if defined(OC_COMPACT_VAL)
+#  define OC_VAL_HASH_ALLOC_(H, HC, ALLOC) hashed(H), a(ALLOC), hashcode(HC)
+#else
+#  define OC_VAL_HASH_ALLOC_(H, HC, ALLOC) hashed(H), hashcode(HC), a(ALLOC)
+#endif
+#define OC_VAL_UNHASHED_(ALLOC) OC_VAL_HASH_ALLOC_(false, 0, ALLOC)
+
 // A value container for heterogeneous types: Note that we can
 // recursively contain other Vals.
 struct Val {
 
-    char tag; char subtype; bool isproxy; char pad[1];
+#if defined(OC_COMPACT_VAL)
+    char tag; char subtype; bool isproxy : 1; 
+    bool hashed : 1;
+    OCValAllocator_ a;
+    int_u4 hashcode;
+#else
+    char tag; char subtype; bool isproxy; 
+
+    // A string key caches its hash when it goes into a table (see
+    // CacheHash_), and copies and swaps carry the cache along, so
+    // keys that come out of a table never get hashed again.  Lookups
+    // never write the cache (they only look at a const Val, which
+    // other threads may be reading too).  These live in what used to
+    // be padding, so a Val is no bigger on 64-bit.
+    bool hashed; 
+    int_u4 hashcode;
+
     Allocator* a;
+#endif
 
     inline Allocator* allocator () const { return a; }
 
     // Constructors for every explicit type
     Val (void*) { throw logic_error("Cannot handle proxies except for Arr, Tab, OTab and Array<T>"); }
 
-    Val () : tag('Z'), isproxy(false), a(0) { }   // None value
-    Val (int_1 v)  : tag('s'), isproxy(false), a(0) { u.s = v; } 
-    Val (int_u1 v) : tag('S'), isproxy(false), a(0) { u.S = v; }
-    Val (int_2 v)  : tag('i'), isproxy(false), a(0) { u.i = v; }
-    Val (int_u2 v) : tag('I'), isproxy(false), a(0) { u.I = v; }
-    Val (int_4 v)  : tag('l'), isproxy(false), a(0) { u.l = v; }
-    Val (int_u4 v) : tag('L'), isproxy(false), a(0) { u.L = v; }
-    Val (int_8 v)  : tag('x'), isproxy(false), a(0) { u.x = v; }
-    Val (int_u8 v) : tag('X'), isproxy(false), a(0) { u.X = v; }
-    Val (ALLOW_SIZE_T v) : tag('X'), isproxy(false), a(0) { u.X = v; }
-    Val (ALLOW_LONG v) : tag('x'), isproxy(false), a(0) { u.X = v; }
-    Val (ALLOW_UNSIGNED_LONG v) : tag('X'), isproxy(false), a(0) { u.X = v; }
-    Val (ALLOW_LONG_LONG v) : tag('x'), isproxy(false), a(0) { u.X = v; }
-    Val (ALLOW_UNSIGNED_LONG_LONG v) : tag('X'), isproxy(false), a(0) { u.X = v; }
-    Val (bool v)   : tag('b'), isproxy(false), a(0) { u.b = v; }
-    Val (real_4 v) : tag('f'), isproxy(false), a(0) { u.f = v; }
-    Val (real_8 v) : tag('d'), isproxy(false), a(0) { u.d = v; }
-    Val (complex_8 v):tag('F'), isproxy(false),a(0) { new (&u.F) complex_8(v);}
-    Val (complex_16 v):tag('D'), isproxy(false),a(0) {new (&u.D)complex_16(v);}
-    Val (const char* cc) : tag('a'), isproxy(false), a(0) { new (&u.a) OCString(cc); }
-    Val (const Str& s)   : tag('a'), isproxy(false), a(0) { new (&u.a) OCString(s.data(), s.length()); }
+    Val () : tag('Z'), isproxy(false), OC_VAL_UNHASHED_(0) { }   // None value
+    Val (int_1 v)  : tag('s'), isproxy(false), OC_VAL_UNHASHED_(0) { u.s = v; } 
+    Val (int_u1 v) : tag('S'), isproxy(false), OC_VAL_UNHASHED_(0) { u.S = v; }
+    Val (int_2 v)  : tag('i'), isproxy(false), OC_VAL_UNHASHED_(0) { u.i = v; }
+    Val (int_u2 v) : tag('I'), isproxy(false), OC_VAL_UNHASHED_(0) { u.I = v; }
+    Val (int_4 v)  : tag('l'), isproxy(false), OC_VAL_UNHASHED_(0) { u.l = v; }
+    Val (int_u4 v) : tag('L'), isproxy(false), OC_VAL_UNHASHED_(0) { u.L = v; }
+    Val (int_8 v)  : tag('x'), isproxy(false), OC_VAL_UNHASHED_(0) { u.x = v; }
+    Val (int_u8 v) : tag('X'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (ALLOW_SIZE_T v) : tag('X'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (ALLOW_LONG v) : tag('x'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (ALLOW_UNSIGNED_LONG v) : tag('X'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (ALLOW_LONG_LONG v) : tag('x'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (ALLOW_UNSIGNED_LONG_LONG v) : tag('X'), isproxy(false), OC_VAL_UNHASHED_(0) { u.X = v; }
+    Val (bool v)   : tag('b'), isproxy(false), OC_VAL_UNHASHED_(0) { u.b = v; }
+    Val (real_4 v) : tag('f'), isproxy(false), OC_VAL_UNHASHED_(0) { u.f = v; }
+    Val (real_8 v) : tag('d'), isproxy(false), OC_VAL_UNHASHED_(0) { u.d = v; }
+    Val (complex_8 v):tag('F'), isproxy(false),OC_VAL_UNHASHED_(0) { new (&u.F) complex_8(v);}
+    Val (complex_16 v):tag('D'), isproxy(false),OC_VAL_UNHASHED_(0) {new (newSpace_(sizeof(complex_16)))complex_16(v);}
+    Val (const char* cc) : tag('a'), isproxy(false), OC_VAL_UNHASHED_(0) { new (newSpace_(sizeof(OCString))) OCString(cc); }
+    Val (const Str& s)   : tag('a'), isproxy(false), OC_VAL_UNHASHED_(0) { new (newSpace_(sizeof(OCString))) OCString(s.data(), s.length()); }
 #if !defined(OC_USE_OC_STRING)
-    Val (const OCString& s)   : tag('a'), isproxy(false), a(0) { new (&u.a) OCString(s); }
+    Val (const OCString& s)   : tag('a'), isproxy(false), OC_VAL_UNHASHED_(0) { new (newSpace_(sizeof(OCString))) OCString(s); }
 #endif
     OC_INLINE Val (const Tab& v, Allocator* a=0);
     OC_INLINE Val (const OTab& ot, Allocator* a=0);
@@ -201,13 +314,13 @@ struct Val {
     OC_INLINE Val (const int_n& tu, Allocator* a=0);
     OC_INLINE Val (const int_un& tu, Allocator* a=0);
     Val (const Proxy& p) : tag(p.tag), subtype(p.subtype), isproxy(true), 
-                           a(0) { new (&u.P) Proxy(p); }
-    Val (Tab* adopt_table) : tag('t'), isproxy(true), a(0) 
-                                          { new (&u.P) Proxy(adopt_table); }
-    Val (OTab* adopt_table) : tag('o'), isproxy(true), a(0) 
-                                          { new (&u.P) Proxy(adopt_table); }
-    Val (Tup* adopt_tuple) : tag('u'), isproxy(true), a(0) 
-                                          { new (&u.P) Proxy(adopt_tuple); }
+                           OC_VAL_UNHASHED_(0) { new (newSpace_(sizeof(Proxy))) Proxy(p); }
+    Val (Tab* adopt_table) : tag('t'), isproxy(true), OC_VAL_UNHASHED_(0) 
+                                          { new (newSpace_(sizeof(Proxy))) Proxy(adopt_table); }
+    Val (OTab* adopt_table) : tag('o'), isproxy(true), OC_VAL_UNHASHED_(0) 
+                                          { new (newSpace_(sizeof(Proxy))) Proxy(adopt_table); }
+    Val (Tup* adopt_tuple) : tag('u'), isproxy(true), OC_VAL_UNHASHED_(0) 
+                                          { new (newSpace_(sizeof(Proxy))) Proxy(adopt_tuple); }
 
     // Construct an Array of any primitive type Val can hold,
     // Array<int_4>, Array<real_8>, Array<Val> (aka Arr).  No Arrays
@@ -219,7 +332,7 @@ struct Val {
     // of Arrays.  This ADOPTS a new Array<T>
     template <class T>
     Val (Array<T>* adopt_arr, Allocator*aa=0):tag('n'), subtype(TagFor((T*)0)), 
-                   isproxy(true), a(aa) { new (&u.P) Proxy(adopt_arr); }
+                   isproxy(true), OC_VAL_UNHASHED_(aa) { new (newSpace_(sizeof(Proxy))) Proxy(adopt_arr); }
 
 
     // Copy constructor:  Have to write because of string, table, array cases
@@ -228,6 +341,20 @@ struct Val {
     // Copy: Have to write for string, table, array classes
     OC_INLINE Val& operator= (const Val& v); 
 
+#if defined(OC_MOVE_SEMANTICS)
+    // Move constructor and move assignment: steal the contents of the
+    // rhs (which is left as None) instead of copying whole subtrees.
+    OC_INLINE Val (Val&& r);
+    OC_INLINE Val& operator= (Val&& v);
+
+    // Move a string or container into a Val without copying it
+    OC_INLINE Val (OCString&& s);
+    OC_INLINE Val (Tab&& t);
+    OC_INLINE Val (OTab&& ot);
+    OC_INLINE Val (Tup&& tu);
+    template <class T> OC_INLINE Val (Array<T>&& arr);
+#endif
+
     // Destructor: Have to write for string, table, array classes
     OC_INLINE ~Val ();
 
@@ -312,10 +439,21 @@ struct Val {
     OC_INLINE operator complex_8 () const;
     OC_INLINE operator complex_16 () const;
     OC_INLINE operator Str ()    const;
-    OC_INLINE operator Tab& () const; // Throw logic_error if not really table
-    OC_INLINE operator Arr& () const; // Throw logic_error if not really Arr
+
+    // The references to containers come in pairs: from a non-const
+    // Val, the reference is for changing things, so a copy-on-write
+    // Proxy detaches its own copy of a shared body first.  From a
+    // const Val, the reference is only for looking, and it never
+    // detaches (so printing, comparing or iterating through a
+    // const Val& keeps the sharing, and is safe for many readers).
+    // Tup only has the const one (see TupOf_ below).
+    OC_INLINE operator Tab& (); // Throw logic_error if not really table
+    OC_INLINE operator Tab& () const; 
+    OC_INLINE operator Arr& (); // Throw logic_error if not really Arr
+    OC_INLINE operator Arr& () const; 
     OC_INLINE operator Proxy& () const; //Throw logic_error if not really Proxy
-    OC_INLINE operator OTab& () const; //Throw logic_error if not really OTab
+    OC_INLINE operator OTab& (); //Throw logic_error if not really OTab
+    OC_INLINE operator OTab& () const; 
     OC_INLINE operator Tup& () const; //Throw logic_error if not really Tup
   //OC_INLINE operator int_n& () const; //Throw logic_error if not really int_n
     OC_INLINE operator int_n () const; //Throw logic_error if not really int_n
@@ -329,13 +467,26 @@ struct Val {
 #if defined(TEMPLATE_OUTCONVERSION_SUPPORTED)
     // Interestingly, this "feature" to outcast isn't supported by all
     // compilers: if that is the case, you may have to revert to OC1.3.4
-    template <class T> operator Array<T>& () const 
+    template <class T> operator Array<T>& () 
     {
       if (isproxy) {
 	Proxy* p = (Proxy*)&u.P;
 	Array<T>& pa = *p; // Have proxy do conversion
 	return pa;
-      } else if ('n'!=tag! || TagFor((T*)0) != subtype) {
+      } else if ('n'!=tag || TagFor((T*)0) != subtype) {
+	Str mesg = "No conversion from:"+Str(*this)+" to array.";
+	throw logic_error(mesg.c_str());
+      } 
+      Array<T>* n = (Array<T>*)&u.n;
+      return *n;
+    }
+    template <class T> operator Array<T>& () const 
+    {
+      if (isproxy) {
+	const Proxy* p = (const Proxy*)&u.P;
+	Array<T>& pa = *p; // Have proxy do conversion: no detach
+	return pa;
+      } else if ('n'!=tag || TagFor((T*)0) != subtype) {
 	Str mesg = "No conversion from:"+Str(*this)+" to array.";
 	throw logic_error(mesg.c_str());
       } 
@@ -345,9 +496,13 @@ struct Val {
 #else
 
 // Same code as above ... squiched to fit in macro
-#  define TEMPLATE_OUTCONV(T) operator Array<T>& () const { \
+#  define TEMPLATE_OUTCONV(T) operator Array<T>& () { \
 if (isproxy) { Proxy*p=(Proxy*)&u.P;Array<T>& pa=*p;return pa;}\
 else if ('n'!=tag || TagFor((T*)0)!= subtype) { Str mesg = "No conversion from:"+Str(*this)+" to array.";throw logic_error(mesg.c_str()); } \
+Array<T>*n=(Array<T>*)&u.n;return *n;} \
+operator Array<T>& () const { \
+if (isproxy) { const Proxy*p=(const Proxy*)&u.P;Array<T>& pa=*p;return pa;}\
+else if ('n'!=tag || TagFor((T*)0)!= subtype) { Str mesg = "No conversion from:"+Str(*this)+" to array.";throw logic_error(mesg.c_str()); } \
 Array<T>*n=(Array<T>*)&u.n;return *n;}
 
     TEMPLATE_OUTCONV(int_1)
@@ -389,6 +544,9 @@ Array<T>*n=(Array<T>*)&u.n;return *n;}
 	real_4 f;
 	real_8 d;       // in a union with a real_8, so no need to worry 
         cx_union_t<real_4> F;
+#if defined(OC_COMPACT_VAL)
+        OCValBox_ D, a, t, n, P, o, u, q, Q;  // all out of line
+#else
         cx_union_t<real_8> D;
 	char a[VALSTR]; // sizeof(Str)
 	char t[VALTAB]; // sizeof(Tab) 
@@ -398,6 +556,7 @@ Array<T>*n=(Array<T>*)&u.n;return *n;}
         char u[VALTUP]; // sizeof(Tup)
         char q[VALBIGINT]; // sizeof(int_n)
         char Q[VALBIGUINT]; // sizeof(int_n)
+#endif
       
       // NOTE: u.a is ALWAYS an OCString (because they coopy faster
       // and are friendlier on the heap. The Array<> of string is
@@ -410,6 +569,18 @@ Array<T>*n=(Array<T>*)&u.n;return *n;}
     // Swap in O(1) time.
     OC_INLINE void swap (Val& rhs);
 
+    // Memory to construct the Str, Tab, etc. this Val holds into:
+    // right in the union, or (with OC_COMPACT_VAL) out of line.  Set
+    // the allocator before asking, and delete the space after the
+    // thing in it is destructed.
+#if defined(OC_COMPACT_VAL)
+    OC_INLINE void* newSpace_ (size_t bytes);
+    OC_INLINE void deleteSpace_ ();
+#else
+    void* newSpace_ (size_t) { return &u; }
+    void deleteSpace_ () { }
+#endif
+
     // Print this Val with nesting
     OC_INLINE void prettyPrint (ostream& os, int starting_indent=0, 
 				int additive_indent=4) const;
@@ -446,8 +617,10 @@ Array<T>*n=(Array<T>*)&u.n;return *n;}
     // copying the data, just moving a few things around.  If this is
     // already a proxy, then it immediately returns.  If the Val
     // contains something that can't be Proxyized, then a logic_error
-    // is thrown.  The parameters indicate what kind of proxy this is.
-    OC_INLINE void Proxyize (bool adopt=true, bool locked=false);
+    // is thrown.  The parameters indicate what kind of proxy this is
+    // (see ocproxy.h: a copy-on-write proxy can't also be locked).
+    OC_INLINE void Proxyize (bool adopt=true, bool locked=false,
+			     bool copy_on_write=false);
   
     // This is the inverse operation of Proxyize: turn a Proxy inside into
     // something that is contained by Val.  TODO:  Worried about copyies?
@@ -474,6 +647,35 @@ OC_INLINE bool operator>= (const Val&v1, const Val&v2);
 static const Val None;  // None constant, default constructed
 
 
+// A StrView is just a pointer and a length: it doesn't own (or copy)
+// the string it refers to.  It's used to look up string keys in a
+// Tab or OTab without building a temporary Val (and OCString) for
+// the key:
+//   StrView key("timestamp", 9);
+//   Val* vp = t.lookup(key, key.hash());  // 0 if not there
+// Tab and OTab have lookup/contains/find overloads that take the
+// (const char*, length) directly.
+struct StrView {
+  StrView (const char* d, size_t len) : data(d), length(len) { }
+  explicit StrView (const char* d) : data(d), length(strlen(d)) { }
+
+  // The same hash a Val holding this string would have
+  int_u4 hash () const { return int_u4(OCStringHashFunction(data, int(length))); }
+
+  const char* data;
+  size_t      length;
+}; // StrView
+
+// A StrView is only ever equal to a string Val with the same bytes
+inline bool operator== (const Val& v, const StrView& s)
+{
+  if (v.tag!='a') return false;
+  const OCString* sp = (const OCString*)&v.u.a;
+  return sp->length()==s.length && memcmp(sp->data(), s.data, s.length)==0;
+}
+inline bool operator!= (const Val& v, const StrView& s) { return !(v==s); }
+
+
 // Specialization, since Val supports allocators
 template <>
 inline void PlaceCopyCons_ (void* location, const Val& copy, Allocator* a)
@@ -481,6 +683,26 @@ inline void PlaceCopyCons_ (void* location, const Val& copy, Allocator* a)
   new (location) Val(copy, a); 
 }
 
+// Specialization: a string key caches its hash as it goes into a
+// table.  The table is being changed, so nobody else is looking at
+// the node: this is the only place the cache is filled.
+template <>
+inline void CacheHash_ (Val& key, int_u4 keyhash)
+{
+  if (key.tag=='a' && !key.isproxy) {
+    key.hashcode = keyhash;
+    key.hashed = true;
+  }
+}
+
+// Specialization, since OCString supports allocators (so the strings
+// of an Array<Str> come from the same place as the Array)
+template <>
+inline void PlaceCopyCons_ (void* location, const OCString& copy, Allocator* a)
+{ 
+  new (location) OCString(copy, a); 
+}
+
 // Specialization: This allows us to construct things using the
 // allocator for Tabs Vals and Arrs
 template <> 
@@ -503,13 +725,78 @@ AVLCreateNode<Val, Val> (void* memory_to_construct_into,
 }
 
 
+// Specialization: same as above, for when Tab is a FlatHashT
+template <> 
+inline FlatNode_<Val, Val>* 
+FlatCreateNode<Val, Val> (void* memory_to_construct_into,
+			  const Val& key, int_u4 keyhash, const Val& value,
+			  Allocator* a)
+{
+  // Construct default Val first
+  FlatNode_<Val, Val>* result = new (memory_to_construct_into) FlatNode_<Val, Val>(Val(),keyhash,Val());
+  // No need to destruct Vals, there are just Nones
+  
+  // Now, construct using the allocator
+  new (&result->key) Val(key, a);
+  new (&result->value) Val(value, a);
+  return result;
+}
+
+// By default, a Tab is an AVLHashT.  If OC_USE_FLATHASH_TAB is
+// defined, Tab is a FlatHashT instead: same interface, open
+// addressing, so much better lookup speed (but iteration order is
+// different, and removed nodes aren't given back until the Tab is
+// cleared).
+#if defined(OC_USE_FLATHASH_TAB)
+typedef FlatHashT<Val, Val, 8>               TabImpl_;
+typedef FlatHashTIterator<Val, Val, 8>       TabItImpl_;
+typedef FlatHashTSortedIterator<Val, Val, 8> TabSitImpl_;
+#else
+typedef AVLHashT<Val, Val, 8>                TabImpl_;
+typedef AVLHashTIterator<Val, Val, 8>        TabItImpl_;
+typedef AVLHashTSortedIterator<Val, Val, 8>  TabSitImpl_;
+#endif
+
+// Specialization: same as above, for when OTab is a CompactOrdHashT
+template <> 
+inline CompactOrdNode_<Val, Val>* 
+CompactOrdCreateNode<Val, Val> (void* memory_to_construct_into,
+				const Val& key, int_u4 keyhash, 
+				const Val& value, Allocator* a)
+{
+  // Construct default Val first
+  CompactOrdNode_<Val, Val>* result = new (memory_to_construct_into) CompactOrdNode_<Val, Val>(Val(),keyhash,Val());
+  // No need to destruct Vals, there are just Nones
+  
+  // Now, construct using the allocator
+  new (&result->key) Val(key, a);
+  new (&result->value) Val(value, a);
+  return result;
+}
+
+// By default, an OTab is an OrdAVLHashT.  If OC_USE_COMPACT_OTAB is
+// defined, OTab is a CompactOrdHashT instead: same interface, same
+// insertion order, but entries are stored densely (like a Python 3.6+
+// dict) so big OTabs take much less memory and iterate faster.  (A
+// remove may move the other entries, see occompactordhasht.h).
+#if defined(OC_USE_COMPACT_OTAB)
+typedef CompactOrdHashT<Val, Val, 8>               OTabImpl_;
+typedef CompactOrdHashTIterator<Val, Val, 8>       OTabItImpl_;
+typedef CompactOrdHashTSortedIterator<Val, Val, 8> OTabSitImpl_;
+#else
+typedef OrdAVLHashT<Val, Val, 8>                   OTabImpl_;
+typedef OrdAVLHashTIterator<Val, Val, 8>           OTabItImpl_;
+typedef OrdAVLHashTSortedIterator<Val, Val, 8>     OTabSitImpl_;
+#endif
+
+
 // ///////////////////////////////////////////// Class Tab
 
 // Table of Vals: same interface as HashTable, AVLHash, etc.  An
 // AVLHash is an extendible HashTable: performs just about as well as
 // a HashTable, but can grow without having to rehash or reduce
 // performance.
-struct Tab : public AVLHashT<Val, Val, 8> {
+struct Tab : public TabImpl_ {
   
   // Return the total number of elements: entries only returns the
   // total number of entries at the surface level.  In fact, most of
@@ -529,6 +816,23 @@ struct Tab : public AVLHashT<Val, Val, 8> {
   // Have to allow nesting here:  Hide the one from AVLhashT
   OC_INLINE Tab& operator= (const Tab& rhs);
 
+#if defined(OC_MOVE_SEMANTICS)
+  // Move: steals the table (t is left empty)
+  OC_INLINE Tab (Tab&& t);
+  OC_INLINE Tab& operator= (Tab&& rhs);
+
+  // Construct the value in place (from any arguments a Val can be
+  // constructed from) and move the key in: if the key is already
+  // there, its value is replaced.  Returns a reference to the value.
+  //   t.emplace("data", Arr(1000));  // No copy of the Arr
+  template <class KEY, class... ARGS>
+  Val& emplace (KEY&& key, ARGS&&... args)
+  { 
+    return TabImpl_::emplace(Val(std::forward<KEY>(key)), 
+			     Val(std::forward<ARGS>(args)...)); 
+  }
+#endif
+
   // Merge right table into this table
   OC_INLINE Tab& operator+= (const Tab& rhs);
 
@@ -539,7 +843,7 @@ struct Tab : public AVLHashT<Val, Val, 8> {
   OC_INLINE void appendStr (const Val& v);  // string version
 
   // Swap in O(1) time.
-  inline void swap (Tab& rhs) { AVLHashT<Val,Val,8>*me=this;me->swap(rhs); }
+  inline void swap (Tab& rhs) { TabImpl_*me=this;me->swap(rhs); }
 
   // Pretty print the table (with indentation)
   OC_INLINE void prettyPrint (ostream& os, int starting_indent=0, 
@@ -556,6 +860,28 @@ struct Tab : public AVLHashT<Val, Val, 8> {
   // to return a default value, which may not anywhere in particular.
   OC_INLINE Val get (const Val& key, const Val& def=None) const;
 
+  // Look up a string key given as a (pointer, length) without
+  // building a temporary Val for it.  If the hash is already known,
+  // pass it in (it must be what HashFunction gives for the string).
+  // lookup returns a pointer to the value, or 0 if it isn't there.
+  // (Any other probe, like a StrView, can use the base templates.)
+  using TabImpl_::lookup;
+  using TabImpl_::contains;
+  using TabImpl_::find;
+  Val* lookup (const char* key, size_t len) const
+  { StrView s(key, len); return TabImpl_::lookup(s, s.hash()); }
+  Val* lookup (const char* key, size_t len, int_u4 hashkey) const
+  { return TabImpl_::lookup(StrView(key, len), hashkey); }
+  bool contains (const char* key, size_t len) const
+  { return lookup(key, len)!=0; }
+  bool contains (const char* key, size_t len, int_u4 hashkey) const
+  { return lookup(key, len, hashkey)!=0; }
+  bool find (const char* key, size_t len, Val& return_key) const
+  { StrView s(key, len); return TabImpl_::find(s, s.hash(), return_key); }
+  bool find (const char* key, size_t len, int_u4 hashkey, 
+	     Val& return_key) const
+  { return TabImpl_::find(StrView(key, len), hashkey, return_key); }
+
  protected:
  OC_INLINE void appendHelper_ (const Val& key, const Val& value); 
 }; // Tab
@@ -580,15 +906,15 @@ inline void PlaceCopyCons_<Tab> (void* location, const Tab& copy, Allocator* a)
 // is required unless you specifically request it.
 
 // Iterators specfically for Tabs
-struct TabIt : public AVLHashTIterator<Val, Val, 8> {
-    TabIt (const Tab& t) : AVLHashTIterator<Val, Val, 8>(t) { }
-    TabIt () : AVLHashTIterator<Val,Val,8>() { }
+struct TabIt : public TabItImpl_ {
+    TabIt (const Tab& t) : TabItImpl_(t) { }
+    TabIt () : TabItImpl_() { }
 }; // TabIt
 
 // Sorted iterator WILL give you the keys in sorted order
-struct TabSit : public AVLHashTSortedIterator<Val, Val, 8> {
-    TabSit (const Tab& t) : AVLHashTSortedIterator<Val, Val, 8>(t) { }
-    TabSit () : AVLHashTSortedIterator<Val, Val, 8>() { }
+struct TabSit : public TabSitImpl_ {
+    TabSit (const Tab& t) : TabSitImpl_(t) { }
+    TabSit () : TabSitImpl_() { }
 }; // TabSit
 
 // ///////////////////////////////////////////// Class OTab
@@ -596,7 +922,7 @@ struct TabSit : public AVLHashTSortedIterator<Val, Val, 8> {
 // Similar to Tabs, but iterator preserves insertion order.  Keys that
 // are updated DO NOT change insertion order, and two OTabs must have
 // EXACT SAME INSERTION order to compare equally.
-struct OTab : public OrdAVLHashT<Val, Val, 8> {
+struct OTab : public OTabImpl_ {
   
   // Return the total number of elements: entries only returns the
   // total number of entries at the surface level.  In fact, most of
@@ -618,6 +944,20 @@ struct OTab : public OrdAVLHashT<Val, Val, 8> {
   // Have to allow nesting here:  Hide the one from AVLhashT
   OC_INLINE OTab& operator= (const OTab& rhs);
 
+#if defined(OC_MOVE_SEMANTICS)
+  // Move: steals the table (t is left empty)
+  OC_INLINE OTab (OTab&& t);
+  OC_INLINE OTab& operator= (OTab&& rhs);
+
+  // Construct the value in place and move the key in (see Tab)
+  template <class KEY, class... ARGS>
+  Val& emplace (KEY&& key, ARGS&&... args)
+  { 
+    return OTabImpl_::emplace(Val(std::forward<KEY>(key)), 
+			     Val(std::forward<ARGS>(args)...)); 
+  }
+#endif
+
   // Merge right table into this table
   OC_INLINE OTab& operator+= (const OTab& rhs);
 
@@ -628,7 +968,7 @@ struct OTab : public OrdAVLHashT<Val, Val, 8> {
   OC_INLINE void appendStr (const Val& v);  // string version
 
   // Swap in O(1) time.
-  inline void swap (OTab& rhs) { OrdAVLHashT<Val,Val,8>*me=this;me->swap(rhs);}
+  inline void swap (OTab& rhs) { OTabImpl_*me=this;me->swap(rhs);}
 
   // Pretty print the table (with indentation)
   OC_INLINE void prettyPrint (ostream& os, int starting_indent=0, 
@@ -645,6 +985,28 @@ struct OTab : public OrdAVLHashT<Val, Val, 8> {
   // to return a default value, which may not anywhere in particular.
   OC_INLINE Val get (const Val& key, const Val& def=None) const;
 
+  // Look up a string key given as a (pointer, length) without
+  // building a temporary Val for it.  If the hash is already known,
+  // pass it in (it must be what HashFunction gives for the string).
+  // lookup returns a pointer to the value, or 0 if it isn't there.
+  // (Any other probe, like a StrView, can use the base templates.)
+  using OTabImpl_::lookup;
+  using OTabImpl_::contains;
+  using OTabImpl_::find;
+  Val* lookup (const char* key, size_t len) const
+  { StrView s(key, len); return OTabImpl_::lookup(s, s.hash()); }
+  Val* lookup (const char* key, size_t len, int_u4 hashkey) const
+  { return OTabImpl_::lookup(StrView(key, len), hashkey); }
+  bool contains (const char* key, size_t len) const
+  { return lookup(key, len)!=0; }
+  bool contains (const char* key, size_t len, int_u4 hashkey) const
+  { return lookup(key, len, hashkey)!=0; }
+  bool find (const char* key, size_t len, Val& return_key) const
+  { StrView s(key, len); return OTabImpl_::find(s, s.hash(), return_key); }
+  bool find (const char* key, size_t len, int_u4 hashkey, 
+	     Val& return_key) const
+  { return OTabImpl_::find(StrView(key, len), hashkey, return_key); }
+
  protected:
  OC_INLINE void appendHelper_ (const Val& key, const Val& value); 
 }; // OTab
@@ -677,15 +1039,15 @@ inline void PlaceCopyCons_<OTab> (void* location,const OTab& copy,Allocator* a)
 
 // Iterators specfically for OTab: This will iterate in
 // insertion order
-struct OTabIt : public OrdAVLHashTIterator<Val, Val, 8> {
-    OTabIt (const OTab& t) : OrdAVLHashTIterator<Val, Val, 8>(t) { }
-    OTabIt () : OrdAVLHashTIterator<Val,Val,8>() { }
+struct OTabIt : public OTabItImpl_ {
+    OTabIt (const OTab& t) : OTabItImpl_(t) { }
+    OTabIt () : OTabItImpl_() { }
 }; // OTabIt
 
 // Sorted iterator WILL give you the keys in sorted order
-struct OTabSit : public OrdAVLHashTSortedIterator<Val, Val, 8> {
-    OTabSit (const OTab& t) : OrdAVLHashTSortedIterator<Val, Val, 8>(t) { }
-    OTabSit () : OrdAVLHashTSortedIterator<Val, Val, 8>() { }
+struct OTabSit : public OTabSitImpl_ {
+    OTabSit (const OTab& t) : OTabSitImpl_(t) { }
+    OTabSit () : OTabSitImpl_() { }
 }; // OTabSit
 
 
@@ -749,6 +1111,9 @@ struct OTabSit : public OrdAVLHashTSortedIterator<Val, Val, 8> {
 //   Val v = p;
 //     or
 //   Val vv = new Tup(3,4,5);  // easier syntax
+//
+// A Tup& from a Val never detaches a copy-on-write body: change a
+// shared Tup through the Val (v[0]=..., v.append(...)) or its Proxy.
 // 
 // If you absoultely have to get the underlying array out:
 //   Tup t;
@@ -832,6 +1197,15 @@ class Tup {
   // Have to allow nesting here
   OC_INLINE Tup& operator= (const Tup& rhs);
 
+#if defined(OC_MOVE_SEMANTICS)
+  // Move: steals the tuple (t is left empty).  With a move declared,
+  // the copy constructor has to be asked for explicitly.  (No move
+  // assignment: with Tup (const Val&) around, tup = val would become
+  // ambiguous.  Use swap.)
+  Tup (const Tup& t) : a_(t.a_) { }
+  Tup (Tup&& t) : a_(std::move(t.a_)) { }
+#endif
+
   // Allow access to array
   const Array<Val>& impl () const { return a_; }
         Array<Val>& impl () { return a_; }
@@ -881,6 +1255,27 @@ class Arr : public Array<Val> {
   // Have to allow nesting here:  Hide the one from Array
   OC_INLINE Arr& operator= (const Arr& rhs);
 
+#if defined(OC_MOVE_SEMANTICS)
+  // Move: steals the array (a is left empty).  With a move declared,
+  // the copy constructor has to be asked for explicitly.
+  Arr (const Arr& a) : Array<Val>(a) { }
+  Arr (Arr&& a) : Array<Val>(std::move(a)) { }
+  Arr (Array<Val>&& a) : Array<Val>(std::move(a)) { }
+  Arr& operator= (Arr&& rhs) 
+  { Array<Val>* me=this; *me = std::move(rhs); return *this; }
+
+  // Construct a new Val at the end of the Arr (from any arguments a
+  // Val can be constructed from) without copying it.  Returns a
+  // reference to the new element.
+  //   a.emplaceAppend(Tab());   // No copy of the Tab
+  template <class... ARGS>
+  Val& emplaceAppend (ARGS&&... args)
+  {
+    append(Val(std::forward<ARGS>(args)...));
+    return data_[length_-1];
+  }
+#endif
+
   // Print a more nested structure
   OC_INLINE void prettyPrint (ostream& os, int starting_indent = 0,
 			      int additive_indent=4) const;
@@ -1015,6 +1410,24 @@ class ArrSit {
 //    cerr << key << " " << value << endl;
 // }
 
+// The Tup in a Val (or a Proxy in the Val).  Tup only has the const
+// outcast, which never detaches: a second, non-const outcast would
+// win over Tup's constructor from a Val, and Tup t = v would stop
+// making a 1-tuple.  So code that changes the Tup gets it from a
+// non-const Val with this, which detaches a shared copy-on-write
+// body first (like the non-const outcasts of Tab, OTab and Arr).
+inline Tup& TupOf_ (Val& v)
+{
+  if (v.isproxy && v.tag=='u') {
+    Proxy& p = v;
+    Tup& t = p;
+    return t;
+  }
+  Tup& t = v;
+  return t;
+}
+inline Tup& TupOf_ (const Val& v) { Tup& t = v; return t; }
+
 // RANT: What C++ needs is a way to "infer" the type given.
 // Generic iterator for Tabs and Arrs and OTabs
 template <class AIT, class TIT, class OIT>
@@ -1028,10 +1441,11 @@ class GenericIT {
   // to iterate through anything other than a Tab or Arr.
   GenericIT (const Tab& t)  :tit_(t),isTab_(OC_TAB)  { }
   GenericIT (const Arr& a)  :ait_(a),isTab_(OC_ARR) { }
-  GenericIT (const Proxy& p) { Val v=p;cons_(v); }
+  GenericIT (const Proxy& p) { const Val v=p;cons_(v); }
   GenericIT (const OTab& ot):oit_(ot), isTab_(OC_OTAB) { }
   GenericIT (const Tup& ot) :ait_((Arr&)ot.impl()), isTab_(OC_ARR) { }
-  GenericIT (const Val& v)   { cons_(v); }
+  GenericIT (const Val& v)   { cons_(v); } // never detaches, see Val
+  GenericIT (Val& v)         { cons_(v); }
   
   // Advance the iterator one position.  Returns true if the new
   // position is valid, false otherwise.
@@ -1085,8 +1499,9 @@ class GenericIT {
   void reset (const Tab& c)  { tit_ = TIT(c); isTab_ = OC_TAB; }
   void reset (const Arr& c)  { ait_ = AIT(c); isTab_ = OC_ARR; }
   void reset (const OTab& c) { oit_ = TIT(c); isTab_ = OC_OTAB; }
-  void reset (const Proxy& c) { cons_(c); } 
+  void reset (const Proxy& c) { const Val v=c; cons_(v); } 
   void reset (const Val& c)   { cons_(c); }
+  void reset (Val& c)         { cons_(c); }
 
   // Are we iterating through a Tab or Arr?
   Tab_e isTab () const { return isTab_; }
@@ -1097,8 +1512,9 @@ class GenericIT {
   OIT oit_;    // Default constructor does little
   Tab_e isTab_;
 
-  // Centralized construction
-  void cons_ (const Val& c) 
+  // Centralized construction: V is Val or const Val, so the outcasts
+  // detach a copy-on-write body only for a non-const Val
+  template <class V> void cons_ (V& c) 
   {
     if (c.tag=='n' && c.subtype=='Z') {
       Arr& a = c;
@@ -1113,7 +1529,7 @@ class GenericIT {
       oit_ = OIT(t);
       isTab_ = OC_OTAB;
     } else if (c.tag=='u') {
-      Tup& t = c;
+      Tup& t = TupOf_(c);
       Array<Val>& a = t.impl();
       Arr& ar = (Arr&)a;
       ait_ = AIT(ar);
@@ -0,0 +1,105 @@
+#ifndef OC_VALARENA_H_
+
+// A ValArena holds a whole Val tree in one arena (a StreamingPool
+// created with CreateArena: see ocstreamingpool.h), so the tree can
+// be thrown away all at once: no destructors run, no nodes are freed
+// one by one, the arena just forgets everything.  This is for the
+// big messages that come in, get looked at, and go away: freeing a
+// 50000 node tree normally takes as long as building it.
+//
+//   ValArena arena;
+//   LoadValFromArray(buffer, arena.root(), SERIALIZE_OC);
+//   ... look at arena.root() ...
+//   arena.clear();  // O(1): ready for the next message
+//
+// The root is a Val that lives IN the arena, and anything assigned
+// into it (or into anything inside of it) is copied into the arena,
+// because a Val remembers its allocator.  The O(1) clear only works
+// because of that: so don't swap things in and out of the root (a
+// swap takes the allocator with it), and remember that proxies are
+// shared (not copied) when assigned, so a proxy from outside the
+// arena that ends up in the tree is never let go of.  The OC
+// Deserialize (and LoadValFromArray into the root) builds
+// everything, proxies too, inside the arena, and so does any code
+// run under an AllocatorScope(arena.allocator()) (see
+// ocstreamingpool.h).  All Vals that refer to the tree are invalid
+// after a clear (or when the arena goes away).
+
+// ///////////////////////////////////////////// Include Files
+
+#include "ocval.h"
+
+OC_BEGIN_NAMESPACE
+
+// ///////////////////////////////////////////// The ValArena Class
+
+class ValArena {
+
+ public:
+
+  // Create an arena with the given number of bytes to start with: if
+  // a tree needs more, the arena gets more from the heap (in chunks
+  // of overflow_bytes, doubling as it goes).
+  ValArena (int bytes=64*1024, int overflow_bytes=64*1024) :
+    memory_(new char[bytes]),
+    pool_(0),
+    root_(0)
+  {
+    try {
+      pool_ = StreamingPool::CreateArena(memory_, bytes, overflow_bytes);
+    } catch (...) {
+      delete [] memory_;
+      throw;
+    }
+    newRoot_();
+  }
+
+  // Everything in the arena goes away, no destructors are run
+  ~ValArena ()
+  {
+    StreamingPool::Clean(pool_);
+    delete [] memory_;
+  }
+
+  // The root of the tree: everything put in here is put in the arena
+  Val& root () { return *root_; }
+  const Val& root () const { return *root_; }
+
+  // The allocator for anything else you want in the arena
+  Allocator* allocator () const { return pool_; }
+
+  // Forget the tree, in O(1): the root becomes an empty Val again
+  void clear ()
+  {
+    pool_->resetArena();
+    newRoot_();
+  }
+
+  // How many bytes the tree is using
+  int_8 bytesAllocated () const { return pool_->arenaBytesAllocated(); }
+
+ protected:
+
+  // The memory the arena starts with, the arena, and the root
+  char* memory_;
+  StreamingPool* pool_;
+  Val* root_;
+
+  // The root is an empty Val (in the arena) that uses the arena
+  void newRoot_ ()
+  {
+    char* mem = pool_->allocate(sizeof(Val));
+    root_ = new (mem) Val(None, pool_);
+  }
+
+  // Don't allow copies
+  ValArena (const ValArena&); // NO IMPL
+  ValArena& operator= (const ValArena&); // NO IMPL
+
+}; // ValArena
+
+
+OC_END_NAMESPACE
+
+#define OC_VALARENA_H_
+#endif // OC_VALARENA_H_
@@ -26,6 +26,7 @@
 #include "ocreader.h"
 #include "ocnumerictools.h"
 #include "ocnumpytools.h"
+#include "ocparsenumber.h"
 #include <limits> // for Nan and Inf and -inf
 
 OC_BEGIN_NAMESPACE
@@ -73,6 +74,18 @@ class ValReaderA {
   bool expectSimpleNumber (Val& n)
   {
     consumeWS_();
+
+    // Most numbers can be converted right out of the input buffer (if
+    // there is one): only the unusual ones go the long way below
+    int avail;
+    const char* start = reader_->unread_(avail);
+    if (start) {
+      const char* end = ParseNumber(start, start+avail, n);
+      if (end) {
+	reader_->skip_(int(end-start));
+	return true;
+      }
+    }
     
     // Get the integer part, if any, of the number
     ValReaderEnum_e special = VR_NOT_SPECIAL;
@@ -133,6 +146,9 @@ class ValReaderA {
       // If we have either a fractional part or an exponential part,
       // then we have a floating point number
       Str stringized_number = integer_part+fractional_part+exponent_part;
+      const char* s = stringized_number.data();
+      const int len = stringized_number.length();
+      if (ParseNumber(s, s+len, n)==s+len) return true;
       Val inside = stringized_number; 
       real_8 num = inside; // Convert out of Val to change from string 
       n = num;
@@ -160,6 +176,9 @@ class ValReaderA {
 	return true;
       } 
     } else { // plain integer
+      const char* s = integer_part.data();
+      const int len = integer_part.length();
+      if (ParseNumber(s, s+len, n)==s+len) return true;
       convertInt_(v); // assumes some int, with tstring inside v
       n = v;
       return true;
@@ -713,6 +713,47 @@ void valTest ()
   }
 }
 
+void smallArrayTest ()
+{
+  cout << "SmallArray Tests:" << endl;
+  SmallArray<string, 3> s;
+  cout << s << " capacity:" << s.capacity() << " inline:" << s.isInline() << endl;
+  for (int ii=0; ii<3; ii++) {
+    s.append("short"+Stringize(ii));
+  }
+  cout << s << " capacity:" << s.capacity() << " inline:" << s.isInline() << endl;
+  s.append("past the inline buffer");
+  cout << s << " capacity:" << s.capacity() << " inline:" << s.isInline() << endl;
+
+  // Copies get their own inline buffer
+  SmallArray<string, 8> copy(s);
+  cout << copy << " capacity:" << copy.capacity() << " inline:" << copy.isInline() << endl;
+  SmallArray<string, 8> assigned;
+  assigned.append("gone");
+  assigned = copy;
+  assigned.append("more");
+  cout << assigned << " " << copy << " inline:" << assigned.isInline() << endl;
+
+  // Swapping with a normal Array moves the elements out of the
+  // inline buffer first
+  Array<string> normal(2);
+  normal.append("normal");
+  swap(copy, normal);
+  cout << copy << " " << normal << " inline:" << copy.isInline() << endl;
+  normal.append("still good");
+  cout << normal << endl;
+
+  // POD too
+  SmallArray<real_8, 4> point;
+  point.append(1.5); point.append(2.5);
+  Array<real_8>& a = point;  // IS an Array
+  a.append(3.5);
+  cout << point << " inline:" << point.isInline() << endl;
+  SmallArray<Val, 2> vals;
+  vals.append(Tab("{'a':1}")); vals.append("two"); vals.append(3);
+  cout << vals << " inline:" << vals.isInline() << endl;
+}
+
 // ///////////////////////////////////////////// ArrayTest Methods
 
 int ArrayTest::tests()
@@ -723,6 +764,7 @@ int ArrayTest::tests()
   swapTest();
   fillTest();
   valTest();
+  smallArrayTest();
 
   return 0;
 }
@@ -0,0 +1,176 @@
+
+// Test the elementwise math in ocarraymath.h: the vectorized kernels
+// have to give the same answers as the plain loop, for every length
+// (so all the leftover elements are handled) and every element type.
+
+#include "ocval.h"
+#include "ocarraymath.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// Small values: real_4 and real_8 sums and dots are then exact, so
+// the order they are added in doesn't matter
+template <class T>
+void Fill (Array<T>& a, int len, int seed)
+{
+  a.clear();
+  int_u4 r = seed*2654435761u + 1;
+  for (int ii=0; ii<len; ii++) {
+    r = r*1664525u + 1013904223u;
+    a.append(T(int_4(r>>24) - 100));
+  }
+}
+
+template <class T>
+bool Same (const Array<T>& a, const Array<T>& b)
+{
+  if (a.length()!=b.length()) return false;
+  for (size_t ii=0; ii<a.length(); ii++) {
+    if (!(a[ii]==b[ii])) return false;
+  }
+  return true;
+}
+
+// Compare all the Array<T> ops with plain loops for lengths 0..70,
+// plus some bigger ones
+template <class T>
+void Check (const char* name)
+{
+  int bad = 0;
+  int lengths[] = { 1000, 4099 };
+  for (int ll=0; ll<71+2; ll++) {
+    int len = ll<71 ? ll : lengths[ll-71];
+    Array<T> a, b, result, expected;
+    Fill(a, len, len);
+    Fill(b, len, len+1000);
+    T s = T(3);
+
+    ArrayAdd(a, b, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]+b[ii]));
+    if (!Same(result, expected)) bad++;
+
+    ArraySub(a, b, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]-b[ii]));
+    if (!Same(result, expected)) bad++;
+
+    ArrayMul(a, b, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]*b[ii]));
+    if (!Same(result, expected)) bad++;
+
+    ArrayScale(a, s, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]*s));
+    if (!Same(result, expected)) bad++;
+
+    ArrayOffset(a, s, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]+s));
+    if (!Same(result, expected)) bad++;
+
+    ArrayAbs(a, result);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(a[ii]<0 ? -a[ii] : a[ii]));
+    if (!Same(result, expected)) bad++;
+
+    // In-place
+    result = a;
+    ArrayAdd(result, b);
+    ArrayScale(result, s);
+    expected.clear(); for (int ii=0; ii<len; ii++) expected.append(T(T(a[ii]+b[ii])*s));
+    if (!Same(result, expected)) bad++;
+
+    T sum = T(0), dot = T(0);
+    for (int ii=0; ii<len; ii++) { sum = T(sum+a[ii]); dot = T(dot+T(a[ii]*b[ii])); }
+    if (!(ArraySum(a)==sum)) bad++;
+    if (!(ArrayDot(a, b)==dot)) bad++;
+    if (len) {
+      T mn = a[0], mx = a[0];
+      for (int ii=1; ii<len; ii++) {
+	if (a[ii]<mn) mn = a[ii];
+	if (mx<a[ii]) mx = a[ii];
+      }
+      if (!(ArrayMin(a)==mn)) bad++;
+      if (!(ArrayMax(a)==mx)) bad++;
+    }
+  }
+  cout << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
+int main ()
+{
+  Check<int_1>("int_1");
+  Check<int_u1>("int_u1");
+  Check<int_2>("int_2");
+  Check<int_u2>("int_u2");
+  Check<int_4>("int_4");
+  Check<int_u4>("int_u4");
+  Check<int_8>("int_8");
+  Check<int_u8>("int_u8");
+  Check<real_4>("real_4");
+  Check<real_8>("real_8");
+
+  // Vals holding arrays
+  {
+    Array<int_2> samples;
+    for (int ii=0; ii<20; ii++) samples.append(int_2(ii-10));
+    Val v = samples;
+    ArrayScale(v, 2);
+    cout << v << endl;
+    ArrayOffset(v, Val(-5));
+    cout << ArraySum(v) << " " << ArrayMin(v) << " " << ArrayMax(v) << endl;
+    Val w;
+    ArrayAbs(v, w);
+    cout << w << endl;
+    cout << ArrayDot(v, w) << endl;
+    ArraySub(v, w, w);
+    cout << w << endl;
+  }
+  {
+    Array<real_4> a, b;
+    for (int ii=0; ii<20; ii++) { a.append(ii*0.5f); b.append(20-ii); }
+    Val va = a, vb = b, r;
+    ArrayMul(va, vb, r);
+    cout << r << endl;
+    ArrayAdd(r, va);
+    cout << r << endl;
+    ArrayMag2(vb);
+    cout << vb << endl;
+    cout << ArrayDot(va, va) << endl;
+  }
+
+  // Complex: Mag and Mag2 give real arrays
+  {
+    Array<complex_8> a;
+    for (int ii=0; ii<20; ii++) a.append(complex_8(3*ii, -4*ii));
+    Val v = a, r;
+    ArrayMag(v, r);
+    cout << r << endl;
+    ArrayMag2(v, r);
+    cout << r.subtype << " " << ArraySum(r) << endl;
+    ArrayScale(v, Val(0.5));
+    ArrayAdd(v, v);
+    cout << ArraySum(v) << endl;
+    ArrayScale(v, Val(complex_8(0,1)));
+    ArrayOffset(v, Val(1.0));
+    Array<complex_8>& c = v;
+    cout << c[2] << " " << c[19] << endl;
+    cout << ArrayDot(v, Val(a)) << endl;
+    ArrayAbs(v);
+    cout << v.subtype << " " << ArrayMax(v) << endl;
+  }
+
+  // Errors
+  {
+    Array<int_4> i4;  i4.append(1); i4.append(2); i4.append(3);
+    Array<real_8> r8; r8.append(1); r8.append(2);
+    Array<bool> bb;   bb.append(true);
+    Array<complex_16> cx; cx.append(complex_16(1,1));
+    Val vi4 = i4, vr8 = r8, vbb = bb, vcx = cx, empty = Array<real_8>();
+    Val r;
+    try { ArrayAdd(vi4, vr8, r); } catch (const runtime_error& e) { cout << e.what() << endl; }
+    try { ArrayAdd(vr8, Val(Array<real_8>(1))); } catch (const runtime_error& e) { cout << e.what() << endl; }
+    try { ArraySum(vbb); } catch (const runtime_error& e) { cout << e.what() << endl; }
+    try { ArrayMin(vcx); } catch (const runtime_error& e) { cout << e.what() << endl; }
+    try { ArrayMax(empty); } catch (const runtime_error& e) { cout << e.what() << endl; }
+    try { ArrayScale(r, 1); } catch (const runtime_error& e) { cout << e.what() << endl; }
+  }
+}
@@ -53,6 +53,26 @@ void testBin (BigInt<I,BI> ii, const char* data=0, int len=0)
 }
 
 
+// Big signed multiplies: the sign is handled by BigInt, the
+// magnitude by the Karatsuba/Toom-3 code in BigUInt
+template <class I, class BI>
+void testBigMultiply (const char* name)
+{
+  typedef BigInt<I,BI> B;
+  int bad = 0;
+  for (int digits=10; digits<4000; digits*=3) {
+    string s;
+    for (int ii=0; ii<digits; ii++) s += char('1' + (ii*7)%9);
+    B a = B(s), b = B(s.substr(0, digits/2+1));
+    B ab = a*b;
+    if ((-a)*b!=-ab || a*(-b)!=-ab || (-a)*(-b)!=ab) bad++;
+    if (ab/b!=a || ab%b!=0 || (-ab)/a!=-b) bad++;
+    B sq = -a;  sq *= sq;                  // square of a negative
+    if (sq<0 || sq!=a*B(a) || sq/a!=a) bad++;
+  }
+  cout << "Big multiply " << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
 void testingall (int low, int high, int inc)
 {
   typedef BigInt<int_u1, int_u2> BI;
@@ -940,6 +960,17 @@ int main (int argc, char** argv)
     testBin(BigInt<int_u2, int_u4>(-65536), "\x00\x00\xff", 3);
     testBin(BigInt<int_u2, int_u4>(-65537), "\xff\xff\xfe", 3);
     testBin(BigInt<int_u2, int_u4>(-1000000000), "\0006e\xc4", 4);
+
+#if defined(OC_INT128)
+    // 64-bit digits write the same bytes as 32-bit digits did
+    testBin(BigInt<int_u8, int_u16>(-1), "\xff\xff\xff\xff", 4);
+    testBin(BigInt<int_u8, int_u16>(-128), "\x80\xff\xff\xff", 4);
+    testBin(BigInt<int_u8, int_u16>(-2147483648LL), "\x00\x00\x00\x80", 4);
+    testBin(BigInt<int_u8, int_u16>(-2147483649LL), "\xff\xff\xff\x7f\xff", 5);
+    testBin(BigInt<int_u8, int_u16>(-4294967296LL), "\x00\x00\x00\x00\xff\xff\xff\xff", 8);
+    testBin(BigInt<int_u8, int_u16>(-1000000000000000000LL), "\x00\x00\x9cXLI\x1f\xf2", 8);
+    testBin(BigInt<int_u8, int_u16>(4294967296LL), "\x00\x00\x00\x00\x01", 5);
+#endif
   }
 
   cout << "Convert from BigUInt to BigInt" << endl;
@@ -1111,5 +1142,12 @@ int main (int argc, char** argv)
     }
   }
 
+  testBigMultiply<int_u1, int_u2>("int_u1");
+  testBigMultiply<int_u2, int_u4>("int_u2");
+  testBigMultiply<int_u4, int_u8>("int_u4");
+#if defined(OC_INT128)
+  testBigMultiply<int_u8, int_u16>("int_u8");
+#endif
+
   cout << "Okay!" << endl;
 }
@@ -83,6 +83,114 @@ void testBin (BigUInt<I,BI> ii)
 }
 
 
+// A "random" number of the given number of decimal digits
+template <class I, class BI>
+BigUInt<I,BI> bigRandom (int digits, int_u4& seed)
+{
+  string s;
+  for (int ii=0; ii<digits; ii++) {
+    seed = seed*1664525u + 1013904223u;
+    s += char('0' + (seed>>24)%10);
+  }
+  s[0] = '1' + s[0]%9;
+  return BigUInt<I,BI>(s);
+}
+
+// Big multiplies use Karatsuba and Toom-3 (and squares have their
+// own versions of those): check them against identities that only
+// need the simpler ops
+template <class I, class BI>
+void testBigMultiply (const char* name)
+{
+  typedef BigUInt<I,BI> U;
+  int_u4 seed = 17;
+  int bad = 0;
+  int sizes[] = { 1, 20, 150, 400, 1200, 4000 };
+  const int n = sizeof(sizes)/sizeof(sizes[0]);
+  for (int ii=0; ii<n; ii++) {
+    for (int jj=0; jj<n; jj++) {
+      U a = bigRandom<I,BI>(sizes[ii], seed);
+      U b = bigRandom<I,BI>(sizes[jj], seed);
+      U ab = a*b;
+      U q, r;
+      U::DivMod(ab, b, q, r);               // (a*b)/b == a
+      if (q!=a || r!=0) bad++;
+      U a1b = a+U(1);  a1b *= b;            // (a+1)*b == a*b + b
+      if (a1b!=ab+b) bad++;
+      if (b*a!=ab) bad++;
+      U sq = a;  sq *= sq;                  // a*a, a square
+      U sq2 = a*U(a);
+      U::DivMod(sq, a, q, r);
+      if (sq!=sq2 || q!=a || r!=0) bad++;
+    }
+  }
+
+  // (10**k-1)**2 == 99..9800..01
+  for (int kk=1; kk<3000; kk=kk*3+1) {
+    U nines = U(string(kk, '9'));
+    U sq = nines;  sq *= sq;
+    string expected = string(kk-1, '9') + "8" + string(kk-1, '0') + "1";
+    if (sq.stringize()!=expected) bad++;
+  }
+
+  // Multiplying by 0 is 0
+  U zero = bigRandom<I,BI>(1000, seed)*U(0);
+  if (zero!=0 || zero.stringize()!="0") bad++;
+  cout << "Big multiply " << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
+// Big numbers are converted to and from strings by splitting them in
+// half: check them against the plain digit at a time conversions
+template <class I, class BI>
+void testBigConvert (const char* name)
+{
+  typedef BigUInt<I,BI> U;
+  static const char digit_chars[] = "0123456789ABCDEF";
+  int_u4 seed = 31;
+  int bad = 0;
+  int sizes[] = { 1, 9, 10, 19, 20, 100, 700, 3000, 12000 };
+  int bases[] = { 10, 16, 2, 7 };
+  for (size_t bb=0; bb<sizeof(bases)/sizeof(bases[0]); bb++) {
+    const int base = bases[bb];
+    for (size_t ss=0; ss<sizeof(sizes)/sizeof(sizes[0]); ss++) {
+      for (int kind=0; kind<3; kind++) {   // random, 10..0, all max digit
+	string s;
+	for (int ii=0; ii<sizes[ss]; ii++) {
+	  seed = seed*1664525u + 1013904223u;
+	  int d = kind==0 ? (seed>>24)%base : kind==1 ? 0 : base-1;
+	  s += digit_chars[d];
+	}
+	s[0] = digit_chars[kind==2 ? base-1 : 1];
+	U x;
+	x.assignDigits(s.data(), s.length(), base);
+	if (x.stringize(base)!=s) bad++;
+	if (sizes[ss]>3000) continue;
+
+	U y = 0;                           // digit at a time
+	for (size_t ii=0; ii<s.length(); ii++) {
+	  y.singleDigitMultiply(base);
+	  y.singleDigitAdd(s[ii]<='9' ? s[ii]-'0' : s[ii]-'A'+10);
+	}
+	string t;
+	for (U r=y, q; !r.zero(); r.swap(q)) {
+	  I rem;
+	  U::singleDigitDivide(r, base, q, rem);
+	  t = digit_chars[rem] + t;
+	}
+	if (x!=y || t!=s) bad++;
+      }
+    }
+  }
+  // DivMod by a divisor with its top bit set
+  const U digit = U(I(~I(0))), radix = digit + U(1);
+  U top = digit;
+  for (int ii=1; ii<3; ii++) top = top*radix + digit;
+  U num = top*top + top - U(1), q, r;
+  U::DivMod(num, top, q, r);
+  if (q!=top || r!=top-U(1)) bad++;
+  cout << "Big convert " << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
 /*
 template <class I, class BI>
 void normalize_test (I seed, int s)
@@ -1102,5 +1210,18 @@ int main (int argc, char** argv)
   int_8 n = AS(ii);
   cout << n << endl;
 
+  testBigMultiply<int_u1, int_u2>("int_u1");
+  testBigMultiply<int_u2, int_u4>("int_u2");
+  testBigMultiply<int_u4, int_u8>("int_u4");
+#if defined(OC_INT128)
+  testBigMultiply<int_u8, int_u16>("int_u8");
+#endif
+  testBigConvert<int_u1, int_u2>("int_u1");
+  testBigConvert<int_u2, int_u4>("int_u2");
+  testBigConvert<int_u4, int_u8>("int_u4");
+#if defined(OC_INT128)
+  testBigConvert<int_u8, int_u16>("int_u8");
+#endif
+
   cout << "Okay!" << endl;
 }
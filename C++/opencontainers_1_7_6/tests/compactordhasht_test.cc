@@ -0,0 +1,194 @@
+// ///////////////////////////////////////////// HashFunction
+#include "ocport.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// For Koenig lookup to find these HashFunctions, they have to be
+// thrown into the namespace
+OC_BEGIN_NAMESPACE
+
+inline int_u4 HashFunction (const int_4& d)
+{
+  return (int_u4) d;
+}
+
+OC_END_NAMESPACE
+
+// ///////////////////////////////////////////// Include Files
+
+#include "occontainer_test.h"
+#include "occompactordhasht.h"
+#include "ocordavlhasht.h"
+#include "ocstring.h"
+
+// Print the table in insertion order
+template <class K, class V>
+void orderPrint (const CompactOrdHashT<K,V,8>& a)
+{
+  cout << "{";
+  for (CompactOrdHashTIterator<K,V,8> it(a); it(); ) {
+    cout << " " << it.key() << ":" << it.value();
+  }
+  cout << " } entries=" << a.entries() << endl;
+}
+
+// The same keys and values in the same order?
+template <class K, class V>
+bool sameOrder (const CompactOrdHashT<K,V,8>& a, const OrdAVLHashT<K,V,8>& ref)
+{
+  CompactOrdHashTIterator<K,V,8> it(a);
+  OrdAVLHashTIterator<K,V,8> rit(ref);
+  while (true) {
+    bool more = it(), rmore = rit();
+    if (more!=rmore) return false;
+    if (!more) return true;
+    if (it.key()!=rit.key() || it.value()!=rit.value()) return false;
+  }
+}
+
+// ///////////////////////////////////////////// Main Program
+
+int main ()
+{
+  {
+    cout << "Empty table" << endl;
+    CompactOrdHashT<int_4, int_4, 8> a;
+    if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    cout << a.contains(1) << " " << a.remove(1) << " " << a.isEmpty() << endl;
+    orderPrint(a);
+  }
+
+  {
+    cout << "Inserts, enough to grow a few times: order is kept" << endl;
+    CompactOrdHashT<int_4, int_4, 8> a;
+    for (int ii=0; ii<100; ii++) {
+      a.insertKeyAndValue((ii*37)%100, ii);
+      if (!a.consistent()) cout << "UH-oh!" << ii << endl;
+    }
+    for (int ii=0; ii<100; ii++) {
+      int_4 v = -1;
+      if (!a.findValue((ii*37)%100, v) || v!=ii) cout << "UH-oh!" << ii << endl;
+    }
+    cout << a.contains(100) << " " << a.contains(-1) << " " << a.contains(50)
+	 << endl;
+    cout << a(74) << " " << a[11] << endl;
+    a[37] = 1000;  // overwriting doesn't change the order
+    orderPrint(a);
+  }
+
+  {
+    cout << "Deletions" << endl;
+    for (int ii=0; ii<10; ii++) {
+      CompactOrdHashT<int_4, int_4, 8> a;
+      for (int jj=0; jj<ii; jj++) {
+	a.insertKeyAndValue(jj, jj);
+      }
+      cout << "Here we go:"; orderPrint(a);
+      for (int kk=0; kk<ii; kk+=2) {
+	cout << "trying to delete: " << kk << " " << a.remove(kk) << endl;
+	if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+      }
+      a[0] = 100;  // back in, but at the end
+      cout << " ... result of delete: "; orderPrint(a);
+    }
+  }
+
+  {
+    cout << "References stay valid across growth" << endl;
+    CompactOrdHashT<string, string, 8> a;
+    string& first = a["first"];
+    first = "still here";
+    for (int ii=0; ii<1000; ii++) {
+      a[Stringize(ii)] = Stringize(ii);
+    }
+    cout << first << " " << a("first") << endl;
+  }
+
+  {
+    cout << "Random inserts and removes against OrdAVLHashT" << endl;
+    CompactOrdHashT<int_4, int_4, 8> a;
+    OrdAVLHashT<int_4, int_4, 8> ref;
+    srand(17);
+    bool okay = true;
+    for (int ii=0; ii<20000; ii++) {
+      int_4 key = rand() % 500;
+      if (rand() % 3) {
+	a.insertKeyAndValue(key, ii);
+	ref.insertKeyAndValue(key, ii);
+      } else {
+	if (a.remove(key) != ref.remove(key)) okay = false;
+      }
+      if (a.entries() != ref.entries()) okay = false;
+      if (ii % 1000 == 0 && !(a.consistent() && sameOrder(a, ref))) okay = false;
+    }
+    if (!sameOrder(a, ref)) okay = false;
+    cout << (okay ? "OKAY" : "UH-oh!") << endl;
+  }
+
+  {
+    cout << "Remove everything, then reuse" << endl;
+    CompactOrdHashT<int_4, int_4, 8> a;
+    for (int kk=0; kk<4; kk++) {
+      for (int ii=0; ii<1000; ii++) a.insertKeyAndValue(ii+kk*1000, ii);
+      for (int ii=0; ii<1000; ii++) a.remove(ii+kk*1000);
+      if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    }
+    cout << a.entries() << endl;
+    a.clear();
+    if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+  }
+
+  {
+    cout << "Big tables (4 byte index)" << endl;
+    CompactOrdHashT<int_4, int_4, 8> a;
+    OrdAVLHashT<int_4, int_4, 8> ref;
+    for (int ii=0; ii<100000; ii++) {
+      a[ii*7] = ii; ref[ii*7] = ii;
+    }
+    for (int ii=0; ii<100000; ii+=3) {
+      a.remove(ii*7); ref.remove(ii*7);
+    }
+    cout << a.entries() << " " << a.consistent() << " " << sameOrder(a, ref)
+	 << endl;
+  }
+
+  {
+    cout << "swap, swapInto, reserve, copy, compare" << endl;
+    CompactOrdHashT<string, string, 8> a, b;
+    a["one"] = "1";
+    b["two"] = "2"; b["three"] = "3";
+    a.swap(b);
+    orderPrint(a); orderPrint(b);
+
+    string k = "four", v = "4";
+    cout << a.swapInto(k, v) << " [" << k << "] [" << v << "]" << endl;
+    k = "four"; v = "FOUR";
+    cout << a.swapInto(k, v) << " [" << k << "] [" << v << "]" << endl;
+
+    CompactOrdHashT<string, string, 8> c(a);
+    c.reserve(1000);
+    if (c.consistent() && c==a) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    c["five"] = "5";
+    cout << (c!=a) << " " << (a<c) << " " << (c>a) << endl;
+
+    // Same keys, different order: not equal
+    CompactOrdHashT<string, string, 8> d;
+    d["three"] = "3"; d["two"] = "2";
+    cout << (d==b) << " " << (d!=b) << endl;
+    c = b;
+    orderPrint(c);
+
+    for (CompactOrdHashTSortedIterator<string,string,8> it(a); it(); ) {
+      cout << it.key() << " ";
+    }
+    cout << endl;
+  }
+
+  ContainerTest<CompactOrdHashT<string, int_u4, 8>,
+    CompactOrdHashTIterator<string, int_u4, 8>,
+    CompactOrdHashT<string, string, 8>,
+    CompactOrdHashTIterator<string, string, 8> > t;
+  return t.tests();
+}
@@ -0,0 +1,210 @@
+
+// Test the copy-on-write proxies: copies share the body until
+// someone asks for a reference they could change.
+
+#include "ocval.h"
+#include "ocserialize.h"
+#include "ocser.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+int main ()
+{
+  {
+    cout << "Tab" << endl;
+    Val config = CopyOnWrite(new Tab("{'a':1, 'b':[1,2,3]}"));
+    Proxy& p = config;
+    cout << config << " " << config.isproxy << " " << p.copyOnWrite() << endl;
+
+    // Copies are O(1): they all share the same body
+    Val c1 = config;
+    Val c2 = c1;
+    cout << is(config, c1) << is(c1, c2) << endl;
+
+    // Reading doesn't detach
+    cout << c1 << " " << (c1==config) << " " << (c1<config) << " "
+	 << c1.entries() << " " << c1.contains("a") << endl;
+    cout << is(config, c1) << is(c1, c2) << endl;
+
+    // Writing does: only the writer gets a new body
+    c1["c"] = "three";
+    cout << config << " " << c1 << " " << c2 << endl;
+    cout << is(config, c1) << is(config, c2) << endl;
+    Proxy& p1 = c1;
+    cout << p1.copyOnWrite() << endl;
+
+    // Nobody else shares c1 now, so no more copies
+    Tab& t1 = c1;
+    Tab& t1again = c1;
+    cout << (&t1==&t1again) << endl;
+
+    // Last one holding the body just changes it
+    c2 = None;
+    Tab& t = config;
+    t["d"] = 4;
+    cout << config << endl;
+  }
+
+  {
+    cout << "Nested" << endl;
+    Val config = CopyOnWrite(new Tab("{'timeout':10}"));
+    Arr messages;
+    for (int ii=0; ii<3; ii++) {
+      Val msg = Tab();
+      msg["id"] = ii;
+      msg["config"] = config;  // O(1)
+      messages.append(msg);
+    }
+    messages[1]["config"]["timeout"] = 20;
+    cout << messages << endl;
+    cout << is(messages[0]["config"], config)
+	 << is(messages[1]["config"], config)
+	 << is(messages[2]["config"], config) << endl;
+  }
+
+  {
+    cout << "OTab, Tup, Arr and Array" << endl;
+    Val o = CopyOnWrite(new OTab("o{'z':1, 'a':2}"));
+    Val oc = o;
+    OTab& ot = oc;
+    ot["m"] = 3;
+    cout << o << " " << oc << " " << o.entries() << endl;
+
+    Val u = CopyOnWrite(new Tup(1, 2.5, "three"));
+    Val uc = u;
+    Proxy& pu = uc;
+    Tup& tu = pu;
+    tu[0] = 100;
+    uc[1] = 3.5;
+    cout << u << " " << uc << endl;
+
+    Val a = CopyOnWrite(new Arr("[1,2,3]"));
+    Val ac = a;
+    ac.append(4);
+    cout << a << " " << ac << " " << a.length() << " " << ac.length() << endl;
+
+    Array<real_8>* rp = new Array<real_8>(3);
+    rp->append(1.5); rp->append(2.5);
+    Val r = CopyOnWrite(rp);
+    Val rc = r;
+    Array<real_8>& ra = rc;
+    ra[0] = 100;
+    cout << r << " " << rc << endl;
+  }
+
+  {
+    cout << "Const lookups" << endl;
+    Val config = CopyOnWrite(new Tab("{'a':1, 'b':[1,2,3]}"));
+    const Val c1 = config;
+    cout << c1("a") << " " << c1(Str("b")) << " " << c1(Val("a")) << endl;
+    cout << is(config, c1) << endl;  // looking didn't detach
+
+    Val o = CopyOnWrite(new OTab("o{'z':1, 'a':2}"));
+    const Val oc = o;
+    cout << oc("a") << " " << is(o, oc) << endl;
+
+    Val a = CopyOnWrite(new Arr("[1,2,3]"));
+    const Val ac = a;
+    cout << ac(2) << " " << is(a, ac) << endl;
+
+    Val plain = Tab("{'a':1}");
+    cout << (c1==plain) << (plain==c1) << (o==plain) << " " 
+	 << is(config, c1) << is(o, oc) << endl;
+  }
+
+  {
+    cout << "Const outcasts" << endl;
+    Val config = CopyOnWrite(new Tab("{'a':1, 'b':[1,2,3]}"));
+    const Val& c1 = config;
+    Val keep = config;
+
+    // References from a const Val are only for looking: no detach
+    Tab& t = c1;
+    Tab copy = c1;
+    for (It ii(c1); ii(); ) { }
+    c1.prettyPrint(cout);
+    cout << t.entries() << " " << copy << " " << is(config, keep) << endl;
+
+    Val oc = CopyOnWrite(new OTab("o{'z':1}"));
+    Val tc = CopyOnWrite(new Tup(1, "two"));
+    Val ac = CopyOnWrite(new Arr("[1,2]"));
+    Val rc = CopyOnWrite(new Array<real_8>(2));
+    const Val ocs = oc, tcs = tc, acs = ac, rcs = rc;
+    OTab& ot = ocs; Tup& tu = tcs; Arr& ar = acs; Array<real_8>& ra = rcs;
+    cout << ot.entries() << tu.length() << ar.length() << ra.length() << " "
+	 << is(oc, ocs) << is(tc, tcs) << is(ac, acs) << is(rc, rcs) << endl;
+
+    // ... but from a non-const Val they are for changing: detach
+    Tab& mine = config;
+    mine["c"] = 3;
+    It it(config);
+    cout << config << " " << keep << " " << is(config, keep) << endl;
+    Arr& amine = ac;
+    amine.append(3);
+    cout << ac << " " << acs << " " << is(ac, acs) << endl;
+  }
+
+  {
+    cout << "Proxyize" << endl;
+    Val v = Tab("{'a':1}");
+    v.Proxyize(true, false, true);
+    Val copy = v;
+    copy["b"] = 2;
+    cout << v << " " << copy << " " << is(v, copy) << endl;
+
+    Val locked = Tab("{'a':1}");
+    try {
+      locked.Proxyize(true, true, true);
+    } catch (const logic_error& e) {
+      cout << "Expected error:" << e.what() << endl;
+    }
+
+    // Plain proxies are still shared, even on a write
+    Val plain = new Tab("{'a':1}");
+    Val pcopy = plain;
+    pcopy["b"] = 2;
+    cout << plain << " " << is(plain, pcopy) << endl;
+  }
+
+  {
+    cout << "Serialization" << endl;
+    Val config = CopyOnWrite(new Tab("{'a':1}"));
+    Tab t;
+    t["one"] = config;
+    t["two"] = config;
+    t["plain"] = new Tab("{'b':2}");
+    Array<char> buff(BytesToSerialize(t));
+    buff.expandTo(BytesToSerialize(t));
+    Serialize(t, buff.data());
+    cout << is(t["one"], config) << endl;  // serializing didn't detach
+
+    Val result;
+    Deserialize(result, buff.data());
+    cout << result << " " << (result==Val(t)) << endl;
+    Proxy& pone = result["one"];
+    Proxy& pplain = result["plain"];
+    cout << pone.copyOnWrite() << pplain.copyOnWrite() << " "
+	 << is(result["one"], result["two"]) << endl;
+    result["one"]["a"] = 100;
+    cout << result["one"] << " " << result["two"] << endl;
+
+    // The OCSerializer too
+    Tab tt;
+    tt["one"] = config;
+    tt["two"] = config;
+    OCSerializer o;
+    o.put(tt);
+    int len;
+    char* mem = o.peek(len);
+    OCDeserializer od(mem);
+    Val result2;
+    od.load(result2);
+    cout << result2 << " " << is(result2["one"], result2["two"]) << endl;
+    Proxy& p2 = result2["one"];
+    cout << p2.copyOnWrite() << " " << is(tt["one"], config) << endl;
+    result2["two"]["a"] = 200;
+    cout << result2 << endl;
+  }
+}
@@ -0,0 +1,188 @@
+// ///////////////////////////////////////////// HashFunction
+#include "ocport.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// For Koenig lookup to find these HashFunctions, they have to be
+// thrown into the namespace
+OC_BEGIN_NAMESPACE
+
+inline int_u4 HashFunction (const int_4& d)
+{
+  return (int_u4) d;
+}
+
+OC_END_NAMESPACE
+
+// ///////////////////////////////////////////// Include Files
+
+#include "occontainer_test.h"
+#include "ocflathasht.h"
+#include "ocavlhasht.h"
+#include "ocstring.h"
+
+// Print the table in sorted order (iteration order of a FlatHashT
+// depends on the hash)
+template <class K, class V>
+void sortedPrint (const FlatHashT<K,V,8>& a)
+{
+  cout << "{";
+  for (FlatHashTSortedIterator<K,V,8> it(a); it(); ) {
+    cout << " " << it.key() << ":" << it.value();
+  }
+  cout << " } entries=" << a.entries() << endl;
+}
+
+// ///////////////////////////////////////////// Main Program
+
+int main ()
+{
+  {
+    cout << "Empty table" << endl;
+    FlatHashT<int_4, int_4, 8> a;
+    if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    cout << a.contains(1) << " " << a.remove(1) << " " << a.isEmpty() << endl;
+    sortedPrint(a);
+  }
+
+  {
+    cout << "Inserts, enough to grow a few times" << endl;
+    FlatHashT<int_4, int_4, 8> a;
+    for (int ii=0; ii<100; ii++) {
+      a.insertKeyAndValue(ii, ii*ii);
+      if (!a.consistent()) cout << "UH-oh!" << ii << endl;
+    }
+    for (int ii=0; ii<100; ii++) {
+      int_4 v = -1;
+      if (!a.findValue(ii, v) || v!=ii*ii) cout << "UH-oh!" << ii << endl;
+    }
+    cout << a.contains(100) << " " << a.contains(-1) << " " << a.contains(50)
+	 << endl;
+    cout << a(7) << " " << a[8] << endl;
+    sortedPrint(a);
+  }
+
+  {
+    cout << "Deletions" << endl;
+    for (int ii=0; ii<10; ii++) {
+      FlatHashT<int_4, int_4, 8> a;
+      for (int jj=0; jj<ii; jj++) {
+	a.insertKeyAndValue(jj, jj);
+      }
+      cout << "Here we go:"; sortedPrint(a);
+      for (int kk=0; kk<ii; kk++) {
+	cout << "trying to delete: " << kk << " " << a.remove(kk) << endl;
+	if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+      }
+      cout << " ... result of delete: "; sortedPrint(a);
+    }
+  }
+
+  {
+    cout << "References stay valid across growth" << endl;
+    FlatHashT<string, string, 8> a;
+    string& first = a["first"];
+    first = "still here";
+    for (int ii=0; ii<1000; ii++) {
+      a[Stringize(ii)] = Stringize(ii);
+    }
+    cout << first << " " << a("first") << endl;
+  }
+
+  {
+    cout << "Random inserts and removes against AVLHashT" << endl;
+    FlatHashT<int_4, int_4, 8> a;
+    AVLHashT<int_4, int_4, 8> ref;
+    srand(17);
+    bool okay = true;
+    for (int ii=0; ii<20000; ii++) {
+      int_4 key = rand() % 500;
+      if (rand() % 3) {
+	a.insertKeyAndValue(key, ii);
+	ref.insertKeyAndValue(key, ii);
+      } else {
+	if (a.remove(key) != ref.remove(key)) okay = false;
+      }
+      if (a.entries() != ref.entries()) okay = false;
+      if (ii % 1000 == 0 && !a.consistent()) okay = false;
+    }
+    for (AVLHashTIterator<int_4,int_4,8> it(ref); it(); ) {
+      int_4 v;
+      if (!a.findValue(it.key(), v) || v!=it.value()) okay = false;
+    }
+    int count = 0;
+    for (FlatHashTIterator<int_4,int_4,8> it(a); it(); count++) {
+      if (ref(it.key()) != it.value()) okay = false;
+    }
+    if (count != int(ref.entries())) okay = false;
+    cout << (okay ? "OKAY" : "UH-oh!") << endl;
+  }
+
+  {
+    cout << "Small tables (one group) against AVLHashT" << endl;
+    FlatHashT<int_4, int_4, 8> a;
+    AVLHashT<int_4, int_4, 8> ref;
+    srand(4);
+    bool okay = true;
+    for (int ii=0; ii<5000; ii++) {
+      int_4 key = rand() % 12;
+      if (rand() % 2) {
+	a[key] = ii;
+	ref[key] = ii;
+      } else {
+	if (a.remove(key) != ref.remove(key)) okay = false;
+      }
+      int_4 v;
+      key = rand() % 12;
+      if (a.findValue(key, v) != ref.findValue(key, v)) okay = false;
+      if (a.entries() != ref.entries() || !a.consistent()) okay = false;
+    }
+    cout << (okay ? "OKAY" : "UH-oh!") << endl;
+  }
+
+  {
+    cout << "Remove everything, then reuse" << endl;
+    FlatHashT<int_4, int_4, 8> a;
+    for (int kk=0; kk<4; kk++) {
+      for (int ii=0; ii<1000; ii++) a.insertKeyAndValue(ii+kk*1000, ii);
+      for (int ii=0; ii<1000; ii++) a.remove(ii+kk*1000);
+      if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    }
+    cout << a.entries() << endl;
+    a.clear();
+    if (a.consistent()) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+  }
+
+  {
+    cout << "swap, swapInto, reserve, copy" << endl;
+    FlatHashT<string, string, 8> a, b;
+    a["one"] = "1";
+    b["two"] = "2"; b["three"] = "3";
+    a.swap(b);
+    sortedPrint(a); sortedPrint(b);
+
+    string k = "four", v = "4";
+    cout << a.swapInto(k, v) << " [" << k << "] [" << v << "]" << endl;
+    k = "four"; v = "FOUR";
+    cout << a.swapInto(k, v) << " [" << k << "] [" << v << "]" << endl;
+
+    FlatHashT<string, string, 8> c(a);
+    c.reserve(1000);
+    if (c.consistent() && c==a) cout << "OKAY" << endl; else cout << "UH-oh!" << endl;
+    c["five"] = "5";
+    cout << (c!=a) << " " << (a<c) << " " << (c>a) << endl;
+    c = b;
+    sortedPrint(c);
+  }
+
+  ContainerTest<FlatHashT<string, int_u4, 8>,
+    FlatHashTIterator<string, int_u4, 8>,
+    FlatHashT<string, string, 8>,
+    FlatHashTIterator<string, string, 8> > t;
+  return t.tests();
+}
+
+
+
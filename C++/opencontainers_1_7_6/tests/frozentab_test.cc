@@ -0,0 +1,134 @@
+
+// Test the FrozenTab (ocfrozentab.h): a read-only Tab with a perfect
+// hash, that becomes a normal Tab again as a Val.
+
+#include "ocval.h"
+#include "ocfrozentab.h"
+#include "ocserialize.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+void Look (const FrozenTab& f, const Val& key)
+{
+  const Val* vp = f.lookup(key);
+  cout << key << " -> ";
+  if (vp) cout << *vp; else cout << "(not there)";
+  cout << endl;
+}
+
+int main ()
+{
+  {
+    cout << "Empty" << endl;
+    FrozenTab f;
+    cout << f.entries() << f.empty() << f.contains("a", 1) << endl;
+    FrozenTab g((Tab()));
+    cout << g.entries() << g.empty() << " " << g << endl;
+    Look(g, 1);
+  }
+
+  {
+    cout << "Small" << endl;
+    Tab t("{'a':1, 'b':2.5, 'station7':'north', 100:'int key', "
+	  "'nested':{'x':[1,2,3]}, None:'none'}");
+    FrozenTab f(t);
+    cout << f.entries() << f.empty() << f.perfect() << endl;
+    cout << f << endl;
+    Look(f, "a");
+    Look(f, "station7");
+    Look(f, 100);
+    Look(f, int_u8(100));
+    Look(f, "nested");
+    Look(f, None);
+    Look(f, "c");
+    Look(f, 101);
+    cout << *f.lookup("station7", 8) << " "
+	 << (f.lookup("station", 7)==0) << " "
+	 << *f.lookup("b", 1, HashFunction(Val("b"))) << endl;
+    cout << f.contains("nested") << f.contains("nest", 4) << endl;
+    cout << f("b") << " " << f.get("zz", "default") << " " << f.get(100) << endl;
+    try {
+      f("zz");
+    } catch (const out_of_range& e) {
+      cout << "out_of_range:" << e.what() << endl;
+    }
+
+    // Every key is there once when iterating
+    Tab seen;
+    for (int ii=0; ii<f.entries(); ii++) seen[f.key(ii)] = f.value(ii);
+    cout << (seen==t) << endl;
+
+    // Back to a Tab: equal, and changes don't touch the FrozenTab
+    Tab thawed = f.thaw();
+    cout << (thawed==t) << endl;
+    thawed["a"] = "changed";
+    cout << f("a") << endl;
+
+    // As a Val, it's a Tab: and it serializes as one
+    Val v = f;
+    cout << v.tag << " " << (v==Val(t)) << endl;
+    Array<char> buff(BytesToSerialize(v));
+    buff.expandTo(BytesToSerialize(v));
+    Serialize(v, buff.data());
+    Val back;
+    Deserialize(back, buff.data());
+    cout << back.tag << " " << (back==Val(t)) << endl;
+    FrozenTab again(back);
+    Look(again, "station7");
+
+    // Copies and swaps
+    FrozenTab copy(f), other;
+    swap(copy, other);
+    cout << copy.entries() << " " << other.entries() << " " << other("a") << endl;
+    copy = other;
+    cout << copy.entries() << " " << copy("b") << endl;
+  }
+
+  {
+    cout << "Keys with the same hash" << endl;
+    // The hash of a real is the hash of its int part: no perfect hash
+    Tab t;
+    t[5] = "five";
+    t[5.5] = "five and a half";
+    t["a"] = 1;
+    t[6] = 6;
+    FrozenTab f(t);
+    cout << f.entries() << f.perfect() << endl;
+    Look(f, 5);
+    Look(f, 5.5);
+    Look(f, 5.25);
+    Look(f, "a");
+    Look(f, 6);
+    Look(f, 7);
+    cout << (f.thaw()==t) << endl;
+  }
+
+  {
+    cout << "Big" << endl;
+    for (int n=1; n<=100000; n*=7) {
+      Tab t;
+      for (int ii=0; ii<n; ii++) {
+	if (ii%2) t[ii] = ii*2; else t[Stringize(ii)] = ii*3;
+      }
+      FrozenTab f(t);
+      int found = 0, right = 0, misses = 0;
+      for (int ii=0; ii<n; ii++) {
+	const Val* vp;
+	if (ii%2) {
+	  vp = f.lookup(ii);
+	  if (vp && int(*vp)==ii*2) right++;
+	} else {
+	  string s = Stringize(ii);
+	  vp = f.lookup(s.data(), s.length());
+	  if (vp && int(*vp)==ii*3) right++;
+	}
+	if (vp) found++;
+	if (f.lookup(n+ii) || f.lookup(Stringize(ii+1)+"x")) misses++;
+      }
+      cout << n << ": " << f.entries() << " " << f.perfect() << " " << found
+	   << " " << right << " " << misses << endl;
+    }
+  }
+}
@@ -0,0 +1,119 @@
+
+// Test the cached hashes of string Vals
+
+#include "ocval.h"
+#include "ocserialize.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// Hash a string the "long way", without any caching
+int_u4 rawHash (const char* s)
+{
+  return int_u4(OCStringHashFunction(s, strlen(s)));
+}
+
+int main ()
+{
+  {
+    cout << "Cached hashes on Vals" << endl;
+    Val v = "hello";
+    cout << v.hashed << endl;
+
+    // Hashing (for a lookup, say) only looks: it never fills the cache
+    int_u4 h = HashFunction(v);
+    cout << v.hashed << " " << (h==rawHash("hello")) << endl;
+
+    // A table fills the cache of its own copy of the key
+    Tab t;
+    t[v] = 1;
+    Val key;
+    for (It ii(t); ii(); ) key = ii.key();
+    cout << v.hashed << " " << key.hashed << " " << (key.hashcode==h) << " "
+	 << (HashFunction(key)==h) << endl;
+
+    // Copies and swaps carry the cache
+    Val copy(key);
+    cout << copy.hashed << " " << (copy.hashcode==h) << endl;
+    Val other = 17;
+    other.swap(copy);
+    cout << other.hashed << " " << copy.hashed << " " << other << endl;
+
+    // Assignment of something else forgets the old hash
+    other = "world";
+    cout << other.hashed << " " << (HashFunction(other)==rawHash("world"))
+	 << endl;
+    other = 3.5;
+    cout << other.hashed << endl;
+
+    // Equality still works with one, both or neither cached
+    Tab keys;
+    keys["same"] = 1;
+    keys["diff"] = 2;
+    Val a = "same", b = "same", c = "diff";
+    Val same, diff;
+    for (It ii(keys); ii(); ) {
+      if (ii.key()=="same") same = ii.key(); else diff = ii.key();
+    }
+    cout << (a==b) << (a==c) << " " << same.hashed << diff.hashed << " "
+	 << (same==a) << (a==same) << (diff==a) << (same==diff) << endl;
+  }
+
+  {
+    cout << "Tables" << endl;
+    Tab t;
+    t["a"] = 1;
+    t["b"] = 2;
+    t.insertKeyAndValue("c", 3);
+    t[100] = 4;
+    for (TabSit it(t); it(); ) {
+      cout << it.key() << ":" << it.value() << " " << it.key().hashed << endl;
+    }
+
+    // Keys out of one table don't get rehashed going into another
+    Tab tt;
+    for (It it(t); it(); ) {
+      tt[it.key()] = it.value();
+    }
+    cout << (tt==t) << " " << tt("a") << tt("b") << tt("c") << endl;
+
+    // Copies of tables (and OTabs) cache too
+    Tab cp = t;
+    OTab o = "o{'z':1, 'y':2}";
+    OTab ocp = o;
+    bool all = true;
+    for (It it(cp); it(); ) {
+      if (it.key().tag=='a' && !it.key().hashed) all = false;
+    }
+    for (It it(ocp); it(); ) {
+      if (!it.key().hashed) all = false;
+    }
+    cout << all << endl;
+  }
+
+  {
+    // The loaders don't need to do anything: the table caches the
+    // hash of each new key as it goes in
+    cout << "Loaded keys" << endl;
+    Tab t = "{ 'a':1, 'b':{ 'a':2, 'c':3 }, 4:'four', 'd':o{'a':5} }";
+    Array<char> buff(BytesToSerialize(t));
+    buff.expandTo(BytesToSerialize(t));
+    Serialize(t, buff.data());
+
+    Val result;
+    Deserialize(result, buff.data());
+    cout << result << " " << (result==Val(t)) << endl;
+    Tab& tr = result;
+    for (TabSit it(tr); it(); ) {
+      cout << it.key() << " " << it.key().hashed << endl;
+    }
+
+    Tab tv;
+    ValReader vr("{ 'x':1, 'y':{ 'x':2 }, 3:'z' }");
+    vr.expectTab(tv);
+    for (TabSit it(tv); it(); ) {
+      cout << it.key() << " " << it.key().hashed << endl;
+    }
+  }
+}
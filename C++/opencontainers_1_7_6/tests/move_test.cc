@@ -0,0 +1,144 @@
+
+// Test the C++11 move constructors/assignments and the emplaces.
+// Moves should steal the memory of the original (so we check the
+// data pointers are the same) and leave the original empty.
+
+#include "ocval.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+#if defined(OC_MOVE_SEMANTICS)
+
+// Make sure a moved temporary gets returned without a copy
+Arr makeArr (int len)
+{
+  Arr a;
+  for (int ii=0; ii<len; ii++) a.append(ii);
+  return a;
+}
+
+int main ()
+{
+  {
+    cout << "OCString" << endl;
+    OCString s("this string is long enough to not fit in the buffer");
+    const char* data = s.data();
+    OCString moved(std::move(s));
+    cout << moved << " " << (moved.data()==data) << " [" << s << "]" << endl;
+    OCString assigned;
+    assigned = std::move(moved);
+    cout << assigned << " " << (assigned.data()==data) << " [" << moved << "]"
+	 << endl;
+    OCString small("short");
+    assigned = std::move(small);
+    cout << assigned << " [" << small << "]" << endl;
+  }
+
+  {
+    cout << "Array" << endl;
+    Array<int_4> a;
+    for (int ii=0; ii<10; ii++) a.append(ii);
+    const int_4* data = a.data();
+    Array<int_4> moved(std::move(a));
+    cout << moved << " " << (moved.data()==data) << " " << a.length() << endl;
+    a.append(100);  // A moved-from array is still usable
+    cout << a << endl;
+    a = std::move(moved);
+    cout << a << " " << (a.data()==data) << " " << moved.length() << endl;
+
+    Arr va;
+    Val big = Tab("{'a':1, 'b':2}");
+    va.append(std::move(big));
+    cout << va << " " << big << endl;
+  }
+
+  {
+    cout << "Val" << endl;
+    Arr a = makeArr(5);
+    const Val* data = a.data();
+    Val v = std::move(a);
+    Arr& ar = v;
+    cout << v << " " << (ar.data()==data) << " " << a.length() << endl;
+
+    Val moved(std::move(v));
+    cout << moved << " " << v << " " << (((Arr&)moved).data()==data) << endl;
+
+    Val other = "something";
+    other = std::move(moved);
+    cout << other << " " << moved << endl;
+
+    // Move assignment from something nested inside
+    Val nest = Tab("{'a':{'b':[1,2,3]}}");
+    nest = std::move(nest["a"]["b"]);
+    cout << nest << endl;
+
+    // Moving proxies just moves the reference
+    Val p = new Tab("{'shared':1}");
+    Val pcopy = p;
+    Val pmoved = std::move(p);
+    cout << pmoved.isproxy << " " << p << " " << (pmoved==pcopy)
+	 << " " << pcopy.isproxy << endl;
+    Tab& tp = pmoved;
+    tp["shared"] = 2;
+    cout << pcopy << endl;
+  }
+
+  {
+    cout << "Tab, OTab and Tup" << endl;
+    Tab t = "{'a':1, 'b':[1,2,3]}";
+    Val v = std::move(t);
+    cout << v << " " << t << endl;
+    t = std::move(v.operator Tab&());
+    cout << t << " " << v << endl;
+
+    OTab o = "o{'z':1, 'y':2}";
+    Val vo = std::move(o);
+    cout << vo << " " << o << endl;
+
+    Tup u(1, 2.5, "three");
+    Val vu = std::move(u);
+    cout << vu << " " << u << endl;
+  }
+
+  {
+    cout << "emplace" << endl;
+    Tab t;
+    Arr a = makeArr(3);
+    const Val* data = a.data();
+    Val& value = t.emplace("data", std::move(a));
+    Arr& ar = value;
+    cout << t << " " << (ar.data()==data) << " " << a << endl;
+    t.emplace("data", 17);        // Replace
+    t.emplace(1, "one");
+    t.emplace(2);                 // None
+    Val key = "str";
+    t.emplace(key, Tab());
+    cout << t << " " << key << endl;
+
+    OTab o;
+    o.emplace("z", 1);
+    o.emplace("a", "2");
+    o.emplace("z", 3.0);
+    cout << o << endl;
+
+    Arr arr;
+    arr.emplaceAppend(1);
+    arr.emplaceAppend("two");
+    arr.emplaceAppend(Tab("{'three':3}"));
+    Val& last = arr.emplaceAppend();
+    last = 4;
+    cout << arr << endl;
+  }
+}
+
+#else
+
+// Without move semantics, there is nothing to test
+int main ()
+{
+  cout << "No C++11 move semantics" << endl;
+}
+
+#endif
@@ -0,0 +1,65 @@
+
+// Micro-benchmark for BufferConvert (ocnumerictools.h): the plain
+// loop against the vectorized kernels (ocsimd.h) on packet-sized
+// buffers.  This is a benchmark, not a test: the numbers depend on
+// the machine, so it's not in runall.  Try it with -DOC_NO_AVX2 (SSE2
+// only) and -DOC_NO_SIMD too.
+//
+//   g++ -O2 -DOC_NEW_STYLE_INCLUDES -I../include numerictools_bench.cc
+
+#include "ocval.h"
+#include "ocnumerictools.h"
+#include <sys/time.h>
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+real_8 Now ()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+template <class IT, class OT>
+void Bench (const char* name, int len, int iterations)
+{
+  Array<IT> in(len);
+  in.expandTo(len);
+  for (int ii=0; ii<len; ii++) in[ii] = IT(ii%1000 - 500);
+  Array<OT> out(len);
+  out.expandTo(len);
+
+  real_8 start = Now();
+  for (int ii=0; ii<iterations; ii++) {
+    ScalarConvert_(in.data(), out.data(), len);
+  }
+  real_8 scalar = Now() - start;
+
+  start = Now();
+  for (int ii=0; ii<iterations; ii++) {
+    BufferConvert(in.data(), out.data(), len);
+  }
+  real_8 simd = Now() - start;
+
+  real_8 mb = real_8(len)*iterations*(sizeof(IT)+sizeof(OT))/1e6;
+  cout << name << ": scalar " << mb/scalar << " MB/s, "
+       << "BufferConvert " << mb/simd << " MB/s, "
+       << "speedup " << scalar/simd << endl;
+}
+
+int main (int argc, char** argv)
+{
+  int len = argc>1 ? atoi(argv[1]) : 1<<20;  // a multi-megabyte packet
+  int iterations = argc>2 ? atoi(argv[2]) : 50;
+  cout << "length " << len << ", AVX2 " << OCHasAVX2() << endl;
+  Bench<int_2,  real_4>("int_2->real_4     ", len, iterations);
+  Bench<int_2,  real_8>("int_2->real_8     ", len, iterations);
+  Bench<int_u1, real_4>("int_u1->real_4    ", len, iterations);
+  Bench<int_4,  real_8>("int_4->real_8     ", len, iterations);
+  Bench<real_4, real_8>("real_4->real_8    ", len, iterations);
+  Bench<real_8, real_4>("real_8->real_4    ", len, iterations);
+  Bench<complex_8, complex_16>("complex_8->complex_16", len, iterations);
+  Bench<complex_16, complex_8>("complex_16->complex_8", len, iterations);
+}
@@ -0,0 +1,111 @@
+
+// Test the BufferConvert and ConvertArray (ocnumerictools.h): the
+// vectorized conversions (see ocsimd.h) have to give exactly the same
+// answers as the plain loop, for every length (so all the leftover
+// elements are handled) and every value.
+
+#include "ocval.h"
+#include "ocnumerictools.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// Fill a buffer with values that exercise the edges of the type
+template <class T>
+void Fill (T* data, int len, int seed)
+{
+  int_u4 r = seed*2654435761u + 1;
+  for (int ii=0; ii<len; ii++) {
+    r = r*1664525u + 1013904223u;
+    data[ii] = T(int_4(r));  // wraps around: all bits of the type
+  }
+  if (len>0) data[0] = T(0);
+  if (len>1) data[len-1] = T(-1);
+}
+
+void Fill (real_4* data, int len, int seed)
+{
+  int_4* ints = new int_4[len+1];
+  Fill(ints, len, seed);
+  for (int ii=0; ii<len; ii++) data[ii] = real_4(ints[ii])/real_4(7.0);
+  delete [] ints;
+}
+
+void Fill (real_8* data, int len, int seed)
+{
+  int_4* ints = new int_4[len+1];
+  Fill(ints, len, seed);
+  for (int ii=0; ii<len; ii++) data[ii] = real_8(ints[ii])/real_8(7.0)*1e30;
+  if (len>2) data[1] = 1e300; // overflows a real_4
+  if (len>3) data[2] = 1e-300; // underflows a real_4
+  delete [] ints;
+}
+
+// Compare BufferConvert with the plain loop for all lengths 0..70,
+// plus some bigger ones, at different offsets (so alignment varies)
+template <class IT, class OT>
+void Check (const char* name)
+{
+  int bad = 0;
+  int lengths[] = { 1000, 4096, 100003 };
+  for (int ii=0; ii<71+3; ii++) {
+    int len = ii<71 ? ii : lengths[ii-71];
+    for (int offset=0; offset<3; offset++) {
+      IT* in = new IT[len+offset+1];
+      OT* simd = new OT[len+offset+1];
+      OT* scalar = new OT[len+offset+1];
+      Fill(in+offset, len, len*10+offset);
+      BufferConvert(in+offset, simd+offset, len);
+      for (int jj=0; jj<len; jj++) {
+	scalar[offset+jj] = OT(in[offset+jj]);
+      }
+      if (len && memcmp(simd+offset, scalar+offset, len*sizeof(OT))!=0) {
+	bad++;
+      }
+      delete [] in; delete [] simd; delete [] scalar;
+    }
+  }
+  cout << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
+int main ()
+{
+  Check<int_1,  real_4>("int_1->real_4");
+  Check<int_u1, real_4>("int_u1->real_4");
+  Check<int_2,  real_4>("int_2->real_4");
+  Check<int_u2, real_4>("int_u2->real_4");
+  Check<int_4,  real_4>("int_4->real_4");
+  Check<int_1,  real_8>("int_1->real_8");
+  Check<int_u1, real_8>("int_u1->real_8");
+  Check<int_2,  real_8>("int_2->real_8");
+  Check<int_u2, real_8>("int_u2->real_8");
+  Check<int_4,  real_8>("int_4->real_8");
+  Check<real_4, real_8>("real_4->real_8");
+  Check<real_8, real_4>("real_8->real_4");
+  Check<int_8,  real_8>("int_8->real_8");  // not vectorized, still works
+
+  // Complex: twice as many reals
+  {
+    Array<complex_8> a(40);
+    for (int ii=0; ii<40; ii++) a.append(complex_8(ii+0.5f, -ii-0.25f));
+    Val v = a;
+    ConvertArray(v, 'D');
+    Array<complex_16>& d = v;
+    cout << v.subtype << " " << d.length() << " " << d[0] << " " << d[39] << endl;
+    ConvertArray(v, 'F');
+    cout << v.subtype << " " << (v==Val(a)) << endl;
+  }
+
+  // ConvertArray on a typical packet
+  {
+    Array<int_2> samples(37);
+    for (int ii=0; ii<37; ii++) samples.append(int_2(ii*1000-18000));
+    Val v = samples;
+    ConvertArray(v, 'f');
+    cout << v << endl;
+    ConvertArray(v, 'd');
+    Array<real_8>& d = v;
+    cout << v.subtype << " " << d[36] << endl;
+  }
+}
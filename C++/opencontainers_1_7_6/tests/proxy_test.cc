@@ -163,6 +163,63 @@ void ThreadsTest ()
   if (okay) cout << "Okay:  Threads test passed" << endl;
 }
 
+// Readers and writers on the same table: writers keep 'a' and 'b'
+// opposite, readers (in READ transactions) should never see otherwise
+void* writer (void* data)
+{
+  Val& shared = *(Val*)data;
+  for (int ii=0; ii<20000; ii++) {
+    TransactionLock tl(shared);
+    shared["a"] = ii;
+    shared["b"] = -ii;
+  }
+  return 0;
+}
+
+void* reader (void* data)
+{
+  Val& shared = *(Val*)data;
+  int bad = 0;
+  for (int ii=0; ii<20000; ii++) {
+    TransactionLock tl(shared, TransactionLock::READ);
+    Tab& t = shared;
+    if (int(t("a")) != -int(t("b"))) bad++;
+  }
+  return (void*)(long)bad;
+}
+
+void ReadWriteTest (bool shared_across_processes)
+{
+  Val shared = Proxy(new Tab("{'a':0, 'b':0}"), true, true, 
+		     shared_across_processes);
+  long bad = 0;
+  {
+    OCThread r1("reader 1", false), r2("reader 2", false);
+    OCThread r3("reader 3", false), w("writer", false);
+    r1.start(reader, &shared); 
+    w.start(writer, &shared);
+    r2.start(reader, &shared);
+    r3.start(reader, &shared);
+    bad += (long)r1.join() + (long)r2.join() + (long)r3.join();
+    w.join();
+  }
+
+  // Readers can be in together
+  {
+    TransactionLock tl1(shared, TransactionLock::READ);
+    TransactionLock tl2(shared, TransactionLock::READ);
+    cout << shared("a") << " " << shared("b") << endl;
+  }
+  // ... and a writer can get in after them
+  {
+    TransactionLock tl(shared);
+    shared["a"] = 0;
+  }
+  cout << "Read/write transactions " 
+       << (shared_across_processes ? "(shared across processes): " : ": ")
+       << (bad ? "FAILED" : "okay") << endl;
+}
+
 // Change by reference
 void Change (Val& v)
 {
@@ -272,6 +329,8 @@ int main ()
 
   // Test a lot of threads banging against the same table
   ThreadsTest();
+  ReadWriteTest(false);
+  ReadWriteTest(true);
 
   // Can we put Arrs in Proxies
   cout << "Test creating Arrays with proxies" << endl;
@@ -496,4 +555,38 @@ int main ()
     }
   }
 
+
+  // Inline proxies: the Arr/Tup and its first few elements come from
+  // the same allocation as the proxy
+  {
+    cout << "Inline proxies" << endl;
+    Val ia = InlineArr(2);
+    Arr& a = ia;
+    a.append(1); a.append("two");
+    cout << ia << " " << a.capacity() << " " << ia.isproxy << endl;
+    a.append(3.3);   // grows past its inline elements
+    cout << ia << " " << (a.capacity()>=3) << endl;
+
+    Val iu = InlineTup(3);
+    Tup& u = iu;
+    u.impl().append(1); u.impl().append(None); u.impl().append("three");
+    Val copy = iu;
+    cout << iu << " " << copy << " " << is(iu, copy) << " " << ia.length() << endl;
+
+    Val swapped = InlineArr(3);
+    Arr& s = swapped;
+    s.append(100);
+    Arr other("[1,2,3,4]");
+    s.swap(other);
+    cout << swapped << " " << other << endl;
+
+    Val cow = InlineArr(2);
+    Arr& c = cow;
+    c.append(1);
+    Proxy& cp = cow;
+    cp.copyOnWrite(true);
+    Val cow2 = cow;
+    cow2.append(2);
+    cout << cow << " " << cow2 << " " << is(cow, cow2) << endl;
+  }
 }
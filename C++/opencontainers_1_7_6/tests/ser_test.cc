@@ -38,6 +38,37 @@ void printer (char* mem, int len)
   cerr << endl;
 }
 
+// Collects a streaming serialization, and how many pieces it came in
+struct StringSink : public DumpSink {
+  StringSink () : writes(0) { }
+  virtual void write (const char* data, size_t len) 
+  { s.append(data, len); writes++; }
+  string s;
+  int writes;
+};
+
+// Deserializing a piece at a time has to give exactly what
+// Deserialize does, however it's split up
+void pushCheck (const char* mem, size_t len, const Val& expected,
+		bool compat=OC_SERIALIZE_COMPAT)
+{
+  for (size_t piece=1; ; piece=piece*5+2) {
+    if (piece>len) piece = len;
+    OCPushDeserializer pd(compat);
+    Val result;
+    bool done = false;
+    for (size_t ii=0; ii<len; ii+=piece) {
+      if (done) { done = false; break; } // done too early
+      done = pd.feed(mem+ii, (len-ii<piece) ? len-ii : piece, result);
+    }
+    if (!done || Stringize(result)!=Stringize(expected)) {
+      cerr << "push deserialization different" << endl;
+      exit(1);
+    }
+    if (piece==len) break;
+  }
+}
+
 void putme (const Val& v, bool compare=true)
 {
   // cerr << "*****v = " << v << endl;
@@ -65,6 +96,28 @@ void putme (const Val& v, bool compare=true)
       exit(1);
     }
 
+    // The single pass serialization (onto the end of a buffer) has to
+    // be exactly the same
+    Array<char> single;
+    single.append('x');
+    size_t single_len = SerializeToArray(v, single);
+    if (single_len != size_t(len) || single.length() != size_t(len+1) ||
+	memcmp(mem, single.data()+1, len)!=0 || single[0]!='x') {
+      cerr << "single pass serialization different" << endl;
+      exit(1);
+    }
+
+    // ... and so does the streaming serialization, even a few bytes at
+    // a time
+    for (size_t chunk=7; chunk<100000; chunk*=100) {
+      StringSink sink;
+      SerializeToSink(v, sink, OC_SERIALIZE_COMPAT, chunk);
+      if (sink.s.length() != size_t(len) || memcmp(mem, sink.s.data(), len)!=0) {
+	cerr << "streaming serialization different" << endl;
+	exit(1);
+      }
+    }
+
     // Now see if both deserialize the same way
     Val result;
     char* ender = Deserialize(result, mem);
@@ -73,6 +126,7 @@ void putme (const Val& v, bool compare=true)
       cerr << "When deserializing, different lengths" << endl;
       exit(1);
     }
+    pushCheck(mem, len, result);
     OCDeserializer od(nm, true);
     Val result2;
     od.load(result2);
@@ -389,6 +443,7 @@ void serOTabTup (bool serialize_compat, bool deserialize_compat)
     if (diff != bytes) { 
       cout << "different bytes?" << endl; exit(1); 
     }
+    pushCheck(buff, bytes, ret, deserialize_compat);
     cout << "After: (conversion=" << deserialize_compat << ")" << endl;
     ret.prettyPrint(cout);
 
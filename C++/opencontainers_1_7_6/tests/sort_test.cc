@@ -5,6 +5,7 @@
 #include "ocport.h"
 #include "ocarray.h"
 #include "ocsort.h"
+#include "ocparallelsort.h"
 #include "ocpermutations.h"
 
 #include <stdio.h>
@@ -41,6 +42,84 @@ bool testIfSorted (const CONTAINER& c, int start, int length)
 }
 
 
+// Fill with values that cover the whole range of the type: negative,
+// positive, big and small, with lots of duplicates
+template <class T>
+void FillRandom (Array<T>& a, int n)
+{
+  a.clear();
+  for (int ii=0; ii<n; ii++) {
+    int_u8 r = (int_u8(rand())<<33) ^ (int_u8(rand())<<11) ^ rand();
+    a.append(T(r % 3 ? int_8(r) : int_8(r%100)-50));
+  }
+}
+template <>
+void FillRandom (Array<real_8>& a, int n)
+{
+  a.clear();
+  for (int ii=0; ii<n; ii++) {
+    real_8 r = (rand()-RAND_MAX/2)*1e-3;
+    a.append(ii%4 ? r*r*r : (ii%3 ? r : -0.0));
+  }
+}
+template <>
+void FillRandom (Array<real_4>& a, int n)
+{
+  Array<real_8> d;
+  FillRandom(d, n);
+  a.clear();
+  for (int ii=0; ii<n; ii++) a.append(real_4(d[ii]));
+}
+
+// Radix sort has to give the same order as QuickSort
+template <class T>
+bool testRadix (const char* name)
+{
+  bool success = true;
+  int lengths[] = { 0, 1, 2, 3, 17, 255, 256, 257, 1000, 65536, 100003 };
+  for (size_t ll=0; ll<sizeof(lengths)/sizeof(lengths[0]); ll++) {
+    Array<T> a, expected;
+    FillRandom(a, lengths[ll]);
+    expected = a;
+    OCQuickSort(expected, 0, expected.length());
+    OCRadixSort(a, 0, a.length());
+    for (size_t ii=0; ii<a.length(); ii++) {
+      if (!(a[ii]==expected[ii])) success = false;
+    }
+  }
+  cout << (success ? "SUCCESS" : "FAILURE") << " for Radix sort of " 
+       << name << endl;
+  return success;
+}
+
+// The parallel sort has to give the same order as QuickSort, for any
+// number of threads
+template <class T>
+bool testParallel (const char* name)
+{
+  bool success = true;
+  int lengths[] = { 0, 1, 100, 1000, 4099, 100003 };
+  for (int threads=1; threads<=7; threads+=2) {
+    ParallelSortT<T> sorter(threads);
+    for (size_t ll=0; ll<sizeof(lengths)/sizeof(lengths[0]); ll++) {
+      Array<T> a, b, expected;
+      FillRandom(a, lengths[ll]);
+      b = a;
+      expected = a;
+      OCQuickSort(expected, 0, expected.length());
+      sorter.sort(a);
+      sorter.radixSort(b);
+      for (size_t ii=0; ii<a.length(); ii++) {
+	if (!(a[ii]==expected[ii]) || !(b[ii]==expected[ii])) success = false;
+      }
+    }
+  }
+  cout << (success ? "SUCCESS" : "FAILURE") << " for Parallel sort of " 
+       << name << endl;
+  return success;
+}
+
+
 string StringIt (const int* c, int n)
 {
   string s;
@@ -246,6 +325,45 @@ int SortTest::tests()
     }
   }
   
+  {
+    cout << "** Radix sort ** " << endl;
+    testRadix<int_1>("int_1");
+    testRadix<int_u1>("int_u1");
+    testRadix<int_2>("int_2");
+    testRadix<int_u2>("int_u2");
+    testRadix<int_4>("int_4");
+    testRadix<int_u4>("int_u4");
+    testRadix<int_8>("int_8");
+    testRadix<int_u8>("int_u8");
+    testRadix<real_4>("real_4");
+    testRadix<real_8>("real_8");
+
+    // Pieces in the middle of an array are left alone around them
+    int_4 a[] = { 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    OCRadixSort(a, 2, 6);
+    cout << StringIt(a, 10) << endl;
+  }
+
+  {
+    cout << "** Parallel sort ** " << endl;
+    testParallel<int_8>("int_8");
+    testParallel<real_8>("real_8");
+    testParallel<int_u2>("int_u2");
+
+    // Anything with a < works with sort (but not radixSort)
+    Array<string> a;
+    for (int ii=0; ii<10000; ii++) a.append(Stringize(rand()));
+    ParallelSortT<string> sorter(4);
+    sorter.sort(a);
+    cout << (testIfSorted(a, 0, a.length()) ? "SUCCESS" : "FAILURE")
+	 << " for Parallel sort of strings" << endl;
+    try {
+      sorter.radixSort(a);
+    } catch (const logic_error& e) {
+      cout << e.what() << endl;
+    }
+  }
+
   delete my_copy;
 
   return 0;
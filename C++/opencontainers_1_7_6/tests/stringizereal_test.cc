@@ -0,0 +1,89 @@
+
+// Test StringizeReal (ocstringizereal.h): the output has to follow
+// the Stringize rules (.0 on integers, %g style exponents, nan/inf),
+// and every real has to read back as exactly the same real.
+
+#include "ocval.h"
+#include <stdio.h>
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+template <class T>
+void Show (T r)
+{
+  char buf[OC_REAL_CHARS];
+  int len = StringizeReal(r, buf);
+  string s(buf, len);
+  len = StringizeReal(r, buf, false);
+  cout << s << "  " << string(buf, len) << endl;
+}
+
+real_8 ReadBack (const char* s, real_8*) { return strtod(s, 0); }
+real_4 ReadBack (const char* s, real_4*) { return strtof(s, 0); }
+
+// Random bit patterns (and some "nice" decimals): all have to read
+// back the same
+template <class T, class U>
+void RoundTrip (const char* name, int n)
+{
+  int bad = 0;
+  int_u8 r = 88172645463325252ULL;
+  for (int ii=0; ii<n; ii++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    T value;
+    if (ii%2) {
+      U bits = U(r);
+      memcpy(&value, &bits, sizeof(value));
+      if (value!=value) continue;  // nan
+    } else {
+      value = T(int_8(r % 2000000) - 1000000) / T(1000);
+    }
+    char buf[OC_REAL_CHARS+1];
+    int len = StringizeReal(value, buf);
+    buf[len] = '\0';
+    T back = ReadBack(buf, (T*)0);
+    if (memcmp(&back, &value, sizeof(T))!=0 && !(back==0 && value==0)) {
+      if (bad++<10) cout << "Didn't read back:" << buf << endl;
+    }
+  }
+  cout << name << (bad ? " FAILED " : " ok ") << bad << endl;
+}
+
+int main ()
+{
+  const real_8 doubles[] = {
+    0.0, -0.0, 1.0, -1.0, 100.0, 0.1, 0.5, 0.3, 0.1+0.2, 1.0/3, -2.0/3,
+    123.456, 1e-4, 1e-5, 1.5e-5, 1e15, 1e16, 1e17, 123456789012345.6,
+    1234567890123456.7, 9223372036854775808.0, -9223372036854775808.0,
+    18446744073709551616.0, 1e100, -1e-100, 1.7976931348623157e308,
+    2.2250738585072014e-308, 4.9406564584124654e-324, 3.14159265358979
+  };
+  for (size_t ii=0; ii<sizeof(doubles)/sizeof(doubles[0]); ii++) {
+    Show(doubles[ii]);
+  }
+  Show(1.0/0.0);
+  Show(-1.0/0.0);
+
+  const real_4 floats[] = {
+    0.0f, 1.0f, -7.0f, 0.1f, 0.3f, 3.14159265f, 1e-5f, 123456.7f,
+    16777216.0f, 1e10f, 1e20f, 3.4028235e38f, 1.17549435e-38f, 1.4e-45f
+  };
+  for (size_t ii=0; ii<sizeof(floats)/sizeof(floats[0]); ii++) {
+    Show(floats[ii]);
+  }
+
+  // Everything that prints reals uses it
+  cout << Stringize(0.1+0.2) << " " << Stringize(real_4(2.5)) << endl;
+  Val v = 1e-7;
+  Str s = v;
+  cout << v << " " << s << " " << Val(real_4(0.1)) << endl;
+  cout << complex_16(1, -0.25) << " " << complex_8(1e-5, 2) << endl;
+  Array<real_8> a;
+  a.append(1); a.append(0.1+0.2); a.append(-1e300);
+  cout << Val(a) << endl;
+
+  RoundTrip<real_8, int_u8>("real_8", 1000000);
+  RoundTrip<real_4, int_u4>("real_4", 1000000);
+}
@@ -145,6 +145,45 @@ static void SerializeTest (Val& big)
 }
 
 
+// Lookups by (const char*, length) and StrView, without a temporary Val
+template <class T>
+void stringLookups_ (T& t)
+{
+  const char* buff = "alphabetagamma";
+  Val* vp = t.lookup(buff, 5);
+  cout << (vp ? *vp : Val("missing")) << " ";
+  vp = t.lookup(buff+5, 4);
+  cout << (vp ? *vp : Val("missing")) << " ";
+  vp = t.lookup(buff, 4);
+  cout << (vp ? *vp : Val("missing")) << endl;
+
+  // Precomputed hashes, and a StrView through the table's template
+  StrView gamma(buff+9, 5);
+  int_u4 h = gamma.hash();
+  cout << (h==HashFunction(Val("gamma"))) << " "
+       << t.contains(buff+9, 5, h) << " " << t.contains(buff+9, 4) << " "
+       << *t.lookup(gamma, h) << " " << t.contains(gamma, h) << endl;
+
+  Val key;
+  cout << t.find(buff+5, 4, key) << " " << key << " ";
+  cout << t.find("nope", 4, key) << " " << key << " ";
+  cout << t.find(buff, 5, StrView(buff, 5).hash(), key) << " " << key << endl;
+
+  // Only strings match: not the int 1, and not the Val-based contains
+  cout << t.contains("1", 1) << " " << t.contains(Val(1)) << " "
+       << t.contains(Val("alpha")) << endl;
+
+  // Through a Val (the operator() uses the same no-allocation path)
+  Val v = t;
+  cout << v("beta") << " ";
+  try {
+    v("delta");
+  } catch (const out_of_range& e) {
+    cout << "out_of_range:" << e.what();
+  }
+  cout << endl;
+}
+
 int main()
 {
   // Try converting out Val, const Val&, Val&, const Val
@@ -751,4 +790,10 @@ int main()
     ll = vl;
     cout << (unsigned long long)(vl) << " " << ll << endl;
   }
+  {
+    Tab t = "{ 'alpha':1, 'beta':2, 'gamma':3, 1:'one' }";
+    stringLookups_(t);
+    OTab o = "o{ 'alpha':1, 'beta':2, 'gamma':3, 1:'one' }";
+    stringLookups_(o);
+  }
 }
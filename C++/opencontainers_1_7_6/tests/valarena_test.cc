@@ -0,0 +1,235 @@
+
+// Test the arenas: StreamingPools created with CreateArena, the
+// ValArena which builds a whole Val tree in one, and the
+// AllocatorScope which builds things in any allocator.
+
+#include "ocval.h"
+#include "ocserialize.h"
+#include "ocvalarena.h"
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+// Count heap allocations, so we can see what's in the arena.  All
+// the replacements go through malloc/free (the array forms call
+// these).  They are never inlined: if the compiler inlines free()
+// into a call site, it pairs it with the builtin operator new and
+// warns (-Wmismatched-new-delete) about a mismatch there isn't.
+#if defined(__GNUC__)
+#  define VALARENA_TEST_NOINLINE __attribute__((noinline))
+#else
+#  define VALARENA_TEST_NOINLINE
+#endif
+static int heap_allocations = 0;
+static VALARENA_TEST_NOINLINE void* HeapAllocate_ (size_t bytes)
+{
+  heap_allocations++;
+  void* mem = malloc(bytes ? bytes : 1);
+  if (!mem) throw std::bad_alloc();
+  return mem;
+}
+static VALARENA_TEST_NOINLINE void HeapFree_ (void* mem) { free(mem); }
+
+void* operator new (size_t bytes) { return HeapAllocate_(bytes); }
+void operator delete (void* mem) throw () { HeapFree_(mem); }
+#if __cplusplus >= 201402L
+void operator delete (void* mem, size_t) throw () { HeapFree_(mem); }
+#endif
+
+int main ()
+{
+  {
+    cout << "Arena" << endl;
+    char memory[1024];
+    StreamingPool* sp = StreamingPool::CreateArena(memory, sizeof(memory),
+						   1024);
+    cout << sp->isArena() << sp->isPristine() << endl;
+    char* m1 = sp->allocate(10);
+    char* m2 = sp->allocate(10);
+    cout << (m2-m1) << " " << (AVLP(m1)%8) << " " << (AVLP(m2)%8)
+	 << " " << sp->arenaBytesAllocated() << endl;
+    sp->deallocate(m1);  // does nothing
+    char* m3 = sp->allocate(10);
+    cout << (m3-m2) << " " << sp->isPristine() << endl;
+
+    // Past the end: more comes from the heap
+    int before = heap_allocations;
+    char* big = sp->allocate(2000);
+    memset(big, 'x', 2000);
+    char* small = sp->allocate(8);
+    cout << (heap_allocations-before) << " " << (AVLP(big)%8)
+	 << " " << (AVLP(small)%8) << " " << sp->arenaBytesAllocated() << endl;
+
+    // Reset starts over, and keeps the biggest chunk for next time
+    sp->resetArena();
+    cout << (sp->allocate(10)==m1) << " " << sp->arenaBytesAllocated() << endl;
+    before = heap_allocations;
+    big = sp->allocate(2000);
+    cout << (heap_allocations-before) << " " << (AVLP(big)%8) << endl;
+    StreamingPool::Clean(sp);  // and everything goes back
+  }
+
+  {
+    cout << "ValArena" << endl;
+    ValArena arena;
+    Val& root = arena.root();
+    cout << root << " " << (root.allocator()==arena.allocator()) << endl;
+
+    // Anything assigned into the root goes into the arena: no heap
+    Val t = Tab("{'a':1, 'b':'a string long enough to not fit inline in the Val'}");
+    Val c = Arr("[1,2.2,'three']");
+    Val n = Tab("{'nested':'also in the arena, all of it'}");
+    int before = heap_allocations;
+    root = t;
+    root["c"] = c;
+    root["c"].append(n);
+    int heap = heap_allocations - before;
+    cout << root << endl;
+    cout << heap << " " << (arena.bytesAllocated()>0)
+	 << " " << (root["c"].allocator()==arena.allocator()) << endl;
+
+    // O(1): nothing is destructed or freed
+    before = heap_allocations;
+    arena.clear();
+    cout << arena.root() << " " << arena.bytesAllocated() << " "
+	 << (heap_allocations-before) << endl;
+  }
+
+  {
+    cout << "Deserialize into an arena" << endl;
+    Val message = Tab("{'header':{'id':17, 'name':'a long name for the message'}, "
+		      "'data':[1, 2.5, 'three', (4, 5, 'a long string in a tuple'), "
+		      "    o{'z':1, 'a':2}], 'big':123456789012345678901234567890}");
+    message["numbers"] = Array<real_8>(3);
+    message["numbers"].append(1.5);
+    message["numbers"].append(2.5);
+    message["shared"] = new Tab("{'proxy':'in the arena too'}");
+    message["again"] = message["shared"];
+    Array<char> buff(BytesToSerialize(message, false));
+    buff.expandTo(BytesToSerialize(message, false));
+    Serialize(message, buff.data(), false);
+
+    ValArena arena(1024, 1024);  // small, so it has to grow
+    for (int ii=0; ii<3; ii++) {
+      int before = heap_allocations;
+      Deserialize(arena.root(), buff.data(), false);
+      int heap = heap_allocations - before;
+      Val& root = arena.root();
+      cout << root << endl;
+      cout << (root==message) << " " << is(root["shared"], root["again"])
+	   << " " << (root["header"]["name"].allocator()==arena.allocator())
+	   << endl;
+      Proxy& p = root["shared"];
+      Tab& shared = p;
+      cout << (shared.allocator()==arena.allocator()) << " "
+	   << (heap < 10) << endl;  // only a few chunks and temporaries
+      arena.clear();
+    }
+  }
+
+  {
+    cout << "AllocatorScope into an arena" << endl;
+    ValArena arena;
+    Allocator* a = arena.allocator();
+    cout << (CurrentAllocator()==0) << endl;
+    {
+      AllocatorScope scope(a);
+      // (The reader itself uses a few std::strings on the heap)
+      Val t = Tab("{'a':1, 'b':'a string long enough to not fit inline in the Val'}");
+      Val c = Arr("[1, 2.2, 'three', {'nested':'and long enough to allocate'}]");
+      int before = heap_allocations;
+      t["c"] = c;
+      t["d"] = Array<real_8>(10);
+      t["e"] = StringToBigInt("123456789012345678901234567890");
+      Val p = NewProxy<Tab>();
+      p["x"] = InlineArr(2);
+      p["x"].append(Tup(1, "a long string in a tuple, on the arena"));
+      t["p"] = p;
+      OCString s("another string long enough to need some memory");
+      int heap = heap_allocations - before;
+      cout << t << endl << s << endl;
+      cout << heap << " " << (CurrentAllocator()==a) << endl;
+      Tab& tt = t;
+      Proxy& pp = t["p"];
+      Tab& pt = pp;
+      cout << (tt.allocator()==a) << (t["c"].allocator()==a) 
+	   << (pt.allocator()==a) << a->owns((char*)&pt) 
+	   << (s.allocator()==a) << endl;
+
+      // Scopes nest: 0 means the heap
+      {
+	AllocatorScope heap_scope(0);
+	Tab h("{'on':'the heap, because of the inner scope'}");
+	cout << (CurrentAllocator()==0) << (h.allocator()==0) << endl;
+      }
+      cout << (CurrentAllocator()==a) << endl;
+    }
+    cout << (CurrentAllocator()==0) << (Tab().allocator()==0) << endl;
+  }
+
+  {
+    cout << "AllocatorScope into a pool" << endl;
+    char* memory = new char[256*1024];
+    StreamingPool* sp = StreamingPool::CreateStreamingPool(memory, 256*1024);
+    {
+      Val v, heap_proxy, pool_proxy;
+      Tab outside("{'built':'outside of the scope, on the heap'}");
+      {
+	AllocatorScope scope(sp);
+	v = outside;   // copies go in the pool too
+	v["more"] = Arr("[1,2,3,'a long string for the array']");
+	heap_proxy = new Tab("{'a':'plain new: on the heap, insides in the pool'}");
+	pool_proxy = NewProxy<Arr>();
+	pool_proxy.append(v);
+      }
+      Proxy& hp = heap_proxy;
+      Proxy& pp = pool_proxy;
+      Tab& ht = hp;
+      Arr& pa = pp;
+      cout << v << endl << heap_proxy << endl << pool_proxy << endl;
+      Tab& vt = v;
+      Tab copy(vt);  // a copy made outside the scope is on the heap
+      cout << (outside.allocator()==0) << (v.allocator()==0) 
+	   << (copy.allocator()==0) << endl;
+      cout << (vt.allocator()==sp) << (ht.allocator()==sp) << sp->owns((char*)&ht)
+	   << (pa.allocator()==sp) << sp->owns((char*)&pa) << endl;
+
+      // Everything still uses the pool after the scope is gone
+      v["after"] = "the scope went away, but v's table still uses the pool";
+      pool_proxy.append(1234567);
+      cout << sp->isPristine() << endl;
+    }
+    // ... and it all goes back where it came from
+    cout << sp->isPristine() << endl;
+    StreamingPool::Clean(sp);
+    delete [] memory;
+  }
+
+  {
+    // More arenas over the life of the program than a compact Val
+    // has allocator slots: each one gives its slot back when it goes
+    // (a hole is kept in the memory each old arena had, so every
+    // arena is at a new address).
+    cout << "Many arenas" << endl;
+    const int arenas = 600;
+    char* holes[arenas];
+    int made = 0, good = 0;
+    try {
+      for (int ii=0; ii<arenas; ii++) {
+	holes[made++] = new char[1024];
+	ValArena arena(1024);
+	Val& root = arena.root();
+	root = Tab("{'a':1, 'b':'a string long enough to not fit inline'}");
+	root["n"] = ii;
+	if (root.allocator()==arena.allocator() && 
+	    root["b"].allocator()==arena.allocator() && 
+	    int(root["n"])==ii) good++;
+      }
+    } catch (const exception& e) {
+      cout << e.what() << endl;
+    }
+    cout << good << endl;
+    for (int ii=0; ii<made; ii++) delete [] holes[ii];
+  }
+}
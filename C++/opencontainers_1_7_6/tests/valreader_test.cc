@@ -90,6 +90,12 @@ void TestNumbers (bool use_streams)
     "18446744073709551615", // Barely fits in int_u8
     "18446744073709551616", // Barely DOESN'T fits in int_u8, int_un
 
+    // Reals that need more than the simple conversion
+    "0.1", "-2.5e-3", "+.5", ".5e1", "1E3", "1e23", "0.30000000000000004",
+    "9007199254740993", "9007199254740993.0", "1.7976931348623157e308",
+    "2.2250738585072014e-308", "4.9406564584124654e-324", "1e400", "1e-400",
+    "123456789012345678901234567890.5", "00012", "007.5", "1.5L", "12,13",
+
     0
   };
 
@@ -253,6 +259,50 @@ void TestTabs (bool uses_streams)
   mainloop(input, trialTabs, uses_streams);
 }
 
+// Every real (and int) has to come back exactly the same after a
+// trip through Stringize and Eval, string and stream
+void RoundTrip ()
+{
+  int_u8 r = 88172645463325252ULL;
+  int bad = 0;
+  for (int ii=0; ii<100000; ii++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    real_8 d;
+    memcpy(&d, &r, sizeof(d));
+    if (d!=d || d-d!=0) continue;  // nan and inf print as words
+    
+    Val v = (ii%3==0) ? Val(d) : (ii%3==1) ? Val(int_8(r)) : Val(r);
+    string s = Stringize(v);
+    Val back = Eval(s);
+    istringstream is(s);
+    StreamValReader svr(is);
+    Val stream_back;
+    svr.expectAnything(stream_back);
+    if (back.tag!=stream_back.tag || !(back==stream_back) || 
+	!(back==v) || (v.tag=='d' && back.tag!='d')) {
+      if (bad++<10) cout << "Didn't read back:" << s << endl;
+    }
+  }
+  cout << "Round trip " << (bad ? "FAILED " : "ok ") << bad << endl;
+
+  // A bunch of reals with lots of digits: has to match strtod
+  bad = 0;
+  for (int ii=0; ii<100000; ii++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    char buff[64];
+    int digits = int(r%25)+1;
+    int exponent = int((r>>8)%620)-320;
+    sprintf(buff, "%.*e", digits, real_8(int_8(r>>11)) * 1e-10);
+    sprintf(strchr(buff, 'e'), "e%d", exponent);
+    real_8 expected = strtod(buff, 0);
+    Val v = Eval(buff);
+    if (v.tag!='d' || memcmp(&v.u.d, &expected, sizeof(expected))!=0) {
+      if (bad++<10) cout << "Didn't match strtod:" << buff << endl;
+    }
+  }
+  cout << "Match strtod " << (bad ? "FAILED " : "ok ") << bad << endl;
+}
+
 // test reading until EOF
 void valReader ()
 {
@@ -444,6 +494,8 @@ int main ()
   // test reading until EOF
   valReader ();
 
+  RoundTrip();
+
   // Double check that complexes read okay
   a = Eval("(1+2j)");
   cout << "tag:" << a.tag << endl;
@@ -0,0 +1,94 @@
+
+// Timing for big multiplies (ocbiguint.h): how long a multiply and a
+// square of two n digit numbers take, and how long converting a
+// number to and from a decimal string takes.  Use this to pick the
+// thresholds for your machine: compile it with the thresholds way up
+// to get just the schoolbook times, then with the defaults (or your
+// own), and compare.  int_un uses 64-bit digits if the compiler has
+// a 128-bit int: -DOC_NO_INT128 times the old 32-bit digits.
+//
+//   g++ -O3 -DOC_NEW_STYLE_INCLUDES -I../include bigint_timing.cc
+//   g++ -O3 -DOC_NEW_STYLE_INCLUDES -I../include bigint_timing.cc \
+//       -DOC_KARATSUBA_THRESHOLD=1000000 -DOC_KARATSUBA_SQR_THRESHOLD=1000000
+//
+// Results are in bigint_timing.results.
+
+#include "ocbigint.h"
+#include <sys/time.h>
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+real_8 Now ()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+// A number with the given number of 32-bit words (all set): this
+// is the same number whatever size digits int_un uses
+int_un Make (int digits, int_u4 seed)
+{
+  int_un result = 0;
+  for (int ii=0; ii<digits; ii++) {
+    seed = seed*1664525u + 1013904223u;
+    result.singleDigitMultiply(65536);   // shift up a digit
+    result.singleDigitMultiply(65536);
+    result += int_un(int_8(seed | 0x80000000u));
+  }
+  return result;
+}
+
+int main ()
+{
+  cout << "Thresholds: Karatsuba=" << OC_KARATSUBA_THRESHOLD 
+       << " (square=" << OC_KARATSUBA_SQR_THRESHOLD << ")"
+       << " Toom-3=" << OC_TOOM3_THRESHOLD
+       << " (square=" << OC_TOOM3_SQR_THRESHOLD << ")" << endl;
+  cout << "digits  multiply(us)  square(us)" << endl;
+  int sizes[] = { 8, 16, 24, 32, 48, 64, 96, 128, 160, 200, 256, 384, 
+		  512, 1024, 2048, 4096, 8192 };
+  for (size_t ss=0; ss<sizeof(sizes)/sizeof(sizes[0]); ss++) {
+    const int n = sizes[ss];
+    int_un a = Make(n, 1), b = Make(n, 2);
+    int iterations = 1;
+    real_8 mul = 0, sqr = 0;
+    // Keep doubling the iterations until we get a decent time
+    while (true) {
+      real_8 start = Now();
+      for (int ii=0; ii<iterations; ii++) {
+	int_un c = a;  c *= b;
+      }
+      mul = Now() - start;
+      start = Now();
+      for (int ii=0; ii<iterations; ii++) {
+	int_un c = a;  c *= c;
+      }
+      sqr = Now() - start;
+      if (mul+sqr > 0.2) break;
+      iterations *= 2;
+    }
+    printf("%6d  %12.2f  %10.2f\n", n, 
+	   mul/iterations*1e6, sqr/iterations*1e6);
+  }
+
+  cout << endl << "Radix conversion: OC_RADIX_DC_THRESHOLD=" 
+       << OC_RADIX_DC_THRESHOLD << " OC_NEWTON_DIV_THRESHOLD="
+       << OC_NEWTON_DIV_THRESHOLD << endl;
+  cout << "decimal digits  parse(s)  stringize(s)" << endl;
+  int digits[] = { 1000, 10000, 100000, 1000000 };
+  for (size_t dd=0; dd<sizeof(digits)/sizeof(digits[0]); dd++) {
+    string s;
+    for (int ii=0; ii<digits[dd]; ii++) s += char('1' + (ii*7)%9);
+    real_8 start = Now();
+    int_un a = StringToBigUInt(s);
+    real_8 parse = Now() - start;
+    start = Now();
+    string back = a.stringize();
+    real_8 print = Now() - start;
+    if (back!=s) cerr << "Conversion error!" << endl;
+    printf("%14d  %8.4f  %12.4f\n", digits[dd], parse, print);
+  }
+}
@@ -1,7 +1,7 @@
 
-// This timing test compares 4 different "comparable" implementations:
-// We compare the STL::map versus three "comparable" classes, The
-// HashTableT, AVLTreeT and AVLHashT.
+// This timing test compares 5 different "comparable" implementations:
+// We compare the STL::map versus four "comparable" classes, The
+// HashTableT, AVLTreeT, AVLHashT and FlatHashT.
 
 // ///////////////////////////////////////////// Defines
 
@@ -9,10 +9,13 @@
 // #define IMPL_HASH
 // #define IMPL_AVLTREE
 // #define IMPL_AVLHASH
+// #define IMPL_FLATHASH
 // #define IMPL_MAP
 
 // ///////////////////////////////////////////// Include Files
 
+#include "ocport.h"
+
 #if defined(IMPL_MAP)
 #  include <map>
    using std::map;
@@ -24,10 +27,12 @@
    using namespace std;
 
 #  include "ochashfunction.h"
+   OC_BEGIN_NAMESPACE
    inline unsigned long HashFunction (const string& s)
    {
     return OCStringHashFunction(s.data(), s.length());
    }
+   OC_END_NAMESPACE
    
 
 #else
@@ -39,10 +44,10 @@
 #endif
 
 
-#include "ocport.h"
 #include "ochashtablet.h"
 #include "ocavltreet.h"
 #include "ocavlhasht.h"
+#include "ocflathasht.h"
 
 
 
@@ -105,6 +110,8 @@ int main ()
       AVLTreeT<string,string,8> impl;
 #elif defined(IMPL_AVLHASH)
       AVLHashT<string,string,8> impl;
+#elif defined(IMPL_FLATHASH)
+      FlatHashT<string,string,8> impl;
 #elif defined(IMPL_MAP)
       map<string,string> impl;
 #endif
@@ -149,6 +156,8 @@ int main ()
       AVLTreeT<string,string,8> impl;
 #elif defined(IMPL_AVLHASH)
       AVLHashT<string,string,8> impl;
+#elif defined(IMPL_FLATHASH)
+      FlatHashT<string,string,8> impl;
 #elif defined(IMPL_MAP)
       map<string,string> impl;
 #endif
@@ -189,6 +198,68 @@ int main ()
       delete [] values;
     }
   }
+
+  // Lookups again, but in a random order, so the branch predictor
+  // can't learn the pattern of which keys come up next
+  {
+    const int probes = 4096;
+    int* probe = new int[probes];
+    for (int len = 1; len<1e4; len = len*2) {
+#if defined(IMPL_HASH)
+      HashTableT<string,string,8> impl; 
+#elif defined(IMPL_AVLTREE)
+      AVLTreeT<string,string,8> impl;
+#elif defined(IMPL_AVLHASH)
+      AVLHashT<string,string,8> impl;
+#elif defined(IMPL_FLATHASH)
+      FlatHashT<string,string,8> impl;
+#elif defined(IMPL_MAP)
+      map<string,string> impl;
+#endif
+
+      string key = "The quick brown fox jumped over the lazy dogs";
+      string value = "The quick brown fox jumped over the lazy dogs many many times";
+      string* keys = new string[len];
+      string* values = new string[len];
+      int ii;
+      for (ii=0; ii<len; ii++) {
+	keys[ii] = shift(key, ii);
+	values[ii] = shift(value, ii);
+      }
+      srand(len);
+      for (ii=0; ii<probes; ii++) {
+	probe[ii] = rand() % len;
+      }
+      
+      for (ii=0; ii<len; ii++) {
+#if defined(IMPL_MAP)
+	impl.insert(map<string,string>::value_type(keys[ii], values[ii]));
+#else
+	impl.insertKeyAndValue(keys[ii], values[ii]);
+#endif
+      }
+      MyTime start;
+      int pp = 0;
+      for (int jj=0; jj<numb; jj++) {
+	for (int kk=0; kk<len; kk++) {
+	  string& s = impl[keys[probe[pp]]];
+	  pp = (pp+1) & (probes-1);
+	}
+      }
+      MyTime end;
+      for (ii=0; ii<len; ii++) {
+#if defined(IMPL_MAP)
+	impl.erase(keys[ii]);
+#else 
+	impl.remove(keys[ii]);
+#endif
+      }
+      cerr << "Time for " << len << " random lookups (done " << numb << " times) = " << end - start << endl;
+      delete [] keys; 
+      delete [] values;
+    }
+    delete [] probe;
+  }
   
 }
 
@@ -0,0 +1,81 @@
+
+// This timing test copies (and destroys) Proxys from many threads at
+// once: each copy is an increment and decrement of the ref count.
+// Compare the atomic ref count (the default) with the old locking one:
+//
+//   g++ -O -I../include -DOC_NEW_STYLE_INCLUDES proxy_timing.cc -pthread
+//   g++ -O -I../include -DOC_NEW_STYLE_INCLUDES -DOC_LOCKED_REFCOUNT ...
+//
+// Usage: proxy_timing [copies_per_thread [max_threads]]
+
+// ///////////////////////////////////////////// Include Files
+
+#include "ocval.h"
+#include "octhread.h"
+#include <sys/time.h>
+#include <stdlib.h>
+
+#if defined(OC_FORCE_NAMESPACE)
+using namespace OC;
+#endif
+
+static double Now ()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+// Every thread copies the same (Locked) Proxy over and over
+struct CopyWork {
+  Proxy* shared;
+  int    copies;
+};
+
+void* CopyLoop (void* data)
+{
+  CopyWork* work = (CopyWork*)data;
+  for (int ii=0; ii<work->copies; ii++) {
+    Proxy copy(*work->shared);
+    Val v = copy;   // ... and once more inside a Val
+  }
+  return 0;
+}
+
+// ///////////////////////////////////////////// Main Program
+
+int main (int argc, char** argv)
+{
+  int copies = (argc>1) ? atoi(argv[1]) : 1000000;
+  int max_threads = (argc>2) ? atoi(argv[2]) : 8;
+
+#if defined(OC_ATOMIC_REFCOUNT)
+  cout << "Atomic ref counts" << endl;
+#else
+  cout << "Locked ref counts" << endl;
+#endif
+
+  const char* kinds[] = { "Locked", "Shared (process-shared lock)" };
+  for (int kind=0; kind<2; kind++) {
+    Proxy p = (kind==0) ? Locked(new Tab("{'a':1, 'b':2}")) :
+                          Proxy(new Tab("{'a':1, 'b':2}"), true, true, true);
+    cout << kinds[kind] << endl;
+    for (int threads=1; threads<=max_threads; threads*=2) {
+      Array<OCThread*> th(threads);
+      CopyWork work = { &p, copies };
+      double start = Now();
+      for (int ii=0; ii<threads; ii++) {
+	th.append(new OCThread("copier", false));
+	th[ii]->start(CopyLoop, &work);
+      }
+      for (int ii=0; ii<threads; ii++) {
+	th[ii]->join();
+	delete th[ii];
+      }
+      double elapsed = Now()-start;
+      cout << "  " << threads << " threads x " << copies << " copies: "
+	   << elapsed << " seconds ("
+	   << (elapsed*1e9)/(2.0*copies*threads) << " ns per copy)" << endl;
+    }
+  }
+}
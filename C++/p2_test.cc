@@ -1356,6 +1356,25 @@ int main ()
     
   }
 
+  // The pickling issues are a bit mask: conversion OR'd with
+  // ABOVE_PYTHON_2_2 converts, just like conversion on its own
+  {
+    Val v = Tup(1, OTab("o{'a':1}"));
+    PicklingIssues_e issues[] = { 
+      ABOVE_PYTHON_2_2, 
+      CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR,
+      PicklingIssues_e(ABOVE_PYTHON_2_2|CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR)
+    };
+    for (int ii=0; ii<3; ii++) {
+      Array<char> buff;
+      P2TopLevelDumpValToArray(v, buff, AS_LIST, issues[ii]);
+      Val res;
+      PickleLoader pl(buff.data(), buff.length());
+      pl.loads(res);
+      cout << "issues:" << int(issues[ii]) << " " << res.tag << ":" << res 
+	   << endl;
+    }
+  }
 
   return 0;
 }
@@ -131,6 +131,13 @@ static string OrderedDictPreambleAsString(OrderedDictPreamble,
 
 
 
+// When dumping into a growable buffer, room(n) makes sure there are at
+// least n+P2_DUMP_SLACK bytes left: the slack covers all the small,
+// fixed-size writes (opcodes, memos, preambles) between calls to room
+#ifndef P2_DUMP_SLACK
+# define P2_DUMP_SLACK 256
+#endif
+
 // The DumpContext allows use to keep a context of relevant variables
 // as we dump without using any globals
 struct DumpContext_ {
@@ -138,6 +145,15 @@ struct DumpContext_ {
   // The memory we are dumping to.
   char* mem;
 
+  // If dumping into a growable buffer (single pass, no BytesToDump
+  // first), the buffer and the end of its memory, and where it goes
+  // when full if streaming.
+#if defined(OC_USE_OC)
+  Array<char>* buffer;
+  char* end;
+  DumpSink* sink;
+#endif
+
   // Special cases for preambles for "special"s
   bool complex_preamble_dumped;
   int  complex_handle;
@@ -154,6 +170,8 @@ struct DumpContext_ {
   int  NumPyNDArray_handle;
   bool NumPyDtype_dumped;
   int  NumPyDtype_handle;
+  bool NumPyFromBuffer_dumped;
+  int  NumPyFromBuffer_handle;
 
   // Associate pointer handles (the key) with small, incremental
   // integer handles (the value).  As we serialize Proxies, we want to
@@ -168,14 +186,29 @@ struct DumpContext_ {
   // the length of the handles_array
   int_u4 current_handle;
 
-  // Current options which affect serialization
+  // Current options which affect serialization.  The issues given
+  // are a bit mask (see valprotocol2.h): pickling_issues only keeps
+  // the Python version (AS_PYTHON_2_2 or ABOVE_PYTHON_2_2), and
+  // compat_ is set by CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR, on its
+  // own or OR'd in.
   ArrayDisposition_e disposition;
   PicklingIssues_e pickling_issues;
 
   bool compat_; // true = perform conversion from OTabTupBigInt to TabArrStr;
 
+  // The pickling protocol: 2, or 4 and 5 (Python 3), where strings
+  // are str or bytes, memos are MEMOIZEs (so handles start at 0) and
+  // globals are STACK_GLOBALs.
+  int protocol;
+
+  // Protocol 5 only: if not 0, where the out-of-band buffers go
+#if defined(OC_USE_OC)
+  Array<PickleBuffer>* out_of_band;
+#endif
+
   // Create a handle context
-  DumpContext_ (char* m, ArrayDisposition_e dis, PicklingIssues_e issues) : 
+  DumpContext_ (char* m, ArrayDisposition_e dis, PicklingIssues_e issues,
+		int proto=2) : 
     mem(m), 
     complex_preamble_dumped(false), 
     complex_handle(-1),
@@ -191,11 +224,47 @@ struct DumpContext_ {
     NumPyNDArray_handle(-1),
     NumPyDtype_dumped(false),
       NumPyDtype_handle(-1),
-    current_handle(1),
+    NumPyFromBuffer_dumped(false),
+    NumPyFromBuffer_handle(-1),
+    current_handle(proto>=4 ? 0 : 1),
     disposition(dis),
-    pickling_issues(issues),
-    compat_(issues==CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR)
-  { }
+    pickling_issues(issues==AS_PYTHON_2_2 ? AS_PYTHON_2_2 : ABOVE_PYTHON_2_2),
+    compat_((issues & CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR)!=0),
+    protocol(proto)
+  { 
+#if defined(OC_USE_OC)
+    buffer = 0;
+    end = 0;
+    sink = 0;
+    out_of_band = 0;
+#endif
+  }
+
+  // Make sure there's room for bytes (plus the slack) more: only a
+  // growable buffer has to check, a plain char* was sized beforehand
+  void room (size_t bytes)
+  {
+#if defined(OC_USE_OC)
+    if (buffer && size_t(end-mem)<bytes+P2_DUMP_SLACK) {
+      OCGrowDumpBuffer_(*buffer, mem, end, bytes+P2_DUMP_SLACK, sink);
+    }
+#endif
+  }
+
+  // Copy a block of string or array data (leaving the slack after it)
+  void block (const void* data, size_t len)
+  {
+#if defined(OC_USE_OC)
+    if (sink) {
+      OCDumpBlock_(*buffer, mem, end, (const char*)data, len, sink);
+      room(0);
+      return;
+    }
+#endif
+    room(len);
+    memcpy(mem, data, len);
+    mem += len;
+  }
 }; // DumpContext_
 
 
@@ -205,6 +274,46 @@ struct DumpContext_ {
 inline void P2DumpCodeAndInt_ (int_u4 i4, char short_code, char long_code,
 			       DumpContext_& dc);
 
+// Memoize the top of the stack as the given handle: protocol 4 just
+// says MEMOIZE, which is always the next handle
+inline void P2DumpPut_ (int_u4 handle, DumpContext_& dc)
+{
+  if (dc.protocol>=4) {
+    *(dc.mem)++ = PY_MEMOIZE;
+  } else {
+    P2DumpCodeAndInt_(handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+  }
+}
+
+// Dump the GLOBAL of a preamble (c<module>\n<name>\n): protocol 4
+// says it as a STACK_GLOBAL of two strs, and Python 3 calls
+// __builtin__ builtins.
+inline void P2DumpGlobal_ (const char* preamble, int len, DumpContext_& dc)
+{
+  if (dc.protocol<4) {
+    memcpy(dc.mem, preamble, len);
+    dc.mem += len;
+    return;
+  }
+  const char* module = preamble+1;
+  const char* name = (const char*)memchr(module, '\n', len-1)+1;
+  int module_len = name-module-1;
+  int name_len = preamble+len-name-1;
+  if (module_len==11 && memcmp(module, "__builtin__", 11)==0) {
+    module = "builtins";
+    module_len = 8;
+  }
+  char* mem = dc.mem;
+  *mem++ = PY_SHORT_BINUNICODE;
+  *mem++ = char(module_len);
+  memcpy(mem, module, module_len); mem += module_len;
+  *mem++ = PY_SHORT_BINUNICODE;
+  *mem++ = char(name_len);
+  memcpy(mem, name, name_len); mem += name_len;
+  *mem++ = PY_STACK_GLOBAL;
+  dc.mem = mem;
+}
+
 #if defined(THE_IDEA_OF_THE_CODE)
 // ... it's the same code over and over for the different handles,
 // so we construct a macro 
@@ -246,9 +355,8 @@ int BytesPremableDumper(DumpContext_& dc)
 #define PREAMBLEDUMPERDEFINE(NAME) inline void PreambleDumper##NAME(DumpContext_& dc) { if (dc.NAME##_dumped) { \
      P2DumpCodeAndInt_(dc.NAME##_handle, PY_BINGET, PY_LONG_BINGET, dc); } \
   else { dc.NAME##_handle = dc.current_handle++; dc.NAME##_dumped = true; \
-    int len=sizeof(NAME##Preamble)-1; \
-    memcpy(dc.mem, NAME##Preamble, len); dc.mem += len; \
-    P2DumpCodeAndInt_(dc.NAME##_handle, PY_BINPUT, PY_LONG_BINPUT, dc); } }
+    P2DumpGlobal_(NAME##Preamble, sizeof(NAME##Preamble)-1, dc); \
+    P2DumpPut_(dc.NAME##_handle, dc); } }
 
 
 
@@ -277,6 +385,12 @@ BYTESPREAMBLEDUMPERDEFINE(NumPyDtype)
 PREAMBLEDUMPERDEFINE(NumPyDtype)
 
 
+// Define the GLOBAL dumper for a protocol 5 NumPy array (only ever
+// dumped in a single pass, so there's no BytesPreamble)
+static char NumPyFromBufferPreamble[] = "cnumpy.core.numeric\n_frombuffer\n";
+PREAMBLEDUMPERDEFINE(NumPyFromBuffer)
+
+
 
 inline void dumpString (const string& s, DumpContext_& dc);
 #if defined(OC_USE_OC) && !defined(OC_USE_OC_STRING)
@@ -435,9 +549,8 @@ inline void dump16ByteComplex (const complex_16& c16, DumpContext_& dc)
     dc.complex_preamble_dumped = true;
 
     // And copy in the original (plus a memo)
-    memcpy(dc.mem, ComplexPreamble, sizeof(ComplexPreamble)-1);
-    dc.mem += sizeof(ComplexPreamble)-1;
-    P2DumpCodeAndInt_(dc.complex_handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+    P2DumpGlobal_(ComplexPreamble, sizeof(ComplexPreamble)-1, dc);
+    P2DumpPut_(dc.complex_handle, dc);
   }
 
   if (dc.pickling_issues==AS_PYTHON_2_2) *(dc.mem)++ = '(';
@@ -473,14 +586,75 @@ inline void dumpBool (bool b, DumpContext_& dc)
 inline int BytesToDumpBool () { return 1+1; }
 
 
+// Is this legal UTF-8?  A Python 3 str has to be, bytes don't
+inline bool P2IsUTF8_ (const char* s, size_t len)
+{
+  const int_u1* u = (const int_u1*)s;
+  for (size_t ii=0; ii<len; ) {
+    int_u4 c = u[ii];
+    if (c<0x80) { ii++; continue; }
+    int follow;
+    int_u4 smallest;
+    if      ((c&0xE0)==0xC0) { follow = 1; smallest = 0x80;    c &= 0x1F; }
+    else if ((c&0xF0)==0xE0) { follow = 2; smallest = 0x800;   c &= 0x0F; }
+    else if ((c&0xF8)==0xF0) { follow = 3; smallest = 0x10000; c &= 0x07; }
+    else return false;
+    if (len-ii<=size_t(follow)) return false;
+    for (int jj=1; jj<=follow; jj++) {
+      if ((u[ii+jj]&0xC0)!=0x80) return false;
+      c = (c<<6) | (u[ii+jj]&0x3F);
+    }
+    if (c<smallest || c>0x10FFFF || (c>=0xD800 && c<=0xDFFF)) return false;
+    ii += follow+1;
+  }
+  return true;
+}
+
+// Helper: dump the code and length for a string, bytes, etc.,
+// choosing the 1, 4 or 8 byte length version (protocol 4 and up)
+inline void P2DumpLength_ (size_t len, char short_code, char long_code,
+			   char longest_code, DumpContext_& dc)
+{
+  if (len>0xFFFFFFFFULL) {
+    int_u8 len8 = len;
+    *(dc.mem)++ = longest_code;
+    DUMP_AS_LITTLE_ENDIAN8(len8, dc.mem);
+    dc.mem += 8;
+  } else {
+    P2DumpCodeAndInt_(int_u4(len), short_code, long_code, dc);
+  }
+}
+
+// Dump raw data: bytes in protocol 4 and up, a string otherwise
+inline void dumpRawBytes (const char* data, size_t len, DumpContext_& dc)
+{
+  if (dc.protocol>=4) {
+    P2DumpLength_(len, PY_SHORT_BINBYTES, PY_BINBYTES, PY_BINBYTES8, dc);
+  } else {
+    P2DumpCodeAndInt_(len, PY_SHORT_BINSTRING, PY_BINSTRING, dc);
+  }
+  dc.block(data, len);
+}
+
 inline void dumpCString (const char* cstr, int len, DumpContext_& dc)
 {
+  // Python 3 (protocol 4) has str and bytes rather than strings:
+  // it's a str if it can be
+  if (dc.protocol>=4) {
+    if (!P2IsUTF8_(cstr, len)) {
+      dumpRawBytes(cstr, len, dc);
+      return;
+    }
+    P2DumpLength_(len, PY_SHORT_BINUNICODE, PY_BINUNICODE, PY_BINUNICODE8, dc);
+    dc.block(cstr, len);
+    return;
+  }
+
   // Dump header for string
   P2DumpCodeAndInt_(len, PY_SHORT_BINSTRING, PY_BINSTRING, dc);
   
   // Put the string in memory
-  memcpy(dc.mem, cstr, len);
-  dc.mem+= len;
+  dc.block(cstr, len);
 }
 
 inline int BytesToDumpCString (const char* /*cstr*/, int bytes)
@@ -536,6 +710,69 @@ char* topleveldump_ (const OT& v, char* mem, ArrayDisposition_e dis,
   return dc.mem;
 }
 
+// Dump (like topleveldump_) onto the end of the buffer in a single
+// pass, growing the buffer as needed.  This (and topleveldumptosink_)
+// can also dump protocols 4 and 5.
+#if defined(OC_USE_OC)
+template <class OT>
+size_t topleveldumptoarray_ (const OT& v, Array<char>& buffer, 
+			     ArrayDisposition_e dis,
+			     PicklingIssues_e issues = ABOVE_PYTHON_2_2,
+			     int protocol = 2,
+			     Array<PickleBuffer>* out_of_band = 0)
+{
+  const size_t start = buffer.length();
+  buffer.expandTo(buffer.capacity());
+  DumpContext_ dc(buffer.data()+start, dis, issues, protocol);
+  dc.buffer = &buffer;
+  dc.end = buffer.data()+buffer.length();
+  dc.out_of_band = out_of_band;
+  dc.room(0);
+
+  if (issues!=AS_PYTHON_2_2) {
+    *(dc.mem)++ = PY_PROTO;     // Preamble:  PROTOCOL!!!
+    *(dc.mem)++ = char(protocol);
+  }
+  P2DumpValue(v, dc);
+  *(dc.mem)++ = PY_STOP;
+
+  buffer.expandTo(dc.mem-buffer.data());
+  return buffer.length()-start;
+}
+#endif
+
+// Dump (like topleveldump_) to the sink in a single pass, a chunk at
+// a time
+#if defined(OC_USE_OC)
+template <class OT>
+void topleveldumptosink_ (const OT& v, DumpSink& sink, 
+			  ArrayDisposition_e dis,
+			  PicklingIssues_e issues = ABOVE_PYTHON_2_2,
+			  size_t chunk_bytes = OC_DUMP_CHUNK,
+			  int protocol = 2,
+			  Array<PickleBuffer>* out_of_band = 0)
+{
+  // Every room() needs the slack to fit in the chunk
+  if (chunk_bytes<2*P2_DUMP_SLACK) chunk_bytes = 2*P2_DUMP_SLACK;
+  Array<char> chunk(chunk_bytes);
+  chunk.expandTo(chunk_bytes);
+  DumpContext_ dc(chunk.data(), dis, issues, protocol);
+  dc.buffer = &chunk;
+  dc.end = chunk.data()+chunk.length();
+  dc.sink = &sink;
+  dc.out_of_band = out_of_band;
+
+  if (issues!=AS_PYTHON_2_2) {
+    *(dc.mem)++ = PY_PROTO;     // Preamble:  PROTOCOL!!!
+    *(dc.mem)++ = char(protocol);
+  }
+  P2DumpValue(v, dc);
+  *(dc.mem)++ = PY_STOP;
+
+  sink.write(chunk.data(), dc.mem-chunk.data());
+}
+#endif
+
 template <class OT>
 int TopLevelBytesToDump (const OT& v, ArrayDisposition_e dis=AS_LIST,
 			 PicklingIssues_e issues = ABOVE_PYTHON_2_2)
@@ -10,6 +10,13 @@
 #include "m2pythontools.h"
 #include "ocnumerictools.h"
 
+// Lists start out empty (and get filled in by APPENDS), so we can't
+// know how big they'll be: give them room for a few elements in the
+// same allocation as the proxy (see InlineArr in ocproxy.h).
+#if !defined(PICKLELOADER_INLINE_ELEMENTS)
+#  define PICKLELOADER_INLINE_ELEMENTS 4
+#endif
+
 OC_BEGIN_NAMESPACE
 
 
@@ -30,6 +37,16 @@ class Stack {
     return impl_(len);
   }
 
+#if defined(OC_MOVE_SEMANTICS)
+  // Push a temporary: moved (not copied) onto the stack
+  T& push (T&& t)
+  {
+    int len = impl_.length();
+    impl_.append(std::move(t));
+    return impl_(len);
+  }
+#endif
+
   // Peek into the stack: 0 is the top, -1 is just below the top, etc.
   // Returns a reference to the element in question.
   T& peek (int where=0) 
@@ -66,6 +83,14 @@ class Stack {
 }; // Stack
 
 
+// NumPy 2 renamed numpy.core to numpy._core: pickles from either
+// use these to rebuild an array
+inline bool IsNumPyReconstruct_ (const Val& name)
+{
+  return name.tag=='a' && (name=="numpy.core.multiarray\n_reconstruct\n" ||
+			   name=="numpy._core.multiarray\n_reconstruct\n");
+}
+
 // Translate all instance of NumPy "classes" (Tuples with name, data)
 // to Array<POD>.  This is post-processing: we have to do things this
 // because of the way BUILD works: it changes a value INPLACE, and we
@@ -77,7 +102,7 @@ inline void TranslateForNumPyClassesToArray (Val& inplace_change)
     Tup& t = inplace_change;
     if (t.length()>=2) {
       Val& first = t(0);
-      if (first.tag=='a' && first=="numpy.core.multiarray\n_reconstruct\n") {
+      if (IsNumPyReconstruct_(first)) {
 	Val& data = t(1);
 	inplace_change = data;
 	return;	
@@ -139,12 +164,22 @@ inline void BuildScottFactoryFunction (const Val& type_object,
 
 
 // Example: ReduceFactoryFunction for OrderedDict: take a list of
-// 2-element Arrs
+// 2-element Arrs.  Python 3 gives no arguments instead (the items come
+// afterwards with SETITEMS), so that's just an empty table.
 inline void ReduceOTabFactory (const Val& /* name */,
 			       const Val& tuple, 
 	 		       Val& env, 
 			       Val& result)
 {  
+  if (tuple.length()==0) {
+    if (!env.contains("compatibility")) {
+      result = NewProxy<OTab>();
+    } else {
+      result = NewProxy<Tab>();
+    }
+    return;
+  }
+
   // Constructor is a 1-tuple which should have a list of 2-element arrs
   if (tuple.length()!=1) {
     throw runtime_error("Malformed OrderedDict constructor");
@@ -313,11 +348,14 @@ inline void ReduceArrayFactory (const Val& /* name */,
 // '\x80\x02cnumpy.core.multiarray\n_reconstruct\nq\x01cnumpy\nndarray\nq\x02K\x00\x85U\x01b\x87Rq\x03(K\x01K\x03\x85cnumpy\ndtype\nq\x04U\x02u4K\x00K\x01\x87Rq\x05(K\x03U\x01<NNNJ\xff\xff\xff\xffJ\xff\xff\xff\xffK\x00tb\x89U\x0c\x0f\x00\x00\x00\x10\x00\x00\x00\x11\x00\x00\x00tb.'
 
 
-#define NUMPYARRAYCREATE(T) { Val temp=new Array<T>(shape); Array<T>&a=temp; a.expandTo(shape); outdata=a.data(); memcpy(outdata, raw_data, raw_data_bytes); result.swap(temp); }
+// If adopt is given, the array takes over its memory (a protocol 5
+// out-of-band buffer) rather than copying the raw data.
+#define NUMPYARRAYCREATE(T) { Val temp=new Array<T>(adopt ? 0 : shape); Array<T>&a=temp; if (adopt) { adopt->giveMemoryTo(a); if (a.length()!=size_t(shape)) throw runtime_error("Out-of-band buffer is the wrong size for its NumPy array"); } else { a.expandTo(shape); memcpy(a.data(), raw_data, raw_data_bytes); } outdata=a.data(); result.swap(temp); }
 inline void dispatchCreateNumpyArray_ (int shape, const string& type_desc,
 				       const char* raw_data, int raw_data_bytes,
 				       const string& endian,
-				       Val& result)
+				       Val& result,
+				       Array<int_u1>* adopt=0)
 {
   // Parse type description field, usallu something like 'u4', 'i8',
   // where the first letter is the type, the next letter is the length of
@@ -390,10 +428,10 @@ inline void dispatchCreateNumpyArray_ (int shape, const string& type_desc,
 
 // helper for BUILD Numpy Array:
 // Any array we are given we flatten out to single dimensional (for now)
-inline int FlattenShape (const Val& tuple)
+inline int FlattenShape (const Val& tuple, int where=1)
 {
   // Handle shape
-  Val& described_shape = tuple(1);
+  Val& described_shape = tuple(where);
   int shape = 1;
   if (described_shape.tag == 'u') { // flatten!
     int len = described_shape.length();
@@ -435,7 +473,7 @@ inline void BUILDNumPyArray_ (Val& instance,
   
   // Handle raw data
   Val& vdata = tuple(4);
-  OCString* ocp = (OCString*) &vdata.u.s;
+  OCString* ocp = (OCString*) &vdata.u.a;
   const char* raw_data = ocp->data();
   const int raw_data_bytes = ocp->length();
 
@@ -485,6 +523,36 @@ inline void ReduceNumPyCoreMultiarray (const Val& type_object,
 }
 
 
+// REDUCE for a protocol 5 NumPy array: the tuple is (buffer, dtype,
+// shape, order), where the buffer is either the data itself (a
+// bytearray, in-band) or an out-of-band buffer (see
+// PickleLoader::outOfBand), whose memory becomes the Array's without
+// a copy.
+inline void ReduceNumPyFromBuffer (const Val& /* name */,
+				   const Val& tuple,
+				   Val& /* env */,
+				   Val& result)
+{
+  Tup& args = tuple;
+  if (args.length()<3) {
+    throw runtime_error("Malformed NumPy _frombuffer arguments");
+  }
+  Val& buffer = args(0);
+  const Val& dtype = args(1);
+  int shape = FlattenShape(tuple, 2);
+  string type_desc = dtype(1)(0);
+  string endian    = dtype(2)(1);
+  if (buffer.tag=='a') {
+    OCString* ocp = (OCString*)&buffer.u.a;
+    dispatchCreateNumpyArray_(shape, type_desc, ocp->data(), ocp->length(),
+			      endian, result);
+  } else {
+    Array<int_u1>& raw = buffer;
+    dispatchCreateNumpyArray_(shape, type_desc, 0, 0, endian, result, &raw);
+  }
+}
+
+
 // The DTYPE: can also be shared with GETS/PUTS, so better
 // if it's represented as a Proxy table which can 
 // be updated with a BUILD correctly.
@@ -525,26 +593,33 @@ inline void ReduceNumPyDtype (const Val& type_object,
 
 
 // The PickleLoader is an loader which will load any Protocol, just
-// like cPickle.loads(): 0 and 2 have been tested, the same
-// infrstaructure should support 1 and 3 later.
+// like cPickle.loads(): 0, 2, 4 and 5 have been tested, the same
+// infrstaructure should support 1 and 3.  Sets (EMPTY_SET,
+// FROZENSET) have no Val to go to, so they are not supported.
 class PickleLoader {
 
  public:
 
   // Construct a Pickleloader with the given input.
-  PickleLoader (const char* buffer, int len) :
+  PickleLoader (const char* buffer=0, int len=0) :
     env_(Tab()),
     input_(const_cast<char*>(buffer)),
     len_(len),
     where_(0),
-    noteProtocol_(0)
+    noteProtocol_(0),
+    buffers_(0),
+    nextBuffer_(0)
   {
     registry_["collections\nOrderedDict\n"]  = ReduceOTabFactory;
     registry_["Numeric\narray_constructor\n"]= ReduceNumericArrayFactory;
     registry_["array\narray\n"]              = ReduceArrayFactory;
     registry_["__builtin__\ncomplex\n"]      = ReduceComplexFactory;
+    registry_["builtins\ncomplex\n"]         = ReduceComplexFactory;
 
     registry_["numpy.core.multiarray\n_reconstruct\n"]    = ReduceNumPyCoreMultiarray;
+    registry_["numpy._core.multiarray\n_reconstruct\n"]   = ReduceNumPyCoreMultiarray;
+    registry_["numpy.core.numeric\n_frombuffer\n"]        = ReduceNumPyFromBuffer;
+    registry_["numpy._core.numeric\n_frombuffer\n"]       = ReduceNumPyFromBuffer;
     registry_["numpy\ndtype\n"]              = ReduceNumPyDtype;
   }
 
@@ -558,6 +633,8 @@ class PickleLoader {
     values_.clear();
     marks_.clear();
     memos_.clear();
+    pending_.clear();
+    nextBuffer_ = 0;
   }
 
   // Load and return the top value
@@ -566,6 +643,24 @@ class PickleLoader {
     TranslateForNumPyClassesToArray(return_value);
   }
 
+  // Push mode: rather than giving the whole pickle at once, give it
+  // to the loader a piece at a time as it comes in (from a
+  // non-blocking socket, say).  Every complete token is decoded as
+  // soon as it arrives (the value, mark and memo stacks are kept
+  // between calls), and a token split across pieces is held back
+  // until the rest of it shows up.  Returns true (with the value in
+  // return_value, just as loads would give) once the STOP has been
+  // seen, false if more is needed.  Anything past the STOP is kept
+  // for the next pickle: feed(0,0,v) to decode it.
+  //
+  //   PickleLoader pl;
+  //   while ((n=read(fd, buff, sizeof(buff)))>0) {
+  //     if (pl.feed(buff, n, v)) break;  
+  //   }
+  //
+  // If feed throws, reset the loader before using it again.
+  inline bool feed (const char* data, int len, Val& return_value);
+
   // Registering your own Python classes so they load correctly.
   // 
   // Most built-ins (Numeric, Array, complex) use the REDUCE method:
@@ -591,6 +686,16 @@ class PickleLoader {
   //   allowNumeric:  when seen, allows Numeric Arrays into POD Arrays
   Val& env () { return env_; }
 
+  // The out-of-band buffers for a protocol 5 pickle (what Python's
+  // pickle.loads(data, buffers=...) takes), used in order as the
+  // pickle asks for them.  A NumPy array takes over the memory of its
+  // buffer, so no data is copied: each buffer used is left empty.
+  // Any other buffer comes out as an Array<int_u1>.  The buffers are
+  // referenced, not adopted (0 means there are none), and every
+  // reset starts over at the first one.
+  void outOfBand (Array< Array<char> >* buffers) 
+  { buffers_ = buffers; nextBuffer_ = 0; }
+
  protected:
 
   // //// Data Members
@@ -626,16 +731,43 @@ class PickleLoader {
   char* input_;
   int len_;
   int where_;
+
+  // Push mode: what's been given to feed but not decoded yet (part
+  // of a token)
+  Array<char> pending_;
  
   // Note the protocol being used ... Not really used right now
   int noteProtocol_;
 
+  // Protocol 5 out-of-band buffers, if any, and the next one to use
+  Array< Array<char> >* buffers_;
+  size_t nextBuffer_;
+
   // ///// Methods
 
   // Keep pulling stuff off of input and final thing on top of stack
   // becomes result
   inline void decode_ (Val& result);
 
+  // Handle one token from the input: true when it's the STOP
+  inline bool token_ (char token);
+
+  // How many bytes (including the token) the next token takes up in
+  // the given input, or 0 if there isn't enough there to tell yet.
+  inline size_t tokenLength_ (const char* input, size_t len) const;
+
+  // Push mode: keep the given bytes, after anything already held back
+  void holdBack_ (const char* data, size_t len)
+  {
+    if (len==0) return;
+    const size_t had = pending_.length();
+    if (had+len > pending_.capacity()) {
+      pending_.resize(had+len < 2*had ? 2*had : had+len);
+    }
+    pending_.expandTo(had+len);
+    memcpy(pending_.data()+had, data, len);
+  }
+
   // Get the next character from input: may throw exception if at end
   // of buffer.
   inline 
@@ -724,6 +856,9 @@ class PickleLoader {
   // Get a 4 byte in from input: a length so int_u4
   inline int_u4 get4ByteInt_ ();
 
+  // Get an 8 byte length from input (protocol 4 and up)
+  inline size_t get8ByteLength_ ();
+
   // Routines to handle each input token
   inline void hMARK();
   inline void hFLOAT();
@@ -766,6 +901,12 @@ class PickleLoader {
   inline void hNEWFALSE();
   inline void hLONG1();
   inline void hLONG4();
+  inline void hBINSTRING8();
+  inline void hFRAME();
+  inline void hMEMOIZE();
+  inline void hSTACK_GLOBAL();
+  inline void hNEWOBJ_EX();
+  inline void hNEXT_BUFFER();
 
   inline void NOT_IMPLEMENTED (char c) { string ss; ss = c; throw runtime_error("Don't know how to handle "+ss); }
 
@@ -781,13 +922,21 @@ inline void PickleLoader::decode_ (Val& result)
   while (!done) {
     int in = getChar_();
     if (in==-1) break;  // End of input
-    char token = in;
+    done = token_(in);
+  }
+  // The final result is whatever is on top of the stack!
+  Val& top = values_.peek(0);
+  result.swap(top);
+}
+
+inline bool PickleLoader::token_ (char token)
+{
     //cerr << "TOKEN:" << token << endl;
     //cerr << "Values:"; values_.print(cerr) << endl;
     //cerr << "marks:";  marks_.print(cerr) << endl;
     switch (token) {
     case PY_MARK:             hMARK(); break;            // '('
-    case PY_STOP:             done = true; break;        // '.'
+    case PY_STOP:             return true;               // '.'
     case PY_POP:           NOT_IMPLEMENTED('0'); break; // '0'
     case PY_POP_MARK:      NOT_IMPLEMENTED('1'); break; // '1'
     case PY_DUP:           NOT_IMPLEMENTED('2'); break; // '2'
@@ -806,7 +955,10 @@ inline void PickleLoader::decode_ (Val& result)
     case PY_BINSTRING:        hBINSTRING(); break;       // 'T'
     case PY_SHORT_BINSTRING:  hSHORT_BINSTRING(); break; // 'U'  
     case PY_UNICODE:       NOT_IMPLEMENTED('V'); // 'V'
-    case PY_BINUNICODE:    NOT_IMPLEMENTED('X'); // 'X'
+      // UTF-8 strings and bytes both come in as Str
+    case PY_BINUNICODE:       hBINSTRING(); break;       // 'X'
+    case PY_BINBYTES:         hBINSTRING(); break;       // 'B'
+    case PY_SHORT_BINBYTES:   hSHORT_BINSTRING(); break; // 'C'
     case PY_APPEND:           hAPPEND(); break;          // 'a'
     case PY_BUILD:            hBUILD(); break;           // 'b'
     case PY_GLOBAL:           hGLOBAL(); break;          // 'c'
@@ -840,12 +992,108 @@ inline void PickleLoader::decode_ (Val& result)
     case PY_NEWFALSE: hNEWFALSE(); break; // '\x89' /* push False */
     case PY_LONG1:    hLONG1(); break; // '\x8a' /* push long from < 256 bytes */
     case PY_LONG4:    hLONG4(); break; // '\x8b' /* push really big long */
+      /* Protocol 4 */
+    case PY_SHORT_BINUNICODE: hSHORT_BINSTRING(); break; // '\x8c'
+    case PY_BINUNICODE8:      hBINSTRING8(); break;      // '\x8d'
+    case PY_BINBYTES8:        hBINSTRING8(); break;      // '\x8e'
+    case PY_EMPTY_SET: NOT_IMPLEMENTED('\x8f'); break;   // '\x8f'
+    case PY_ADDITEMS:  NOT_IMPLEMENTED('\x90'); break;   // '\x90'
+    case PY_FROZENSET: NOT_IMPLEMENTED('\x91'); break;   // '\x91'
+    case PY_NEWOBJ_EX:        hNEWOBJ_EX(); break;       // '\x92'
+    case PY_STACK_GLOBAL:     hSTACK_GLOBAL(); break;    // '\x93'
+    case PY_MEMOIZE:          hMEMOIZE(); break;         // '\x94'
+    case PY_FRAME:            hFRAME(); break;           // '\x95'
+      /* Protocol 5 */
+    case PY_BYTEARRAY8:       hBINSTRING8(); break;      // '\x96'
+    case PY_NEXT_BUFFER:      hNEXT_BUFFER(); break;     // '\x97'
+    case PY_READONLY_BUFFER:  break; // '\x98' nothing is readonly in a Val
     default: throw runtime_error("Unknown token");
     }
+    return false;
+}
+
+inline size_t PickleLoader::tokenLength_ (const char* input, size_t len) const
+{
+  if (len==0) return 0;
+  size_t newlines = 1; // most text tokens end with a newline
+  switch (input[0]) {
+  case PY_BININT1: case PY_BINGET: case PY_BINPUT: case PY_PROTO: return 2;
+  case PY_BININT2:                                                return 3;
+  case PY_BININT: case PY_LONG_BINGET: case PY_LONG_BINPUT:       return 5;
+  case PY_BINFLOAT: case PY_FRAME:                               return 9;
+
+  case PY_SHORT_BINSTRING: case PY_LONG1: 
+  case PY_SHORT_BINBYTES: case PY_SHORT_BINUNICODE:
+    return (len<2) ? 0 : 2+size_t(int_u1(input[1]));
+  case PY_BINSTRING: case PY_LONG4: 
+  case PY_BINBYTES: case PY_BINUNICODE: {
+    if (len<5) return 0;
+    int_u4 len4;
+    LOAD_FROM(int_u4, input+1, &len4);
+    return 5+size_t(len4);
+  }
+  case PY_BINBYTES8: case PY_BINUNICODE8: case PY_BYTEARRAY8: {
+    if (len<9) return 0;
+    int_u8 len8;
+    LOAD_FROM(int_u8, input+1, &len8);
+    return 9+size_t(len8);
+  }
+
+  case PY_GLOBAL: newlines = 2; // module\nname\n
+  case PY_FLOAT: case PY_INT: case PY_LONG: case PY_STRING:
+  case PY_GET: case PY_PUT: {
+    for (size_t ii=1; ii<len; ii++) {
+      if (input[ii]=='\n' && --newlines==0) return ii+1;
+    }
+    return 0;
+  }
+  default: return 1;  // everything else is just the token
   }
-  // The final result is whatever is on top of the stack!
-  Val& top = values_.peek(0);
-  result.swap(top);
+}
+
+inline bool PickleLoader::feed (const char* data, int len, Val& return_value)
+{
+  // Decode straight out of the given data, unless part of a token was
+  // held back last time
+  const bool held = pending_.length()!=0;
+  if (held) {
+    holdBack_(data, len);
+    input_ = pending_.data();
+    len_   = pending_.length();
+  } else {
+    input_ = const_cast<char*>(data);
+    len_   = len;
+  }
+  where_ = 0;
+
+  bool done = false;
+  while (!done) {
+    const size_t left = len_-where_;
+    const size_t need = tokenLength_(input_+where_, left);
+    if (need==0 || need>left) break;
+    done = token_(input_[where_++]);
+  }
+
+  // Whatever hasn't been decoded waits for the next feed
+  const size_t left = len_-where_;
+  if (held) {
+    memmove(pending_.data(), input_+where_, left);
+    pending_.expandTo(left);
+  } else {
+    holdBack_(input_+where_, left);
+  }
+  input_ = 0; len_ = where_ = 0;
+  if (!done) return false;
+
+  // Just like loads: the final result is on top of the stack
+  return_value = None;
+  return_value.swap(values_.peek(0));
+  TranslateForNumPyClassesToArray(return_value);
+  noteProtocol_ = 0;
+  values_.clear();
+  marks_.clear();
+  memos_.clear();
+  return true;
 }
 
 // Ugh, put this back into Arr
@@ -874,7 +1122,7 @@ inline void PickleLoader::hSHORT_BINSTRING ()
   char* start = advanceInput_(len);     // advance next few, but keep where was
   
   // TODO: A little sketchy, but it saves a copy
-  new (&s.u.a) OCString(start, len);
+  new (s.newSpace_(sizeof(OCString))) OCString(start, len);
   s.tag = 'a';
   //v = string(start, len);
 }
@@ -901,11 +1149,30 @@ inline void PickleLoader::hBINSTRING ()
   char* start_char = advanceInput_(len);
 
   // TODO: A little sketchy, but it saves a copy
-  new (&s.u.a) OCString(start_char, len);
+  new (s.newSpace_(sizeof(OCString))) OCString(start_char, len);
   s.tag = 'a';
   // s = string(start_char, len);
 }
 
+inline size_t PickleLoader::get8ByteLength_ ()
+{ 
+  int_u8 len8; 
+  char* current = advanceInput_(8);
+  LOAD_FROM(int_u8, current, &len8); 
+  if (len8 > int_u8(len_)) throw out_of_range("...past input for PickleLoader");
+  return size_t(len8);
+}
+
+inline void PickleLoader::hBINSTRING8 ()
+{
+  Val& s = values_.push(None);
+  size_t len = get8ByteLength_();
+  char* start_char = advanceInput_(int(len));
+
+  new (s.newSpace_(sizeof(OCString))) OCString(start_char, len);
+  s.tag = 'a';
+}
+
 inline void PickleLoader::hMARK ()
 {
   // Simulate a "mark" on Python stack with a meta value
@@ -925,6 +1192,18 @@ inline void PickleLoader::hGLOBAL ()
 }
 
 
+inline void PickleLoader::hSTACK_GLOBAL ()
+{
+  // Like GLOBAL, but the module and name are the top two strings on
+  // the stack: leave the same "module\nname\n" string in their place
+  Val& module = values_.peek(-1);
+  Val& name   = values_.peek(0);
+  string m = module;
+  string n = name;
+  module = m+"\n"+n+"\n";
+  values_.pop(1);
+}
+
 inline void PickleLoader::hREDUCE ()
 {
   // There are two things on the stack: a "global function name" and a
@@ -971,7 +1250,7 @@ inline void PickleLoader::hDICT ()
 
   // No actual dict value on stack at this point: it replaces the
   // first thing on the stack
-  Val v = new Tab();
+  Val v = NewProxy<Tab>();
   Tab& d = v;
 
   // For efficiency, swap the values in
@@ -1002,12 +1281,11 @@ inline void PickleLoader::hLIST ()
   int items_to_append = values_.length() - last_mark;
 
   // No actual tuple value on stack: it replaces the first thing on
-  // the stack
-  Val v = new Arr();
+  // the stack.  The Arr and its elements come from one allocation.
+  Val v = InlineArr(items_to_append);
   Arr& a = v;
 
   // For efficiency, swap the values in
-  a.resize(items_to_append);
   for (int ii=0; ii<items_to_append; ii++) {
     SwapIntoAppend(a,values_[last_mark+ii]);
   }
@@ -1025,9 +1303,10 @@ inline void PickleLoader::hLIST ()
 }
 
 // EMPY doesn't look at the mark, just plops on the stack.
-inline void PickleLoader::hEMPTY_DICT ()  { values_.push(new Tab()); }
-inline void PickleLoader::hEMPTY_LIST ()  { values_.push(new Arr()); }
-inline void PickleLoader::hEMPTY_TUPLE () { values_.push(new Tup()); }
+inline void PickleLoader::hEMPTY_DICT ()  { values_.push(NewProxy<Tab>()); }
+inline void PickleLoader::hEMPTY_LIST ()  
+{ values_.push(InlineArr(PICKLELOADER_INLINE_ELEMENTS)); }
+inline void PickleLoader::hEMPTY_TUPLE () { values_.push(InlineTup(0)); }
 
 
 inline void PickleLoader::hFLOAT () 
@@ -1075,6 +1354,14 @@ inline void PickleLoader::hLONG_BINPUT ()
   memos_[memo_number] = values_.peek();
 }
 
+inline void PickleLoader::hMEMOIZE ()
+{
+  // Like a PUT, but the memo number is just the next one
+  int_u4 memo_number = memos_.entries();
+  
+  memos_[memo_number] = values_.peek();
+}
+
 inline void PickleLoader::pushMemo_ (int memo_number)
 {
   Val& v = memos_(memo_number);
@@ -1126,13 +1413,20 @@ inline void PickleLoader::hAPPEND ()
 
 inline void PickleLoader::hSETITEM ()
 {
-  // Three items on stack: must be Tab, key, value
-  Tab& t = values_.peek(-2);
+  // Three items on stack: must be Tab (or an OTab, from an
+  // OrderedDict), key, value
+  Val& table = values_.peek(-2);
   Val& key = values_.peek(-1);
   Val& value = values_.peek(0);
   
   // insert key/value
-  t.swapInto(key, value);
+  if (table.tag=='o') {
+    OTab& o = table;
+    o.swapInto(key, value);
+  } else {
+    Tab& t = table;
+    t.swapInto(key, value);
+  }
 
   // Leave just Tab on stack
   values_.pop(2);
@@ -1141,8 +1435,9 @@ inline void PickleLoader::hSETITEM ()
 inline void PickleLoader::hTUPLE1 ()
 {
   Val& e0 = values_.peek(0);
-  Val t = new Tup(None);
-  t[0].swap(e0);
+  Val t = InlineTup(1);
+  Tup& u = t;
+  SwapIntoAppend(u.impl(), e0);
   t.swap(e0); // no pop: single element swap with value
 }
 
@@ -1150,9 +1445,10 @@ inline void PickleLoader::hTUPLE2 ()
 {
   Val& e0 = values_.peek(-1);
   Val& e1 = values_.peek(0);
-  Val t = new Tup(None, None);
-  t[0].swap(e0);
-  t[1].swap(e1);
+  Val t = InlineTup(2);
+  Tup& u = t;
+  SwapIntoAppend(u.impl(), e0);
+  SwapIntoAppend(u.impl(), e1);
   t.swap(e0);
 
   // Leave just tuple on stack
@@ -1164,10 +1460,11 @@ inline void PickleLoader::hTUPLE3 ()
   Val& e0 = values_.peek(-2);
   Val& e1 = values_.peek(-1);
   Val& e2 = values_.peek( 0);
-  Val t = new Tup(None, None, None);
-  t[0].swap(e0);
-  t[1].swap(e1);
-  t[2].swap(e2);
+  Val t = InlineTup(3);
+  Tup& u = t;
+  SwapIntoAppend(u.impl(), e0);
+  SwapIntoAppend(u.impl(), e1);
+  SwapIntoAppend(u.impl(), e2);
   t.swap(e0);
 
   // Leave just tuple on stack
@@ -1184,8 +1481,13 @@ inline void PickleLoader::hAPPENDS ()
   // the current length, and where the last mark was
   int items_to_append = values_.length() - last_mark;
 
-  // For efficiency, swap the values in
+  // For efficiency, swap the values in: make room for them all at
+  // once (but still grow geometrically for many APPENDS in a row)
   Arr& a = values_[last_mark-1];
+  const size_t needed = a.length() + items_to_append;
+  if (needed > a.capacity()) {
+    a.resize(needed < 2*a.capacity() ? 2*a.capacity() : needed);
+  }
   for (int ii=0; ii<items_to_append; ii++) {
     SwapIntoAppend(a, values_[last_mark+ii]);
   }
@@ -1204,9 +1506,17 @@ inline void PickleLoader::hSETITEMS ()
   int items_to_insert = values_.length() - last_mark;
 
   // For efficiency, swap the values in
-  Tab& t = values_[last_mark-1];
-  for (int ii=0; ii<items_to_insert; ii+=2) {
-    t.swapInto(values_[last_mark+ii], values_[last_mark+ii+1] );
+  Val& table = values_[last_mark-1];
+  if (table.tag=='o') {
+    OTab& o = table;
+    for (int ii=0; ii<items_to_insert; ii+=2) {
+      o.swapInto(values_[last_mark+ii], values_[last_mark+ii+1] );
+    }
+  } else {
+    Tab& t = table;
+    for (int ii=0; ii<items_to_insert; ii+=2) {
+      t.swapInto(values_[last_mark+ii], values_[last_mark+ii+1] );
+    }
   }
 
   // Once all the values are swapped into the array, pop 'em! Leaves
@@ -1245,6 +1555,15 @@ inline void PickleLoader::hNEWOBJ ()
 }
 
 
+inline void PickleLoader::hNEWOBJ_EX ()
+{
+  // Like NEWOBJ with keyword arguments on top: we have nowhere to put
+  // those, so drop them
+  values_.pop(1);
+  hNEWOBJ();
+}
+
+
 inline void PickleLoader::hTUPLE ()
 {
   // Find where top of the stack was at mark time
@@ -1255,13 +1574,12 @@ inline void PickleLoader::hTUPLE ()
   int items_to_append = values_.length() - last_mark;
 
   // No actual tuple value on stack: it replaces the first thing on
-  // the stack
-  Val v = new Tup();
+  // the stack.  The Tup and its elements come from one allocation.
+  Val v = InlineTup(items_to_append);
   Tup& u = v;
 
   // For efficiency, swap the values in
   Array<Val>& a = u.impl();
-  a.resize(items_to_append);
   for (int ii=0; ii<items_to_append; ii++) {
     SwapIntoAppend(a,values_[last_mark+ii]);
   }
@@ -1320,6 +1638,25 @@ inline void PickleLoader::hLONG4 ()
 inline void PickleLoader::hNONE ()     { values_.push(None); }
 
 
+inline void PickleLoader::hFRAME ()
+{
+  // Frames only group the tokens for Python's reader: skip the length
+  advanceInput_(8);
+}
+
+inline void PickleLoader::hNEXT_BUFFER ()
+{
+  if (buffers_==0 || nextBuffer_>=buffers_->length()) {
+    throw runtime_error("pickle stream refers to out-of-band data "
+			"but not enough buffers were given");
+  }
+  // The buffer's memory moves into the Val: no copy
+  Val& v = values_.push(Array<int_u1>());
+  Array<int_u1>& a = v;
+  (*buffers_)[nextBuffer_++].giveMemoryTo(a);
+}
+
+
 inline void PickleLoader::hBININT () 
 {   // 'J' -2**31 to 2**31-1
   char* start = advanceInput_(4);
@@ -36,6 +36,25 @@ Val Loading (const char* str, const Val& expected, int len=-1,
     if (v.tag=='n') cout << v.subtype;
     cout << "'" << expected << endl;
   }
+
+  // The same pickle given to a push mode loader a piece at a time
+  // should load exactly the same
+  if (!ssf && len && str[len-1]=='.') {
+    for (int piece=1; piece<=5; piece+=4) {
+      PickleLoader push;
+      push.env()["supportsNumeric"] = true;
+      Val pv;
+      bool done = false;
+      for (int ii=0; ii<len && !done; ii+=piece) {
+	done = push.feed(str+ii, (len-ii<piece) ? len-ii : piece, pv);
+      }
+      if (!done || (pv!=v && string(v)!="nan") || pv.tag!=v.tag) {
+	cout << "Oops! Push mode (pieces of " << piece << ") saw " << pv 
+	     << endl;
+	throw runtime_error("Unexpected");
+      }
+    }
+  }
   return v;
 }
 
@@ -675,4 +694,70 @@ int main ()
   resultme = Loading("\x80\x02}q\x01(U\001acnumpy.core.multiarray\n_reconstruct\nq\002cnumpy\nndarray\nq\x03K\x00\x85U\001b\x87Rq\x04(K\x01K\x01\x85\x63numpy\ndtype\nq\x05U\x02i4K\x00K\x01\x87Rq\x06(K\x03U\x01<NNNJ\xff\xff\xff\xffJ\xff\xff\xff\xffK\x00tb\x89U\x04\x01\x00\x00\x00tbU\001bh\x02h\x03K\x00\x85U\001b\x87Rq\x07(K\x01K\x01\x85h\x06\x89U\x04\x01\x00\x00\x00tbu.", 
 		     shar1, 175);
   cout << is(resultme["a"], resultme["b"]) << endl;
+
+  cout << "**Protocols 4 and 5 (from Python 3)" << endl;
+  Loading("\x80\x04\x95*\x00\x00\x00\x00\x00\x00\x00}\x94(\x8c\x01" "a\x94K\x01\x8c\x01" "b\x94]\x94(K\x02G@\x08\x00\x00\x00\x00\x00\x00" "e\x8c\x01" "c\x94\x8c\x05three\x94u.", 
+	  Tab("{'a':1, 'b':[2,3.0], 'c':'three'}"), 53);
+  Loading("\x80\x05\x95*\x00\x00\x00\x00\x00\x00\x00}\x94(\x8c\x01" "a\x94K\x01\x8c\x01" "b\x94]\x94(K\x02G@\x08\x00\x00\x00\x00\x00\x00" "e\x8c\x01" "c\x94\x8c\x05three\x94u.", 
+	  Tab("{'a':1, 'b':[2,3.0], 'c':'three'}"), 53);
+  Loading("\x80\x04\x95" "8\x00\x00\x00\x00\x00\x00\x00\x8c\x0b" "collections\x94\x8c\x0bOrderedDict\x94\x93\x94)R\x94(\x8c\x01z\x94K\x01\x8c\x01" "a\x94K\x01\x8c\x03two\x94\x86\x94u.",
+	  OTab("o{'z':1, 'a':(1,'two')}"), 67);
+  Loading("\x80\x04\x95\x07\x00\x00\x00\x00\x00\x00\x00" "C\x03\xff\x00\x01\x94.", 
+	  Val(string("\xff\x00\x01", 3)), 18);
+  Loading("\x80\x04\x95" "B\x00\x00\x00\x00\x00\x00\x00\x8a\x0b\x15_\x04|\x9f\xb1\xe3\xf2\xfd\x1e" "fJ\xff\xff\xff\xff\x8c\x08" "builtins\x94\x8c\x07" "complex\x94\x93\x94G\x3f\xf0\x00\x00\x00\x00\x00\x00G@\x00\x00\x00\x00\x00\x00\x00\x86\x94R\x94\x87\x94.",
+	  Tup(StringToBigInt("123456789123456789123456789"), -1, 
+	      complex_16(1,2)), 77);
+  Loading("\x80\x04\x95\x95\x00\x00\x00\x00\x00\x00\x00\x8c\x16numpy._core.multiarray\x94\x8c\x0c_reconstruct\x94\x93\x94\x8c\x05numpy\x94\x8c\x07ndarray\x94\x93\x94K\x00\x85\x94" "C\x01" "b\x94\x87\x94R\x94(K\x01K\x03\x85\x94h\x03\x8c\x05" "dtype\x94\x93\x94\x8c\x02i4\x94\x89\x88\x87\x94R\x94(K\x03\x8c\x01<\x94NNNJ\xff\xff\xff\xffJ\xff\xff\xff\xffK\x00t\x94" "b\x89" "C\x0c\x0f\x00\x00\x00\x10\x00\x00\x00\x11\x00\x00\x00\x94t\x94" "b.",
+	  r22, 160);
+  Loading("\x80\x05\x95\x80\x00\x00\x00\x00\x00\x00\x00\x8c\x13numpy._core.numeric\x94\x8c\x0b_frombuffer\x94\x93\x94(\x96\x0c\x00\x00\x00\x00\x00\x00\x00\x0f\x00\x00\x00\x10\x00\x00\x00\x11\x00\x00\x00\x94\x8c\x05numpy\x94\x8c\x05" "dtype\x94\x93\x94\x8c\x02i4\x94\x89\x88\x87\x94R\x94(K\x03\x8c\x01<\x94NNNJ\xff\xff\xff\xffJ\xff\xff\xff\xffK\x00t\x94" "bK\x03\x85\x94\x8c\x01" "C\x94t\x94R\x94.",
+	  r22, 139);
+
+  cout << "**Protocol 5, out-of-band buffer" << endl;
+  {
+    const char oob[] = "\x80\x05\x95r\x00\x00\x00\x00\x00\x00\x00}\x94\x8c\x01x\x94\x8c\x13numpy._core.numeric\x94\x8c\x0b_frombuffer\x94\x93\x94(\x97\x8c\x05numpy\x94\x8c\x05" "dtype\x94\x93\x94\x8c\x02i4\x94\x89\x88\x87\x94R\x94(K\x03\x8c\x01<\x94NNNJ\xff\xff\xff\xffJ\xff\xff\xff\xffK\x00t\x94" "bK\x03\x85\x94\x8c\x01" "C\x94t\x94R\x94s.";
+    Array< Array<char> > buffers;
+    buffers.append(Array<char>());
+    for (int ii=15; ii<18; ii++) {
+      int_4 little = ii;  // little-endian, like the test machines
+      for (size_t jj=0; jj<sizeof(little); jj++) {
+	buffers[0].append(((char*)&little)[jj]);
+      }
+    }
+    const char* data = buffers[0].data();
+    PickleLoader pl(oob, sizeof(oob)-1);
+    pl.outOfBand(&buffers);
+    Val v;
+    pl.loads(v);
+    Array<int_4>& a = v("x");
+    cout << v << " " << (a==r22) << " copied:" << ((char*)a.data()!=data) 
+	 << " left:" << buffers[0].length() << endl;
+    try {
+      PickleLoader none(oob, sizeof(oob)-1);
+      none.loads(v);
+    } catch (const exception& e) {
+      cout << "Expected error: no buffers given" << endl;
+    }
+  }
+
+  cout << "**Push mode: a stream of pickles, split anywhere" << endl;
+  {
+    const char stream[] = "\x80\x02}q\x01(U\001aK\x01U\001b]q\x02(K\x02G@\x08\x00\x00\x00\x00\x00\x00" "eu.(lp1\nS'two'\np2\nag2\na.\x80\x02N.";
+    const int len = sizeof(stream)-1;
+    for (int split=0; split<=len; split+=7) {
+      PickleLoader push;
+      Val v;
+      Arr results;
+      if (push.feed(stream, split, v)) results.append(v);
+      for (bool more = push.feed(stream+split, len-split, v); more; 
+	   more = push.feed(0, 0, v)) {
+	results.append(v);
+      }
+      if (split==0 || split+7>len) cout << split << ":" << results << endl;
+      if (results.length()!=3) cout << "Oops! " << split << ":" << results << endl;
+    }
+    PickleLoader push;
+    Val v;
+    cout << push.feed("(lp1\nS'par", 10, v) << push.feed("tial'\n", 6, v) 
+	 << push.feed("a", 1, v) << push.feed(".", 1, v) << " " << v << endl;
+  }
 }
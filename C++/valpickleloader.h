@@ -9,23 +9,23 @@
 
 // Defines: we do this to preserve speed 
 
-#define INSERT_STRING(s,start,len) new (&s.u.a) OCString(start, len); s.tag = 'a';   // TODO: A little sketchy, but it saves a copy
+#define INSERT_STRING(s,start,len) new (s.newSpace_(sizeof(OCString))) OCString(start, len); s.tag = 'a';   // TODO: A little sketchy, but it saves a copy
 
 # define NONE_VALUE                  None
 # define CHEAP_VALUE                 None
-# define MAKE_DICT()                 new Tab()
+# define MAKE_DICT()                 NewProxy<Tab>()
 # define EXTRACT_DICT(DICTNAME, ov)  Tab& DICTNAME = (ov)
 # define DICT_CONTAINS(D,VALUE)      (D).contains(VALUE) 
 # define DICT_GET(D,VALUE)           D(VALUE)
 
-# define MAKE_LIST()                 new Arr()
+# define MAKE_LIST()                 NewProxy<Arr>()
 # define MAKE_LIST1(EXPECT_LEN)      new Arr(EXPECT_LEN)
 # define EXTRACT_LIST(LISTNAME, ov)  Arr& LISTNAME = (ov)
 # define LIST_SUB(LIST, I)           LIST(I)
 # define LIST_LENGTH(LIST)           LIST.length()
 
 # define MAKE_OBJ_FROM_NUMBER(N)     N
-# define MAKE_TUP0()                 new Tup()
+# define MAKE_TUP0()                 NewProxy<Tup>()
 # define MAKE_TUP1(A)                new Tup(A)
 # define MAKE_TUP2(A,B)              new Tup(A,B)
 # define MAKE_TUP3(A,B,C)            new Tup(A,B,C)
@@ -1,5 +1,6 @@
 
 #include "valprotocol2.h"
+#include "ocdumpsink.h"  // OCGrowDumpBuffer_, DumpSink
 #include <stdint.h>
 
 PTOOLS_BEGIN_NAMESPACE
@@ -48,6 +49,49 @@ char* P2DumpVal (const Val& v, char* mem,
 		 PicklingIssues_e issues)
 { return P2DumpSingleVal(v, mem, dis, issues); }
 
+size_t P2TopLevelDumpValToArray (const Val& v, Array<char>& buffer,
+				 ArrayDisposition_e dis,
+				 PicklingIssues_e issues)
+{ return topleveldumptoarray_(v, buffer, dis, issues); }
+
+void P2TopLevelDumpValToSink (const Val& v, DumpSink& sink,
+			      ArrayDisposition_e dis,
+			      PicklingIssues_e issues, size_t chunk_bytes)
+{ topleveldumptosink_(v, sink, dis, issues, chunk_bytes); }
+
+// There's always a PROTO for protocol 4 and 5: asking for conversion
+// (with or without ABOVE_PYTHON_2_2) becomes
+// CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR, which always gets a PROTO.
+static PicklingIssues_e P4Issues_ (int protocol, PicklingIssues_e issues)
+{
+  if (protocol<4 || protocol>5) {
+    throw runtime_error("P4TopLevelDump only knows pickling protocols 4 and 5");
+  }
+  return (int(issues) & int(CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR)) ? 
+    CONVERT_OTAB_TUP_ARR__TO__TAB_ARR_STR : ABOVE_PYTHON_2_2;
+}
+
+size_t P4TopLevelDumpValToArray (const Val& v, Array<char>& buffer,
+				 int protocol, ArrayDisposition_e dis,
+				 PicklingIssues_e issues,
+				 Array<PickleBuffer>* out_of_band)
+{ 
+  issues = P4Issues_(protocol, issues);
+  if (protocol<5) out_of_band = 0;
+  return topleveldumptoarray_(v, buffer, dis, issues, protocol, out_of_band); 
+}
+
+void P4TopLevelDumpValToSink (const Val& v, DumpSink& sink,
+			      int protocol, ArrayDisposition_e dis,
+			      PicklingIssues_e issues,
+			      Array<PickleBuffer>* out_of_band, 
+			      size_t chunk_bytes)
+{ 
+  issues = P4Issues_(protocol, issues);
+  if (protocol<5) out_of_band = 0;
+  topleveldumptosink_(v, sink, dis, issues, chunk_bytes, protocol, out_of_band);
+}
+
 int P2TopLevelBytesToDumpVal (const Val& v, ArrayDisposition_e dis,
 			      PicklingIssues_e issues)
 { return TopLevelBytesToDump(v, dis, issues); }
@@ -71,7 +115,7 @@ void MemoizeSelf_ (void* ptr_handle, DumpContext_& dc)
 {
   int_u4 int_handle = dc.current_handle++;
   dc.handles[ptr_handle] = int_handle;
-  P2DumpCodeAndInt_(int_handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+  P2DumpPut_(int_handle, dc);
 }
 
 int_u4 BytesToMemoizeSelf_ (void* ptr_handle, DumpContext_& dc)
@@ -81,8 +125,8 @@ int_u4 BytesToMemoizeSelf_ (void* ptr_handle, DumpContext_& dc)
   return (int_handle<256) ? 2 : 5;
 }
 
-#define P2PLAINARRAYDUMP(T, FUN) { Array<T>&ap=*(Array<T>*)arr_data; int len=ap.length(); T*d=ap.data(); for (int ii=0;ii<len;ii++) { FUN(d[ii], dc); } }
-#define P2PLAINARRAYDUMP2(T, FUN, ARG) { Array<T>&ap=*(Array<T>*)arr_data; int len=ap.length(); T*d=ap.data(); for (int ii=0;ii<len;ii++) { FUN(d[ii], dc, ARG); } }
+#define P2PLAINARRAYDUMP(T, FUN) { Array<T>&ap=*(Array<T>*)arr_data; int len=ap.length(); T*d=ap.data(); for (int ii=0;ii<len;ii++) { dc.room(0); FUN(d[ii], dc); } dc.room(0); }
+#define P2PLAINARRAYDUMP2(T, FUN, ARG) { Array<T>&ap=*(Array<T>*)arr_data; int len=ap.length(); T*d=ap.data(); for (int ii=0;ii<len;ii++) { dc.room(0); FUN(d[ii], dc, ARG); } dc.room(0); }
 // The user doesn't have Numeric installed and Array is an older version
 // of python that doesn't work (!), so we have to be able to give them
 // back something:  an Array of Val.
@@ -247,9 +291,8 @@ inline void dumpArray_ (void* arr_data, char subtype, DumpContext_& dc,
       dc.array_preamble_dumped = true;
 
       // Then dump it (with memo to annotate it)
-      memcpy(dc.mem, ArrayPreamble, sizeof(ArrayPreamble)-1);
-      dc.mem += sizeof(ArrayPreamble)-1;
-      P2DumpCodeAndInt_(dc.array_handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+      P2DumpGlobal_(ArrayPreamble, sizeof(ArrayPreamble)-1, dc);
+      P2DumpPut_(dc.array_handle, dc);
     }
 
     // Same layout, regardless of type.
@@ -259,7 +302,7 @@ inline void dumpArray_ (void* arr_data, char subtype, DumpContext_& dc,
 
     // Dump the format before the data
     dumpCString(c, 1, dc);
-    dumpCString(dat, ap->length()*sz, dc);
+    dumpRawBytes(dat, ap->length()*sz, dc);
     *(dc.mem)++ = PY_TUPLE2;
     *(dc.mem)++ = PY_REDUCE;
     if (memoize_self)  MemoizeSelf_(memoize_self, dc); 
@@ -320,12 +363,18 @@ void dumpNumericHelp_(PT*, T*, const char*c, DumpContext_& dc, void* arr_data)
   int len = elements*sizeof(PT);
   P2DumpCodeAndInt_(len, PY_SHORT_BINSTRING, PY_BINSTRING, dc);
 
-  // Dump actual data for string
-  PT* sm=(PT*)dc.mem;
-  for (int ii=0; ii<elements; ii++) {
-    sm[ii] = od[ii];
+  // Dump actual data for string: a piece at a time, so a streaming
+  // dump never needs all of it in its chunk
+  const int piece = 1024;
+  for (int start=0; start<elements; start+=piece) {
+    const int n = (elements-start<piece) ? elements-start : piece;
+    dc.room(n*sizeof(PT));
+    PT* sm=(PT*)dc.mem;
+    for (int ii=0; ii<n; ii++) {
+      sm[ii] = od[start+ii];
+    }
+    dc.mem += n*sizeof(PT);
   }
-  dc.mem += len;
 }
 
 // If someone is using XMPY, they may want their Numeric Arrays
@@ -351,9 +400,8 @@ void dumpNumericArray_ (void* arr_data, char subtype, DumpContext_& dc,
     dc.numeric_preamble_dumped = true;
 
     // Dump the original data
-    memcpy(dc.mem, NumericPreamble, sizeof(NumericPreamble)-1);
-    dc.mem += sizeof(NumericPreamble)-1;
-    P2DumpCodeAndInt_(dc.numeric_handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+    P2DumpGlobal_(NumericPreamble, sizeof(NumericPreamble)-1, dc);
+    P2DumpPut_(dc.numeric_handle, dc);
   } 
 
 
@@ -464,6 +512,42 @@ string ValToNumPyCode (char subtype)
   }
 }
 
+// Dump the dtype for a NumPy array of the given type
+void dumpNumPyDtype_ (char subtype, DumpContext_& dc)
+{
+  // Initial args to a "prototype" dtype
+  PreambleDumperNumPyDtype(dc);
+  string numpy_code = ValToNumPyCode(subtype);
+  Tup dtype_initial(numpy_code, 0, 1);
+  P2DumpValue(dtype_initial, dc);
+  *(dc.mem)++ = PY_REDUCE;
+
+  // Tuple of arguments that get applied to "prototype" dtype BUILD
+  string endian = ByteLength(subtype)==1 ? "|" : IsLittleEndian() ? "<" : ">";
+  Tup dtype_args(3, endian, None, None, None, -1, -1, 0);
+  P2DumpValue(dtype_args, dc);
+  *(dc.mem)++ = PY_BUILD;
+}
+
+// Protocol 5 with out-of-band buffers: the array is
+// _frombuffer(buffer, dtype, shape, 'C'), and the buffer is just a
+// pointer to the Array's data (no copy)
+void dumpNumPyFromBuffer_ (Array<char>* ap, char subtype, DumpContext_& dc,
+			   void* memoize_self)
+{
+  PreambleDumperNumPyFromBuffer(dc);
+  *(dc.mem)++ = PY_MARK;
+  *(dc.mem)++ = PY_NEXT_BUFFER;
+  PickleBuffer pb = { ap->data(), ByteLength(subtype)*ap->length() };
+  dc.out_of_band->append(pb);
+  dumpNumPyDtype_(subtype, dc);
+  P2DumpValue(Tup(int(ap->length())), dc);
+  dumpCString("C", 1, dc);
+  *(dc.mem)++ = PY_TUPLE;
+  *(dc.mem)++ = PY_REDUCE;
+  if (memoize_self) { MemoizeSelf_(memoize_self, dc); }
+}
+
 // If someone is using XMPY, they may want their Numeric Arrays
 void dumpNumPyArray_ (void* arr_data, char subtype, DumpContext_& dc,
 		      void* memoize_self)
@@ -482,6 +566,11 @@ void dumpNumPyArray_ (void* arr_data, char subtype, DumpContext_& dc,
   Array<char>* ap = (Array<char>*)arr_data;  
   int shape = ap->length();
 
+  if (dc.out_of_band) {
+    dumpNumPyFromBuffer_(ap, subtype, dc, memoize_self);
+    return;
+  }
+
   // PY_GLOBAL reconstruct ...  
   PreambleDumperNumPyReconstruct(dc);
 
@@ -500,27 +589,14 @@ void dumpNumPyArray_ (void* arr_data, char subtype, DumpContext_& dc,
     P2DumpValue(Tup(shape), dc);
 
     // Starting DTYPE
-    {
-      // Initial args to a "prototype" dtype
-      PreambleDumperNumPyDtype(dc);
-      string numpy_code = ValToNumPyCode(subtype);
-      Tup dtype_initial(numpy_code, 0, 1);
-      P2DumpValue(dtype_initial, dc);
-      *(dc.mem)++ = PY_REDUCE;
-
-      // Tuple of arguments that get applied to "prototype" dtype BUILD
-      string endian = ByteLength(subtype)==1 ? "|" : IsLittleEndian() ? "<" : ">";
-      Tup dtype_args(3, endian, None, None, None, -1, -1, 0);
-      P2DumpValue(dtype_args, dc);
-      *(dc.mem)++ = PY_BUILD;
-    }
+    dumpNumPyDtype_(subtype, dc);
     // Assertion: Dtype top thing on values stack
 
     *(dc.mem)++ = PY_NEWFALSE;
 
     // Dump the actual data
     const char* raw_data = ap->data();
-    dumpCString(raw_data, ByteLength(subtype)*ap->length(), dc);
+    dumpRawBytes(raw_data, ByteLength(subtype)*ap->length(), dc);
     
     *(dc.mem)++ = PY_TUPLE;
   }
@@ -628,9 +704,8 @@ inline void P2DumpOTab (const OTab& t, DumpContext_& dc, void* memoize_self)
     dc.ordereddict_preamble_dumped = true;
 
     // Dump the original data
-    memcpy(dc.mem, OrderedDictPreamble, sizeof(OrderedDictPreamble)-1);
-    dc.mem += sizeof(OrderedDictPreamble)-1;
-    P2DumpCodeAndInt_(dc.ordereddict_handle, PY_BINPUT, PY_LONG_BINPUT, dc);
+    P2DumpGlobal_(OrderedDictPreamble, sizeof(OrderedDictPreamble)-1, dc);
+    P2DumpPut_(dc.ordereddict_handle, dc);
   } 
 
   const int len = t.entries();
@@ -777,8 +852,7 @@ inline void P2DumpBigInt (const int_n& i, DumpContext_& dc, void* memoize_self)
     int_u1 small_len = int_u1(len);
     *(dc.mem)++ = small_len;
   }
-  memcpy(dc.mem, s.data(), len);
-  dc.mem += len;
+  dc.block(s.data(), len);
   if (memoize_self) MemoizeSelf_(memoize_self, dc);
 }
 
@@ -848,13 +922,13 @@ inline void P2DumpProxy (const Proxy& p, DumpContext_& dc)
   // Dump what the proxy points to as normal (but force the label
   // where appropriate)
   if (p.tag=='t') { 
-    Tab& t = p;  
+    const Tab& t = *(Tab*)p.data_();
     P2DumpTab(t, dc, ptr_handle); // Memoize happens in here
   } else if (p.tag=='o') { 
-    OTab& ot = p;  
+    const OTab& ot = *(OTab*)p.data_();
     P2DumpOTab(ot, dc, ptr_handle); // Memoize happens in here
   } else if (p.tag=='u') { 
-    Tup& t = p;  
+    const Tup& t = *(Tup*)p.data_();
     P2DumpTup(t, dc, ptr_handle); // Memoize happens in here
 
   } else if (p.tag=='n') {
@@ -891,13 +965,13 @@ inline int BytesToDumpProxy (const Proxy& p, DumpContext_& dc)
 
   // Bytes to dump?
   if (p.tag=='t') {
-    Tab& t = p;  
+    const Tab& t = *(Tab*)p.data_();
     bytes += BytesToDumpTab(t, dc, ptr_handle);
   } else if (p.tag=='o') {
-    OTab& ot = p;  
+    const OTab& ot = *(OTab*)p.data_();
     bytes += BytesToDumpOTab(ot, dc, ptr_handle);
   } else if (p.tag=='u') {
-    Tup& t = p;  
+    const Tup& t = *(Tup*)p.data_();
     bytes += BytesToDumpTup(t, dc, ptr_handle);
 
   } else if (p.tag=='n') {
@@ -928,7 +1002,10 @@ inline int BytesToDumpProxy (const Proxy& p, DumpContext_& dc)
 // Generic dump
 inline void P2DumpValue (const Val& v, DumpContext_& dc)
 {
-  if (IsProxy(v)) { Proxy*pp=(Proxy*)&v.u.P; P2DumpProxy(*pp, dc); return; }
+  // Growable buffers: room for this value's opcodes (and, on the way
+  // out, for the container it's in to finish up)
+  dc.room(0);
+  if (IsProxy(v)) { Proxy*pp=(Proxy*)&v.u.P; P2DumpProxy(*pp, dc); dc.room(0); return; }
 
   switch(v.tag) {
 
@@ -972,7 +1049,7 @@ inline void P2DumpValue (const Val& v, DumpContext_& dc)
   case 'Z' : *(dc.mem)++ = 'N'; break;
   default:  p2error_("Unknown type in dump");
   }
-
+  dc.room(0);
 }
 
 // Note that these are all over estimates by a few bytes 
@@ -1050,7 +1127,7 @@ inline void HandleGetAssignment (Val& lhs, Val& rhs)
 }
 
 
-#define LOADARRAYHELP(T, SUB) { v.tag='n'; v.subtype=SUB; int len=byte_len/sizeof(T); Array<T>*ap=(Array<T>*)(&v.u.n); new (ap) Array<T>(len); ap->expandTo(len); memcpy(ap->data(), lc.mem, byte_len); }
+#define LOADARRAYHELP(T, SUB) { v.tag='n'; v.subtype=SUB; int len=byte_len/sizeof(T); Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>)); new (ap) Array<T>(len); ap->expandTo(len); memcpy(ap->data(), lc.mem, byte_len); }
 
 
 void P2LoadArray(Val& v, LoadContext_& lc, bool saw_memo=false)
@@ -1102,7 +1179,7 @@ void P2LoadArray(Val& v, LoadContext_& lc, bool saw_memo=false)
 }
 
 // Currently same as above
-#define LOADNUMERICHELP(T, SUB) { v.tag='n'; v.subtype=SUB; int len=byte_len/sizeof(T); Array<T>*ap=(Array<T>*)(&v.u.n); new (ap) Array<T>(len); ap->expandTo(len); memcpy(ap->data(), lc.mem, byte_len); }
+#define LOADNUMERICHELP(T, SUB) { v.tag='n'; v.subtype=SUB; int len=byte_len/sizeof(T); Array<T>*ap=(Array<T>*)v.newSpace_(sizeof(Array<T>)); new (ap) Array<T>(len); ap->expandTo(len); memcpy(ap->data(), lc.mem, byte_len); }
 
 void P2LoadNumeric(Val& v, LoadContext_& lc, bool saw_memo=false)
 {
@@ -1158,7 +1235,7 @@ void P2LoadNumeric(Val& v, LoadContext_& lc, bool saw_memo=false)
   //case 'x': LOADNUMERICHELP(int_u8,'X'); break;
   case 'l': {
     v.tag='n'; v.subtype='x'; int len=byte_len/sizeof(long); 
-    Array<int_8>*ap=(Array<int_8>*)(&v.u.n); 
+    Array<int_8>*ap=(Array<int_8>*)v.newSpace_(sizeof(Array<int_8>)); 
     new (ap) Array<int_8>(len); 
     ap->expandTo(len);
     int_8* out_data = (int_8*)ap->data();
@@ -1440,7 +1517,7 @@ inline void P2LoadArr (Val& v, LoadContext_& lc)
 inline void P2LoadComplex (Val& v, LoadContext_& lc, bool saw_mem=false)
 {
   v.tag = 'D';  // Risky; assumes Val is None
-  cx_union_t<real_8>* vp = &v.u.D;
+  cx_union_t<real_8>* vp = (cx_union_t<real_8>*)v.newSpace_(sizeof(complex_16));
   complex_16* cp = (complex_16*)vp;
   loadc16_(*cp, lc, saw_mem);
   handleAPut_(&v, lc);
@@ -1488,7 +1565,7 @@ inline bool P2LoadValue (Val& v, LoadContext_& lc)
   }
 
   case PY_SHORT_BINSTRING :
-  case PY_BINSTRING : { lc.mem--; P2LoadString((OCString*)&v.u.a, lc); v.tag='a'; break; }
+  case PY_BINSTRING : { lc.mem--; P2LoadString((OCString*)v.newSpace_(sizeof(OCString)), lc); v.tag='a'; break; }
 
   case PY_EMPTY_DICT: lc.mem--; P2LoadTab(v, lc); break;
   case PY_EMPTY_LIST: lc.mem--; P2LoadArr(v, lc); break;
@@ -4,6 +4,7 @@
 // Tools for pickling using Python Pickling protocol 2
 
 #include "ocval.h"
+#include "ocdumpsink.h"
 
 
 // ISSUE:
@@ -66,9 +67,54 @@ char* P2TopLevelDumpVal (const Val& ov, char* mem,
 // after every memory access.
 int P2TopLevelBytesToDumpVal (const Val& ov, ArrayDisposition_e dis=AS_LIST,
 			      PicklingIssues_e issues=ABOVE_PYTHON_2_2);
+
+// Or, dump onto the end of a buffer in a single pass, without
+// computing the bytes first: the buffer grows as needed.  Returns how
+// many bytes were dumped.
+size_t P2TopLevelDumpValToArray (const Val& ov, Array<char>& buffer,
+				 ArrayDisposition_e dis=AS_LIST,
+				 PicklingIssues_e issues=ABOVE_PYTHON_2_2);
+
+// Or, stream it to the sink (see ocdumpsink.h) a chunk at a time, so
+// the whole dump is never in memory at once.
+void P2TopLevelDumpValToSink (const Val& ov, DumpSink& sink,
+			      ArrayDisposition_e dis=AS_LIST,
+			      PicklingIssues_e issues=ABOVE_PYTHON_2_2,
+			      size_t chunk_bytes=OC_DUMP_CHUNK);
 int P2BytesToDumpVal (const Val& ov, ArrayDisposition_e dis=AS_LIST,
 		      PicklingIssues_e issues=ABOVE_PYTHON_2_2);
 
+
+// Pickling Protocols 4 and 5 are what Python 3 uses: these dump just
+// like the P2 routines above, but strings go as Python 3 strs (or
+// bytes, if they aren't UTF-8), and the preambles use the Python 3
+// names.  Python 2 can't load these.  (They only dump in a single
+// pass, so there's no BytesToDump for them.)
+//
+// Protocol 5 can leave big data out of the pickle altogether: given
+// an out_of_band list, the data of every POD Array dumped AS_NUMPY is
+// NOT copied into the pickle.  Instead, a PickleBuffer pointing right
+// at the Array's memory is appended to the list (like Python's
+// buffer_callback), so the data never gets copied on the way out.
+// Send the buffers along with the pickle (the PickleLoader takes them
+// back: see PickleLoader::outOfBand), and don't change the Val until
+// they've gone.
+struct PickleBuffer {
+  const char* data;
+  size_t      bytes;
+};
+size_t P4TopLevelDumpValToArray (const Val& ov, Array<char>& buffer,
+				 int protocol=4, 
+				 ArrayDisposition_e dis=AS_LIST,
+				 PicklingIssues_e issues=ABOVE_PYTHON_2_2,
+				 Array<PickleBuffer>* out_of_band=0);
+void P4TopLevelDumpValToSink (const Val& ov, DumpSink& sink,
+			      int protocol=4, 
+			      ArrayDisposition_e dis=AS_LIST,
+			      PicklingIssues_e issues=ABOVE_PYTHON_2_2,
+			      Array<PickleBuffer>* out_of_band=0,
+			      size_t chunk_bytes=OC_DUMP_CHUNK);
+
 // Load a Val from memory that heas been serialized using Python
 // Pickling Protocol 2 (the binary/fast protocol for pickling).
 char* P2TopLevelLoadVal (Val& ov, char* mem);
@@ -109,18 +109,18 @@ char ChooseNumber (const Val& v, string& arg1, string& arg2)
   case 'f' : // real_4
   case 'd' : // real_8
     {
-      choose = 'd'; real_8 d8 = v; Val vd8 = d8;
-      Str s = vd8;
-      arg1 = string(s.c_str());
+      choose = 'd'; real_8 d8 = v;
+      char b[OC_REAL_CHARS];
+      arg1 = string(b, StringizeReal(d8, b));
       break;
     }
   case 'F': // complex_8
   case 'D': // complex_16
     {
       choose = 'D'; complex_16 c16 = v;
-      Val vr =c16.re; Val vi = c16.im;
-      Str sr = vr;    Str si = vi;
-      arg1 = string(sr.c_str()); arg2 = string(si.c_str());
+      char b[OC_REAL_CHARS];
+      arg1 = string(b, StringizeReal(c16.re, b)); 
+      arg2 = string(b, StringizeReal(c16.im, b));
       break;
     }
   case 'q': // int_n
@@ -50,7 +50,7 @@ inline void TableSet (Val& table, const Val& key, const Val& value)
 // mostly.
 inline Val MakeTuple (bool compat) 
 { if (compat) return Arr(); else return Tup(); }
-inline void TupleAppend (const Val& tuple, const Val& value)
+inline void TupleAppend (Val& tuple, const Val& value)
 { 
   if (tuple.tag=='u') { // Allows both compatibility modes
     Tup& a=tuple; a.impl().append(value); 
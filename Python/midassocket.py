@@ -41,6 +41,12 @@ SERIALIZE_P2_OLD = SERIALIZE_PYTHON_PICKLING_PROTOCOL_2_AS_PYTHON_2_2_WOULD
 
 from arraydisposition import *
 
+# A framed message (which the C++ MidasSocket_ can send) has this where
+# the length would be: then the usual header, then the serialized data
+# as frames (a 4-byte length in network order, then that many bytes),
+# ending with an empty frame.
+MIDASSOCKET_FRAMED = 0xFFFFFFFFL
+
 # Do you use two sockets or 1 socket for full duplex communication?
 # Some very old versions (VMWARE) only supported single duplex sockets,
 # and so full duplex sockets had to be emulated with 2 sockets.
@@ -208,6 +214,7 @@ class MidasSocket_ :
 
         # Do we have a header?  If we do, do we count it?
         (unpack_bytes,) = struct.unpack("!I", bytes)
+        framed = (unpack_bytes == MIDASSOCKET_FRAMED)
         if (hdr[:2]=='PY' and hdr[2] in 'AN0U' and hdr[3] in '-02') :
             # legal 
             read_bytes = unpack_bytes
@@ -231,10 +238,25 @@ serialization to Python 0 or 2""")
             read_bytes = unpack_bytes - 4
             already_read = hdr
 
-        data = already_read+self.readExact_(fd, read_bytes) #get message
+        if framed :
+            data = already_read+self.readFrames_(fd)
+        else :
+            data = already_read+self.readExact_(fd, read_bytes) #get message
         return self.unpackageData_(data)
 
 
+    def readFrames_(self, fd):
+        """Read the frames of a framed message (each an unsigned
+        4-byte length in network order, then that many bytes) up to
+        the empty frame that ends it."""
+        frames = []
+        while 1 :
+            (frame,) = struct.unpack("!I", self.readExact_(fd, 4))
+            if frame == 0 : break
+            frames.append(self.readExact_(fd, frame))
+        return "".join(frames)
+
+
     def readExact_(self, fd, bytes):
         """Read exactly the given number of bytes from the socket
         (blocking)."""